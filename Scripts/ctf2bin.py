@@ -13,6 +13,10 @@
 #   <matrix type> is the matrix type, i.e., dense or sparse
 #   <sample dimension> is the dimension of each sample for the input
 #
+# For large inputs, consider the native converter (ctf2cbf, built from
+# Source/Readers/CTFToCBFConverter), which accepts the same header file and
+# arguments, and parses the input in parallel.
+#
 
 import sys
 import argparse
@@ -0,0 +1,522 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include "DistributedCommunicator.h"
+
+namespace CNTK
+{
+    // =======================================================================
+    // SparsifiedMPICommunicatorImpl -- top-k gradient sparsification with error feedback.
+    // Every worker owns a column stripe of each gradient (the same striping as the 1-bit
+    // QuantizedMPICommunicatorImpl). Instead of quantizing all entries, each worker sends to the
+    // owner of a stripe only the largest-magnitude entries of its stripe as (index, value) pairs.
+    // The owner sums them into its own (exact) stripe, sparsifies the aggregate once more and
+    // broadcasts the selected entries back. Everything that is not sent stays in the value or
+    // stripe residuals and is added to the gradient of the next step (error feedback).
+    //
+    // The number of entries sent per stripe is density * stripe size. If a target number of bytes
+    // per step is given, the density is adapted after every step such that the bytes actually sent
+    // by this worker track the target.
+    // =======================================================================
+    class SparsifiedMPICommunicatorImpl final : public MPICommunicatorImpl, public QuantizedDistributedCommunicator
+    {
+        using Base = MPICommunicatorImpl;
+
+        template<class T> using vector = std::vector<T>;
+        template<class T> using shared_ptr = std::shared_ptr<T>;
+        template<class T> using unordered_set = std::unordered_set<T>;
+        template<class T> using Matrix = Microsoft::MSR::CNTK::Matrix<T>;
+
+        using MpiFail = Microsoft::MSR::CNTK::MpiFail;
+
+        // A single transmitted gradient entry. The first entry of every message is a header whose
+        // m_index holds the number of entries that follow.
+        template <class ElemType>
+        struct SparseEntry
+        {
+            uint32_t m_index;
+            ElemType m_value;
+        };
+
+        // Smallest density we adapt down to, so that every stripe still carries some signal.
+        static constexpr double MinDensity = 1e-6;
+        // Number of magnitudes sampled per stripe when estimating the selection threshold.
+        static constexpr size_t ThresholdSampleSize = 4096;
+
+    public:
+        SparsifiedMPICommunicatorImpl(double density, size_t targetBytesPerStep, bool useSampledThreshold)
+            : m_density(density), m_targetBytesPerStep(targetBytesPerStep), m_useSampledThreshold(useSampledThreshold), m_densityInitialized(targetBytesPerStep == 0), m_lastBytesSent(0)
+        {
+            if (!(density > 0 && density <= 1))
+                InvalidArgument("SparsifiedMPICommunicator: density (%g) must be in the range (0, 1].", density);
+        }
+
+        void QuantizedAggregateInPlace(
+            std::vector<NDArrayViewPtr>& inValues,
+            std::vector<NDArrayViewPtr>& valueQuantizationResidues,
+            std::vector<NDArrayViewPtr>& stripeQuantizationResidues,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            QuantizedAggregate(
+                inValues, valueQuantizationResidues, stripeQuantizationResidues,
+                inValues, valueQuantizationResidues, stripeQuantizationResidues,
+                sendToWorkers);
+        }
+
+        // A collective communication API to perform sparsified aggregation of values across all workers of this communicator.
+        // The residues play the same role as for the quantized aggregation: they keep whatever has not been sent yet.
+        void QuantizedAggregate(
+            const vector<NDArrayViewPtr>& inValues,
+            const vector<NDArrayViewPtr>& valueQuantizationResidues,
+            const vector<NDArrayViewPtr>& stripeQuantizationResidues,
+            vector<NDArrayViewPtr>& aggregatedOutputs,
+            vector<NDArrayViewPtr>& newQuantizationResidues,
+            vector<NDArrayViewPtr>& newStripeQuantizationResidues,
+            const unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            CheckWorkers(sendToWorkers);
+
+            if (Workers().size() == 1) // No need to aggregate anything.
+            {
+                aggregatedOutputs = inValues;
+                newQuantizationResidues = valueQuantizationResidues;
+                newStripeQuantizationResidues = stripeQuantizationResidues;
+                return;
+            }
+
+            if (inValues.empty())
+                return;
+
+            DataType dataType = inValues.front()->GetDataType();
+            for (const auto& v : inValues)
+            {
+                if (v->GetDataType() != dataType)
+                    RuntimeError("Currently values of different types are not supported for sparsified aggregation.");
+            }
+
+            if (dataType == DataType::Float)
+                SparsifiedAggregate<float>(inValues, valueQuantizationResidues, stripeQuantizationResidues, aggregatedOutputs, newQuantizationResidues, newStripeQuantizationResidues);
+            else if (dataType == DataType::Double)
+                SparsifiedAggregate<double>(inValues, valueQuantizationResidues, stripeQuantizationResidues, aggregatedOutputs, newQuantizationResidues, newStripeQuantizationResidues);
+            else
+                LogicError("Unexpected type value.");
+        }
+
+        // Fraction of the entries of each stripe that is currently selected for sending.
+        double CurrentDensity() const { return m_density; }
+
+        // Number of bytes this worker sent during the last aggregation.
+        size_t LastBytesSent() const { return m_lastBytesSent; }
+
+        // Redefining inherited members.
+        // TODO: Use using and virtual inheritance after switching to VS2015.
+        const std::unordered_set<DistributedWorkerDescriptor>& Workers() const override { return Base::Workers(); }
+        const DistributedWorkerDescriptor& CurrentWorker() const override { return Base::CurrentWorker(); }
+        DistributedCommunicatorPtr SubGroup(const std::unordered_set<DistributedWorkerDescriptor>& g) const override { return Base::SubGroup(g); }
+        void Concatenate(
+            const std::vector<ValuePtr>& in,
+            std::vector<ValuePtr>& out,
+            const std::unordered_set<DistributedWorkerDescriptor>& w) override
+        {
+            Base::Concatenate(in, out, w);
+        }
+
+        void AggregateInPlace(
+            const std::vector<NDArrayViewPtr>& values,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            Base::AggregateInPlace(values, sendToWorkers);
+        }
+
+        void Aggregate(
+            const std::vector<NDArrayViewPtr>& values,
+            std::vector<NDArrayViewPtr>& outputValues,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            Base::Aggregate(values, outputValues, sendToWorkers);
+        }
+
+        void Barrier() override
+        {
+            Base::Barrier();
+        }
+
+        virtual void Concatenate(
+            const std::vector<NDArrayViewPtr>& input,
+            std::vector<NDArrayViewPtr>& output,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            Base::Concatenate(input, output, sendToWorkers);
+        }
+
+        virtual void Gather(
+            const Dictionary& input,
+            std::vector<DictionaryPtr>& output,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override
+        {
+            Base::Gather(input, output, sendToWorkers);
+        }
+
+    private:
+        struct Stripe
+        {
+            size_t m_startCol;
+            size_t m_numCols;
+        };
+
+        // Determine which stripe of the gradient is this node responsible for
+        Stripe GetStripeForNode(size_t numCols, size_t nodeRank, size_t numNodes)
+        {
+            size_t numColsPerNode = numCols / numNodes;
+            size_t residue = numCols % numNodes;
+            size_t startColNumofStripe = (numColsPerNode * nodeRank) + min(residue, nodeRank);
+            size_t numColsinStripe = numColsPerNode + ((nodeRank < residue) ? 1 : 0);
+            return Stripe{ startColNumofStripe, numColsinStripe };
+        }
+
+        size_t NumEntriesToSend(size_t stripeSize) const
+        {
+            return std::min(stripeSize, std::max<size_t>(1, (size_t)std::ceil(m_density * stripeSize)));
+        }
+
+        // Makes sure the residues exist. Residues are allocated on the device of the value and zero initialized.
+        template <class ElemType>
+        void InitializeResidue(const NDArrayViewPtr& value, size_t numCols, NDArrayViewPtr& residue, NDArrayViewPtr& newResidue)
+        {
+            if (residue)
+            {
+                if (!newResidue)
+                    newResidue = residue;
+                return;
+            }
+
+            auto v = GetMatrix<ElemType>(value);
+            residue = MakeSharedObject<NDArrayView>(AsDataType<ElemType>(), NDShape{ v->GetNumRows(), numCols }, AsDeviceDescriptor(v->GetDeviceId()));
+            residue->SetValue((ElemType)0);
+            newResidue = residue;
+        }
+
+        // Selects the entries of values[0..n) to be sent and appends them to 'out', preceded by a header entry.
+        // Selected entries are zeroed in 'values', so that what remains is the error-feedback residual.
+        // With exact selection exactly min(k, #non-zeros) entries are sent; with sampled selection the threshold
+        // is estimated from a strided sample and the number of entries sent only approximates k.
+        template <class ElemType>
+        void Sparsify(ElemType* values, size_t n, size_t k, vector<SparseEntry<ElemType>>& out, vector<ElemType>& scratch)
+        {
+            if (n > std::numeric_limits<uint32_t>::max())
+                LogicError("SparsifiedMPICommunicator: stripes with more than 2^32 elements are not supported.");
+
+            size_t headerPos = out.size();
+            out.push_back(SparseEntry<ElemType>{ 0, 0 });
+
+            ElemType threshold = 0;
+            size_t numTies = k;
+            if (k < n)
+            {
+                size_t step = m_useSampledThreshold ? std::max<size_t>(1, n / ThresholdSampleSize) : 1;
+                scratch.clear();
+                for (size_t j = 0; j < n; j += step)
+                    scratch.push_back(std::abs(values[j]));
+
+                size_t numSampled = scratch.size();
+                size_t numAbove = std::min(numSampled - 1, (size_t)((double)k * numSampled / n));
+                auto nth = scratch.begin() + (numSampled - 1 - numAbove);
+                std::nth_element(scratch.begin(), nth, scratch.end());
+                threshold = *nth;
+
+                if (m_useSampledThreshold)
+                    numTies = n; // take everything at or above the estimate
+                else
+                    numTies = k - std::count_if(nth + 1, scratch.end(), [threshold](ElemType a) { return a > threshold; });
+            }
+
+            for (size_t j = 0; j < n; ++j)
+            {
+                ElemType a = std::abs(values[j]);
+                if (a == 0)
+                    continue;
+
+                bool select = a > threshold;
+                if (!select && a == threshold && numTies > 0)
+                {
+                    select = true;
+                    numTies--;
+                }
+
+                if (select)
+                {
+                    out.push_back(SparseEntry<ElemType>{ (uint32_t)j, values[j] });
+                    values[j] = 0;
+                }
+            }
+
+            out[headerPos].m_index = (uint32_t)(out.size() - headerPos - 1);
+        }
+
+        template <class ElemType>
+        static void Accumulate(const SparseEntry<ElemType>* message, ElemType* dst)
+        {
+            size_t count = message[0].m_index;
+            for (size_t j = 1; j <= count; ++j)
+                dst[message[j].m_index] += message[j].m_value;
+        }
+
+        template <class ElemType>
+        static int MessageBytes(const vector<SparseEntry<ElemType>>& message)
+        {
+            return (int)(message.size() * sizeof(SparseEntry<ElemType>));
+        }
+
+        template <class ElemType>
+        static void CopyToBuffer(const Matrix<ElemType>& m, vector<ElemType>& buffer)
+        {
+            buffer.resize(m.GetNumElements());
+            if (!buffer.empty())
+                m.CopySection(m.GetNumRows(), m.GetNumCols(), buffer.data(), m.GetNumRows());
+        }
+
+        // On the first step with a byte target, derive the density from the total number of entries:
+        // a worker sends (N-1)/N of every gradient in the reduce phase and its own stripe N-1 times in the broadcast phase.
+        template <class ElemType>
+        void InitializeDensity(const vector<NDArrayViewPtr>& inValues, size_t numWorkers)
+        {
+            if (m_densityInitialized)
+                return;
+
+            size_t totalElements = 0;
+            for (const auto& v : inValues)
+                totalElements += v->Shape().TotalSize();
+
+            double entriesPerStep = 2.0 * (numWorkers - 1) / numWorkers * totalElements;
+            if (entriesPerStep > 0)
+                m_density = std::max((double)MinDensity, std::min(1.0, m_targetBytesPerStep / (entriesPerStep * sizeof(SparseEntry<ElemType>))));
+            m_densityInitialized = true;
+        }
+
+        void AdaptDensity(size_t bytesSent)
+        {
+            m_lastBytesSent = bytesSent;
+            if (m_targetBytesPerStep == 0 || bytesSent == 0)
+                return;
+
+            // Damped multiplicative update towards the byte target.
+            double ratio = std::max(0.5, std::min(2.0, (double)m_targetBytesPerStep / bytesSent));
+            m_density = std::max((double)MinDensity, std::min(1.0, m_density * ratio));
+        }
+
+        template<class ElemType>
+        void SparsifiedAggregate(
+            const vector<NDArrayViewPtr>& inValues,
+            const vector<NDArrayViewPtr>& formalValueQuantizationResidues,
+            const vector<NDArrayViewPtr>& formalStripeQuantizationResidues,
+            vector<NDArrayViewPtr>& aggregatedOutputs,
+            vector<NDArrayViewPtr>& newQuantizationResidues,
+            vector<NDArrayViewPtr>& newStripeQuantizationResidues)
+        {
+            const int numWorkers = static_cast<int>(Workers().size());
+            const int rank = static_cast<int>(CurrentWorker().m_globalRank);
+            const int numValues = static_cast<int>(inValues.size());
+
+            auto valueResidues = formalValueQuantizationResidues;
+            auto stripeResidues = formalStripeQuantizationResidues;
+            valueResidues.resize(numValues);
+            stripeResidues.resize(numValues);
+            newQuantizationResidues.resize(numValues);
+            newStripeQuantizationResidues.resize(numValues);
+            if (aggregatedOutputs.size() != inValues.size())
+                LogicError("Number of aggregated outputs should be equal to the number of values.");
+
+            InitializeDensity<ElemType>(inValues, numWorkers);
+
+            m_sendBuffers.resize(numValues);
+            m_recvBuffers.resize(numValues);
+            size_t bytesSent = 0;
+
+            // Accumulated gradients (gradient + residual), brought to the CPU.
+            vector<vector<ElemType>> accumulated(numValues);
+            vector<ElemType> scratch, residue;
+
+            // Reduce phase: post receives for the stripe this worker owns, then sparsify and send the other stripes.
+            vector<MPI_Request> recvRequests;
+            vector<MPI_Request> sendRequests;
+            for (int i = 0; i < numValues; ++i)
+            {
+                if (inValues[i]->GetStorageFormat() != StorageFormat::Dense)
+                    RuntimeError("Sparsified aggregation for sparse matrices is currently not supported!");
+
+                auto value = GetMatrix<ElemType>(inValues[i]);
+                size_t nRow = value->GetNumRows();
+                size_t nCol = value->GetNumCols();
+
+                Stripe ownStripe = GetStripeForNode(nCol, rank, numWorkers);
+                InitializeResidue<ElemType>(inValues[i], nCol, valueResidues[i], newQuantizationResidues[i]);
+                if (ownStripe.m_numCols > 0)
+                    InitializeResidue<ElemType>(inValues[i], ownStripe.m_numCols, stripeResidues[i], newStripeQuantizationResidues[i]);
+
+                auto& recvBuffers = GetBuffers<ElemType>(m_recvBuffers[i]);
+                recvBuffers.resize(numWorkers);
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    if (j == rank || ownStripe.m_numCols == 0)
+                        continue;
+
+                    recvBuffers[j].resize(nRow * ownStripe.m_numCols + 1);
+                    recvRequests.push_back(MPI_Request());
+                    m_mpi->Irecv(recvBuffers[j].data(), MessageBytes(recvBuffers[j]), MPI_CHAR, j, i, &recvRequests.back()) || MpiFail("MPI_Irecv");
+                }
+
+                CopyToBuffer(*value, accumulated[i]);
+                CopyToBuffer(*GetMatrix<ElemType>(valueResidues[i]), residue);
+                for (size_t j = 0; j < accumulated[i].size(); ++j)
+                    accumulated[i][j] += residue[j];
+
+                auto& sendBuffers = GetBuffers<ElemType>(m_sendBuffers[i]);
+                sendBuffers.resize(numWorkers);
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    Stripe stripe = GetStripeForNode(nCol, j, numWorkers);
+                    if (j == rank || stripe.m_numCols == 0)
+                        continue;
+
+                    size_t stripeSize = nRow * stripe.m_numCols;
+                    sendBuffers[j].clear();
+                    Sparsify(accumulated[i].data() + nRow * stripe.m_startCol, stripeSize, NumEntriesToSend(stripeSize), sendBuffers[j], scratch);
+                    bytesSent += MessageBytes(sendBuffers[j]);
+
+                    sendRequests.push_back(MPI_Request());
+                    m_mpi->Isend(sendBuffers[j].data(), MessageBytes(sendBuffers[j]), MPI_CHAR, j, i, &sendRequests.back()) || MpiFail("MPI_Isend");
+                }
+            }
+
+            if (!recvRequests.empty())
+                m_mpi->Waitall((int)recvRequests.size(), recvRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            // Broadcast phase: sum the received entries into the own stripe, which is kept exact, add the stripe residual
+            // and send the selected entries of the aggregate to everybody else.
+            m_recvAggBuffers.resize(numValues);
+            vector<MPI_Request> recvAggRequests;
+            vector<vector<ElemType>> aggregated(numValues);
+            for (int i = 0; i < numValues; ++i)
+            {
+                auto value = GetMatrix<ElemType>(inValues[i]);
+                size_t nRow = value->GetNumRows();
+                size_t nCol = value->GetNumCols();
+                Stripe ownStripe = GetStripeForNode(nCol, rank, numWorkers);
+
+                auto& recvAggBuffers = GetBuffers<ElemType>(m_recvAggBuffers[i]);
+                recvAggBuffers.resize(numWorkers);
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    Stripe stripe = GetStripeForNode(nCol, j, numWorkers);
+                    if (j == rank || stripe.m_numCols == 0)
+                        continue;
+
+                    recvAggBuffers[j].resize(nRow * stripe.m_numCols + 1);
+                    recvAggRequests.push_back(MPI_Request());
+                    m_mpi->Irecv(recvAggBuffers[j].data(), MessageBytes(recvAggBuffers[j]), MPI_CHAR, j, numValues + 1 + i, &recvAggRequests.back()) || MpiFail("MPI_Irecv");
+                }
+
+                aggregated[i].assign(nRow * nCol, 0);
+                if (ownStripe.m_numCols == 0)
+                    continue;
+
+                size_t stripeSize = nRow * ownStripe.m_numCols;
+                ElemType* own = accumulated[i].data() + nRow * ownStripe.m_startCol;
+                vector<ElemType> stripeSum(own, own + stripeSize);
+                std::fill(own, own + stripeSize, (ElemType)0); // the own stripe is consumed in full
+                auto& recvBuffers = GetBuffers<ElemType>(m_recvBuffers[i]);
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    if (j != rank)
+                        Accumulate(recvBuffers[j].data(), stripeSum.data());
+                }
+
+                CopyToBuffer(*GetMatrix<ElemType>(stripeResidues[i]), residue);
+                for (size_t j = 0; j < stripeSize; ++j)
+                    stripeSum[j] += residue[j];
+
+                auto& broadcastBuffer = GetBuffers<ElemType>(m_sendBuffers[i])[rank];
+                broadcastBuffer.clear();
+                Sparsify(stripeSum.data(), stripeSize, NumEntriesToSend(stripeSize), broadcastBuffer, scratch);
+                Accumulate(broadcastBuffer.data(), aggregated[i].data() + nRow * ownStripe.m_startCol);
+
+                GetWritableMatrix<ElemType>(newStripeQuantizationResidues[i])->SetValue(nRow, ownStripe.m_numCols, GetMatrix<ElemType>(stripeResidues[i])->GetDeviceId(), stripeSum.data());
+
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    if (j == rank)
+                        continue;
+
+                    bytesSent += MessageBytes(broadcastBuffer);
+                    sendRequests.push_back(MPI_Request());
+                    m_mpi->Isend(broadcastBuffer.data(), MessageBytes(broadcastBuffer), MPI_CHAR, j, numValues + 1 + i, &sendRequests.back()) || MpiFail("MPI_Isend");
+                }
+            }
+
+            if (!recvAggRequests.empty())
+                m_mpi->Waitall((int)recvAggRequests.size(), recvAggRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            // Scatter the received stripes into the dense outputs and store the new residuals.
+            for (int i = 0; i < numValues; ++i)
+            {
+                auto value = GetMatrix<ElemType>(inValues[i]);
+                size_t nRow = value->GetNumRows();
+                size_t nCol = value->GetNumCols();
+
+                auto& recvAggBuffers = GetBuffers<ElemType>(m_recvAggBuffers[i]);
+                for (int j = 0; j < numWorkers; ++j)
+                {
+                    Stripe stripe = GetStripeForNode(nCol, j, numWorkers);
+                    if (j != rank && stripe.m_numCols > 0)
+                        Accumulate(recvAggBuffers[j].data(), aggregated[i].data() + nRow * stripe.m_startCol);
+                }
+
+                GetWritableMatrix<ElemType>(newQuantizationResidues[i])->SetValue(nRow, nCol, value->GetDeviceId(), accumulated[i].data());
+                GetWritableMatrix<ElemType>(aggregatedOutputs[i])->SetValue(nRow, nCol, value->GetDeviceId(), aggregated[i].data());
+            }
+
+            if (!sendRequests.empty())
+                m_mpi->Waitall((int)sendRequests.size(), sendRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            AdaptDensity(bytesSent);
+        }
+
+        // Per value and per peer message buffers, kept between calls to avoid reallocation.
+        // Stored type-erased since the communicator serves both float and double gradients.
+        template <class ElemType>
+        vector<vector<SparseEntry<ElemType>>>& GetBuffers(shared_ptr<void>& holder)
+        {
+            if (!holder)
+                holder = std::make_shared<vector<vector<SparseEntry<ElemType>>>>();
+            return *static_cast<vector<vector<SparseEntry<ElemType>>>*>(holder.get());
+        }
+
+        // Fraction of the entries of every stripe that are sent.
+        double m_density;
+
+        // If non-zero, the density is adapted such that this worker sends about this many bytes per aggregation.
+        const size_t m_targetBytesPerStep;
+
+        // Estimate the selection threshold from a sample instead of an exact top-k selection.
+        const bool m_useSampledThreshold;
+
+        bool m_densityInitialized;
+        size_t m_lastBytesSent;
+
+        vector<shared_ptr<void>> m_sendBuffers;
+        vector<shared_ptr<void>> m_recvBuffers;
+        vector<shared_ptr<void>> m_recvAggBuffers;
+    };
+}
@@ -59,6 +59,10 @@ void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config);
+template <typename ElemType>
+void DoCompressModel(const ConfigParameters& config);
+template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
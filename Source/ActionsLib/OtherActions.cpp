@@ -16,6 +16,10 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "BestGpu.h"
+#include "SGD.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
 
 #include <string>
 #include <chrono>
@@ -203,6 +207,244 @@ void DoParameterSVD(const ConfigParameters& config)
 template void DoParameterSVD<float>(const ConfigParameters& config);
 template void DoParameterSVD<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoOptimizeForInference() - implements CNTK "optimizeForInference" command
+// ===========================================================================
+
+//////////////////////////////////////////////////////////////////////////
+//  for action optimizeForInference
+//      Rewrites an existing model for inference (see ComputationNetwork::OptimizeForInference()):
+//      BatchNormalization nodes are folded into the weights of a preceding Convolution or Times,
+//      subgraphs that only depend on parameters are precomputed, and nodes the outputs do not depend on are removed.
+//      The forward pass of the model is timed before and after on random inputs.
+//
+//      To use this command,
+//          user need to specify:
+//                  1)  modelPath           -- path to the existing model
+//                  2)  outputModelPath     -- where to write the optimized model
+//                  3)  outputNodeNames     -- (optional) the outputs to keep; default: the output nodes of the model
+//                  4)  minibatchSize       -- (optional) number of samples the forward pass is timed with; default: 32
+//                  5)  numTimedPasses      -- (optional) number of timed forward passes; default: 20, 0 to skip timing
+//
+//////////////////////////////////////////////////////////////////////////
+
+// average time of a forward pass over random dense inputs, in seconds; -1 if the model has inputs this can't make up
+template <typename ElemType>
+static double TimeForwardPass(const ComputationNetworkPtr& net, const vector<wstring>& outputNodeNames, size_t minibatchSize, size_t numPasses,
+                              map<wstring, double>* nodeLatencies = nullptr)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto outputNodes = net->OutputNodesByName(outputNodeNames);
+    auto inputNodes = net->InputNodesForOutputs(outputNodeNames);
+    // nodes are timed by running them again after the full passes, so their inputs must not be overwritten by other nodes
+    if (nodeLatencies)
+        for (const auto& node : net->GetAllNodes())
+            node->MarkValueNonSharable();
+    net->AllocateAllMatrices({}, outputNodes, nullptr);
+    net->StartEvaluateMinibatchLoop(outputNodes);
+
+    for (const auto& node : inputNodes)
+    {
+        auto value = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        if (!value || value->GetMatrixType() != MatrixType::DENSE || !node->HasMBLayout())
+            return -1;
+        value->Resize(node->GetSampleLayout().GetNumElements(), minibatchSize);
+        value->SetUniformRandomValue(-1, 1, /*seed=*/1);
+        node->GetMBLayout()->Init(1, minibatchSize);
+        node->GetMBLayout()->AddSequence(0, 0, 0, minibatchSize);
+    }
+
+    auto forwardPass = [&]()
+    {
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        net->ForwardProp(outputNodes);
+        dynamic_pointer_cast<Matrix<ElemType>>(outputNodes[0]->ValuePtr())->Get00Element(); // wait for the device
+    };
+    forwardPass(); // (warm-up)
+    auto startTime = chrono::steady_clock::now();
+    for (size_t i = 0; i < numPasses; i++)
+        forwardPass();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+
+    // Times and Convolution nodes outside of loops, each on its own
+    if (nodeLatencies)
+    {
+        set<ComputationNodeBasePtr> timedNodes;
+        for (const auto& output : outputNodes)
+        {
+            for (const auto& node : net->GetEvalOrder(output))
+            {
+                if (node->IsPartOfLoop() || !timedNodes.insert(node).second ||
+                    (node->OperationName() != OperationNameOf(TimesNode) && node->OperationName() != OperationNameOf(ConvolutionNode)))
+                    continue;
+
+                auto nodeForwardProp = [&]()
+                {
+                    node->BeginForwardProp();
+                    node->ForwardProp(FrameRange(node->GetMBLayout()));
+                    node->EndForwardProp();
+                    dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr())->Get00Element(); // wait for the device
+                };
+                nodeForwardProp(); // (warm-up)
+                auto nodeStartTime = chrono::steady_clock::now();
+                for (size_t i = 0; i < numPasses; i++)
+                    nodeForwardProp();
+                chrono::duration<double> nodeElapsed = chrono::steady_clock::now() - nodeStartTime;
+                (*nodeLatencies)[node->NodeName()] = nodeElapsed.count() / numPasses;
+            }
+        }
+    }
+    return elapsed.count() / numPasses;
+}
+
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    ConfigArray outputNodeNamesConfig = config(L"outputNodeNames", "");
+    size_t minibatchSize = config(L"minibatchSize", "32");
+    size_t numTimedPasses = config(L"numTimedPasses", "20");
+
+    if (modelPath.empty())
+        InvalidArgument("optimizeForInference: modelPath is empty.");
+    if (outputModelPath.empty())
+        InvalidArgument("optimizeForInference: outputModelPath is empty.");
+
+    vector<wstring> outputNodeNames;
+    for (int i = 0; i < outputNodeNamesConfig.size(); ++i)
+        outputNodeNames.push_back(outputNodeNamesConfig[i]);
+
+    // the original model is timed on its own instance, since a network can only be allocated once
+    double latencyBefore = -1;
+    if (numTimedPasses > 0)
+    {
+        ComputationNetworkPtr net = make_shared<ComputationNetwork>(deviceId);
+        net->Load<ElemType>(modelPath);
+        latencyBefore = TimeForwardPass<ElemType>(net, outputNodeNames, minibatchSize, numTimedPasses);
+    }
+
+    ComputationNetworkPtr net = make_shared<ComputationNetwork>(deviceId);
+    net->Load<ElemType>(modelPath);
+    net->OptimizeForInference<ElemType>(outputNodeNames);
+    net->Save(outputModelPath);
+
+    if (latencyBefore >= 0)
+    {
+        double latencyAfter = TimeForwardPass<ElemType>(net, outputNodeNames, minibatchSize, numTimedPasses);
+        fprintf(stderr, "optimizeForInference: forward pass of %d samples took %.3f ms before and %.3f ms after optimization (%+.1f%%).\n",
+                (int)minibatchSize, latencyBefore * 1000, latencyAfter * 1000, (latencyAfter / latencyBefore - 1) * 100);
+    }
+    else if (numTimedPasses > 0)
+        fprintf(stderr, "optimizeForInference: forward pass not timed, the model has inputs that are sparse or have no dynamic axis.\n");
+}
+
+template void DoOptimizeForInference<float>(const ConfigParameters& config);
+template void DoOptimizeForInference<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoCompressModel() - implements CNTK "compressModel" command
+// ===========================================================================
+
+// Shrinks the Times and Convolution layers of a model until it meets a latency or FLOP budget, by low-rank
+// factorization and filter pruning (see ComputationNetwork::CompressForBudget()). Parameters:
+//  - modelPath, outputModelPath: the model to compress, and where to write the result
+//  - outputNodeNames: the outputs to compress for (default: the output nodes of the model)
+//  - latencyBudget: forward-pass time in ms for a minibatch of minibatchSize random samples on the device
+//  - flopBudget: Times and Convolution operations per sample, in millions
+//  - alignedSize: kept ranks and filter counts are multiples of this (default: 8)
+//  - maxLayerError: largest part of the squared norm of a layer's weights that may be discarded (default: 0.5)
+//  - minibatchSize, numTimedPasses: for profiling the latency of the network and its nodes
+// If an SGD section is given, the compressed model is fine-tuned on the data of 'reader' (and 'cvReader').
+template <typename ElemType>
+void DoCompressModel(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    ConfigArray outputNodeNamesConfig = config(L"outputNodeNames", "");
+    double latencyBudget = config(L"latencyBudget", "0");
+    double flopBudget = config(L"flopBudget", "0");
+    size_t minibatchSize = config(L"minibatchSize", "32");
+    size_t numTimedPasses = config(L"numTimedPasses", "20");
+
+    if (modelPath.empty())
+        InvalidArgument("compressModel: modelPath is empty.");
+    if (outputModelPath.empty())
+        InvalidArgument("compressModel: outputModelPath is empty.");
+    if (latencyBudget <= 0 && flopBudget <= 0)
+        InvalidArgument("compressModel: Either latencyBudget (in ms) or flopBudget (in millions of operations per sample) must be given.");
+
+    vector<wstring> outputNodeNames;
+    for (int i = 0; i < outputNodeNamesConfig.size(); ++i)
+        outputNodeNames.push_back(outputNodeNamesConfig[i]);
+
+    ComputationNetwork::CompressionBudget budget;
+    budget.m_latency = latencyBudget / 1000;
+    budget.m_flops = flopBudget * 1e6;
+    budget.m_alignment = config(L"alignedSize", "8");
+    budget.m_maxLayerError = config(L"maxLayerError", "0.5");
+
+    // the model is profiled on its own instance, since a network can only be allocated once
+    if (numTimedPasses > 0)
+    {
+        ComputationNetworkPtr net = make_shared<ComputationNetwork>(deviceId);
+        net->Load<ElemType>(modelPath);
+        budget.m_profiledLatency = TimeForwardPass<ElemType>(net, outputNodeNames, minibatchSize, numTimedPasses, &budget.m_nodeLatencies);
+        if (budget.m_profiledLatency < 0)
+        {
+            budget.m_profiledLatency = 0;
+            budget.m_nodeLatencies.clear();
+        }
+    }
+    if (budget.m_latency > 0 && budget.m_profiledLatency <= 0)
+        InvalidArgument("compressModel: A latencyBudget requires profiling (numTimedPasses > 0) of a model whose inputs are dense and have a dynamic axis.");
+
+    // compressed on the CPU, where the SVD is computed
+    ComputationNetworkPtr net = make_shared<ComputationNetwork>(CPUDEVICE);
+    net->Load<ElemType>(modelPath);
+    net->CompressForBudget<ElemType>(outputNodeNames, budget);
+    net->Save(outputModelPath);
+
+    if (budget.m_profiledLatency > 0)
+    {
+        ComputationNetworkPtr compressedNet = make_shared<ComputationNetwork>(deviceId);
+        compressedNet->Load<ElemType>(outputModelPath);
+        double latencyAfter = TimeForwardPass<ElemType>(compressedNet, outputNodeNames, minibatchSize, numTimedPasses);
+        fprintf(stderr, "compressModel: forward pass of %d samples took %.3f ms before and %.3f ms after compression (%+.1f%%).\n",
+                (int)minibatchSize, budget.m_profiledLatency * 1000, latencyAfter * 1000, (latencyAfter / budget.m_profiledLatency - 1) * 100);
+    }
+
+    if (!config.Exists(L"SGD"))
+        return;
+
+    // fine-tune, writing the model to outputModelPath rather than to the modelPath of the command
+    ConfigParameters configSGD(config(L"SGD"));
+    if (!configSGD.ExistsCurrent("modelPath"))
+        configSGD.Insert("modelPath", msra::strfun::utf8(outputModelPath));
+
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    auto dataReader = make_shared<DataReader>(readerConfig);
+
+    shared_ptr<DataReader> cvDataReader;
+    ConfigParameters cvReaderConfig(config(L"cvReader", L""));
+    if (cvReaderConfig.size() != 0)
+    {
+        cvReaderConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+        cvDataReader = make_shared<DataReader>(cvReaderConfig);
+    }
+
+    ComputationNetworkPtr fineTunedNet = ComputationNetwork::CreateFromFile<ElemType>(deviceId, outputModelPath);
+    SGD<ElemType> sgd(configSGD);
+    sgd.InitMPI(MPIWrapper::GetInstance());
+    sgd.Train(fineTunedNet, deviceId, dataReader.get(), cvDataReader.get(), /*startEpoch=*/0, /*loadNetworkFromCheckpoint=*/false);
+}
+
+template void DoCompressModel<float>(const ConfigParameters& config);
+template void DoCompressModel<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoWriteWordAndClassInfo() - implements CNTK "writeWordAndClass" command
 // ===========================================================================
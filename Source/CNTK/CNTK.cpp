@@ -82,6 +82,13 @@ void SetupProfiling(ProfilerContext& profilerContext, const ConfigParamType& con
                              config(L"profilerBufferSize", static_cast<uint64_t>(32 * 1024 * 1024)),
                              std::to_wstring(nodeRank),
                              config(L"profilerSyncGpu", true));
+
+        // Trace mode keeps the most recent events in a ring buffer and records per-node spans.
+        if (config(L"profilerTrace", false))
+        {
+            ProfilerTraceMode(true, (unsigned int)config(L"profilerTraceSamplingPeriod", static_cast<uint64_t>(1)));
+            Globals::SetNodeTiming(true);
+        }
     }
 }
 
@@ -341,6 +348,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoParameterSVD<ElemType>(commandParams);
                 }
+                else if (thisAction == "optimizeForInference")
+                {
+                    DoOptimizeForInference<ElemType>(commandParams);
+                }
+                else if (thisAction == "compressModel")
+                {
+                    DoCompressModel<ElemType>(commandParams);
+                }
                 else
                 {
                     RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -512,6 +527,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetCompiledPlanCaching(config(L"cacheCompiledPlans", false));
+    Globals::SetDirectConvolution(config(L"directConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -664,6 +681,8 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetCompiledPlanCaching(config(L"cacheCompiledPlans", false));
+    Globals::SetDirectConvolution(config(L"directConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
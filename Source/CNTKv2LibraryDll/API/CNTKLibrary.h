@@ -668,6 +668,9 @@ namespace CNTK
         friend class BlockMomentumDistributedLearner;
         friend class Internal::VariableResolver;
         friend class Trainer;
+        friend class Serializer;
+        friend class WeightStore;
+        friend class BeamSearchDecoder;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -996,6 +999,9 @@ namespace CNTK
     private:
         CNTK_API NDArrayView(::CNTK::DataType dataType, const DeviceDescriptor& device, ::CNTK::StorageFormat storageType, const NDShape& viewShape, bool readOnly, void* tensorView);
 
+        // A dense CPU view over an external 'dataBuffer' that is kept alive by 'dataBufferOwner'.
+        NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const std::shared_ptr<void>& dataBufferOwner);
+
         template <typename ElementType>
         static std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>> GetMatrixImpl(const Microsoft::MSR::CNTK::TensorView<ElementType>* tensorView, size_t rowColSplitPoint);
 
@@ -1023,6 +1029,9 @@ namespace CNTK
         bool m_isReadOnly;
 
         std::shared_ptr<void> m_tensorView; // Microsoft::MSR::CNTK::TensorView<ElemType>*
+
+        // Owner of the external buffer this view (and all of its aliases) refers to, e.g. a memory mapped model file; may be null.
+        std::shared_ptr<void> m_dataBufferOwner;
     };
 
     enum class MaskKind : char
@@ -1922,6 +1931,7 @@ namespace CNTK
         friend class PrimitiveFunction;
         friend class Utils;
         friend class CNTKToONNXHelper;
+        friend class WeightStore;
 
         template <typename T>
         friend struct std::hash;
@@ -2806,6 +2816,62 @@ namespace CNTK
             return CreateSequence(sampleShape, sequenceLength, colStarts, rowIndices, nonZeroValues, numNonZeroValues, true, device, readOnly);
         }
 
+        ///
+        /// Creates a new Value object containing a batch of variable length sequences in packed form, i.e. without padding each sequence
+        /// to the length of the longest one. The samples of all sequences are stored back to back, and the length of each sequence is given explicitly.
+        /// The data are laid out the way the network consumes them, so feeding the Value to a Function needs neither a mask nor a reshuffle of the data.
+        /// Data() and Mask() unpack the Value on first access.
+        /// Parameters:
+        ///     ElementType: data type of the created Value object. Currently, float and double are supported.
+        ///     sampleShape: the tensor shape of the Value object.
+        ///     packedData: the samples of all sequences, concatenated in the order of the sequences. Each sample has sampleShape.TotalSize() elements.
+        ///     sequenceLengths: the number of samples in each sequence. The number of sequences is the number of elements of sequenceLengths.
+        ///     sequenceStartFlags: A collection of boolean value. Each element represent whether the correspoinding sequence is a new sequence(in case of true) or a continuation of a previous sequence(in case of false).
+        ///     device: on which device the Value object should be created.
+        ///     readOnly: the Value is read-only if this flag is true.
+        ///
+        template <typename ElementType>
+        CNTK_API static ValuePtr CreatePacked(const NDShape& sampleShape, const std::vector<ElementType>& packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false);
+
+        ///
+        /// Creates a new Value object containing a batch of variable length sequences in packed form.
+        /// Each sequence is a new sequence. All other parameters are same as the method above.
+        ///
+        template <typename ElementType>
+        static ValuePtr CreatePacked(const NDShape& sampleShape, const std::vector<ElementType>& packedData, const std::vector<size_t>& sequenceLengths, const DeviceDescriptor& device, bool readOnly = false)
+        {
+            return CreatePacked<ElementType>(sampleShape, packedData, sequenceLengths, {}, device, readOnly);
+        }
+
+        ///
+        /// Creates a new Value object containing a batch of variable length sequences in packed form.
+        /// Each sample is represented by sampleShape.SubShape(1).TotalSize() index values that point to the non-zero value in one-hot vectors of sampleShape[0] elements.
+        /// The indices of all sequences are stored back to back in packedOneHotData, and sequenceLengths gives the number of samples in each sequence.
+        /// All other parameters are same as the method above.
+        ///
+        template <typename ElementType>
+        CNTK_API static ValuePtr CreatePacked(const NDShape& sampleShape, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false);
+
+        ///
+        /// Creates a new Value object containing a batch of variable length sequences in packed form.
+        /// Each sample is represented by an index value that points to the non-zero value in the one-hot vector of dimension elements.
+        /// All other parameters are same as the method above.
+        ///
+        template <typename ElementType>
+        static ValuePtr CreatePacked(size_t dimension, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false)
+        {
+            return CreatePacked<ElementType>(NDShape({ dimension }), packedOneHotData, sequenceLengths, sequenceStartFlags, device, readOnly);
+        }
+
+        ///
+        /// Creates a new Value object containing a batch of variable length sequences in packed form.
+        /// The samples of all sequences are represented by CSC sparse input format, one column per sample, and sequenceLengths gives the number of samples in each sequence.
+        /// The tensor shape leading dimensionality must be the same as the total size of the tensor shape.
+        /// All other parameters are same as the method above.
+        ///
+        template <typename ElementType>
+        CNTK_API static ValuePtr CreatePacked(const NDShape& sampleShape, const std::vector<size_t>& sequenceLengths, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly = false);
+
         ///
         /// Destruct 'this' Value object.
         ///
@@ -2994,6 +3060,28 @@ namespace CNTK
             CopyVariableValueToCSCSparse(sequenceLength, colStarts, rowIndices, nonZeroValues, numNonZeroValues);
         }
 
+        ///
+        /// Copy the data stored in 'this' Value object to the buffer 'packedData' as a batch of variable length sequences in packed form,
+        /// i.e. the samples of all sequences back to back, and the number of samples in each sequence to 'sequenceLengths'.
+        /// If 'this' Value holds packed data, e.g. an output of Function::Forward, the samples are copied from it directly, without unpacking it.
+        /// The buffers will be resized if necessary.
+        /// The Value should have the same tensor shape as outputVariable.
+        ///
+        template <typename ElementType>
+        void CopyVariableValueToPacked(const Variable& outputVariable, std::vector<ElementType>& packedData, std::vector<size_t>& sequenceLengths)
+        {
+            NDShape inferredVarShape = outputVariable.Shape();
+            size_t numOfSequences;
+            size_t maxSequenceLen;
+            std::tie(maxSequenceLen, numOfSequences) = GetSequenceAndBatchLength(outputVariable, &inferredVarShape);
+
+            sequenceLengths.resize(numOfSequences);
+            size_t numOfSamples = GetPackedSequenceLengths(outputVariable, sequenceLengths.data());
+
+            packedData.resize(numOfSamples * inferredVarShape.TotalSize());
+            CopyVariableValueToPackedBuffer<ElementType>(outputVariable, packedData.data(), packedData.size());
+        }
+
         ///
         /// If the value stored is a scalar, returns it. Otherwise, throws an error.
         ///
@@ -3046,6 +3134,15 @@ namespace CNTK
 
         CNTK_API static void GetSequenceStartsAndLengths(const NDMaskPtr& mask, std::vector<ptrdiff_t>& sequenceBeginIndices, std::vector<size_t>& sequenceLengths, size_t numDynamicAxes);
 
+        ///
+        /// Stores the length of each sequence in 'this' Value to 'sequenceLengths' and returns the total number of samples.
+        /// Assumption: 'sequenceLengths' has room for the number of sequences returned by GetSequenceAndBatchLength().
+        ///
+        CNTK_API size_t GetPackedSequenceLengths(const Variable& outputVariable, size_t* sequenceLengths);
+
+        template <typename ElementType>
+        CNTK_API void CopyVariableValueToPackedBuffer(const Variable& outputVariable, ElementType* packedData, size_t packedDataSize);
+
         ///
         /// Resize the 'sequences' buffer if needed.
         /// It should be kept in the header file, as the memory should be allocated at the caller side, not the CNTKLibarary.dll side.
@@ -5535,6 +5632,129 @@ namespace CNTK
     ///
     CNTK_API EvaluatorPtr CreateEvaluator(const FunctionPtr& evaluationFunction, const std::vector<ProgressWriterPtr>& progressWriters = {});
 
+    ///
+    /// Options of beam search decoding.
+    ///
+    struct BeamSearchOptions
+    {
+        ///
+        /// Number of hypotheses kept for each request, and the maximum number of hypotheses returned for it.
+        ///
+        size_t beamWidth = 4;
+
+        ///
+        /// Maximum number of tokens generated for a request, including the end token.
+        ///
+        size_t maxLength = 100;
+
+        ///
+        /// Hypotheses are ranked by their log-probability divided by ((5 + length) / 6)^lengthPenalty (Wu et al., 2016).
+        /// With the default 0, they are ranked by their log-probability, which favors short hypotheses.
+        ///
+        double lengthPenalty = 0.0;
+
+        ///
+        /// If true, a request is done as soon as it has beamWidth finished hypotheses. Otherwise it is done once no live
+        /// hypothesis ranks higher than the finished ones at its current length.
+        ///
+        bool earlyStopping = true;
+    };
+
+    ///
+    /// A hypothesis found by beam search.
+    ///
+    struct BeamSearchHypothesis
+    {
+        ///
+        /// The generated tokens, without the start and end tokens.
+        ///
+        std::vector<size_t> tokens;
+
+        ///
+        /// Sum of the log-probabilities of the generated tokens (including the end token, if any).
+        ///
+        double logProbability;
+
+        ///
+        /// The length-normalized log-probability that hypotheses are ranked by.
+        ///
+        double score;
+
+        ///
+        /// False if the hypothesis was cut off at maxLength before generating the end token.
+        ///
+        bool finished;
+    };
+
+    ///
+    /// BeamSearchDecoder runs beam search on a sequence-to-sequence model for many requests at once.
+    /// The model consists of an encoder Function, that maps a batch of source sequences to the initial decoder states
+    /// (one column per request), and a decoder Function that computes one step: from the previous token and the current
+    /// states it computes scores (logits or log-probabilities) over the vocabulary and the next states.
+    /// The live hypotheses of all requests are packed along the batch axis, so that each step is a single evaluation of the
+    /// decoder; when hypotheses are pruned or extended the states are reordered by a gather on the compute device.
+    ///
+    class BeamSearchDecoder
+    {
+    public:
+        ///
+        /// Decodes each of the source sequences in 'encoderArguments' and returns up to beamWidth hypotheses for each of them, best first.
+        ///
+        CNTK_API std::vector<std::vector<BeamSearchHypothesis>> Decode(const std::unordered_map<Variable, ValuePtr>& encoderArguments, const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
+
+        ///
+        /// Number of decoder evaluations, and of tokens scored (i.e. hypotheses extended), in the last call to Decode.
+        ///
+        size_t NumSteps() const { return m_numSteps; }
+        size_t NumTokensScored() const { return m_numTokensScored; }
+
+        CNTK_API virtual ~BeamSearchDecoder() {}
+
+    private:
+        template <typename T1, typename ...CtorArgTypes>
+        friend std::shared_ptr<T1> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+        BeamSearchDecoder(const FunctionPtr& encoder, const FunctionPtr& decoder, const Variable& tokenInput, const Variable& scoresOutput,
+                          const std::vector<Variable>& stateInputs, const std::vector<Variable>& stateOutputs,
+                          size_t startToken, size_t endToken, const BeamSearchOptions& options);
+
+        template <typename ElementType>
+        std::vector<std::vector<BeamSearchHypothesis>> Decode(const std::unordered_map<Variable, ValuePtr>& encoderArguments, const DeviceDescriptor& computeDevice);
+
+        // Columns 'columns' of 'source' (a batch of samples), in that order.
+        template <typename ElementType>
+        static NDArrayViewPtr GatherColumns(const NDArrayViewPtr& source, const std::vector<size_t>& columns);
+
+        double LengthNormalized(double logProbability, size_t length) const;
+
+        FunctionPtr m_encoder;
+        FunctionPtr m_decoder;
+        Variable m_tokenInput;
+        Variable m_scoresOutput;
+        std::vector<Variable> m_stateInputs;
+        std::vector<Variable> m_stateOutputs;
+        size_t m_vocabularySize;
+        size_t m_startToken;
+        size_t m_endToken;
+        BeamSearchOptions m_options;
+
+        size_t m_numSteps;
+        size_t m_numTokensScored;
+    };
+
+    ///
+    /// Construct a BeamSearchDecoder.
+    /// 'tokenInput' is the input of 'decoder' that takes the previous token (one-hot, over the vocabulary), and 'scoresOutput'
+    /// is the output of 'decoder' with the scores of the next token; both have the batch axis as their only dynamic axis.
+    /// 'stateInputs' are the other inputs of 'decoder', and 'stateOutputs' are the outputs of 'decoder' with their values in
+    /// the next step, in the same order. A state that does not change from step to step (e.g. a fixed-size encoding of the
+    /// source that is attended to) is its own output. The outputs of 'encoder' are the initial values of the states, in the
+    /// same order. Scores are normalized with a log-softmax, which leaves log-probabilities unchanged.
+    ///
+    CNTK_API BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& encoder, const FunctionPtr& decoder, const Variable& tokenInput, const Variable& scoresOutput,
+                                                          const std::vector<Variable>& stateInputs, const std::vector<Variable>& stateOutputs,
+                                                          size_t startToken, size_t endToken, const BeamSearchOptions& options = BeamSearchOptions());
+
     enum class DataUnit : unsigned int
     {
         ///Indiciate that the frequency of action is counted by sweep.
@@ -5923,6 +6143,23 @@ namespace CNTK
         /// Maximum number of errors in the dataset to ignore.
         ///
         size_t maxErrors{ 0 };
+
+        ///
+        /// Number of length buckets (only applicable with randomization). If greater than 1, the sequences of
+        /// each randomized chunk are sorted into this many buckets by length, and the buckets are returned in
+        /// a random order, so that minibatches contain sequences of similar length and need less padding.
+        ///
+        size_t numberOfLengthBuckets{ 0 };
+
+        ///
+        /// Number of chunks to read ahead of the randomization window in the background (only applicable with randomization).
+        ///
+        size_t numberOfReadAheadChunks{ 1 };
+
+        ///
+        /// Upper bound on the estimated memory size of the chunks read ahead, in bytes (0 - no limit).
+        ///
+        size_t readAheadMaxBytes{ 0 };
     };
 
     ///
@@ -6194,6 +6431,15 @@ namespace CNTK
     ///
     CNTK_API QuantizedDistributedCommunicatorPtr QuantizedMPICommunicator(bool zeroThresholdFor1Bit, bool useQuantizationForSelfStripe, size_t numQuantizationBits);
 
+    ///
+    /// Distributed communicator that aggregates only the largest-magnitude entries of each gradient stripe as (index, value) pairs.
+    /// Entries that are not sent are kept in the residuals and added to the next step (error feedback).
+    /// density: fraction of entries of every stripe that is sent.
+    /// targetBytesPerStep: if non-zero, the density is adapted such that each worker sends about this many bytes per aggregation.
+    /// useSampledThreshold: estimate the selection threshold from a sample of the gradient instead of an exact top-k selection.
+    ///
+    CNTK_API QuantizedDistributedCommunicatorPtr SparsifiedMPICommunicator(double density, size_t targetBytesPerStep = 0, bool useSampledThreshold = false);
+
     ///
     /// Cross validation configuration
     ///
@@ -214,6 +214,9 @@ namespace CNTK
     class Evaluator;
     typedef std::shared_ptr<Evaluator> EvaluatorPtr;
 
+    class BeamSearchDecoder;
+    typedef std::shared_ptr<BeamSearchDecoder> BeamSearchDecoderPtr;
+
     class Trainer;
     typedef std::shared_ptr<Trainer> TrainerPtr;
 
@@ -306,12 +309,67 @@ namespace CNTK
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
 
+        // While enabled, the analysis of the internal network built for evaluating a Function (evaluation order, recurrent
+        // loops, inferred shapes and memory sharing plan) is cached and reused for Functions with the same graph structure
+        // and input shapes, e.g. clones. Function::Save stores it next to the model file, and Function::Load picks it up.
+        CNTK_API void EnableCompiledPlanCaching();
+        CNTK_API void DisableCompiledPlanCaching();
+        CNTK_API bool IsCompiledPlanCachingEnabled();
+        CNTK_API void ClearCompiledPlanCache();
+
+        // Convolution and pooling operations keep the state built for the most recently seen shapes of their input
+        // (geometry, index maps, selected algorithms), so that evaluating a Function with free dimension arguments
+        // alternating among a few shapes does not rebuild it on every change. The capacity is per operation
+        // (default 4, 0 disables the reuse); hits count the shape changes served from it, misses the states built.
+        CNTK_API void SetShapeSpecializationCacheCapacity(size_t capacity);
+        CNTK_API size_t GetShapeSpecializationCacheCapacity();
+        CNTK_API size_t GetShapeSpecializationCacheHits();
+        CNTK_API size_t GetShapeSpecializationCacheMisses();
+        CNTK_API void ResetShapeSpecializationCacheCounters();
+
+        // Lets convolutions on the CPU use direct and Winograd kernels on blocked weights where they support the
+        // geometry and MKL-DNN is not available, instead of unrolling the input for a GEMM. Disabled by default.
+        CNTK_API void EnableDirectConvolution();
+        CNTK_API void DisableDirectConvolution();
+        CNTK_API bool IsDirectConvolutionEnabled();
+
+        // Models saved while this is enabled keep their NDArrayView contents outside of the protobuf message, in an aligned
+        // layout that can be memory mapped when loaded. Otherwise models are saved in the previous layouts.
+        CNTK_API void EnableMappableModelSaving();
+        CNTK_API void DisableMappableModelSaving();
+        CNTK_API bool IsMappableModelSavingEnabled();
+
+        // When enabled, models in the aligned layout are memory mapped by Dictionary::Load and Function::Load, and CPU parameters
+        // and constants alias the copy-on-write pages of the mapping instead of being copied. The model file must not be
+        // overwritten while such a model is alive.
+        CNTK_API void EnableMemoryMappedModelLoading();
+        CNTK_API void DisableMemoryMappedModelLoading();
+        CNTK_API bool IsMemoryMappedModelLoadingEnabled();
+
+        // Makes the dense CPU parameters and constants of 'function' views of the named shared memory segment 'segmentName',
+        // which is created and filled in with their current values if it does not exist yet. Returns true if it was created.
+        // Processes that load the same model and call this with the same name thus hold a single physical copy of its
+        // parameters, and so do clones of 'function' made with ParameterCloningMethod::Share, within a process as well as
+        // across processes; each one only allocates its own activations. Each call maps the segment copy-on-write, so that
+        // updates made through one Function are private to it and its clones (and cost a copy of the pages written to),
+        // also when another Function of the same process is bound to the segment.
+        // Must be called before 'function' (or a clone of it) is evaluated. GPU and sparse values are not shared.
+        // On Linux the segment outlives the processes until it is removed with RemoveSharedWeights; on Windows it is
+        // destroyed with its last mapping.
+        CNTK_API bool ShareWeightsAcrossProcesses(const FunctionPtr& function, const std::wstring& segmentName);
+        CNTK_API void RemoveSharedWeights(const std::wstring& segmentName);
+
         static const uint64_t DefaultProfilerBufferSize = 32 * 1024 * 1024;
         CNTK_API void StartProfiler(const std::wstring& profilerDir = L"profiler", bool profilerSyncGpu = false, size_t profilerBufferSize = DefaultProfilerBufferSize);
         CNTK_API void EnableProfiler();
         CNTK_API void DisableProfiler();
         CNTK_API void StopProfiler();
 
+        // Switches the profiler started with StartProfiler to trace mode: its buffer becomes a ring buffer that keeps
+        // the most recent events, and events are recorded for one in every 'samplingPeriod' minibatches only.
+        // Per-node forward/backward spans additionally require EnableNodeTiming().
+        CNTK_API void SetProfilerTraceMode(size_t samplingPeriod = 1);
+
         CNTK_API void EnableNodeTiming();
         CNTK_API void DisableNodeTimeing();
 
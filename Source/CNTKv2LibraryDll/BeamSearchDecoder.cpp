@@ -0,0 +1,333 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace CNTK
+{
+    BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& encoder, const FunctionPtr& decoder, const Variable& tokenInput, const Variable& scoresOutput,
+                                                 const std::vector<Variable>& stateInputs, const std::vector<Variable>& stateOutputs,
+                                                 size_t startToken, size_t endToken, const BeamSearchOptions& options)
+    {
+        return MakeSharedObject<BeamSearchDecoder>(encoder, decoder, tokenInput, scoresOutput, stateInputs, stateOutputs, startToken, endToken, options);
+    }
+
+    static bool HasOnlyBatchAxis(const Variable& variable)
+    {
+        return variable.DynamicAxes() == std::vector<Axis>({ Axis::DefaultBatchAxis() });
+    }
+
+    BeamSearchDecoder::BeamSearchDecoder(const FunctionPtr& encoder, const FunctionPtr& decoder, const Variable& tokenInput, const Variable& scoresOutput,
+                                         const std::vector<Variable>& stateInputs, const std::vector<Variable>& stateOutputs,
+                                         size_t startToken, size_t endToken, const BeamSearchOptions& options)
+        : m_encoder(encoder), m_decoder(decoder), m_tokenInput(tokenInput), m_scoresOutput(scoresOutput),
+          m_stateInputs(stateInputs), m_stateOutputs(stateOutputs), m_vocabularySize(tokenInput.Shape().TotalSize()),
+          m_startToken(startToken), m_endToken(endToken), m_options(options), m_numSteps(0), m_numTokensScored(0)
+    {
+        if (!m_encoder || !m_decoder)
+            InvalidArgument("BeamSearchDecoder: The encoder and decoder Functions must not be null.");
+
+        if (m_options.beamWidth == 0 || m_options.maxLength == 0)
+            InvalidArgument("BeamSearchDecoder: The beam width (%zu) and the maximum length (%zu) must be positive.", m_options.beamWidth, m_options.maxLength);
+
+        if (m_startToken >= m_vocabularySize || m_endToken >= m_vocabularySize)
+            InvalidArgument("BeamSearchDecoder: The start (%zu) and end (%zu) tokens must be less than the vocabulary size (%zu).", m_startToken, m_endToken, m_vocabularySize);
+
+        auto dataType = m_scoresOutput.GetDataType();
+        if (dataType != DataType::Float && dataType != DataType::Double)
+            InvalidArgument("BeamSearchDecoder: Unsupported data type %s of the decoder scores.", DataTypeName(dataType));
+
+        auto decoderArguments = m_decoder->Arguments();
+        auto isDecoderArgument = [&decoderArguments](const Variable& variable)
+        {
+            return std::find(decoderArguments.begin(), decoderArguments.end(), variable) != decoderArguments.end();
+        };
+        auto decoderOutputs = m_decoder->Outputs();
+        auto isDecoderOutput = [&decoderOutputs](const Variable& variable)
+        {
+            return std::find(decoderOutputs.begin(), decoderOutputs.end(), variable) != decoderOutputs.end();
+        };
+
+        if (!isDecoderArgument(m_tokenInput) || !HasOnlyBatchAxis(m_tokenInput))
+            InvalidArgument("BeamSearchDecoder: The token input '%S' must be an argument of the decoder with the batch axis as its only dynamic axis.", m_tokenInput.AsString().c_str());
+
+        if (!isDecoderOutput(m_scoresOutput) || !HasOnlyBatchAxis(m_scoresOutput) || m_scoresOutput.Shape().TotalSize() != m_vocabularySize)
+            InvalidArgument("BeamSearchDecoder: The scores '%S' must be an output of the decoder with the batch axis as its only dynamic axis and one value per token (%zu).",
+                            m_scoresOutput.AsString().c_str(), m_vocabularySize);
+
+        auto encoderOutputs = m_encoder->Outputs();
+        if (m_stateInputs.size() != m_stateOutputs.size() || m_stateInputs.size() != encoderOutputs.size())
+            InvalidArgument("BeamSearchDecoder: The numbers of state inputs (%zu), state outputs (%zu) and encoder outputs (%zu) must be the same.",
+                            m_stateInputs.size(), m_stateOutputs.size(), encoderOutputs.size());
+
+        if (decoderArguments.size() != m_stateInputs.size() + 1)
+            InvalidArgument("BeamSearchDecoder: The decoder has %zu arguments, expected the token input and %zu state inputs.", decoderArguments.size(), m_stateInputs.size());
+
+        for (size_t i = 0; i < m_stateInputs.size(); i++)
+        {
+            const auto& input = m_stateInputs[i];
+            if (!isDecoderArgument(input) || !HasOnlyBatchAxis(input) || input.GetDataType() != dataType)
+                InvalidArgument("BeamSearchDecoder: The state input '%S' must be an argument of the decoder with the batch axis as its only dynamic axis and the data type of the scores.",
+                                input.AsString().c_str());
+
+            if (m_stateOutputs[i] != input && (!isDecoderOutput(m_stateOutputs[i]) || !HasOnlyBatchAxis(m_stateOutputs[i]) || m_stateOutputs[i].Shape() != input.Shape()))
+                InvalidArgument("BeamSearchDecoder: The state output '%S' must be an output of the decoder with the batch axis as its only dynamic axis and the shape of the state input '%S'.",
+                                m_stateOutputs[i].AsString().c_str(), input.AsString().c_str());
+
+            if (!HasOnlyBatchAxis(encoderOutputs[i]) || encoderOutputs[i].Shape() != input.Shape())
+                InvalidArgument("BeamSearchDecoder: The encoder output '%S' must have the batch axis as its only dynamic axis and the shape of the state input '%S'.",
+                                encoderOutputs[i].AsString().c_str(), input.AsString().c_str());
+        }
+    }
+
+    std::vector<std::vector<BeamSearchHypothesis>> BeamSearchDecoder::Decode(const std::unordered_map<Variable, ValuePtr>& encoderArguments, const DeviceDescriptor& computeDevice)
+    {
+        if (m_scoresOutput.GetDataType() == DataType::Float)
+            return Decode<float>(encoderArguments, computeDevice);
+        else
+            return Decode<double>(encoderArguments, computeDevice);
+    }
+
+    double BeamSearchDecoder::LengthNormalized(double logProbability, size_t length) const
+    {
+        if (m_options.lengthPenalty == 0)
+            return logProbability;
+        return logProbability / std::pow((5.0 + length) / 6.0, m_options.lengthPenalty);
+    }
+
+    // Returns the values of a batch of samples as a [sampleShape x numSamples] view.
+    static NDArrayViewPtr BatchOfSamples(const ValuePtr& value, const NDShape& sampleShape)
+    {
+        auto data = value->Data();
+        auto numSamples = data->Shape().TotalSize() / sampleShape.TotalSize();
+        return data->AsShape(sampleShape.AppendShape({ numSamples }));
+    }
+
+    template <typename ElementType>
+    /*static*/ NDArrayViewPtr BeamSearchDecoder::GatherColumns(const NDArrayViewPtr& source, const std::vector<size_t>& columns)
+    {
+        auto sampleRank = source->Shape().Rank() - 1;
+        auto result = MakeSharedObject<NDArrayView>(source->GetDataType(), source->Shape().SubShape(0, sampleRank).AppendShape({ columns.size() }), source->Device());
+
+        std::vector<ElementType> indices(columns.begin(), columns.end());
+        Microsoft::MSR::CNTK::Matrix<ElementType> indexMatrix(1, indices.size(), indices.data(), AsCNTKImplDeviceId(source->Device()));
+        result->GetWritableMatrix<ElementType>(sampleRank)->DoGatherColumnsOf(0, indexMatrix, *source->GetMatrix<ElementType>(sampleRank), 1);
+        return result;
+    }
+
+    template <typename ElementType>
+    std::vector<std::vector<BeamSearchHypothesis>> BeamSearchDecoder::Decode(const std::unordered_map<Variable, ValuePtr>& encoderArguments, const DeviceDescriptor& computeDevice)
+    {
+        const size_t beamWidth = m_options.beamWidth;
+
+        // A hypothesis is a node of the tree of the tokens generated so far: its token and its parent.
+        struct Node
+        {
+            size_t token;
+            size_t parent;
+        };
+        std::vector<Node> nodes;
+
+        struct Hypothesis
+        {
+            size_t node;
+            double logProbability;
+            double score;
+            bool finished;
+        };
+
+        struct Request
+        {
+            std::vector<Hypothesis> live;     // row i of the batch holds the state of live[i]
+            std::vector<Hypothesis> finished; // best first
+        };
+
+        // The initial states are the outputs of the encoder, one column per request.
+        std::unordered_map<Variable, ValuePtr> encoderOutputs;
+        for (const auto& output : m_encoder->Outputs())
+            encoderOutputs[output] = nullptr;
+        m_encoder->Forward(encoderArguments, encoderOutputs, computeDevice);
+
+        std::vector<NDArrayViewPtr> states(m_stateInputs.size());
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            states[i] = BatchOfSamples(encoderOutputs[m_encoder->Outputs()[i]], m_stateInputs[i].Shape());
+            if (states[i]->Shape()[states[i]->Shape().Rank() - 1] != states[0]->Shape()[states[0]->Shape().Rank() - 1])
+                LogicError("BeamSearchDecoder: The encoder outputs have different numbers of samples.");
+        }
+
+        auto numRequests = states[0]->Shape()[states[0]->Shape().Rank() - 1];
+        std::vector<Request> requests(numRequests);
+        for (auto& request : requests)
+        {
+            nodes.push_back({ m_startToken, SIZE_MAX });
+            request.live.push_back({ nodes.size() - 1, 0.0, 0.0, false });
+        }
+
+        m_numSteps = 0;
+        m_numTokensScored = 0;
+
+        struct Candidate
+        {
+            double logProbability;
+            size_t row;
+            size_t token;
+        };
+        const size_t candidatesPerRequest = 2 * beamWidth; // enough to keep beamWidth live hypotheses if up to beamWidth of them end
+        std::vector<Candidate> candidates;
+        std::vector<size_t> tokenOrder(m_vocabularySize);
+        std::vector<double> logProbabilities(m_vocabularySize);
+
+        std::vector<size_t> tokens;
+        std::vector<size_t> parentRows;
+        for (size_t length = 1;; length++)
+        {
+            tokens.clear();
+            for (const auto& request : requests)
+                for (const auto& hypothesis : request.live)
+                    tokens.push_back(nodes[hypothesis.node].token);
+
+            if (tokens.empty())
+                break;
+
+            // One step of the decoder for all live hypotheses.
+            std::unordered_map<Variable, ValuePtr> arguments = { { m_tokenInput, Value::CreateBatch<ElementType>(m_vocabularySize, tokens, computeDevice, /*readOnly =*/ true) } };
+            for (size_t i = 0; i < states.size(); i++)
+                arguments[m_stateInputs[i]] = MakeSharedObject<Value>(states[i]);
+
+            std::unordered_map<Variable, ValuePtr> outputs = { { m_scoresOutput, nullptr } };
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                if (m_stateOutputs[i] != m_stateInputs[i])
+                    outputs[m_stateOutputs[i]] = nullptr;
+            }
+            m_decoder->Forward(arguments, outputs, computeDevice);
+            m_numSteps++;
+            m_numTokensScored += tokens.size();
+
+            auto scores = BatchOfSamples(outputs[m_scoresOutput], NDShape({ m_vocabularySize }));
+            if (scores->Device() != DeviceDescriptor::CPUDevice())
+                scores = scores->DeepClone(DeviceDescriptor::CPUDevice());
+            if (scores->Shape()[1] != tokens.size())
+                LogicError("BeamSearchDecoder: The decoder returned scores for %zu hypotheses, expected %zu.", scores->Shape()[1], tokens.size());
+
+            // Extend the live hypotheses of each request by their best tokens and keep the best of them.
+            parentRows.clear();
+            size_t row = 0;
+            for (auto& request : requests)
+            {
+                candidates.clear();
+                for (size_t i = 0; i < request.live.size(); i++, row++)
+                {
+                    const ElementType* rowScores = scores->DataBuffer<ElementType>() + row * m_vocabularySize;
+                    double maxScore = *std::max_element(rowScores, rowScores + m_vocabularySize);
+                    double sum = 0;
+                    for (size_t token = 0; token < m_vocabularySize; token++)
+                        sum += std::exp(rowScores[token] - maxScore);
+                    double logNormalizer = maxScore + std::log(sum);
+                    for (size_t token = 0; token < m_vocabularySize; token++)
+                        logProbabilities[token] = rowScores[token] - logNormalizer;
+
+                    auto numBest = std::min(candidatesPerRequest, m_vocabularySize);
+                    std::iota(tokenOrder.begin(), tokenOrder.end(), 0);
+                    std::nth_element(tokenOrder.begin(), tokenOrder.begin() + (numBest - 1), tokenOrder.end(),
+                                     [&](size_t a, size_t b) { return logProbabilities[a] > logProbabilities[b]; });
+                    for (size_t k = 0; k < numBest; k++)
+                        candidates.push_back({ request.live[i].logProbability + logProbabilities[tokenOrder[k]], row, tokenOrder[k] });
+                }
+
+                if (candidates.empty())
+                    continue;
+
+                auto numCandidates = std::min(candidatesPerRequest, candidates.size());
+                std::partial_sort(candidates.begin(), candidates.begin() + numCandidates, candidates.end(),
+                                  [](const Candidate& a, const Candidate& b) { return a.logProbability > b.logProbability; });
+
+                size_t firstRow = row - request.live.size();
+                std::vector<Hypothesis> live;
+                for (size_t rank = 0; rank < numCandidates && live.size() < beamWidth; rank++)
+                {
+                    const auto& candidate = candidates[rank];
+                    nodes.push_back({ candidate.token, request.live[candidate.row - firstRow].node });
+                    Hypothesis hypothesis = { nodes.size() - 1, candidate.logProbability, LengthNormalized(candidate.logProbability, length), false };
+                    if (candidate.token == m_endToken)
+                    {
+                        // An end token that does not make it into the beam does not end a hypothesis either.
+                        if (rank < beamWidth)
+                        {
+                            hypothesis.finished = true;
+                            request.finished.push_back(hypothesis);
+                        }
+                    }
+                    else
+                    {
+                        live.push_back(hypothesis);
+                        parentRows.push_back(candidate.row);
+                    }
+                }
+
+                if (length == m_options.maxLength)
+                    request.finished.insert(request.finished.end(), live.begin(), live.end());
+
+                std::stable_sort(request.finished.begin(), request.finished.end(), [](const Hypothesis& a, const Hypothesis& b) { return a.score > b.score; });
+                if (request.finished.size() > beamWidth)
+                    request.finished.resize(beamWidth);
+
+                bool done = (length == m_options.maxLength) || live.empty();
+                if (!done && request.finished.size() == beamWidth)
+                {
+                    // With the length normalization, a live hypothesis might still overtake the finished ones, but that is left to those
+                    // who do not stop early; their search ends once the best live hypothesis ranks below all finished ones at its current length.
+                    done = m_options.earlyStopping || (live.front().score <= request.finished.back().score);
+                }
+
+                if (done)
+                {
+                    parentRows.resize(parentRows.size() - live.size());
+                    live.clear();
+                }
+                request.live = std::move(live);
+            }
+
+            // Reorder the states of the surviving hypotheses. The decoder outputs reference the network's own
+            // storage, which the next Forward overwrites, so even if nothing moved they are copied out.
+            bool identity = (parentRows.size() == tokens.size());
+            for (size_t i = 0; identity && i < parentRows.size(); i++)
+                identity = (parentRows[i] == i);
+
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                auto next = (m_stateOutputs[i] == m_stateInputs[i]) ? states[i] : BatchOfSamples(outputs[m_stateOutputs[i]], m_stateInputs[i].Shape());
+                if (parentRows.empty())
+                    states[i] = nullptr;
+                else if (!identity)
+                    states[i] = GatherColumns<ElementType>(next, parentRows);
+                else if (m_stateOutputs[i] != m_stateInputs[i])
+                    states[i] = next->DeepClone();
+            }
+        }
+
+        std::vector<std::vector<BeamSearchHypothesis>> results(numRequests);
+        for (size_t r = 0; r < numRequests; r++)
+        {
+            for (const auto& hypothesis : requests[r].finished)
+            {
+                BeamSearchHypothesis result = { {}, hypothesis.logProbability, hypothesis.score, hypothesis.finished };
+                for (auto node = hypothesis.node; nodes[node].parent != SIZE_MAX; node = nodes[node].parent)
+                    result.tokens.push_back(nodes[node].token);
+                std::reverse(result.tokens.begin(), result.tokens.end());
+                if (result.finished)
+                    result.tokens.pop_back(); // the end token
+                results[r].push_back(std::move(result));
+            }
+        }
+        return results;
+    }
+}
@@ -14,6 +14,8 @@
 #include <thread>
 #include "GPUMatrix.h"
 #include "Globals.h"
+#include "ComputationNetwork.h"
+#include "ConvolutionalNodes.h"
 #include "PerformanceProfiler.h"
 #include "MPIWrapper.h"
 #include "EnvironmentUtil.h"
@@ -171,6 +173,98 @@ namespace CNTK
             Microsoft::MSR::CNTK::Globals::SetGradientAccumulationOptimization(/* enable = */ false);
         }
 
+        void EnableCompiledPlanCaching()
+        {
+            Microsoft::MSR::CNTK::Globals::SetCompiledPlanCaching(/* enable = */ true);
+        }
+
+        void DisableCompiledPlanCaching()
+        {
+            Microsoft::MSR::CNTK::Globals::SetCompiledPlanCaching(/* enable = */ false);
+        }
+
+        bool IsCompiledPlanCachingEnabled()
+        {
+            return Microsoft::MSR::CNTK::Globals::ShouldCacheCompiledPlans();
+        }
+
+        void ClearCompiledPlanCache()
+        {
+            Microsoft::MSR::CNTK::ComputationNetwork::ClearCompiledPlans();
+        }
+
+        void SetShapeSpecializationCacheCapacity(size_t capacity)
+        {
+            Microsoft::MSR::CNTK::Globals::SetShapeSpecializationCacheCapacity(capacity);
+        }
+
+        size_t GetShapeSpecializationCacheCapacity()
+        {
+            return Microsoft::MSR::CNTK::Globals::GetShapeSpecializationCacheCapacity();
+        }
+
+        size_t GetShapeSpecializationCacheHits()
+        {
+            return Microsoft::MSR::CNTK::ConvolutionEngineCache::NumHits();
+        }
+
+        size_t GetShapeSpecializationCacheMisses()
+        {
+            return Microsoft::MSR::CNTK::ConvolutionEngineCache::NumMisses();
+        }
+
+        void ResetShapeSpecializationCacheCounters()
+        {
+            Microsoft::MSR::CNTK::ConvolutionEngineCache::ResetCounters();
+        }
+
+        void EnableDirectConvolution()
+        {
+            Microsoft::MSR::CNTK::Globals::SetDirectConvolution(/* enable = */ true);
+        }
+
+        void DisableDirectConvolution()
+        {
+            Microsoft::MSR::CNTK::Globals::SetDirectConvolution(/* enable = */ false);
+        }
+
+        bool IsDirectConvolutionEnabled()
+        {
+            return Microsoft::MSR::CNTK::Globals::ShouldUseDirectConvolution();
+        }
+
+        std::atomic<bool> s_mappableModelSaving(false);
+        void EnableMappableModelSaving()
+        {
+            s_mappableModelSaving.store(true);
+        }
+
+        void DisableMappableModelSaving()
+        {
+            s_mappableModelSaving.store(false);
+        }
+
+        bool IsMappableModelSavingEnabled()
+        {
+            return s_mappableModelSaving.load();
+        }
+
+        std::atomic<bool> s_memoryMappedModelLoading(false);
+        void EnableMemoryMappedModelLoading()
+        {
+            s_memoryMappedModelLoading.store(true);
+        }
+
+        void DisableMemoryMappedModelLoading()
+        {
+            s_memoryMappedModelLoading.store(false);
+        }
+
+        bool IsMemoryMappedModelLoadingEnabled()
+        {
+            return s_memoryMappedModelLoading.load();
+        }
+
         void StartProfiler(const wstring& profilerDir, bool profilerSyncGpu, size_t profilerBufferSize)
         {
 #ifndef CNTK_UWP
@@ -203,6 +297,16 @@ namespace CNTK
 #endif
         }
 
+        void SetProfilerTraceMode(size_t samplingPeriod)
+        {
+#ifndef CNTK_UWP
+            if (samplingPeriod == 0 || samplingPeriod > std::numeric_limits<unsigned int>::max())
+                InvalidArgument("SetProfilerTraceMode: The sampling period %zu is out of range.", samplingPeriod);
+
+            Microsoft::MSR::CNTK::ProfilerTraceMode(true, (unsigned int)samplingPeriod);
+#endif
+        }
+
         void StopProfiler()
         {
 #ifndef CNTK_UWP
@@ -423,6 +423,13 @@ namespace CNTK
         }
     }
 
+    template <typename ValueType>
+    static ComputationNodeBasePtr CreateLearnableParameterReferencing(ComputationNetworkPtr& network, const std::wstring& name, const NDShape& shape, const std::shared_ptr<const MatrixBase>& valueMatrix)
+    {
+        auto& value = *std::dynamic_pointer_cast<const Matrix<ValueType>>(valueMatrix);
+        return network->AddNodeToNetWithElemType(New<LearnableParameter<ValueType>>(network->GetDeviceId(), name, AsTensorShape(shape), value));
+    }
+
     /*static*/ void CompositeFunction::CastAssignNodeValue(ComputationNodeBasePtr node, DataType dataType, std::shared_ptr<const MatrixBase> matrix)
     {
         switch (dataType)
@@ -478,27 +485,23 @@ namespace CNTK
             if (variable.Shape().HasInferredDimension())
                 InvalidArgument("Parameter or Constant '%S' with unresolved shape %S found when compiling the Function graph.", variable.AsString().c_str(), variable.Shape().AsString().c_str());
 
-            computationNodePtr = CreateLearnableParameterFromVariable(variable, builder, variable.Shape(), internalNodeName);
-            network->InitLearnableParameters(computationNodePtr, L"fixedValue", 0); // must call this to follow protocol; can overwrite later
-            if (!variable.NeedsGradient() || (inputsToExcludeGradientsFor.find(variable) != inputsToExcludeGradientsFor.end()))
-                computationNodePtr->SetLearningRateMultiplier(0.0);
-
             NDArrayViewPtr value = variable.IsConstant() ? Constant(variable).Value() : Parameter(variable).Value();
             std::shared_ptr<const MatrixBase> valueMatrix = variable.IsConstant() ? value->GetMatrixBase() : value->GetWritableMatrixBase();
 
             if (variable.IsParameter() || (valueMatrix->GetDeviceId() == network->GetDeviceId()))
             {
-                // shallow copy from parameter value to computation node value to link them together
+                // The node value is a reference to the parameter value, which links them together. Nothing is allocated, so all
+                // networks of a Function and of its clones that share parameters (ParameterCloningMethod::Share) use a single copy.
                 switch (variable.GetDataType())
                 {
                 case DataType::Float:
-                    std::dynamic_pointer_cast<ComputationNode<float>>(computationNodePtr)->Value() = std::dynamic_pointer_cast<const Matrix<float>>(valueMatrix)->AsReference();
+                    computationNodePtr = CreateLearnableParameterReferencing<float>(network, internalNodeName, variable.Shape(), valueMatrix);
                     break;
                 case DataType::Double:
-                    std::dynamic_pointer_cast<ComputationNode<double>>(computationNodePtr)->Value() = std::dynamic_pointer_cast<const Matrix<double>>(valueMatrix)->AsReference();
+                    computationNodePtr = CreateLearnableParameterReferencing<double>(network, internalNodeName, variable.Shape(), valueMatrix);
                     break;
                 case DataType::Float16:
-                    std::dynamic_pointer_cast<ComputationNode<half>>(computationNodePtr)->Value() = std::dynamic_pointer_cast<const Matrix<half>>(valueMatrix)->AsReference();
+                    computationNodePtr = CreateLearnableParameterReferencing<half>(network, internalNodeName, variable.Shape(), valueMatrix);
                     break;
                 default:
                     LogicError("Unsupported data type");
@@ -506,6 +509,9 @@ namespace CNTK
             }
             else // Constant: if initialized data lives on wrong device, make a copy to the right one (copy is OK since it's constant)
             {
+                computationNodePtr = CreateLearnableParameterFromVariable(variable, builder, variable.Shape(), internalNodeName);
+                network->InitLearnableParameters(computationNodePtr, L"fixedValue", 0); // must call this to follow protocol; can overwrite later
+
                 // TODO: the following two lines are a workaround for a bug in the Math library
                 // (AssignValuesOf throws when source and destination matrices reside on different GPU devices).
                 // Once this bug is fixed, change to
@@ -543,6 +549,9 @@ namespace CNTK
                     LogicError("Unsupported data type");
                 }
             }
+
+            if (!variable.NeedsGradient() || (inputsToExcludeGradientsFor.find(variable) != inputsToExcludeGradientsFor.end()))
+                computationNodePtr->SetLearningRateMultiplier(0.0);
         }
         else if (variable.IsInput())
         {
@@ -11,6 +11,7 @@
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
 #include "QuantizedDistributedCommunicator.h"
+#include "SparsifiedDistributedCommunicator.h"
 #include "QuantizedDataParallelDistributedLearner.h"
 #include "BlockMomentumDistributedLearner.h"
 #endif
@@ -23,6 +24,11 @@ namespace CNTK
         return MakeSharedObject<QuantizedMPICommunicatorImpl>(zeroThresholdFor1Bit, useQuantizationForSelfStripe, numQuantizationBits);
     }
 
+    QuantizedDistributedCommunicatorPtr SparsifiedMPICommunicator(double density, size_t targetBytesPerStep, bool useSampledThreshold)
+    {
+        return MakeSharedObject<SparsifiedMPICommunicatorImpl>(density, targetBytesPerStep, useSampledThreshold);
+    }
+
     DistributedLearnerPtr CreateQuantizedDataParallelDistributedLearner(
         QuantizedDistributedCommunicatorPtr communicator,
         LearnerPtr learner,
@@ -78,6 +84,11 @@ namespace CNTK
         LogicError("Quantized MPI Communicator is not supported for this build. The GPU build is needed, see CNTK wiki for details.");
     }
 
+    QuantizedDistributedCommunicatorPtr SparsifiedMPICommunicator(double, size_t, bool)
+    {
+        LogicError("Sparsified MPI Communicator is not supported for this build. The GPU build is needed, see CNTK wiki for details.");
+    }
+
     DistributedLearnerPtr CreateQuantizedDataParallelDistributedLearner(QuantizedDistributedCommunicatorPtr, LearnerPtr, size_t, bool)
     {
         LogicError("Quantized Distributed Trainer is not supported for this build. The GPU build is needed, see CNTK wiki for details.");
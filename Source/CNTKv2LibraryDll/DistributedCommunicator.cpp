@@ -14,6 +14,7 @@
 #include "GPUDataTransferer.h"
 #include <numeric>
 #include "Utils.h"
+#include "PerformanceProfiler.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -305,6 +306,11 @@ namespace CNTK
         if (numValues == 0)
             return;
 
+        auto profAggregate = Microsoft::MSR::CNTK::ProfilerTimeBegin();
+        long long aggregateBytes = 0;
+        for (const auto& inputValue : inputValues)
+            aggregateBytes += GetBufferSize(inputValue);
+
         std::vector<NDArrayViewPtr> valuesToAggregate; // Corresponding to inputValues
         std::vector<NDArrayViewPtr> valuesAfterAggregate; // Corresponding to outputValues
         size_t packedFloatGradientsSizeInBytes = 0;
@@ -415,6 +421,7 @@ namespace CNTK
 
         // wait for async all reduce to complete. As soon as one of the requests is finished,
         // check if corresponding value is gpu bound and, if it is the case, initiate a cpu-to-gpu transfer.
+        auto profWait = Microsoft::MSR::CNTK::ProfilerTimeBegin();
         size_t numAllReduceRequestsCompleted = 0;
         while (numAllReduceRequestsCompleted < allReduceRequests.size())
         {
@@ -446,10 +453,13 @@ namespace CNTK
             if (ShouldCopyDataToCPU(valuesToAggregate[i]))
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
         }
+        Microsoft::MSR::CNTK::ProfilerTimeEnd(profWait, "MPI Wait For AllReduce", Microsoft::MSR::CNTK::profilerCatDistributed);
 
         // Unpack the continuous buffer
         UnpackFromContinuousBuffer(m_aggregationBufferFloat.get(), outputValues, packedFloatGradientsIndex);
         UnpackFromContinuousBuffer(m_aggregationBufferDouble.get(), outputValues, packedDoubleGradientsIndex);
+
+        Microsoft::MSR::CNTK::ProfilerTimeEnd(profAggregate, "MPI Aggregate", Microsoft::MSR::CNTK::profilerCatDistributed, aggregateBytes);
     }
 
     void MPICommunicatorImpl::AllReduceSparseBlockColumn(
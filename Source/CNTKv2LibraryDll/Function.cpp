@@ -478,6 +478,12 @@ namespace CNTK
             auto stream = GetFstream(filepath, false);
             *stream << model;
             stream->flush();
+
+            // save the analysis of the internal network along with the model, for Load to pick it up
+            auto compositeFunction = dynamic_cast<CompositeFunction*>(this);
+            if (Internal::IsCompiledPlanCachingEnabled() && compositeFunction && compositeFunction->m_computationNetwork &&
+                compositeFunction->m_computationNetwork->HasCompiledPlan())
+                compositeFunction->m_computationNetwork->SaveCompiledPlan(Microsoft::MSR::CNTK::ComputationNetwork::CompiledPlanFileName(filepath));
             break;
         }
 
@@ -495,9 +501,19 @@ namespace CNTK
         {
         case ModelFormat::CNTKv2:
         {
+            auto planFilepath = Microsoft::MSR::CNTK::ComputationNetwork::CompiledPlanFileName(filepath);
+            if (Internal::IsCompiledPlanCachingEnabled() && fexists(planFilepath.c_str()))
+                Microsoft::MSR::CNTK::ComputationNetwork::LoadCompiledPlans(planFilepath);
+
             auto stream = GetFstream(filepath, true);
             if (!Internal::IsLegacyModel(*stream))
             {
+                if (Internal::IsMemoryMappedModelLoadingEnabled())
+                {
+                    stream.reset();
+                    return Function::Deserialize(Dictionary::Load(filepath), computeDevice);
+                }
+
                 Dictionary model;
                 *stream >> model;
                 return Function::Deserialize(model, computeDevice);
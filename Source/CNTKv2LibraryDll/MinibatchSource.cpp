@@ -581,6 +581,21 @@ namespace CNTK
                 augmentedConfiguration[L"maxErrors"] = configuration.maxErrors;
             }
 
+            if (configuration.numberOfLengthBuckets != 0)
+            {
+                augmentedConfiguration[L"lengthBuckets"] = configuration.numberOfLengthBuckets;
+            }
+
+            if (configuration.numberOfReadAheadChunks != 1)
+            {
+                augmentedConfiguration[L"readAheadChunks"] = configuration.numberOfReadAheadChunks;
+            }
+
+            if (configuration.readAheadMaxBytes != 0)
+            {
+                augmentedConfiguration[L"readAheadMaxBytes"] = configuration.readAheadMaxBytes;
+            }
+
             bool defaultMultithreaded = false;
             // The CNTK reader implementation requires for each deserializer both the module and deserializer type be specified
             // This is redundant and the V2 API users will just specify type from which the module is automatically inferred
@@ -214,6 +214,12 @@ namespace CNTK
         : NDArrayView(dataType, device, storageType, viewShape, false, AllocateTensorView(dataType, storageType, viewShape, device))
     {}
 
+    NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const std::shared_ptr<void>& dataBufferOwner)
+        : NDArrayView(dataType, viewShape, dataBuffer, bufferSizeInBytes, DeviceDescriptor::CPUDevice())
+    {
+        m_dataBufferOwner = dataBufferOwner;
+    }
+
     NDArrayView::~NDArrayView()
     {}
 
@@ -535,7 +541,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), Shape(), IsReadOnly() || readOnly, tensorView);
+        auto view = MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), Shape(), IsReadOnly() || readOnly, tensorView);
+        view->m_dataBufferOwner = m_dataBufferOwner;
+        return view;
     }
 
     NDArrayViewPtr NDArrayView::SliceView(const std::vector<size_t>& startOffset, const std::vector<size_t>& extent, bool readOnly) const
@@ -652,7 +660,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), sliceViewShape, IsReadOnly() || readOnly, tensorView);
+        auto view = MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), sliceViewShape, IsReadOnly() || readOnly, tensorView);
+        view->m_dataBufferOwner = m_dataBufferOwner;
+        return view;
     }
 
     NDArrayViewPtr NDArrayView::AsShape(const NDShape& newShape) const
@@ -688,7 +698,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), newShape, IsReadOnly(), tensorView);
+        auto view = MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), newShape, IsReadOnly(), tensorView);
+        view->m_dataBufferOwner = m_dataBufferOwner;
+        return view;
     }
 
     template <typename ElementType>
@@ -11,9 +11,15 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
 
 #ifdef _MSC_VER
 #include <io.h>
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #pragma warning(push)
@@ -29,8 +35,25 @@ namespace CNTK
     using namespace ::google::protobuf;
 
     static const uint32 MAGIC_NUMBER = 0x636e746bU;
+    static const uint32 ALIGNED_MAGIC_NUMBER = 0x636e746dU;
     static const uint32 BLOCK_SIZE = 8 << 10; // 8Kb;
 
+    // Alignment of the NDArrayView contents in the aligned layout, relative to the start of the stream.
+    static const size_t PAYLOAD_ALIGNMENT = 64;
+
+    static size_t AlignUp(size_t offset)
+    {
+        return (offset + PAYLOAD_ALIGNMENT - 1) / PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT;
+    }
+
+    // The aligned layout: the magic number and the size of the metadata message, the message, and the payload region
+    // which starts at the next aligned offset. Each NDArrayView stores its contents in the native (little-endian) representation
+    // at an aligned offset in the payload region, so that they can be used in place when the file is memory mapped.
+    static size_t AlignedPayloadStart(size_t messageSize)
+    {
+        return AlignUp(2 * sizeof(uint32) + messageSize);
+    }
+
     static void SetUTF8Locale()
     {
 #ifndef _MSC_VER
@@ -113,6 +136,86 @@ namespace CNTK
     };
 
 
+    static bool Skip(io::ZeroCopyInputStream& input, size_t size)
+    {
+        while (size > 0)
+        {
+            auto count = std::min<size_t>(size, INT_MAX);
+            if (!input.Skip((int)count))
+                return false;
+            size -= count;
+        }
+        return true;
+    }
+
+    // A private (copy-on-write) mapping of a whole file: pages are shared with the file cache until they are written to,
+    // and writes never reach the file.
+    class MappedFile
+    {
+    public:
+        // Returns null if the file cannot be mapped.
+        static std::shared_ptr<MappedFile> Open(const std::wstring& filename)
+        {
+            void* data = nullptr;
+            size_t size = 0;
+#ifdef _MSC_VER
+            HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return nullptr;
+
+            LARGE_INTEGER fileSize;
+            if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+            {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+                if (mapping != nullptr)
+                {
+                    data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                    size = (size_t)fileSize.QuadPart;
+                    CloseHandle(mapping); // the view keeps the mapping alive
+                }
+            }
+            CloseHandle(file);
+#else
+            auto fd = GetFileDescriptor(filename, true);
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+            {
+                size = (size_t)fileStat.st_size;
+                data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                    data = nullptr;
+            }
+            close(fd);
+#endif
+            if (data == nullptr)
+                return nullptr;
+
+            return std::shared_ptr<MappedFile>(new MappedFile(static_cast<char*>(data), size));
+        }
+
+        ~MappedFile()
+        {
+#ifdef _MSC_VER
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+        }
+
+        char* Data() const { return m_data; }
+        size_t Size() const { return m_size; }
+
+    private:
+        MappedFile(char* data, size_t size)
+            : m_data(data), m_size(size)
+        {}
+
+        MappedFile(const MappedFile&) = delete; MappedFile& operator=(const MappedFile&) = delete;
+
+        char* m_data;
+        size_t m_size;
+    };
+
     class Serializer
     {
         friend std::ostream& operator<<(std::ostream&, const Dictionary&);
@@ -141,6 +244,8 @@ namespace CNTK
 
         void CopyNDArrayViewDataToProtos();
         void WriteNDArrayViewData(io::CodedOutputStream& output);
+        void AssignPayloadOffsets();
+        void WriteAlignedNDArrayViewData(io::CodedOutputStream& output);
 
         std::ostream& Write(std::ostream& stream);
         void Write(const std::wstring& filename);
@@ -157,6 +262,10 @@ namespace CNTK
         bool Read(std::istream& stream, const std::function<bool(io::ZeroCopyInputStream& input)>& callback);
 
         bool ReadNDArrayViewData(io::ZeroCopyInputStream& input);
+        bool ReadAlignedNDArrayViewData(io::ZeroCopyInputStream& input);
+
+        bool ReadMapped(const std::shared_ptr<MappedFile>& file, const std::function<bool(io::ZeroCopyInputStream& input)>& callback);
+        NDArrayView* CreateMappedView(const proto::NDArrayView& src, DataType dataType, const NDShape& shape);
 
         size_t GetTotalByteSize()
         {
@@ -344,11 +453,101 @@ namespace CNTK
             memcpy(buffer, src.data(), size * sizeof(int8_t));
         }
 
+        static size_t PayloadSize(const NDArrayView& view)
+        {
+            return view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+        }
+
+        static const void* RawDataBuffer(const NDArrayView& src)
+        {
+            switch (src.GetDataType())
+            {
+            case DataType::Float:
+                return src.DataBuffer<float>();
+            case DataType::Double:
+                return src.DataBuffer<double>();
+            case DataType::Float16:
+                return src.DataBuffer<float16>();
+            case DataType::Int8:
+                return src.DataBuffer<int8_t>();
+            case DataType::Int16:
+                return src.DataBuffer<int16_t>();
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(src.GetDataType()));
+            }
+        }
+
+        static void* WritableRawDataBuffer(NDArrayView& dst)
+        {
+            switch (dst.GetDataType())
+            {
+            case DataType::Float:
+                return dst.WritableDataBuffer<float>();
+            case DataType::Double:
+                return dst.WritableDataBuffer<double>();
+            case DataType::Float16:
+                return dst.WritableDataBuffer<float16>();
+            case DataType::Int8:
+                return dst.WritableDataBuffer<int8_t>();
+            case DataType::Int16:
+                return dst.WritableDataBuffer<int16_t>();
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(dst.GetDataType()));
+            }
+        }
+
+        // CodedOutputStream and ZeroCopyInputStream count in ints, buffers of more than 2GBs are written and read in pieces.
+        static void WriteRaw(io::CodedOutputStream& output, const void* buffer, size_t size)
+        {
+            auto bytes = static_cast<const char*>(buffer);
+            while (size > 0)
+            {
+                auto count = std::min<size_t>(size, INT_MAX);
+                output.WriteRaw(bytes, (int)count);
+                bytes += count;
+                size -= count;
+            }
+        }
+
+        static void WritePadding(io::CodedOutputStream& output, size_t size)
+        {
+            static const char zeros[PAYLOAD_ALIGNMENT] = {};
+            assert(size < PAYLOAD_ALIGNMENT);
+            output.WriteRaw(zeros, (int)size);
+        }
+
+        static bool ReadRaw(io::ZeroCopyInputStream& input, void* buffer, size_t size)
+        {
+            auto bytes = static_cast<char*>(buffer);
+            while (size > 0)
+            {
+                const void* data;
+                int available;
+                if (!input.Next(&data, &available))
+                    return false;
+
+                auto count = std::min<size_t>(size, available);
+                memcpy(bytes, data, count);
+                if (count < available)
+                    input.BackUp(available - (int)count);
+                bytes += count;
+                size -= count;
+            }
+            return true;
+        }
+
         UsingUTF8 m_locale;
         Arena m_arena;
         Message* m_proto;
         std::vector<std::pair<NDArrayView*, proto::NDArrayView*>> m_arrayViews;
         size_t m_byteSize {0};
+
+        // Whether the payload being read is in the aligned layout.
+        bool m_hasAlignedPayload {false};
+
+        // The file the model is being read from, if it is memory mapped, and the offset of its payload region.
+        std::shared_ptr<MappedFile> m_mappedFile;
+        size_t m_mappedPayloadStart {0};
     };
 
 
@@ -422,11 +621,35 @@ namespace CNTK
         }
     }
 
+    void Serializer::AssignPayloadOffsets()
+    {
+        size_t offset = 0;
+        for (auto& pair : m_arrayViews)
+        {
+            pair.second->set_payload_offset(offset);
+            offset = AlignUp(offset + PayloadSize(*(pair.first)));
+        }
+    }
+
+    void Serializer::WriteAlignedNDArrayViewData(io::CodedOutputStream& output)
+    {
+        for (auto& pair : m_arrayViews)
+        {
+            const auto& src = *(pair.first);
+            auto size = PayloadSize(src);
+            WriteRaw(output, RawDataBuffer(src), size);
+            WritePadding(output, AlignUp(size) - size);
+        }
+    }
+
     bool Serializer::ReadNDArrayViewData(io::ZeroCopyInputStream& input)
     {
         if (m_arrayViews.size() == 0)
             return true;
 
+        if (m_hasAlignedPayload)
+            return ReadAlignedNDArrayViewData(input);
+
         RenewableCodedStream wrapper(input);
         for (auto& pair : m_arrayViews)
         {
@@ -460,6 +683,37 @@ namespace CNTK
         return true;
     }
 
+    bool Serializer::ReadAlignedNDArrayViewData(io::ZeroCopyInputStream& input)
+    {
+        // The input is positioned at the start of the payload region.
+        auto arrayViews = m_arrayViews;
+        std::sort(arrayViews.begin(), arrayViews.end(), [](const std::pair<NDArrayView*, proto::NDArrayView*>& a, const std::pair<NDArrayView*, proto::NDArrayView*>& b) {
+            return a.second->payload_offset() < b.second->payload_offset();
+        });
+
+        size_t position = 0;
+        for (auto& pair : arrayViews)
+        {
+            auto& dst = *(pair.first);
+            auto offset = pair.second->payload_offset();
+            auto size = PayloadSize(dst);
+            if (offset < position || !Skip(input, offset - position) || !ReadRaw(input, WritableRawDataBuffer(dst), size))
+                return false;
+            position = offset + size;
+        }
+        return true;
+    }
+
+    NDArrayView* Serializer::CreateMappedView(const proto::NDArrayView& src, DataType dataType, const NDShape& shape)
+    {
+        auto size = shape.TotalSize() * DataTypeSize(dataType);
+        auto offset = m_mappedPayloadStart + src.payload_offset();
+        if (offset > m_mappedFile->Size() || size > m_mappedFile->Size() - offset)
+            RuntimeError("The contents of an NDArrayView lie outside of the memory mapped model file (%zu bytes).", m_mappedFile->Size());
+
+        return new NDArrayView(dataType, shape, m_mappedFile->Data() + offset, size, m_mappedFile);
+    }
+
     proto::NDShape* Serializer::CreateProto(const NDShape& src, Arena* arena)
     {
         proto::NDShape* dst = (arena != nullptr) ? 
@@ -536,6 +790,10 @@ namespace CNTK
         std::unique_ptr<NDShape> shape(CreateFromProto(src.shape()));
         auto dataType = FromProtoType(src.data_type());
         auto storageFormat = FromProtoType(src.storage_format());
+
+        if (m_mappedFile && storageFormat == StorageFormat::Dense && src.values_case() == proto::NDArrayView::VALUES_NOT_SET)
+            return CreateMappedView(src, dataType, *shape);
+
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
         if (dataType == DataType::Float)
@@ -543,35 +801,35 @@ namespace CNTK
             if (src.float_values().value().size() == shape->TotalSize())
                 CopyData<float>(src.float_values().value(), dst);
             else 
-                m_arrayViews.push_back({ dst, nullptr });
+                m_arrayViews.push_back({ dst, const_cast<proto::NDArrayView*>(&src) });
         }
         else if (dataType == DataType::Double)
         {
             if (src.double_values().value().size() == shape->TotalSize())
                 CopyData<double>(src.double_values().value(), dst);
             else
-                m_arrayViews.push_back({ dst, nullptr });
+                m_arrayViews.push_back({ dst, const_cast<proto::NDArrayView*>(&src) });
         }
         else if(dataType == DataType::Float16)
         {
             if (src.float_values().value().size() == shape->TotalSize())
                 CopyData<float, float16>(src.float_values().value(), dst);
             else
-                m_arrayViews.push_back({ dst, nullptr });
+                m_arrayViews.push_back({ dst, const_cast<proto::NDArrayView*>(&src) });
         }
         else if (dataType == DataType::Int8)
         {
             if (src.bytes_value().value().size() == shape->TotalSize())
                 CopyInt8Data(src.bytes_value().value(), dst);
             else
-                m_arrayViews.push_back({ dst, nullptr });
+                m_arrayViews.push_back({ dst, const_cast<proto::NDArrayView*>(&src) });
         }
         else if (dataType == DataType::Int16)
         {
             if (src.sint32_values().value().size() == shape->TotalSize())
                  CopyData<int32, int16_t>(src.sint32_values().value(), dst);
             else
-                 m_arrayViews.push_back({ dst, nullptr });
+                 m_arrayViews.push_back({ dst, const_cast<proto::NDArrayView*>(&src) });
         }
         return dst;
     }
@@ -740,7 +998,23 @@ namespace CNTK
 
         // Protobufs have a hard limit on the maximum message size(INT_MAX = 2GBs). 
         // Check if we fit into a single protobuf message.
-        if (FitsIntoProtobuf())
+        if (Internal::IsMappableModelSavingEnabled())
+        {
+            // If the model is meant to be memory mapped, pull the metadata apart from the actual payload
+            // (NDArrayView content) and store the payload separately, outside of the protobuf, in the aligned layout.
+            // Prefix the metadata protobuf with a magic number and its bytes size.
+            AssignPayloadOffsets();
+            auto messageSize = m_proto->ByteSizeLong();
+            if (messageSize > INT_MAX)
+                RuntimeError("Size of the model metadata (%zu bytes) exceeds the protobuf message size limit.", messageSize);
+
+            output.WriteLittleEndian32(ALIGNED_MAGIC_NUMBER);
+            output.WriteLittleEndian32((uint32)messageSize);
+            m_proto->SerializeToCodedStream(&output);
+            WritePadding(output, AlignedPayloadStart(messageSize) - 2 * sizeof(uint32) - messageSize);
+            WriteAlignedNDArrayViewData(output);
+        }
+        else if (FitsIntoProtobuf())
         {
             CopyNDArrayViewDataToProtos();
             m_proto->SerializeToCodedStream(&output);
@@ -778,7 +1052,9 @@ namespace CNTK
 #endif
     }
 
-    bool ParseMessage(io::ZeroCopyInputStream& input, Message& msg)
+    // On success, 'hasAlignedPayload' tells if the message is followed by a payload in the aligned layout, the input is then
+    // positioned at the start of its payload region.
+    bool ParseMessage(io::ZeroCopyInputStream& input, Message& msg, bool& hasAlignedPayload)
     {
         uint32 prefix = 0, limit = INT_MAX;;
         const void* temp;
@@ -797,8 +1073,9 @@ namespace CNTK
         }
 
         // the message is only prefixed with a magic number + message length,
-        // if its size exceeds 2GBs.
-        if (prefix == MAGIC_NUMBER) 
+        // if its size exceeds 2GBs or it was saved to be memory mapped.
+        hasAlignedPayload = (prefix == ALIGNED_MAGIC_NUMBER);
+        if (prefix == MAGIC_NUMBER || hasAlignedPayload) 
         {
             io::CodedInputStream::ReadLittleEndian32FromArray(
                 reinterpret_cast<const uint8*>(temp) + sizeof(prefix), &limit);
@@ -808,9 +1085,14 @@ namespace CNTK
         else 
             input.BackUp(size);
 
-        io::CodedInputStream codedInput(&input);
-        codedInput.SetTotalBytesLimit(limit, limit);
-        return msg.ParseFromCodedStream(&codedInput) && codedInput.ConsumedEntireMessage();
+        {
+            io::CodedInputStream codedInput(&input);
+            codedInput.SetTotalBytesLimit(limit, limit);
+            if (!msg.ParseFromCodedStream(&codedInput) || !codedInput.ConsumedEntireMessage())
+                return false;
+        }
+
+        return !hasAlignedPayload || Skip(input, AlignedPayloadStart(limit) - sizeof(prefix) - sizeof(limit) - limit);
     }
 
     bool Serializer::Read(std::istream& stream, Dictionary& dict)
@@ -849,13 +1131,48 @@ namespace CNTK
         });
     }
 
+    bool Serializer::ReadMapped(const std::shared_ptr<MappedFile>& file, const std::function<bool(io::ZeroCopyInputStream& input)>& callback)
+    {
+        auto data = reinterpret_cast<const uint8*>(file->Data());
+        uint32 messageSize;
+        io::CodedInputStream::ReadLittleEndian32FromArray(data + sizeof(uint32), &messageSize);
+        if (messageSize > INT_MAX || AlignedPayloadStart(messageSize) > file->Size())
+            return false;
+
+        {
+            io::CodedInputStream codedInput(data + 2 * sizeof(uint32), (int)messageSize);
+            codedInput.SetTotalBytesLimit(messageSize, messageSize);
+            if (!m_proto->ParseFromCodedStream(&codedInput) || !codedInput.ConsumedEntireMessage())
+                return false;
+        }
+
+        // NDArrayViews created from the message alias the mapped file, there is no payload left to read.
+        m_mappedFile = file;
+        m_mappedPayloadStart = AlignedPayloadStart(messageSize);
+        io::ArrayInputStream noPayload(data, 0);
+        return callback(noPayload);
+    }
+
     bool Serializer::Read(std::wstring filename, const std::function<bool(io::ZeroCopyInputStream& input)>& callback)
     {
+        if (Internal::IsMemoryMappedModelLoadingEnabled())
+        {
+            auto file = MappedFile::Open(filename);
+            if (file && file->Size() >= 2 * sizeof(uint32))
+            {
+                uint32 prefix;
+                io::CodedInputStream::ReadLittleEndian32FromArray(reinterpret_cast<const uint8*>(file->Data()), &prefix);
+                if (prefix == ALIGNED_MAGIC_NUMBER)
+                    return ReadMapped(file, callback);
+            }
+            // Models in the other layouts are read as usual.
+        }
+
         bool result;
         auto fd = GetFileDescriptor(filename, true);
         {
             io::FileInputStream input(fd, BLOCK_SIZE);
-            result = ParseMessage(input, *m_proto);
+            result = ParseMessage(input, *m_proto, m_hasAlignedPayload);
             result = result && callback(input);
         }
 #ifdef _MSC_VER
@@ -869,7 +1186,7 @@ namespace CNTK
     bool Serializer::Read(std::istream& stream, const std::function<bool(io::ZeroCopyInputStream& input)>& callback)
     {
         io::IstreamInputStream input(&stream, BLOCK_SIZE);
-        if (ParseMessage(input, *m_proto))
+        if (ParseMessage(input, *m_proto, m_hasAlignedPayload))
         {
             return callback(input);
         }
@@ -680,6 +680,47 @@ namespace CNTK
         }
     }
 
+    /*static*/ MBLayoutPtr Utils::CreatePackedLayout(const std::vector<ptrdiff_t>& sequenceBeginIndices, const std::vector<size_t>& sequenceLengths, std::vector<std::pair<size_t, size_t>>& placement)
+    {
+        auto numSequences = sequenceLengths.size();
+        size_t maxNumTimeSteps = 0;
+        for (auto sequenceLength : sequenceLengths)
+            maxNumTimeSteps = std::max(maxNumTimeSteps, sequenceLength);
+
+        bool hasTruncatedSequences = std::find_if(sequenceBeginIndices.begin(), sequenceBeginIndices.end(), [](const ptrdiff_t& val) { return (val < 0); }) != sequenceBeginIndices.end();
+
+        auto layout = std::make_shared<MBLayout>();
+        if (!hasTruncatedSequences)
+        {
+            std::vector<MBLayout::SequenceInfo> sequences;
+            for (size_t i = 0; i < numSequences; ++i)
+                sequences.push_back({ i, SIZE_MAX, sequenceBeginIndices[i], sequenceLengths[i] });
+
+            std::vector<size_t> rowAllocations;
+            layout->InitAsPackedSequences(sequences, placement, rowAllocations);
+        }
+        else
+        {
+            layout->Init(numSequences, maxNumTimeSteps);
+
+            // We cannot pack as some of the sequences are truncated and thus all sequences have to be
+            // kept in their original parallel streams
+            placement.resize(numSequences);
+            for (size_t i = 0; i < numSequences; ++i)
+            {
+                layout->AddSequence(i, i, sequenceBeginIndices[i], sequenceLengths[i]);
+
+                // Add the gap if there is one
+                if (sequenceLengths[i] < maxNumTimeSteps)
+                    layout->AddSequence(GAP_SEQUENCE_ID, i, sequenceLengths[i], maxNumTimeSteps);
+
+                placement[i] = std::make_pair(i, 0);
+            }
+        }
+
+        return layout;
+    }
+
     template <typename ElementType>
     std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape,
                                                                                                                           const std::shared_ptr<Matrix<ElementType>>& outputMatrixStorage,
@@ -754,37 +795,8 @@ namespace CNTK
             if (mask != nullptr)
                 Value::GetSequenceStartsAndLengths(mask, sequenceBeginIndices, sequenceLengths, numDynamicAxes);
 
-            bool hasTruncatedSequences = std::find_if(sequenceBeginIndices.begin(), sequenceBeginIndices.end(), [](const ptrdiff_t& val) { return (val < 0); }) != sequenceBeginIndices.end();
-
-            auto layout = std::make_shared<MBLayout>();
             std::vector<std::pair<size_t, size_t>> placement;
-            if (!hasTruncatedSequences)
-            {
-                std::vector<MBLayout::SequenceInfo> sequences;
-                for (size_t i = 0; i < numSequences; ++i)
-                    sequences.push_back({ i, SIZE_MAX, sequenceBeginIndices[i], sequenceLengths[i] });
-
-                std::vector<size_t> rowAllocations;
-                layout->InitAsPackedSequences(sequences, placement, rowAllocations);
-            }
-            else
-            {
-                layout->Init(numSequences, maxNumTimeSteps);
-
-                // We cannot pack as some of the sequences are truncated and thus all sequences have to be
-                // kept in their original parallel streams
-                placement.resize(numSequences);
-                for (size_t i = 0; i < numSequences; ++i)
-                {
-                    layout->AddSequence(i, i, sequenceBeginIndices[i], sequenceLengths[i]);
-
-                    // Add the gap if there is one
-                    if (sequenceLengths[i] < maxNumTimeSteps)
-                        layout->AddSequence(GAP_SEQUENCE_ID, i, sequenceLengths[i], maxNumTimeSteps);
-
-                    placement[i] = std::make_pair(i, 0);
-                }
-            }
+            auto layout = CreatePackedLayout(sequenceBeginIndices, sequenceLengths, placement);
 
             if (maxNumTimeSteps != layout->GetNumTimeSteps())
                 LogicError("The number (%d) of time steps in the packed MBLayout does not match the longest sequence's length (%d) in the Value object", (int)maxNumTimeSteps, (int)layout->GetNumTimeSteps());
@@ -687,6 +687,11 @@ namespace CNTK
         }
         static void VerifyVariableValueCompatibility(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape = nullptr);
 
+        // Creates the MBLayout that packs sequences of the specified lengths into parallel streams, and returns the
+        // (parallel stream, begin time step) each sequence is placed at in 'placement'. Sequences that do not begin
+        // in this minibatch cannot be packed and are given a stream of their own.
+        static Microsoft::MSR::CNTK::MBLayoutPtr CreatePackedLayout(const std::vector<ptrdiff_t>& sequenceBeginIndices, const std::vector<size_t>& sequenceLengths, std::vector<std::pair<size_t, size_t>>& placement);
+
         template <typename ElementType>
         static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr>
         GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape,
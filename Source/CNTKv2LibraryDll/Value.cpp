@@ -365,6 +365,163 @@ namespace CNTK
         return Create(sampleShape, {sequenceData}, {sequenceStartFlag}, device, readOnly, false);
     }
 
+    //
+    // Create the MBLayout packing sequences of the specified lengths, and map each of its columns to the index of the sample
+    // (counted over the concatenation of all sequences) it holds, or SIZE_MAX if the column is a gap.
+    //
+    static Microsoft::MSR::CNTK::MBLayoutPtr CreatePackedSequencesLayout(const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, std::vector<size_t>& sampleIndexOfColumn, size_t& numSamples)
+    {
+        size_t numSequences = sequenceLengths.size();
+        if (numSequences == 0)
+            InvalidArgument("Value::CreatePacked: The number of sequences must be > 0");
+
+        if (!sequenceStartFlags.empty() && (sequenceStartFlags.size() != numSequences))
+            InvalidArgument("Value::CreatePacked: The number (%zu) of sequence start flags does not match the number (%zu) of sequences.", sequenceStartFlags.size(), numSequences);
+
+        std::vector<ptrdiff_t> sequenceBeginIndices(numSequences, 0);
+        numSamples = 0;
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            if (sequenceLengths[i] == 0)
+                InvalidArgument("Value::CreatePacked: The length of sequence #%zu is 0; all sequences must have at least one sample.", i);
+
+            if (!sequenceStartFlags.empty() && !sequenceStartFlags[i])
+                sequenceBeginIndices[i] = Microsoft::MSR::CNTK::SentinelValueIndicatingUnspecifedSequenceBeginIdx;
+
+            numSamples += sequenceLengths[i];
+        }
+
+        std::vector<std::pair<size_t, size_t>> placement;
+        auto layout = Utils::CreatePackedLayout(sequenceBeginIndices, sequenceLengths, placement);
+
+        size_t numParallelSequences = layout->GetNumParallelSequences();
+        sampleIndexOfColumn.assign(layout->GetNumCols(), SIZE_MAX);
+        for (size_t i = 0, sampleIndex = 0; i < numSequences; ++i)
+        {
+            for (size_t j = 0; j < sequenceLengths[i]; ++j, ++sampleIndex)
+                sampleIndexOfColumn[((placement[i].second + j) * numParallelSequences) + placement[i].first] = sampleIndex;
+        }
+
+        return layout;
+    }
+
+    template <typename ElementType>
+    /*static*/ ValuePtr Value::CreatePacked(const NDShape& sampleShape, const std::vector<ElementType>& packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/)
+    {
+        std::vector<size_t> sampleIndexOfColumn;
+        size_t numSamples;
+        auto layout = CreatePackedSequencesLayout(sequenceLengths, sequenceStartFlags, sampleIndexOfColumn, numSamples);
+
+        size_t sampleSize = sampleShape.TotalSize();
+        if (packedData.size() != (numSamples * sampleSize))
+            InvalidArgument("Value::CreatePacked: The number of elements (%zu) in the vector containing the packed data must be the total length (%zu) of the sequences times the size (%zu) of the sample shape '%S'.",
+                            packedData.size(), numSamples, sampleSize, sampleShape.AsString().c_str());
+
+        // Interleave the samples into the columns of the layout. Gaps are zeroed; the layout masks them anyway.
+        NDShape packedShape({ sampleSize, layout->GetNumCols() });
+        NDArrayViewPtr packedView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), packedShape, DeviceDescriptor::CPUDevice());
+        ElementType* packedBuffer = packedView->WritableDataBuffer<ElementType>();
+        for (size_t col = 0; col < sampleIndexOfColumn.size(); ++col)
+        {
+            ElementType* column = packedBuffer + (col * sampleSize);
+            if (sampleIndexOfColumn[col] == SIZE_MAX)
+                std::fill(column, column + sampleSize, (ElementType)0);
+            else
+                std::copy(packedData.data() + (sampleIndexOfColumn[col] * sampleSize), packedData.data() + ((sampleIndexOfColumn[col] + 1) * sampleSize), column);
+        }
+
+        if (device != DeviceDescriptor::CPUDevice())
+            packedView = packedView->DeepClone(device, readOnly);
+        else if (readOnly)
+            packedView = packedView->Alias(readOnly);
+
+        return MakeSharedObject<PackedValue>(sampleShape, Axis::DefaultInputVariableDynamicAxes(), packedView, layout, readOnly);
+    }
+
+    template <typename ElementType>
+    /*static*/ ValuePtr Value::CreatePacked(const NDShape& sampleShape, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/)
+    {
+        if (sampleShape.Rank() < 1)
+            InvalidArgument("Value::CreatePacked: The sample rank must be > 0");
+
+        std::vector<size_t> sampleIndexOfColumn;
+        size_t numSamples;
+        auto layout = CreatePackedSequencesLayout(sequenceLengths, sequenceStartFlags, sampleIndexOfColumn, numSamples);
+
+        // A sample is a column of sampleShape.TotalSize() rows; its one-hot vectors are stacked in it, one per index.
+        size_t dimension = sampleShape[0];
+        size_t numIndicesPerSample = sampleShape.SubShape(1).TotalSize();
+        if (packedOneHotData.size() != (numSamples * numIndicesPerSample))
+            InvalidArgument("Value::CreatePacked: The number of indices (%zu) in the vector containing the packed one-hot data must be the total length (%zu) of the sequences times %zu for the sample shape '%S'.",
+                            packedOneHotData.size(), numSamples, numIndicesPerSample, sampleShape.AsString().c_str());
+
+        std::vector<SparseIndexType> colStarts(sampleIndexOfColumn.size() + 1);
+        std::vector<SparseIndexType> rowIndices;
+        rowIndices.reserve(packedOneHotData.size());
+        for (size_t col = 0; col < sampleIndexOfColumn.size(); ++col)
+        {
+            colStarts[col] = (SparseIndexType)rowIndices.size();
+            if (sampleIndexOfColumn[col] == SIZE_MAX)
+                continue;
+
+            const size_t* sampleIndices = packedOneHotData.data() + (sampleIndexOfColumn[col] * numIndicesPerSample);
+            for (size_t k = 0; k < numIndicesPerSample; ++k)
+            {
+                size_t oneHotIdx = sampleIndices[k];
+                if ((oneHotIdx & OneHotSkip) == OneHotSkip)
+                    continue;
+
+                if (oneHotIdx >= dimension)
+                    InvalidArgument("Value::CreatePacked: one-hot index value (%zu) exceeds vocabulary size (%zu).", oneHotIdx, dimension);
+
+                rowIndices.push_back((SparseIndexType)((k * dimension) + oneHotIdx));
+            }
+        }
+
+        colStarts.back() = (SparseIndexType)rowIndices.size();
+        std::vector<ElementType> nonZeroValues(rowIndices.size(), (ElementType)1);
+        NDShape packedShape({ sampleShape.TotalSize(), layout->GetNumCols() });
+        auto packedView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), packedShape, colStarts.data(), rowIndices.data(), nonZeroValues.data(), nonZeroValues.size(), device, readOnly);
+        return MakeSharedObject<PackedValue>(sampleShape, Axis::DefaultInputVariableDynamicAxes(), packedView, layout, readOnly);
+    }
+
+    template <typename ElementType>
+    /*static*/ ValuePtr Value::CreatePacked(const NDShape& sampleShape, const std::vector<size_t>& sequenceLengths, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/)
+    {
+        if ((sampleShape.Rank() < 1) || (sampleShape[0] != sampleShape.TotalSize()))
+            InvalidArgument("Value::CreatePacked: The leading dimension of the sample shape '%S' must be the same as its total size for sparse data.", sampleShape.AsString().c_str());
+
+        std::vector<size_t> sampleIndexOfColumn;
+        size_t numSamples;
+        auto layout = CreatePackedSequencesLayout(sequenceLengths, sequenceStartFlags, sampleIndexOfColumn, numSamples);
+
+        if ((size_t)(colStarts[numSamples] - colStarts[0]) != numNonZeroValues)
+            InvalidArgument("Value::CreatePacked: The number (%zu) of non-zero values does not match the column starts of the %zu samples of the packed sequences.", numNonZeroValues, numSamples);
+
+        // Reorder the columns into the layout; the non-zero values of a column stay together.
+        std::vector<SparseIndexType> packedColStarts(sampleIndexOfColumn.size() + 1);
+        std::vector<SparseIndexType> packedRowIndices(numNonZeroValues);
+        std::vector<ElementType> packedNonZeroValues(numNonZeroValues);
+        size_t numCopiedValues = 0;
+        for (size_t col = 0; col < sampleIndexOfColumn.size(); ++col)
+        {
+            packedColStarts[col] = (SparseIndexType)numCopiedValues;
+            if (sampleIndexOfColumn[col] == SIZE_MAX)
+                continue;
+
+            size_t begin = colStarts[sampleIndexOfColumn[col]] - colStarts[0];
+            size_t end = colStarts[sampleIndexOfColumn[col] + 1] - colStarts[0];
+            std::copy(rowIndices + begin, rowIndices + end, packedRowIndices.begin() + numCopiedValues);
+            std::copy(nonZeroValues + begin, nonZeroValues + end, packedNonZeroValues.begin() + numCopiedValues);
+            numCopiedValues += (end - begin);
+        }
+
+        packedColStarts.back() = (SparseIndexType)numCopiedValues;
+        NDShape packedShape({ sampleShape.TotalSize(), layout->GetNumCols() });
+        auto packedView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), packedShape, packedColStarts.data(), packedRowIndices.data(), packedNonZeroValues.data(), numCopiedValues, device, readOnly);
+        return MakeSharedObject<PackedValue>(sampleShape, Axis::DefaultInputVariableDynamicAxes(), packedView, layout, readOnly);
+    }
+
     /*virtual*/ Value::~Value()
     {
     }
@@ -631,6 +788,126 @@ namespace CNTK
         memcpy(rowIndices.data(), rawRowIndices, numNonZeroValues * sizeof(SparseIndexType));
     }
 
+    //
+    // Returns the packed data of 'value' and its layout, if 'value' still holds packed data with a layout, and nullptr otherwise.
+    //
+    static NDArrayViewPtr GetPackedDataViewAndLayout(const Value* value, Microsoft::MSR::CNTK::MBLayoutPtr& layout)
+    {
+        auto packedValue = dynamic_cast<const PackedValue*>(value);
+        if (!packedValue || !packedValue->IsPacked())
+            return nullptr;
+
+        NDArrayViewPtr packedView;
+        std::tie(packedView, layout) = packedValue->PackedDataView();
+        return layout ? packedView : nullptr;
+    }
+
+    size_t Value::GetPackedSequenceLengths(const Variable& outputVariable, size_t* sequenceLengths)
+    {
+        size_t numSamples = 0;
+        Microsoft::MSR::CNTK::MBLayoutPtr layout;
+        if (GetPackedDataViewAndLayout(this, layout))
+        {
+            // Sequences are listed in the same order in which unpacking places them
+            size_t seqIndex = 0;
+            for (const auto& sequenceInfo : layout->GetAllSequences())
+            {
+                if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+                    continue;
+
+                if (sequenceInfo.tBegin < 0)
+                    RuntimeError("Currently, only sequence starting with SequenceBegin is supported.");
+
+                sequenceLengths[seqIndex] = std::min(layout->GetNumTimeSteps(), sequenceInfo.tEnd) - (size_t)sequenceInfo.tBegin;
+                numSamples += sequenceLengths[seqIndex++];
+            }
+
+            return numSamples;
+        }
+
+        size_t numOfSequences;
+        size_t maxSequenceLen;
+        std::tie(maxSequenceLen, numOfSequences) = GetSequenceAndBatchLength(outputVariable);
+
+        std::vector<ptrdiff_t> sequenceBeginIndices(numOfSequences, 0);
+        std::vector<size_t> unpackedSequenceLengths(numOfSequences, maxSequenceLen);
+        GetSequenceStartsAndLengths(Mask(), sequenceBeginIndices, unpackedSequenceLengths, outputVariable.DynamicAxes().size());
+        for (size_t seqIndex = 0; seqIndex < numOfSequences; ++seqIndex)
+        {
+            if (sequenceBeginIndices[seqIndex] != 0)
+                RuntimeError("Currently, only sequence starting with SequenceBegin is supported.");
+
+            sequenceLengths[seqIndex] = unpackedSequenceLengths[seqIndex];
+            numSamples += unpackedSequenceLengths[seqIndex];
+        }
+
+        return numSamples;
+    }
+
+    template <typename ElementType>
+    void Value::CopyVariableValueToPackedBuffer(const Variable& outputVariable, ElementType* packedData, size_t packedDataSize)
+    {
+        if (IsSparse())
+            InvalidArgument("Value::CopyVariableValueToPacked: Only dense data can be copied in packed form; the Value for Variable '%S' is sparse.", outputVariable.AsString().c_str());
+
+        if (AsDataType<ElementType>() != GetDataType())
+            InvalidArgument("Value::CopyVariableValueToPacked: The specified ElementType %s does not match the Value's DataType %s.", typeid(ElementType).name(), DataTypeName(GetDataType()));
+
+        size_t numCopiedElements = 0;
+        auto CopySamples = [&](const ElementType* source, size_t numElements) {
+            if ((numCopiedElements + numElements) > packedDataSize)
+                LogicError("Value::CopyVariableValueToPacked: The samples of the Value exceed the size (%zu) of the packed data buffer.", packedDataSize);
+
+            std::copy(source, source + numElements, packedData + numCopiedElements);
+            numCopiedElements += numElements;
+        };
+
+        Microsoft::MSR::CNTK::MBLayoutPtr layout;
+        auto packedView = GetPackedDataViewAndLayout(this, layout);
+        if (packedView)
+        {
+            // Gather the columns of each sequence from the packed data; only the valid samples are transferred.
+            if (packedView->Device() != DeviceDescriptor::CPUDevice())
+                packedView = packedView->DeepClone(DeviceDescriptor::CPUDevice());
+
+            const ElementType* packedBuffer = packedView->DataBuffer<ElementType>();
+            size_t sampleSize = packedView->Shape()[0];
+            size_t numParallelSequences = layout->GetNumParallelSequences();
+            for (const auto& sequenceInfo : layout->GetAllSequences())
+            {
+                if (sequenceInfo.seqId == GAP_SEQUENCE_ID)
+                    continue;
+
+                size_t sequenceBegin = (size_t)std::max<ptrdiff_t>(0, sequenceInfo.tBegin);
+                size_t sequenceEnd = std::min(layout->GetNumTimeSteps(), sequenceInfo.tEnd);
+                for (size_t t = sequenceBegin; t < sequenceEnd; ++t)
+                    CopySamples(packedBuffer + (((t * numParallelSequences) + sequenceInfo.s) * sampleSize), sampleSize);
+            }
+        }
+        else
+        {
+            size_t numOfSequences;
+            size_t maxSequenceLen;
+            std::tie(maxSequenceLen, numOfSequences) = GetSequenceAndBatchLength(outputVariable);
+
+            std::vector<ptrdiff_t> sequenceBeginIndices(numOfSequences, 0);
+            std::vector<size_t> sequenceLengths(numOfSequences, maxSequenceLen);
+            GetSequenceStartsAndLengths(Mask(), sequenceBeginIndices, sequenceLengths, outputVariable.DynamicAxes().size());
+
+            auto cpuView = Data();
+            if (cpuView->Device() != DeviceDescriptor::CPUDevice())
+                cpuView = cpuView->DeepClone(DeviceDescriptor::CPUDevice());
+
+            const ElementType* valueBuffer = cpuView->DataBuffer<ElementType>();
+            size_t sampleSize = cpuView->Shape().TotalSize() / (maxSequenceLen * numOfSequences);
+            for (size_t seqIndex = 0; seqIndex < numOfSequences; ++seqIndex)
+                CopySamples(valueBuffer + (seqIndex * maxSequenceLen * sampleSize), sequenceLengths[seqIndex] * sampleSize);
+        }
+
+        if (numCopiedElements != packedDataSize)
+            LogicError("Value::CopyVariableValueToPacked: The samples of the Value (%zu elements) do not fill the packed data buffer (%zu elements).", numCopiedElements, packedDataSize);
+    }
+
     template <typename ElementType>
     ElementType Value::AsScalar() const
     {
@@ -764,6 +1041,15 @@ namespace CNTK
     template /*static*/ CNTK_API ValuePtr Value::CreateSequence<float>(const NDShape& sampleShape, size_t sequenceLength, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const float* nonZeroValues, size_t numNonZeroValues, bool sequenceStartFlag, const DeviceDescriptor& device, bool readOnly/* = false*/);
     template /*static*/ CNTK_API ValuePtr Value::CreateSequence<double>(const NDShape& sampleShape, size_t sequenceLength, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const double* nonZeroValues, size_t numNonZeroValues, bool sequenceStartFlag, const DeviceDescriptor& device, bool readOnly/* = false*/);
     template /*static*/ CNTK_API ValuePtr Value::CreateSequence<float16>(const NDShape& sampleShape, size_t sequenceLength, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const float16* nonZeroValues, size_t numNonZeroValues, bool sequenceStartFlag, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float>(const NDShape& sampleShape, const std::vector<float>& packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<double>(const NDShape& sampleShape, const std::vector<double>& packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float16>(const NDShape& sampleShape, const std::vector<float16>& packedData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float>(const NDShape& sampleShape, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<double>(const NDShape& sampleShape, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float16>(const NDShape& sampleShape, const std::vector<size_t>& packedOneHotData, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float>(const NDShape& sampleShape, const std::vector<size_t>& sequenceLengths, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const float* nonZeroValues, size_t numNonZeroValues, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<double>(const NDShape& sampleShape, const std::vector<size_t>& sequenceLengths, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const double* nonZeroValues, size_t numNonZeroValues, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
+    template /*static*/ CNTK_API ValuePtr Value::CreatePacked<float16>(const NDShape& sampleShape, const std::vector<size_t>& sequenceLengths, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const float16* nonZeroValues, size_t numNonZeroValues, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly/* = false*/);
     template CNTK_API void Value::CopyVariableValueToVector<float>(const Variable& outputVariable, std::vector<std::vector<float>>& sequences);
     template CNTK_API void Value::CopyVariableValueToVector<double>(const Variable& outputVariable, std::vector<std::vector<double>>& sequences);
     template CNTK_API void Value::CopyVariableValueToVector<float16>(const Variable& outputVariable, std::vector<std::vector<float16>>& sequences);
@@ -776,6 +1062,9 @@ namespace CNTK
     template CNTK_API void Value::CopyVariableValueToCSCSparse<float>(size_t sequenceLength, std::vector<SparseIndexType>& colStarts, std::vector<SparseIndexType>& rowIndices, std::vector<float>& nonZeroValues, size_t& numNonZeroValues);
     template CNTK_API void Value::CopyVariableValueToCSCSparse<double>(size_t sequenceLength, std::vector<SparseIndexType>& colStarts, std::vector<SparseIndexType>& rowIndices, std::vector<double>& nonZeroValues, size_t& numNonZeroValues);
     template CNTK_API void Value::CopyVariableValueToCSCSparse<float16>(size_t sequenceLength, std::vector<SparseIndexType>& colStarts, std::vector<SparseIndexType>& rowIndices, std::vector<float16>& nonZeroValues, size_t& numNonZeroValues);
+    template CNTK_API void Value::CopyVariableValueToPackedBuffer<float>(const Variable& outputVariable, float* packedData, size_t packedDataSize);
+    template CNTK_API void Value::CopyVariableValueToPackedBuffer<double>(const Variable& outputVariable, double* packedData, size_t packedDataSize);
+    template CNTK_API void Value::CopyVariableValueToPackedBuffer<float16>(const Variable& outputVariable, float16* packedData, size_t packedDataSize);
     template float Value::AsScalar<float>() const;
     template double Value::AsScalar<double>() const;
     template float16 Value::AsScalar<float16>() const;
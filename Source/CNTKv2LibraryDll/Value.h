@@ -122,6 +122,14 @@ namespace CNTK
             return { m_packedData->GetMatrix<ElementType>(), m_packedDataLayout };
         }
 
+        std::pair<NDArrayViewPtr, std::shared_ptr<Microsoft::MSR::CNTK::MBLayout>> PackedDataView() const
+        {
+            if (!m_isPacked)
+                InvalidArgument("PackedValue::PackedDataView called on a Value object that has already been unpacked.");
+
+            return { m_packedData, m_packedDataLayout };
+        }
+
         static NDShape GetUnpackedShape(const NDShape& sampleShape, const std::vector<Axis>& sampleDynamicAxes, const std::shared_ptr<Microsoft::MSR::CNTK::MBLayout>& packedDataLayout)
         {
             // Determine unpacked shape
@@ -548,7 +548,14 @@ namespace CNTK
 
             // TODO: this copying here is redundant, value should be moved from the dictionary to the variable.
             // Also, the correct device should be used upfront when deserializing NDArrayView.
-            Variable var(shape, kind, dataType, value.DeepClone(device, value.IsReadOnly()), needsGradient, dynamicAxis, isSparse, name, uid);
+            // Views over a memory mapped model file are not copied to the CPU, the mapping is copy-on-write.
+            NDArrayViewPtr varValue;
+            if (value.m_dataBufferOwner && device.Type() == DeviceKind::CPU)
+                varValue = value.Alias(value.IsReadOnly());
+            else
+                varValue = value.DeepClone(device, value.IsReadOnly());
+
+            Variable var(shape, kind, dataType, varValue, needsGradient, dynamicAxis, isSparse, name, uid);
             if (var.IsParameter())
                 return Parameter(var);
             else
@@ -0,0 +1,329 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// WeightStore.cpp -- sharing the values of the parameters and constants of a model across processes through a named
+// shared memory segment.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include "Variable.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CNTK
+{
+    // A copy-on-write mapping of a named shared memory segment: pages are shared by all processes that map the segment
+    // until they are written to, and writes are never seen by the other processes.
+    class SharedMemorySegment
+    {
+    public:
+        // Creates the segment with 'size' bytes and fills it in with 'fill' if it does not exist, and maps it.
+        // Otherwise waits until the process that creates it calls 'isReady' with true, and maps the size it returns.
+        // 'isReady' is called on the first bytes of the segment with 'headerSize' bytes.
+        static std::shared_ptr<SharedMemorySegment> CreateOrOpen(const std::wstring& name, size_t size, size_t headerSize,
+                                                                 const std::function<void(char* data)>& fill,
+                                                                 const std::function<bool(const char* header, size_t& size)>& isReady,
+                                                                 bool& created)
+        {
+            size_t mappedSize = size;
+            void* data = nullptr;
+#ifdef _MSC_VER
+            HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+            if (mapping == nullptr)
+                RuntimeError("Cannot create the shared memory segment '%S' (error %u).", name.c_str(), (unsigned int)GetLastError());
+
+            created = (GetLastError() != ERROR_ALREADY_EXISTS);
+            auto view = MapViewOfFile(mapping, created ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, created ? size : headerSize);
+            if (view != nullptr)
+            {
+                if (created)
+                    fill(static_cast<char*>(view));
+                else
+                    WaitUntilReady(name, [&]() { return isReady(static_cast<const char*>(view), mappedSize); });
+                UnmapViewOfFile(view);
+                data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, mappedSize);
+            }
+            CloseHandle(mapping); // the view keeps the mapping alive
+            if (data == nullptr)
+                RuntimeError("Cannot map the shared memory segment '%S' (error %u).", name.c_str(), (unsigned int)GetLastError());
+#else
+            auto objectName = ObjectName(name);
+            int fd = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            created = (fd >= 0);
+            if (created)
+            {
+                auto view = (ftruncate(fd, (off_t)size) == 0) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+                if (view == MAP_FAILED)
+                {
+                    close(fd);
+                    shm_unlink(objectName.c_str());
+                    RuntimeError("Cannot create the shared memory segment '%S' with %zu bytes.", name.c_str(), size);
+                }
+                fill(static_cast<char*>(view));
+                munmap(view, size);
+            }
+            else
+            {
+                if (errno != EEXIST || (fd = shm_open(objectName.c_str(), O_RDONLY, 0)) < 0)
+                    RuntimeError("Cannot open the shared memory segment '%S'.", name.c_str());
+
+                // The creator may not have sized the segment yet.
+                void* header = MAP_FAILED;
+                WaitUntilReady(name, [&]()
+                {
+                    struct stat segmentStat;
+                    if (header == MAP_FAILED && fstat(fd, &segmentStat) == 0 && (size_t)segmentStat.st_size >= headerSize)
+                        header = mmap(nullptr, headerSize, PROT_READ, MAP_SHARED, fd, 0);
+                    return header != MAP_FAILED && isReady(static_cast<const char*>(header), mappedSize);
+                });
+                munmap(header, headerSize);
+            }
+
+            // A private mapping may be written to without a writable descriptor.
+            data = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+                RuntimeError("Cannot map the shared memory segment '%S'.", name.c_str());
+#endif
+            return std::shared_ptr<SharedMemorySegment>(new SharedMemorySegment(static_cast<char*>(data), mappedSize));
+        }
+
+        static void Remove(const std::wstring& name)
+        {
+#ifdef _MSC_VER
+            UNUSED(name); // the segment is destroyed with the last mapping of it
+#else
+            if (shm_unlink(ObjectName(name).c_str()) != 0 && errno != ENOENT)
+                RuntimeError("Cannot remove the shared memory segment '%S'.", name.c_str());
+#endif
+        }
+
+        ~SharedMemorySegment()
+        {
+#ifdef _MSC_VER
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+        }
+
+        char* Data() const { return m_data; }
+        size_t Size() const { return m_size; }
+
+    private:
+        SharedMemorySegment(char* data, size_t size)
+            : m_data(data), m_size(size)
+        {}
+
+        SharedMemorySegment(const SharedMemorySegment&) = delete; SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+#ifndef _MSC_VER
+        static std::string ObjectName(const std::wstring& name)
+        {
+            return "/" + ToString(name);
+        }
+#endif
+
+        static void WaitUntilReady(const std::wstring& name, const std::function<bool()>& isReady)
+        {
+            static const auto timeout = std::chrono::seconds(60);
+            auto start = std::chrono::steady_clock::now();
+            while (!isReady())
+            {
+                if (std::chrono::steady_clock::now() - start > timeout)
+                    RuntimeError("The shared memory segment '%S' has not been filled in within %d seconds; "
+                                 "if the process that created it failed, remove it with Internal::RemoveSharedWeights.", name.c_str(), (int)timeout.count());
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        char* m_data;
+        size_t m_size;
+    };
+
+    // The segment holds
+    //   SegmentHeader | SegmentEntry[numEntries] | uids (UTF-8) | values, each one at a multiple of ValueAlignment.
+    // Its creator sets SegmentHeader::ready last.
+    class WeightStore
+    {
+    public:
+        static bool Share(const FunctionPtr& function, const std::wstring& segmentName)
+        {
+            if (segmentName.empty() || segmentName.find_first_of(L"/\\") != std::wstring::npos)
+                InvalidArgument("ShareWeightsAcrossProcesses: The segment name '%S' must be non-empty and must not contain slashes.", segmentName.c_str());
+
+            // Parameters and constants are looked up by uid, so all processes need to load the same model.
+            std::vector<Variable> variables;
+            std::vector<std::string> uids;
+            auto add = [&](const Variable& variable)
+            {
+                auto value = variable.Value(); // Runs a pending initializer.
+                if (value->Device().Type() != DeviceKind::CPU || value->GetStorageFormat() != StorageFormat::Dense)
+                    return;
+
+                variables.push_back(variable);
+                uids.push_back(ToString(variable.Uid()));
+            };
+            for (const auto& parameter : function->Parameters())
+                add(parameter);
+            for (const auto& constant : function->Constants())
+                add(constant);
+
+            if (variables.empty())
+                InvalidArgument("ShareWeightsAcrossProcesses: Function '%S' has no dense CPU parameters or constants.", function->AsString().c_str());
+
+            std::vector<SegmentEntry> entries(variables.size());
+            size_t size = sizeof(SegmentHeader) + entries.size() * sizeof(SegmentEntry);
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                entries[i].uidOffset = size;
+                entries[i].uidSize = uids[i].size();
+                size += uids[i].size();
+            }
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                size = AlignedSize(size);
+                entries[i].valueOffset = size;
+                entries[i].valueSize = variables[i].Shape().TotalSize() * DataTypeSize(variables[i].GetDataType());
+                entries[i].dataType = (uint32_t)variables[i].GetDataType();
+                entries[i].reserved = 0;
+                size += entries[i].valueSize;
+            }
+
+            auto fill = [&](char* data)
+            {
+                auto header = reinterpret_cast<SegmentHeader*>(data);
+                header->totalSize = size;
+                header->numEntries = entries.size();
+                header->reserved = 0;
+                memcpy(header + 1, entries.data(), entries.size() * sizeof(SegmentEntry));
+                for (size_t i = 0; i < entries.size(); i++)
+                {
+                    memcpy(data + entries[i].uidOffset, uids[i].data(), uids[i].size());
+                    NDArrayView(variables[i].GetDataType(), variables[i].Shape(), data + entries[i].valueOffset, entries[i].valueSize, DeviceDescriptor::CPUDevice())
+                        .CopyFrom(*variables[i].Value());
+                }
+                std::atomic_thread_fence(std::memory_order_release);
+                *static_cast<volatile uint64_t*>(&header->ready) = ReadyMagic;
+            };
+
+            auto isReady = [](const char* data, size_t& segmentSize)
+            {
+                auto header = reinterpret_cast<const SegmentHeader*>(data);
+                if (*static_cast<const volatile uint64_t*>(&header->ready) != ReadyMagic)
+                    return false;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                segmentSize = header->totalSize;
+                return true;
+            };
+
+            bool created = false;
+            auto segment = SharedMemorySegment::CreateOrOpen(segmentName, size, sizeof(SegmentHeader), fill, isReady, created);
+            Bind(segment, segmentName, variables, uids);
+            return created;
+        }
+
+        static void Remove(const std::wstring& segmentName)
+        {
+            SharedMemorySegment::Remove(segmentName);
+        }
+
+    private:
+        static const uint64_t ReadyMagic = 0x31746867696577ULL; // "weight1"
+        static const size_t ValueAlignment = 64;
+
+        struct SegmentHeader
+        {
+            uint64_t ready;
+            uint64_t totalSize;
+            uint64_t numEntries;
+            uint64_t reserved;
+        };
+
+        struct SegmentEntry
+        {
+            uint64_t uidOffset;
+            uint64_t uidSize;
+            uint64_t valueOffset;
+            uint64_t valueSize;
+            uint32_t dataType;
+            uint32_t reserved;
+        };
+
+        static size_t AlignedSize(size_t size)
+        {
+            return (size + ValueAlignment - 1) / ValueAlignment * ValueAlignment;
+        }
+
+        // Makes the values of 'variables' views of the segment. Functions that share them (e.g. clones made with
+        // ParameterCloningMethod::Share) see the new values too, as they refer to the same variables.
+        static void Bind(const std::shared_ptr<SharedMemorySegment>& segment, const std::wstring& segmentName,
+                         const std::vector<Variable>& variables, const std::vector<std::string>& uids)
+        {
+            auto data = segment->Data();
+            auto header = reinterpret_cast<const SegmentHeader*>(data);
+            auto entries = reinterpret_cast<const SegmentEntry*>(header + 1);
+            if (header->numEntries != variables.size() || sizeof(SegmentHeader) + header->numEntries * sizeof(SegmentEntry) > segment->Size())
+                InvalidArgument("ShareWeightsAcrossProcesses: The shared memory segment '%S' holds %zu values, the Function has %zu dense CPU parameters and constants.",
+                                segmentName.c_str(), (size_t)header->numEntries, variables.size());
+
+            std::unordered_map<std::string, const SegmentEntry*> entriesByUid;
+            for (size_t i = 0; i < header->numEntries; i++)
+            {
+                if (entries[i].uidOffset + entries[i].uidSize > segment->Size() || entries[i].valueOffset + entries[i].valueSize > segment->Size())
+                    RuntimeError("ShareWeightsAcrossProcesses: The shared memory segment '%S' is corrupt.", segmentName.c_str());
+                entriesByUid[std::string(data + entries[i].uidOffset, entries[i].uidSize)] = &entries[i];
+            }
+
+            // Check all of them before changing any.
+            std::vector<const SegmentEntry*> matches;
+            for (size_t i = 0; i < variables.size(); i++)
+            {
+                auto entry = entriesByUid.find(uids[i]);
+                if (entry == entriesByUid.end() ||
+                    entry->second->dataType != (uint32_t)variables[i].GetDataType() ||
+                    entry->second->valueSize != variables[i].Shape().TotalSize() * DataTypeSize(variables[i].GetDataType()))
+                    InvalidArgument("ShareWeightsAcrossProcesses: The shared memory segment '%S' has no value of the type and size of '%S'; "
+                                    "it holds the parameters of a different model.", segmentName.c_str(), variables[i].AsString().c_str());
+                matches.push_back(entry->second);
+            }
+
+            for (size_t i = 0; i < variables.size(); i++)
+            {
+                auto& variable = variables[i];
+                NDArrayViewPtr value = MakeSharedObject<NDArrayView>(variable.GetDataType(), variable.Shape(), data + matches[i]->valueOffset, (size_t)matches[i]->valueSize, segment);
+                if (variable.Value()->IsReadOnly())
+                    value = value->Alias(/*readOnly =*/ true);
+                variable.m_dataFields->m_value = value;
+            }
+        }
+    };
+
+    namespace Internal
+    {
+        bool ShareWeightsAcrossProcesses(const FunctionPtr& function, const std::wstring& segmentName)
+        {
+            return WeightStore::Share(function, segmentName);
+        }
+
+        void RemoveSharedWeights(const std::wstring& segmentName)
+        {
+            WeightStore::Remove(segmentName);
+        }
+    }
+}
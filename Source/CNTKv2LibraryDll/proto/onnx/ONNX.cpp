@@ -65,6 +65,9 @@ FunctionPtr ONNXFormat::Load(const std::wstring& filepath, const DeviceDescripto
     if (!loadStatus.Ok())
         LogicError("Failed to load the model.");
 
-    FunctionPtr cntkFunction = ONNXToCNTK::CreateGraph(model->MainGraph(), computeDevice);
+    auto separator = filepath.find_last_of(L"/\\");
+    std::wstring modelDirectory = (separator == std::wstring::npos) ? L"." : filepath.substr(0, separator);
+
+    FunctionPtr cntkFunction = ONNXToCNTK::CreateGraph(model->MainGraph(), computeDevice, modelDirectory);
     return cntkFunction;
 }
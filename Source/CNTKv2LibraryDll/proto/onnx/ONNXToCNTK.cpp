@@ -9,6 +9,7 @@
 #include "Operators.h"
 #include <algorithm>
 #include <iostream>
+#include <unordered_set>
 #include "RNNHelper.h"
 
 using namespace ONNXIR;
@@ -30,6 +31,13 @@ public:
                                                  ONNXToCNTKVariableMap &constructedNodeArgVariableMap,
                                                  const Graph *graph, const DeviceDescriptor &computeDevice);
 
+    //
+    // Create the constants of the initializers of a graph ahead of its nodes, converting initializers in parallel.
+    // External data of initializers is read relative to 'modelDirectory'.
+    //
+    static void CreateInitializerConstants(Graph *graph, const std::wstring &modelDirectory,
+                                           ONNXToCNTKVariableMap &constructedNodeArgVariableMap, const DeviceDescriptor &computeDevice);
+
 private:
     static FunctionPtr CreateCNTKNode(const Node *node, const std::vector<Variable> &inputs,
                                       const DeviceDescriptor &computeDevice);
@@ -37,6 +45,10 @@ private:
     static Constant CreateConstant(const Node *node, const DeviceDescriptor &computeDevice);
     static Constant CreateConstant(const onnx::TensorProto &valueProto, const std::string &nodeName,
                                    const DeviceDescriptor &computeDevice);
+    static Constant CreateConstant(const NDArrayViewPtr &cpuValue, const std::string &nodeName,
+                                   const DeviceDescriptor &computeDevice);
+    static NDArrayViewPtr CreateNDArrayView(const onnx::TensorProto &valueProto);
+    static NDArrayViewPtr TakeNDArrayView(onnx::TensorProto &valueProto, const std::wstring &modelDirectory);
     static Variable CreateLeafVariableOrConstant(const NodeArg *nodeArg, const Node *parentNode, const Graph *graph,
                                                  const DeviceDescriptor &computeDevice);
     static std::vector<Variable> CreateRNNLeafVariableOrConstant(const NodeArg *nodeArg,
@@ -262,21 +274,26 @@ bool IsLittleEndianOrder()
 
 #pragma warning(disable : 4244)
 
-float UnpackFloat(const char *buf, int i)
+// raw_data holds little-endian values.
+void ToHostByteOrder(char *data, size_t size, size_t elementSize)
 {
-    float temp = 0;
     if (IsLittleEndianOrder())
+        return;
+
+    for (size_t i = 0; i + elementSize <= size; i += elementSize)
+        std::reverse(data + i, data + i + elementSize);
+}
+
+template <typename T>
+void RetrieveRawData(const onnx::TensorProto &valueProto, ::google::protobuf::RepeatedField<T> *p_mutable_data)
+{
+    const auto &raw_data = valueProto.raw_data();
+    if (!raw_data.empty())
     {
-        memcpy((void *) &temp, (void *) buf, sizeof(char) * 4);
-    }
-    else
-    {
-        temp = ((buf[0] << 24) |
-                (buf[1] << 16) |
-                (buf[2] << 8) |
-                buf[3]);
+        p_mutable_data->Resize((int) (raw_data.size() / sizeof(T)), T());
+        memcpy(p_mutable_data->mutable_data(), raw_data.data(), p_mutable_data->size() * sizeof(T));
+        ToHostByteOrder(reinterpret_cast<char *>(p_mutable_data->mutable_data()), p_mutable_data->size() * sizeof(T), sizeof(T));
     }
-    return temp;
 }
 
 void RetrieveRawDataAsFloat(const onnx::TensorProto &valueProto)
@@ -284,52 +301,70 @@ void RetrieveRawDataAsFloat(const onnx::TensorProto &valueProto)
     if (!valueProto.float_data().empty())
         return;
 
-    auto raw_data = valueProto.raw_data();
     onnx::TensorProto &mutableProto = const_cast<onnx::TensorProto &>(valueProto);
-    ::google::protobuf::RepeatedField<float> *p_mutable_float_data = mutableProto.mutable_float_data();
-    if (!raw_data.empty())
-    {
-        auto buff = raw_data.c_str();
-        for (int i = 0; i < raw_data.size(); i += 4)
-        {
-            float v = UnpackFloat(buff + i, i);
-            p_mutable_float_data->Add(v);
-        }
-    }
+    RetrieveRawData(valueProto, mutableProto.mutable_float_data());
 }
 
-double UnpackDouble(const char *buf, int i)
+void RetrieveRawDataAsDouble(const onnx::TensorProto &valueProto)
 {
-    double temp = 0;
+    if (!valueProto.double_data().empty())
+        return;
 
-    if (IsLittleEndianOrder())
+    onnx::TensorProto &mutableProto = const_cast<onnx::TensorProto &>(valueProto);
+    RetrieveRawData(valueProto, mutableProto.mutable_double_data());
+}
+
+bool HasExternalData(const onnx::TensorProto &valueProto)
+{
+    return valueProto.data_location() == onnx::TensorProto::EXTERNAL;
+}
+
+// Reads the data of a tensor that is stored in an external file, as described by its external_data.
+std::unique_ptr<std::string> ReadExternalData(const onnx::TensorProto &valueProto, const std::wstring &modelDirectory)
+{
+    std::string location;
+    size_t offset = 0, length = SIZE_MAX;
+    for (const auto &entry : valueProto.external_data())
     {
-        memcpy((void *) &temp, (void *) buf, sizeof(char) * 8);
+        if (entry.key() == "location")
+            location = entry.value();
+        else if (entry.key() == "offset")
+            offset = std::stoull(entry.value());
+        else if (entry.key() == "length")
+            length = std::stoull(entry.value());
     }
-    else
+    if (location.empty())
+        CNTK::LogicError("External data of tensor '%s' has no location.", valueProto.name().c_str());
+
+    std::wstring filePath = modelDirectory + L"/" + ToWString(location);
+    auto stream = GetFstream(filePath, true);
+    if (length == SIZE_MAX)
     {
-        // this is temperal code that will soon be replaced by onnx core.
-        NOT_IMPLEMENTED;
+        stream->seekg(0, std::ios_base::end);
+        size_t fileSize = (size_t) stream->tellg();
+        if (offset > fileSize)
+            CNTK::RuntimeError("External data of tensor '%s' starts past the end of '%S'.", valueProto.name().c_str(), filePath.c_str());
+        length = fileSize - offset;
     }
-    return temp;
+
+    std::unique_ptr<std::string> data(new std::string(length, '\0'));
+    stream->seekg(offset);
+    stream->read(&(*data)[0], length);
+    if ((size_t) stream->gcount() != length)
+        CNTK::RuntimeError("Cannot read %zu bytes of external data of tensor '%s' from '%S'.", length, valueProto.name().c_str(), filePath.c_str());
+    return data;
 }
 
-void RetrieveRawDataAsDouble(const onnx::TensorProto &valueProto)
+DataType ONNXTensorDataType(const onnx::TensorProto &valueProto)
 {
-    if (!valueProto.double_data().empty())
-        return;
-
-    auto raw_data = valueProto.raw_data();
-    onnx::TensorProto &mutableProto = const_cast<onnx::TensorProto &>(valueProto);
-    ::google::protobuf::RepeatedField<double> *p_mutable_double_data = mutableProto.mutable_double_data();
-    if (!raw_data.empty())
+    switch (valueProto.data_type())
     {
-        auto buff = raw_data.c_str();
-        for (int i = 0; i < raw_data.size(); i += 4)
-        {
-            double v = UnpackDouble(buff + i, i);
-            p_mutable_double_data->Add(v);
-        }
+    case TensorProto_DataType_FLOAT:
+        return DataType::Float;
+    case TensorProto_DataType_DOUBLE:
+        return DataType::Double;
+    default:
+        return DataType::Unknown;
     }
 }
 
@@ -368,128 +403,142 @@ Constant ONNXToCNTKHelper::CreateConstant(const Node *node, const DeviceDescript
 Constant ONNXToCNTKHelper::CreateConstant(const onnx::TensorProto &valueProto, const std::string &nodeName,
                                           const DeviceDescriptor &computeDevice)
 {
-    auto dataType = valueProto.data_type();
+    return CreateConstant(CreateNDArrayView(valueProto), nodeName, computeDevice);
+}
 
-    NDShape shape(std::vector<size_t>(valueProto.dims().begin(), valueProto.dims().end()));
+Constant ONNXToCNTKHelper::CreateConstant(const NDArrayViewPtr &cpuValue, const std::string &nodeName,
+                                          const DeviceDescriptor &computeDevice)
+{
+    if (computeDevice.Type() == DeviceKind::CPU)
+    {
+        Constant constantVariable(cpuValue, ToWString(nodeName));
+        return constantVariable;
+    }
+    else
+    {
+        // this is the way to load values into GPU:
+        // Create a GPU NDArrayView and CopyFrom a CPU NDArrayView that holding the data.
+        NDArrayViewPtr dstFinalGPU(new NDArrayView(cpuValue->GetDataType(), StorageFormat::Dense, cpuValue->Shape(), computeDevice));
+        dstFinalGPU->CopyFrom(*cpuValue);
+        Constant constantVariable(dstFinalGPU, ToWString(nodeName));
+        return constantVariable;
+    }
+}
 
-    // the following code is to revert CNTKToONNXHelper::ToTensorShape.to restore a CNTK NDArray
-    NDShape reversedShape = ReverseShape(shape);
+// The row major data of an ONNX tensor is the column major data of CNTK's reversed shape, so tensors are copied as they are.
+NDArrayViewPtr ONNXToCNTKHelper::CreateNDArrayView(const onnx::TensorProto &valueProto)
+{
+    auto dataType = ONNXTensorDataType(valueProto);
+    if (dataType == DataType::Unknown)
+        NOT_IMPLEMENTED;
 
-    auto totalSize = shape.TotalSize();
+    NDShape reversedShape = ReverseShape(NDShape(std::vector<size_t>(valueProto.dims().begin(), valueProto.dims().end())));
+    auto totalSize = reversedShape.TotalSize();
+    auto byteSize = totalSize * DataTypeSize(dataType);
 
-    switch (dataType)
-    {
-    case TensorProto_DataType_FLOAT:
+    NDArrayViewPtr value = MakeSharedObject<NDArrayView>(dataType, StorageFormat::Dense, reversedShape, DeviceDescriptor::CPUDevice());
+    char *buffer = (dataType == DataType::Float) ? reinterpret_cast<char *>(value->WritableDataBuffer<float>())
+                                                 : reinterpret_cast<char *>(value->WritableDataBuffer<double>());
+
+    if (dataType == DataType::Float && !valueProto.float_data().empty() && valueProto.float_data_size() == totalSize)
+        memcpy(buffer, valueProto.float_data().data(), byteSize);
+    else if (dataType == DataType::Double && !valueProto.double_data().empty() && valueProto.double_data_size() == totalSize)
+        memcpy(buffer, valueProto.double_data().data(), byteSize);
+    else if (valueProto.raw_data().size() == byteSize)
     {
-        float *data = new float[totalSize];
-        if (valueProto.float_data().empty())
-        {
-            RetrieveRawDataAsFloat(valueProto);
-        }
+        memcpy(buffer, valueProto.raw_data().data(), byteSize);
+        ToHostByteOrder(buffer, byteSize, DataTypeSize(dataType));
+    }
+    else
+        RuntimeError("The data of tensor '%s' does not match its shape '%S'.", valueProto.name().c_str(), reversedShape.AsString().c_str());
 
-        if (shape.Rank() <= 2)
-        {
-            for (size_t index = 0; index < totalSize; index++)
-            {
-                data[index] = valueProto.float_data()[index];
-            }
-        }
-        else
-        {
-            int outputChannels = shape[0], inputChanndels = shape[1];
-            NDShape channelKernelShape(std::vector<size_t>(shape.Dimensions().begin() + 2, shape.Dimensions().end()));
-            NDShape channelReversedShape = ReverseShape(channelKernelShape);
-            int channelKernelSize = channelKernelShape.TotalSize();
-            for (int oC = 0; oC < outputChannels; oC++)
-            {
-                for (int iC = 0; iC < inputChanndels; iC++)
-                {
-                    int channelIndex = (oC * inputChanndels + iC);
-                    for (int pixel = 0; pixel < channelKernelSize; pixel++)
-                    {
-                        data[channelIndex * channelKernelSize + pixel] =
-                            valueProto.float_data()[channelIndex * channelKernelSize + pixel];
-                    }
-                }
-            }
-        }
+    return value;
+}
 
-        NDArrayViewPtr dstFinal(new NDArrayView(DataType::Float, reversedShape, &data[0],
-                                                totalSize * sizeof(float), computeDevice.CPUDevice()));
+// Like CreateNDArrayView, but the returned view takes over raw_data (or the external data) of the tensor instead of copying it.
+NDArrayViewPtr ONNXToCNTKHelper::TakeNDArrayView(onnx::TensorProto &valueProto, const std::wstring &modelDirectory)
+{
+    auto dataType = ONNXTensorDataType(valueProto);
+    if (dataType == DataType::Unknown)
+        return CreateNDArrayView(valueProto);
 
-        if (computeDevice.Type() == DeviceKind::CPU)
-        {
-            Constant constantVariable(dstFinal, ToWString(nodeName));
-            return constantVariable;
-        }
-        else
-        {
-            // this is the way to load values into GPU:
-            // Create a GPU NDArrayView and CopyFrom a CPU NDArrayView that holding the data.
-            NDArrayViewPtr dstFinalGPU(new NDArrayView(DataType::Float, StorageFormat::Dense, reversedShape, computeDevice));
-            dstFinalGPU->CopyFrom(*dstFinal);
-            Constant constantVariable(dstFinalGPU, ToWString(nodeName));
-            return constantVariable;
-        }
+    std::shared_ptr<std::string> data;
+    if (HasExternalData(valueProto))
+        data = ReadExternalData(valueProto, modelDirectory);
+    else if (valueProto.has_raw_data() && valueProto.float_data().empty() && valueProto.double_data().empty())
+        data.reset(valueProto.release_raw_data());
+
+    if (!data)
+        return CreateNDArrayView(valueProto);
+
+    NDShape reversedShape = ReverseShape(NDShape(std::vector<size_t>(valueProto.dims().begin(), valueProto.dims().end())));
+    auto elementSize = DataTypeSize(dataType);
+    auto byteSize = reversedShape.TotalSize() * elementSize;
+    if (data->size() != byteSize)
+        RuntimeError("The data of tensor '%s' does not match its shape '%S'.", valueProto.name().c_str(), reversedShape.AsString().c_str());
+
+    ToHostByteOrder(&(*data)[0], byteSize, elementSize);
+    if (byteSize == 0 || reinterpret_cast<uintptr_t>(data->data()) % elementSize != 0)
+    {
+        valueProto.set_allocated_raw_data(new std::string(std::move(*data)));
+        valueProto.clear_data_location();
+        return CreateNDArrayView(valueProto);
     }
-    break;
-    case TensorProto_DataType_DOUBLE:
+
+    return MakeSharedObject<NDArrayView>(dataType, reversedShape, &(*data)[0], byteSize, data);
+}
+
+void ONNXToCNTKHelper::CreateInitializerConstants(Graph *graph, const std::wstring &modelDirectory,
+                                                  ONNXToCNTKVariableMap &constructedNodeArgVariableMap, const DeviceDescriptor &computeDevice)
+{
+    // Constants of RNN inputs are rearranged per gate and direction, CreateRNNConstant creates them from the tensors.
+    std::unordered_set<std::string> rnnInputs;
+    for (Graph::NodeIterator it = graph->Nodes_begin(); it != graph->Nodes_end(); ++it)
     {
-        // TODO: refactore commom code for float and double
-        double *data = new double[totalSize];
-        if (valueProto.double_data().empty())
+        if (Operators::IsRNNOp((*it)->OpType()))
         {
-            RetrieveRawDataAsDouble(valueProto);
+            for (const NodeArg &nodeArg : (*it)->InputDefs())
+                rnnInputs.insert(nodeArg.Name());
         }
+    }
 
-        if (shape.Rank() <= 2)
+    std::vector<std::pair<std::string, onnx::TensorProto *>> initializers;
+    for (const auto &initializer : graph->GetAllInitialTensors())
+        initializers.push_back({initializer.first, const_cast<onnx::TensorProto *>(initializer.second)});
+
+    std::vector<NDArrayViewPtr> values(initializers.size());
+    std::vector<std::exception_ptr> errors(initializers.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) initializers.size(); i++)
+    {
+        try
         {
-            for (size_t index = 0; index < totalSize; index++)
+            auto &valueProto = *initializers[i].second;
+            if (rnnInputs.find(initializers[i].first) == rnnInputs.end() && ONNXTensorDataType(valueProto) != DataType::Unknown)
+                values[i] = TakeNDArrayView(valueProto, modelDirectory);
+            else if (HasExternalData(valueProto))
             {
-                data[index] = valueProto.double_data()[index];
+                // The tensor is converted when its node is, with its data in place.
+                valueProto.set_allocated_raw_data(ReadExternalData(valueProto, modelDirectory).release());
+                valueProto.clear_data_location();
             }
         }
-        else
+        catch (...)
         {
-            int outputChannels = shape[0], inputChanndels = shape[1];
-            NDShape channelKernelShape(std::vector<size_t>(shape.Dimensions().begin() + 2, shape.Dimensions().end()));
-            NDShape channelReversedShape = ReverseShape(channelKernelShape);
-            int channelKernelSize = channelKernelShape.TotalSize();
-            for (int oC = 0; oC < outputChannels; oC++)
-            {
-                for (int iC = 0; iC < inputChanndels; iC++)
-                {
-                    int channelIndex = (oC * inputChanndels + iC);
-                    for (int pixel = 0; pixel < channelKernelSize; pixel++)
-                    {
-                        data[channelIndex * channelKernelSize + pixel] =
-                            valueProto.double_data()[channelIndex * channelKernelSize + pixel];
-                    }
-                }
-            }
+            errors[i] = std::current_exception();
         }
+    }
 
-        NDArrayViewPtr dstFinal(new NDArrayView(DataType::Double, reversedShape, &data[0],
-                                                totalSize * sizeof(double), computeDevice.CPUDevice()));
-
-        if (computeDevice.Type() == DeviceKind::CPU)
-        {
-            Constant constantVariable(dstFinal, ToWString(nodeName));
-            return constantVariable;
-        }
-        else
-        {
-            // this is the way to load values into GPU:
-            // Create a GPU NDArrayView and CopyFrom a CPU NDArrayView that holding the data.
-            NDArrayViewPtr dstFinalGPU(new NDArrayView(DataType::Double, StorageFormat::Dense, reversedShape, computeDevice));
-            dstFinalGPU->CopyFrom(*dstFinal);
-            Constant constantVariable(dstFinalGPU, ToWString(nodeName));
-            return constantVariable;
-        }
+    for (const auto &error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
     }
-    break;
-    default:
-        NOT_IMPLEMENTED;
+
+    for (size_t i = 0; i < initializers.size(); i++)
+    {
+        if (values[i])
+            constructedNodeArgVariableMap.insert(ONNXToCNTKVariableMap::value_type(initializers[i].first, CreateConstant(values[i], initializers[i].first, computeDevice)));
     }
 }
 
@@ -2879,13 +2928,14 @@ FunctionPtr ONNXToCNTKHelper::CreateCNTKFCNode(const std::wstring &nodeName, con
     return cntkFunction;
 }
 
-FunctionPtr ONNXToCNTK::CreateGraph(ONNXIR::Graph *src, const DeviceDescriptor &computeDevice)
+FunctionPtr ONNXToCNTK::CreateGraph(ONNXIR::Graph *src, const DeviceDescriptor &computeDevice, const std::wstring &modelDirectory)
 {
     FunctionPtr cntkModel;
 
     // To use depth-first-traversal, keeps a collection of visited nodes.
     ONNXToCNTKMap constructedFunctions;
     ONNXToCNTKVariableMap constructedNodeArgVariableMap;
+    ONNXToCNTKHelper::CreateInitializerConstants(src, modelDirectory, constructedNodeArgVariableMap, computeDevice);
     for (Graph::NodeIterator it = src->Nodes_begin(); it != src->Nodes_end(); ++it)
     {
         const Node *node = *it;
@@ -2968,8 +3018,18 @@ std::vector<Variable> ONNXToCNTKHelper::CreateCNTKInputsStartingFromIndex(const
             }
             else
             {
-                Variable inputVariable = CreateLeafVariableOrConstant(nodeArg, node, graph, computeDevice);
-                inputs.push_back(inputVariable);
+                // Constants of initializers are created up front by CreateInitializerConstants.
+                ONNXToCNTKVariableMap::iterator itConstant = constructedNodeArgVariableMap.find(nodeArg->Name());
+                const onnx::TensorProto *valueProto;
+                if (itConstant != constructedNodeArgVariableMap.end() && graph->GetInitialTensor(nodeArg->Name(), &valueProto))
+                {
+                    inputs.push_back(itConstant->second);
+                }
+                else
+                {
+                    Variable inputVariable = CreateLeafVariableOrConstant(nodeArg, node, graph, computeDevice);
+                    inputs.push_back(inputVariable);
+                }
             }
         }
     }
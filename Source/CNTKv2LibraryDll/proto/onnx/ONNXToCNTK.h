@@ -30,8 +30,8 @@ namespace CNTK
     public:
         //
         // Create a CNTK graph (Function) given an ONNX graph. The function is created to use the 
-        // specified computing device.
+        // specified computing device. Initializers stored in external files are looked up relative to 'modelDirectory'.
         //
-        static FunctionPtr CreateGraph(ONNXIR::Graph* src, const DeviceDescriptor& computeDevice);
+        static FunctionPtr CreateGraph(ONNXIR::Graph* src, const DeviceDescriptor& computeDevice, const std::wstring& modelDirectory = L".");
     };
 }
\ No newline at end of file
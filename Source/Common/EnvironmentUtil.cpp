@@ -20,6 +20,10 @@ using namespace std;
 // create an std::string from the returned value.
 int EnvironmentUtil::GetTotalNumberOfMPINodes()
 {
+    int sharedMemoryWorldSize = GetSharedMemoryWorldSize();
+    if (sharedMemoryWorldSize > 0)
+        return sharedMemoryWorldSize;
+
 #if !HAS_MPI
     const char* p = nullptr;
 #elif WIN32
@@ -33,6 +37,12 @@ int EnvironmentUtil::GetTotalNumberOfMPINodes()
 
 int EnvironmentUtil::GetLocalMPINodeRank()
 {
+    if (GetSharedMemoryWorldSize() > 0)
+    {
+        const char* rank = getenv("CNTK_SHM_RANK");
+        return (!rank) ? 0 : stoi(string(rank));
+    }
+
 #if !HAS_MPI
     const char* p = nullptr;
 #elif WIN32
@@ -43,6 +53,24 @@ int EnvironmentUtil::GetLocalMPINodeRank()
 
     return (!p) ? 0 : stoi(string(p));
 }
+
+int EnvironmentUtil::GetSharedMemoryWorldSize()
+{
+    const char* p = getenv("CNTK_SHM_WORLD_SIZE");
+    return (!p) ? 0 : stoi(string(p));
+}
+
+string EnvironmentUtil::GetSharedMemoryName()
+{
+    const char* p = getenv("CNTK_SHM_NAME");
+    return (!p) ? string("cntk-shm") : string(p);
+}
+
+bool EnvironmentUtil::UseHierarchicalSharedMemoryAllReduce()
+{
+    const char* p = getenv("CNTK_MPI_SHARED_MEMORY_ALLREDUCE");
+    return p && stoi(string(p)) != 0;
+}
 #pragma warning(pop)
 
 }}}
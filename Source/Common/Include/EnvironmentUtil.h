@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <string>
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
     class EnvironmentUtil 
@@ -19,6 +21,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // corresponging to the rank of the local MPI node.
         // This function returns 0 if the variable is not present.
         static int GetLocalMPINodeRank();
+
+        // Returns the number of processes of a job that communicates through shared memory instead of MPI
+        // (CNTK_SHM_WORLD_SIZE), or 0 if the variable is not present. Such jobs are started without mpiexec,
+        // by launching one process per rank with CNTK_SHM_RANK set.
+        static int GetSharedMemoryWorldSize();
+
+        // Returns the name of the shared-memory segment of such a job (CNTK_SHM_NAME), or a default name.
+        static std::string GetSharedMemoryName();
+
+        // Returns true if MPI all-reduce should reduce within a host through shared memory first,
+        // and use MPI only between hosts (CNTK_MPI_SHARED_MEMORY_ALLREDUCE=1).
+        static bool UseHierarchicalSharedMemoryAllReduce();
     };
     
 }}}
@@ -316,6 +316,9 @@ public:
     //
     // Allocate internal state for calling ForwardPass(). The call restricts the network (inputs and outputs)
     // to the functions represented by the output name.
+    // With optimizeForInference=true in the config passed to Init(), the network is first rewritten for these
+    // outputs: BatchNormalization is folded into preceding weights, parameter-only subgraphs are precomputed,
+    // and all other nodes are removed.
     //
     virtual void StartForwardEvaluation(const std::vector<std::wstring>& outputs) = 0;
 
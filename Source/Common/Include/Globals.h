@@ -31,6 +31,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void SetNodeTiming(bool enable) { m_enableNodeTiming = enable; }
         static bool ShouldEnableNodeTiming() { return m_enableNodeTiming; }
 
+        // Reuse the analysis and memory plan of networks with the same structure and input shapes (see ComputationNetwork::CompileNetwork()).
+        static void SetCompiledPlanCaching(bool enable) { m_enableCompiledPlanCaching = enable; }
+        static bool ShouldCacheCompiledPlans() { return m_enableCompiledPlanCaching; }
+
+        // Number of engines built for different input shapes that each convolution and pooling node keeps for reuse
+        // (see ConvolutionNodeBase::ReuseConvolutionEngine()); 0 disables the reuse.
+        static void SetShapeSpecializationCacheCapacity(std::size_t capacity) { m_shapeSpecializationCacheCapacity = capacity; }
+        static std::size_t GetShapeSpecializationCacheCapacity() { return m_shapeSpecializationCacheCapacity; }
+
+        // Lets CPU convolution nodes use the direct/Winograd engine (ConvolutionEngineKind::Direct) where it supports
+        // the geometry and MKL-DNN is not available.
+        static void SetDirectConvolution(bool enable) { m_enableDirectConvolution = enable; }
+        static bool ShouldUseDirectConvolution() { return m_enableDirectConvolution; }
+
         static void SetMPIPackThreshold(std::size_t packThreholdInBytes) { m_mpiPackThresholdInBytes = packThreholdInBytes; }
         static std::size_t GetMPIPackThreshold() { return m_mpiPackThresholdInBytes; }
     private:
@@ -40,6 +54,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
         static std::atomic<bool> m_enableNodeTiming;
+        static std::atomic<bool> m_enableCompiledPlanCaching;
+        static std::atomic<std::size_t> m_shapeSpecializationCacheCapacity;
+        static std::atomic<bool> m_enableDirectConvolution;
         static std::atomic<std::size_t> m_mpiPackThresholdInBytes;
     };
 }}}
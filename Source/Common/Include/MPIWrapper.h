@@ -27,6 +27,8 @@ typedef void *MPI_Comm;
 typedef enum _MPI_Datatype { MPI_CHAR, MPI_INT, MPI_FLOAT, MPI_DOUBLE, MPI_UNSIGNED, MPI_LONG_LONG_INT } MPI_Datatype;
 
 #define MPI_IN_PLACE          ((void*)(int)-1)
+#define MPI_MAX               ((MPI_Op)0x58000001)
+#define MPI_MIN               ((MPI_Op)0x58000002)
 #define MPI_SUM               ((MPI_Op)0x58000003)
 
 #define MPI_STATUSES_IGNORE  (MPI_Status*)1
@@ -0,0 +1,163 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+// SharedMemoryCommunicator.h -- collective and point-to-point communication between the processes of one host
+// through a POSIX shared-memory segment.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SharedMemoryCommunicator -- all ranks of a host map the same named segment.
+// The segment holds one data slot per rank, and one mailbox ring per ordered pair of ranks.
+//
+// All-reduce is a reduce-scatter followed by an all-gather: every rank copies its
+// data into its own slot, then reduces its stripe of all slots in place into its own
+// slot, then everybody copies the reduced stripes out. A slot is first touched by the
+// rank that owns it, so the stripe a rank reduces into lives on its own NUMA node.
+// Buffers larger than a slot are processed in slot-sized chunks.
+//
+// Point-to-point messages are streamed through the mailbox rings. Progress is made
+// while waiting on any request, so that sends and receives cannot block each other.
+// Like MPI with MPI_THREAD_SERIALIZED, calls must not be issued concurrently.
+// -----------------------------------------------------------------------
+class SharedMemoryCommunicator
+{
+public:
+    enum class ReduceOp
+    {
+        Sum,
+        Max,
+        Min
+    };
+
+    // 0 denotes a null request.
+    typedef uint32_t RequestId;
+
+    static const size_t DefaultSlotSizeInBytes = 16 * 1024 * 1024;
+    static const size_t DefaultMailboxSizeInBytes = 1024 * 1024;
+
+    // Creates (rank 0) or attaches to (other ranks) the segment 'name' and waits for all ranks to attach.
+    SharedMemoryCommunicator(const std::string& name, size_t rank, size_t numRanks,
+                             size_t slotSizeInBytes = DefaultSlotSizeInBytes, size_t mailboxSizeInBytes = DefaultMailboxSizeInBytes);
+    ~SharedMemoryCommunicator();
+
+    size_t Rank() const { return m_rank; }
+    size_t NumRanks() const { return m_numRanks; }
+
+    void Barrier();
+
+    // In-place all-reduce of data[0..count). If given, 'reducedStripe' is called on every rank for every chunk
+    // with the part of the chunk this rank has reduced, before it is shared with the other ranks. It can be
+    // used to further reduce the stripe across hosts (hierarchical all-reduce). It is called even for empty stripes.
+    template <class ElemType>
+    void AllReduce(ElemType* data, size_t count, ReduceOp op, const std::function<void(ElemType*, size_t)>& reducedStripe = nullptr);
+
+    void Broadcast(void* data, size_t bytes, size_t root);
+
+    // 'recv' receives NumRanks() * bytes, ordered by rank.
+    void AllGather(const void* send, size_t bytes, void* recv);
+
+    // On the root, the data of rank r is written to recv + offsets[r]. Ranks may send different numbers of bytes.
+    void Gatherv(const void* send, size_t bytes, void* recv, const size_t* offsets, size_t root);
+
+    RequestId Isend(const void* buffer, size_t bytes, size_t dest, int tag);
+    RequestId Irecv(void* buffer, size_t bytes, size_t source, int tag);
+
+    // Returns a request that is already complete, for collectives that are executed synchronously.
+    RequestId CompletedRequest();
+
+    void Wait(RequestId request);
+
+    // Waits until one of the non-null requests completes, releases it and returns its index.
+    // Returns SIZE_MAX if all requests are null.
+    size_t WaitAny(const RequestId* requests, size_t numRequests);
+
+private:
+    SharedMemoryCommunicator(const SharedMemoryCommunicator&) = delete;
+    SharedMemoryCommunicator& operator=(const SharedMemoryCommunicator&) = delete;
+
+    struct ControlBlock;
+    struct MailboxHeader;
+
+    struct Request
+    {
+        bool m_isSend;
+        bool m_done;
+        const char* m_sendBuffer;
+        char* m_recvBuffer;
+        size_t m_bytes;
+        size_t m_peer;
+        int m_tag;
+        size_t m_transferred;
+        bool m_headerWritten;
+    };
+
+    // A message that arrived before a matching receive was posted.
+    struct UnexpectedMessage
+    {
+        int m_tag;
+        std::vector<char> m_data;
+        bool m_complete;
+        RequestId m_boundRecv;
+    };
+
+    // The message currently being read from a source's mailbox.
+    struct IncomingMessage
+    {
+        bool m_active;
+        size_t m_bytes;
+        size_t m_received;
+        char* m_target;
+        RequestId m_recv;                           // receive the message goes to, or 0 if unexpected
+        std::list<UnexpectedMessage>::iterator m_unexpected;
+    };
+
+    char* Slot(size_t rank) const;
+    MailboxHeader* Mailbox(size_t source, size_t dest) const;
+    char* MailboxData(size_t source, size_t dest) const;
+    void StripeRange(size_t count, size_t elemSize, size_t rank, size_t& begin, size_t& end) const;
+
+    RequestId NewRequest(const Request& request);
+    bool IsDone(RequestId request) const;
+    void Progress();
+    bool ProgressSend(size_t dest);
+    bool ProgressRecv(size_t source);
+    size_t WriteMailbox(size_t dest, const char* data, size_t bytes);
+    size_t ReadMailbox(size_t source, char* data, size_t bytes);
+    size_t MailboxBytesAvailable(size_t source) const;
+    size_t MailboxBytesFree(size_t dest) const;
+
+    std::string m_name;
+    size_t m_rank;
+    size_t m_numRanks;
+    size_t m_slotSize;
+    size_t m_mailboxSize;
+    size_t m_segmentSize;
+    size_t m_slotsOffset;
+    size_t m_mailboxesOffset;
+    size_t m_mailboxStride;
+    char* m_segment;
+    ControlBlock* m_control;
+    uint64_t* m_publishedSizes;
+
+    RequestId m_nextRequestId;
+    std::unordered_map<RequestId, Request> m_requests;
+    std::vector<std::deque<RequestId>> m_sendQueues;   // per destination
+    std::vector<std::deque<RequestId>> m_postedRecvs;  // per source, not yet matched
+    std::vector<std::list<UnexpectedMessage>> m_unexpected; // per source
+    std::vector<IncomingMessage> m_incoming;           // per source
+};
+
+}}}
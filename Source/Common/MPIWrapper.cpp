@@ -5,6 +5,11 @@
 #include "Include/Basics.h"
 #include "Include/MPIWrapper.h"
 #include "Include/EnvironmentUtil.h"
+#include "Include/SharedMemoryCommunicator.h"
+#include <cstring>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #if HAS_MPI
 #pragma comment(lib, "msmpi.lib")
@@ -48,6 +53,15 @@ class MPIWrapperMpi : public MPIWrapper
     static int s_myRank;
     static void MPIWorkaroundAtExit();
 
+    // Hierarchical all-reduce: ranks on one host reduce through shared memory, and each rank then
+    // all-reduces the stripe it owns with the ranks that own the same stripe on the other hosts.
+    std::unique_ptr<SharedMemoryCommunicator> m_sharedMemoryComm;
+    MPI_Comm m_crossHostComm;
+
+    void InitializeSharedMemoryAllReduce();
+    template <class ElemType>
+    bool SharedMemoryAllReduce(const void* sendData, ElemType* receiveData, size_t numElements, MPI_Op op, MPI_Request* request) const;
+
 public:
     MPIWrapperMpi();
 
@@ -248,6 +262,111 @@ public:
     virtual int WaitAll(std::vector<MPI_Request>& requests);
 };
 
+// -----------------------------------------------------------------------
+// MPIWrapperShm -- all ranks run on one host and communicate through a
+// shared-memory segment; MPI does not need to be installed.
+// -----------------------------------------------------------------------
+
+class MPIWrapperShm : public MPIWrapper
+{
+    std::unique_ptr<SharedMemoryCommunicator> m_comm;
+
+    template <class ElemType>
+    void AllReduceImpl(ElemType* sendData, ElemType* receiveData, size_t numElements, MPI_Op op) const;
+    template <class ElemType>
+    void GathervImpl(const ElemType* sendData, size_t numSendElements, ElemType* receiveData, int offsets[], size_t rootRank) const;
+
+public:
+    MPIWrapperShm();
+    ~MPIWrapperShm();
+
+    size_t NumNodesInUse() const;
+    size_t CurrentNodeRank() const;
+    bool IsMainNode() const;
+    std::wstring CurrentNodeName() const;
+    bool IsIdle() const;
+    bool UsingAllNodes() const;
+    size_t MainNodeRank() const;
+    bool IsMultiHost() const;
+    // Use GPUDirect RDMA
+    virtual bool UseGpuGdr() override;
+
+    // -----------------------------------------------------------------------
+    // data-exchange functions (wrappers around MPI functions)
+    // -----------------------------------------------------------------------
+
+    virtual int Finalize(void);
+    virtual int Wait(MPI_Request* request, MPI_Status* status);
+    virtual int Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status);
+    virtual int Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]);
+    virtual int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
+    virtual int Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Status* status);
+    virtual int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
+    virtual int Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, /*MPI_Comm comm,*/ MPI_Request* request);
+    virtual int Abort(int errorcode);
+    virtual int Error_string(int errorcode, char* string, int* resultlen);
+
+    // allreduce of a vector
+    virtual void AllReduce(std::vector<size_t>& accumulator) const;
+    virtual void AllReduce(std::vector<int>& accumulator) const;
+    virtual void AllReduce(std::vector<double>& accumulator) const;
+    virtual void AllReduce(std::vector<float>& accumulator) const;
+
+    // for raw pointer
+    virtual void AllReduce(size_t* sendData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(int* sendData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(double* sendData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(float* sendData, size_t numElements, MPI_Op op = MPI_SUM) const;
+
+    virtual void AllReduce(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(int* sendData, int* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(double* sendData, double* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduce(float* sendData, float* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const;
+
+    virtual void AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(int* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(double* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(float* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+
+    virtual void AllReduceAsync(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(int* sendData, int* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(double* sendData, double* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+    virtual void AllReduceAsync(float* sendData, float* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const;
+
+    virtual void Bcast(size_t* sendData, size_t numElements, size_t srcRank);
+    virtual void Bcast(double* sendData, size_t numElements, size_t srcRank);
+    virtual void Bcast(float* sendData, size_t numElements, size_t srcRank);
+    virtual void Bcast(void* buffer, int count, MPI_Datatype datatype, int root);
+
+    virtual void AllGatherAsync(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, MPI_Request* request) const;
+    virtual void AllGatherAsync(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, MPI_Request* request) const;
+    virtual void AllGatherAsync(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, MPI_Request* request) const;
+    virtual void AllGatherAsync(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, MPI_Request* request) const;
+    virtual void Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const;
+
+    virtual void AllGather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements) const;
+    virtual void AllGather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements) const;
+    virtual void AllGather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements) const;
+    virtual void AllGather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements) const;
+
+    virtual void Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const;
+    virtual void Gather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, size_t rootRank) const;
+    virtual void Gather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, size_t rootRank) const;
+    virtual void Gather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, size_t rootRank) const;
+
+    virtual void Gatherv(const size_t *sendData, size_t numSendElements, size_t *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
+    virtual void Gatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
+    virtual void Gatherv(const int *sendData, size_t numSendElements, int *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
+    virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
+    virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
+
+    // wait for all ranks to reach here
+    virtual int WaitAll();
+    virtual void WaitAny(MPI_Request* requests, int numRequests, int* index);
+    virtual void Wait(MPI_Request* request);
+    virtual int WaitAll(std::vector<MPI_Request>& requests);
+};
+
 
 // -----------------------------------------------------------------------
 // Factory pattern.
@@ -261,6 +380,12 @@ public:
 
 extern "C" void GetMpiWrapper(MPIWrapper **mpi)
 {
+    if (EnvironmentUtil::GetSharedMemoryWorldSize() > 0)
+    {
+        *mpi = new MPIWrapperShm();
+        return;
+    }
+
 #if HAS_MPI
     *mpi = new MPIWrapperMpi();
 #else
@@ -373,7 +498,7 @@ MPI_Datatype MPIWrapper::GetDataType(size_t *)
 int MPIWrapperMpi::s_myRank = -1;
 
 MPIWrapperMpi::MPIWrapperMpi()
-    : m_currentComm(MPI_COMM_WORLD)
+    : m_currentComm(MPI_COMM_WORLD), m_crossHostComm(MPI_COMM_NULL)
 {
     static bool initialized = false;
     if (initialized)
@@ -422,6 +547,9 @@ MPIWrapperMpi::MPIWrapperMpi()
     // do an initial handshake
     Ping("mpihelper");
 
+    if (EnvironmentUtil::UseHierarchicalSharedMemoryAllReduce())
+        InitializeSharedMemoryAllReduce();
+
     // stagger the jobs just a little to get a sort-of deterministic order e.g. in GPU allocation when running on one machine
     // continue 0.5 seconds apart
     ::Sleep((DWORD)(500 * CurrentNodeRank()));
@@ -482,6 +610,97 @@ void MPIWrapperMpi::MPIWorkaroundAtExit()
     Sleep(s_myRank * 50);
 }
 
+void MPIWrapperMpi::InitializeSharedMemoryAllReduce()
+{
+#ifdef _WIN32
+    fprintf(stderr, "MPIWrapperMpi: shared-memory all-reduce is not supported on this platform, using MPI only\n");
+    fflush(stderr);
+#else
+    MPI_Comm hostComm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, m_myRank, MPI_INFO_NULL, &hostComm) || MpiFail("InitializeSharedMemoryAllReduce: MPI_Comm_split_type");
+    int hostRank, hostSize;
+    MPI_Comm_rank(hostComm, &hostRank);
+    MPI_Comm_size(hostComm, &hostSize);
+
+    // Stripes only line up across hosts if every host runs the same number of ranks.
+    int minHostSize, maxHostSize;
+    MPI_Allreduce(&hostSize, &minHostSize, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD) || MpiFail("InitializeSharedMemoryAllReduce: MPI_Allreduce");
+    MPI_Allreduce(&hostSize, &maxHostSize, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD) || MpiFail("InitializeSharedMemoryAllReduce: MPI_Allreduce");
+    if (minHostSize != maxHostSize || maxHostSize == 1)
+    {
+        fprintf(stderr, "MPIWrapperMpi: hosts run between %d and %d ranks, shared-memory all-reduce needs the same number (> 1) on every host, using MPI only\n", minHostSize, maxHostSize);
+        fflush(stderr);
+        MPI_Comm_free(&hostComm);
+        return;
+    }
+
+    MPI_Comm_split(MPI_COMM_WORLD, hostRank, m_myRank, &m_crossHostComm) || MpiFail("InitializeSharedMemoryAllReduce: MPI_Comm_split");
+
+    // the pid of the first rank of a host makes the segment name unique on that host
+    int pid = (int)getpid();
+    MPI_Bcast(&pid, 1, MPI_INT, 0, hostComm) || MpiFail("InitializeSharedMemoryAllReduce: MPI_Bcast");
+    m_sharedMemoryComm.reset(new SharedMemoryCommunicator("cntk-mpi-" + std::to_string(pid), hostRank, hostSize));
+    MPI_Comm_free(&hostComm);
+
+    fprintf(stderr, "MPIWrapperMpi: using shared-memory all-reduce with %d ranks per host on %d hosts\n", hostSize, m_numMPINodes / hostSize);
+    fflush(stderr);
+#endif
+}
+
+static int CompletedRequestQuery(void*, MPI_Status* status)
+{
+    MPI_Status_set_elements(status, MPI_BYTE, 0);
+    MPI_Status_set_cancelled(status, 0);
+    status->MPI_SOURCE = MPI_UNDEFINED;
+    status->MPI_TAG = MPI_UNDEFINED;
+    return MPI_SUCCESS;
+}
+
+static int CompletedRequestFree(void*)
+{
+    return MPI_SUCCESS;
+}
+
+static int CompletedRequestCancel(void*, int)
+{
+    return MPI_SUCCESS;
+}
+
+// Returns false if the hierarchical all-reduce is not enabled or does not apply, and the caller should use MPI.
+// The shared-memory all-reduce is synchronous, so if 'request' is given, it receives a request that is already complete.
+template <class ElemType>
+bool MPIWrapperMpi::SharedMemoryAllReduce(const void* sendData, ElemType* receiveData, size_t numElements, MPI_Op op, MPI_Request* request) const
+{
+    SharedMemoryCommunicator::ReduceOp reduceOp;
+    if (!m_sharedMemoryComm || !UsingAllNodes())
+        return false;
+    else if (op == MPI_SUM)
+        reduceOp = SharedMemoryCommunicator::ReduceOp::Sum;
+    else if (op == MPI_MAX)
+        reduceOp = SharedMemoryCommunicator::ReduceOp::Max;
+    else if (op == MPI_MIN)
+        reduceOp = SharedMemoryCommunicator::ReduceOp::Min;
+    else
+        return false;
+
+    if (sendData != MPI_IN_PLACE && sendData != receiveData)
+        memcpy(receiveData, sendData, numElements * sizeof(ElemType));
+
+    MPI_Comm crossHostComm = m_crossHostComm;
+    MPI_Datatype dataType = GetDataType(receiveData);
+    m_sharedMemoryComm->AllReduce<ElemType>(receiveData, numElements, reduceOp, [crossHostComm, dataType, op](ElemType* stripe, size_t count)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, stripe, (int)count, dataType, op, crossHostComm) || MpiFail("SharedMemoryAllReduce: MPI_Allreduce");
+    });
+
+    if (request)
+    {
+        MPI_Grequest_start(CompletedRequestQuery, CompletedRequestFree, CompletedRequestCancel, nullptr, request) || MpiFail("SharedMemoryAllReduce: MPI_Grequest_start");
+        MPI_Grequest_complete(*request) || MpiFail("SharedMemoryAllReduce: MPI_Grequest_complete");
+    }
+    return true;
+}
+
 void MPIWrapperMpi::Ping(const char *msg) const
 {
 #undef USE2NDCOMM
@@ -643,6 +862,11 @@ int MPIWrapperMpi::Irecv(void* buf, int count, MPI_Datatype datatype, int source
 
 int MPIWrapperMpi::Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Request* request)
 {
+    if (datatype == MPI_FLOAT && SharedMemoryAllReduce(sendbuf, static_cast<float*>(recvbuf), count, op, request))
+        return MPI_SUCCESS;
+    if (datatype == MPI_DOUBLE && SharedMemoryAllReduce(sendbuf, static_cast<double*>(recvbuf), count, op, request))
+        return MPI_SUCCESS;
+
     return MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, m_currentComm, request);
 }
 
@@ -772,11 +996,17 @@ void MPIWrapperMpi::AllReduce(int* sendData, int* receiveData, size_t numElement
 
 void MPIWrapperMpi::AllReduce(double* sendData, double* receiveData, size_t numElements, MPI_Op op) const
 {
+    if (SharedMemoryAllReduce(sendData, receiveData, numElements, op, nullptr))
+        return;
+
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
 }
 
 void MPIWrapperMpi::AllReduce(float* sendData, float* receiveData, size_t numElements, MPI_Op op) const
 {
+    if (SharedMemoryAllReduce(sendData, receiveData, numElements, op, nullptr))
+        return;
+
     MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
 }
 
@@ -816,10 +1046,16 @@ void MPIWrapperMpi::AllReduceAsync(int *sendData, int *receiveData, size_t numEl
 }
 void MPIWrapperMpi::AllReduceAsync(double *sendData, double *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    if (SharedMemoryAllReduce(sendData, receiveData, numElements, op, request))
+        return;
+
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
 }
 void MPIWrapperMpi::AllReduceAsync(float *sendData, float *receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
 {
+    if (SharedMemoryAllReduce(sendData, receiveData, numElements, op, request))
+        return;
+
     MPI_Iallreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
 }
 
@@ -1259,4 +1495,498 @@ void MPIWrapperEmpty::WaitAny(MPI_Request* requests, int numRequests, int* index
 
 #pragma warning(pop)
 
+// -----------------------------------------------------------------------
+// MPIWrapperShm that communicates through shared memory
+// -----------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable: 4100) // unreferenced formal parameter
+
+static size_t GetDataTypeSize(MPI_Datatype datatype)
+{
+    if (datatype == MPI_CHAR)
+        return sizeof(char);
+    else if (datatype == MPI_INT)
+        return sizeof(int);
+    else if (datatype == MPI_FLOAT)
+        return sizeof(float);
+    else if (datatype == MPI_DOUBLE)
+        return sizeof(double);
+    else if (datatype == MPI_UNSIGNED)
+        return sizeof(unsigned int);
+    else if (datatype == MPI_LONG_LONG_INT)
+        return sizeof(long long);
+    else
+        LogicError("MPIWrapperShm: unsupported MPI_Datatype.");
+}
+
+static SharedMemoryCommunicator::ReduceOp GetReduceOp(MPI_Op op)
+{
+    if (op == MPI_SUM)
+        return SharedMemoryCommunicator::ReduceOp::Sum;
+    else if (op == MPI_MAX)
+        return SharedMemoryCommunicator::ReduceOp::Max;
+    else if (op == MPI_MIN)
+        return SharedMemoryCommunicator::ReduceOp::Min;
+    else
+        LogicError("MPIWrapperShm: only MPI_SUM, MPI_MAX and MPI_MIN are supported.");
+}
+
+// SharedMemoryCommunicator request ids are stored in the bytes of an MPI_Request.
+static_assert(sizeof(MPI_Request) >= sizeof(SharedMemoryCommunicator::RequestId), "MPI_Request cannot hold a SharedMemoryCommunicator::RequestId.");
+
+static MPI_Request ToMpiRequest(SharedMemoryCommunicator::RequestId id)
+{
+    MPI_Request request;
+    memset(&request, 0, sizeof(request));
+    memcpy(&request, &id, sizeof(id));
+    return request;
+}
+
+static SharedMemoryCommunicator::RequestId FromMpiRequest(const MPI_Request& request)
+{
+    SharedMemoryCommunicator::RequestId id;
+    memcpy(&id, &request, sizeof(id));
+    return id;
+}
+
+MPIWrapperShm::MPIWrapperShm()
+{
+    static bool initialized = false;
+    if (initialized)
+        LogicError("MPIWrapperShm: this is a singleton class that can only be instantiated once per process");
+
+    initialized = true;
+
+    size_t numRanks = EnvironmentUtil::GetTotalNumberOfMPINodes();
+    size_t rank = EnvironmentUtil::GetLocalMPINodeRank();
+    fprintf(stderr, "MPIWrapperShm: initializing rank %d of %d\n", (int)rank, (int)numRanks);
+    fflush(stderr);
+
+    m_comm.reset(new SharedMemoryCommunicator(EnvironmentUtil::GetSharedMemoryName(), rank, numRanks));
+
+    fprintf(stderr, "MPIWrapperShm: all %d ranks attached to shared memory\n", (int)numRanks);
+    fflush(stderr);
+}
+
+MPIWrapperShm::~MPIWrapperShm()
+{
+    if (GetMathLibTraceLevel() > 0)
+        fprintf(stderr, "~MPIWrapperShm\n");
+}
+
+bool MPIWrapperShm::IsMultiHost() const
+{
+    return false;
+}
+
+bool MPIWrapperShm::UseGpuGdr()
+{
+    return false;
+}
+
+int MPIWrapperShm::Finalize(void)
+{
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::WaitAll()
+{
+    m_comm->Barrier();
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Wait(MPI_Request* request, MPI_Status* status)
+{
+    m_comm->Wait(FromMpiRequest(*request));
+    *request = ToMpiRequest(0);
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::WaitAll(std::vector<MPI_Request>& requests)
+{
+    return Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+int MPIWrapperShm::Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status)
+{
+    std::vector<SharedMemoryCommunicator::RequestId> ids(count);
+    for (int i = 0; i < count; ++i)
+        ids[i] = FromMpiRequest(array_of_requests[i]);
+
+    size_t completed = m_comm->WaitAny(ids.data(), ids.size());
+    if (completed == SIZE_MAX)
+    {
+        *index = MPI_UNDEFINED;
+        return MPI_SUCCESS;
+    }
+
+    array_of_requests[completed] = ToMpiRequest(0);
+    *index = (int)completed;
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[])
+{
+    for (int i = 0; i < count; ++i)
+        Wait(&array_of_requests[i], MPI_STATUS_IGNORE);
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request)
+{
+    *request = ToMpiRequest(m_comm->Isend(buf, count * GetDataTypeSize(datatype), dest, tag));
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Status* status)
+{
+    m_comm->Wait(m_comm->Irecv(buf, count * GetDataTypeSize(datatype), source, tag));
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Request* request)
+{
+    *request = ToMpiRequest(m_comm->Irecv(buf, count * GetDataTypeSize(datatype), source, tag));
+    return MPI_SUCCESS;
+}
+
+// Collectives are executed synchronously; the returned request is already complete.
+int MPIWrapperShm::Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Request* request)
+{
+    if (datatype == MPI_INT)
+        AllReduceImpl((int*)sendbuf, (int*)recvbuf, count, op);
+    else if (datatype == MPI_FLOAT)
+        AllReduceImpl((float*)sendbuf, (float*)recvbuf, count, op);
+    else if (datatype == MPI_DOUBLE)
+        AllReduceImpl((double*)sendbuf, (double*)recvbuf, count, op);
+    else if (datatype == GetDataType((size_t*)nullptr))
+        AllReduceImpl((size_t*)sendbuf, (size_t*)recvbuf, count, op);
+    else
+        LogicError("MPIWrapperShm::Iallreduce: unsupported MPI_Datatype.");
+
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Abort(int errorcode)
+{
+    // Skip destructors, which would wait for the other ranks.
+    fflush(stderr);
+    std::_Exit(errorcode);
+}
+
+int MPIWrapperShm::Error_string(int errorcode, char* str, int* resultlen)
+{
+    if (!str || !resultlen)
+    {
+        return MPI_UNDEFINED;
+    }
+
+    *resultlen = sprintf(str, "Error-%d", errorcode);
+    return MPI_SUCCESS;
+}
+
+size_t MPIWrapperShm::NumNodesInUse() const
+{
+    return m_comm->NumRanks();
+}
+
+size_t MPIWrapperShm::CurrentNodeRank() const
+{
+    return m_comm->Rank();
+}
+
+std::wstring MPIWrapperShm::CurrentNodeName() const
+{
+    return L"localhost";
+}
+
+bool MPIWrapperShm::IsMainNode() const
+{
+    return CurrentNodeRank() == 0;
+}
+
+bool MPIWrapperShm::IsIdle() const
+{
+    return CurrentNodeRank() >= NumNodesInUse();
+}
+
+bool MPIWrapperShm::UsingAllNodes() const
+{
+    return true;
+}
+
+size_t MPIWrapperShm::MainNodeRank() const
+{
+    return 0;
+}
+
+template <class ElemType>
+void MPIWrapperShm::AllReduceImpl(ElemType* sendData, ElemType* receiveData, size_t numElements, MPI_Op op) const
+{
+    if (sendData != static_cast<ElemType*>(MPI_IN_PLACE) && sendData != receiveData)
+        memcpy(receiveData, sendData, numElements * sizeof(ElemType));
+
+    m_comm->AllReduce(receiveData, numElements, GetReduceOp(op));
+}
+
+// allreduce of a vector
+void MPIWrapperShm::AllReduce(std::vector<size_t>& accumulator) const
+{
+    AllReduce(accumulator.data(), accumulator.size());
+}
+
+void MPIWrapperShm::AllReduce(std::vector<int>& accumulator) const
+{
+    AllReduce(accumulator.data(), accumulator.size());
+}
+
+void MPIWrapperShm::AllReduce(std::vector<double>& accumulator) const
+{
+    AllReduce(accumulator.data(), accumulator.size());
+}
+
+void MPIWrapperShm::AllReduce(std::vector<float>& accumulator) const
+{
+    AllReduce(accumulator.data(), accumulator.size());
+}
+
+// for raw pointer
+void MPIWrapperShm::AllReduce(size_t* sendData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, sendData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(int* sendData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, sendData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(double* sendData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, sendData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(float* sendData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, sendData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(int* sendData, int* receiveData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(double* sendData, double* receiveData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduce(float* sendData, float* receiveData, size_t numElements, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+}
+
+void MPIWrapperShm::AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceAsync(sendData, sendData, numElements, request, op);
+}
+
+void MPIWrapperShm::AllReduceAsync(int* sendData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceAsync(sendData, sendData, numElements, request, op);
+}
+
+void MPIWrapperShm::AllReduceAsync(double* sendData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceAsync(sendData, sendData, numElements, request, op);
+}
+
+void MPIWrapperShm::AllReduceAsync(float* sendData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceAsync(sendData, sendData, numElements, request, op);
+}
+
+void MPIWrapperShm::AllReduceAsync(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllReduceAsync(int* sendData, int* receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllReduceAsync(double* sendData, double* receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllReduceAsync(float* sendData, float* receiveData, size_t numElements, MPI_Request* request, MPI_Op op) const
+{
+    AllReduceImpl(sendData, receiveData, numElements, op);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::Bcast(size_t* sendData, size_t numElements, size_t srcRank)
+{
+    m_comm->Broadcast(sendData, numElements * sizeof(*sendData), srcRank);
+}
+
+void MPIWrapperShm::Bcast(double* sendData, size_t numElements, size_t srcRank)
+{
+    m_comm->Broadcast(sendData, numElements * sizeof(*sendData), srcRank);
+}
+
+void MPIWrapperShm::Bcast(float* sendData, size_t numElements, size_t srcRank)
+{
+    m_comm->Broadcast(sendData, numElements * sizeof(*sendData), srcRank);
+}
+
+void MPIWrapperShm::Bcast(void* buffer, int count, MPI_Datatype datatype, int root)
+{
+    m_comm->Broadcast(buffer, count * GetDataTypeSize(datatype), root);
+}
+
+void MPIWrapperShm::AllGatherAsync(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, MPI_Request* request) const
+{
+    AllGather(sendData, numSendElements, receiveData, numRecvElements);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllGatherAsync(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, MPI_Request* request) const
+{
+    AllGather(sendData, numSendElements, receiveData, numRecvElements);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllGatherAsync(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, MPI_Request* request) const
+{
+    AllGather(sendData, numSendElements, receiveData, numRecvElements);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+void MPIWrapperShm::AllGatherAsync(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, MPI_Request* request) const
+{
+    AllGather(sendData, numSendElements, receiveData, numRecvElements);
+    *request = ToMpiRequest(m_comm->CompletedRequest());
+}
+
+// Note: as with MPI_Allgather, numRecvElements is the number of elements received from each rank.
+void MPIWrapperShm::AllGather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements) const
+{
+    m_comm->AllGather(sendData, numSendElements * sizeof(*sendData), receiveData);
+}
+
+void MPIWrapperShm::AllGather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements) const
+{
+    m_comm->AllGather(sendData, numSendElements * sizeof(*sendData), receiveData);
+}
+
+void MPIWrapperShm::AllGather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements) const
+{
+    m_comm->AllGather(sendData, numSendElements * sizeof(*sendData), receiveData);
+}
+
+void MPIWrapperShm::AllGather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements) const
+{
+    m_comm->AllGather(sendData, numSendElements * sizeof(*sendData), receiveData);
+}
+
+void MPIWrapperShm::Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const
+{
+    m_comm->AllGather(sendbuf, sendcount * GetDataTypeSize(sendtype), recvbuf);
+}
+
+void MPIWrapperShm::Gather(const size_t *sendData, size_t numSendElements, size_t *receiveData, size_t numRecvElements, size_t rootRank) const
+{
+    std::vector<size_t> offsets(m_comm->NumRanks());
+    for (size_t r = 0; r < offsets.size(); ++r)
+        offsets[r] = r * numRecvElements * sizeof(*receiveData);
+    m_comm->Gatherv(sendData, numSendElements * sizeof(*sendData), receiveData, offsets.data(), rootRank);
+}
+
+void MPIWrapperShm::Gather(const int *sendData, size_t numSendElements, int *receiveData, size_t numRecvElements, size_t rootRank) const
+{
+    std::vector<size_t> offsets(m_comm->NumRanks());
+    for (size_t r = 0; r < offsets.size(); ++r)
+        offsets[r] = r * numRecvElements * sizeof(*receiveData);
+    m_comm->Gatherv(sendData, numSendElements * sizeof(*sendData), receiveData, offsets.data(), rootRank);
+}
+
+void MPIWrapperShm::Gather(const float *sendData, size_t numSendElements, float *receiveData, size_t numRecvElements, size_t rootRank) const
+{
+    std::vector<size_t> offsets(m_comm->NumRanks());
+    for (size_t r = 0; r < offsets.size(); ++r)
+        offsets[r] = r * numRecvElements * sizeof(*receiveData);
+    m_comm->Gatherv(sendData, numSendElements * sizeof(*sendData), receiveData, offsets.data(), rootRank);
+}
+
+void MPIWrapperShm::Gather(const double *sendData, size_t numSendElements, double *receiveData, size_t numRecvElements, size_t rootRank) const
+{
+    std::vector<size_t> offsets(m_comm->NumRanks());
+    for (size_t r = 0; r < offsets.size(); ++r)
+        offsets[r] = r * numRecvElements * sizeof(*receiveData);
+    m_comm->Gatherv(sendData, numSendElements * sizeof(*sendData), receiveData, offsets.data(), rootRank);
+}
+
+// The receive counts are not needed: every rank publishes the size of its own contribution.
+template <class ElemType>
+void MPIWrapperShm::GathervImpl(const ElemType* sendData, size_t numSendElements, ElemType* receiveData, int offsets[], size_t rootRank) const
+{
+    std::vector<size_t> byteOffsets(m_comm->NumRanks());
+    if (m_comm->Rank() == rootRank)
+    {
+        for (size_t r = 0; r < byteOffsets.size(); ++r)
+            byteOffsets[r] = offsets[r] * sizeof(ElemType);
+    }
+    m_comm->Gatherv(sendData, numSendElements * sizeof(ElemType), receiveData, byteOffsets.data(), rootRank);
+}
+
+void MPIWrapperShm::Gatherv(const size_t *sendData, size_t numSendElements, size_t *receiveData, int recvCounts[], int offsets[], size_t rootRank) const
+{
+    GathervImpl(sendData, numSendElements, receiveData, offsets, rootRank);
+}
+
+void MPIWrapperShm::Gatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[], size_t rootRank) const
+{
+    GathervImpl(sendData, numSendElements, receiveData, offsets, rootRank);
+}
+
+void MPIWrapperShm::Gatherv(const int *sendData, size_t numSendElements, int *receiveData, int recvCounts[], int offsets[], size_t rootRank) const
+{
+    GathervImpl(sendData, numSendElements, receiveData, offsets, rootRank);
+}
+
+void MPIWrapperShm::Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const
+{
+    GathervImpl(sendData, numSendElements, receiveData, offsets, rootRank);
+}
+
+void MPIWrapperShm::Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const
+{
+    GathervImpl(sendData, numSendElements, receiveData, offsets, rootRank);
+}
+
+void MPIWrapperShm::Wait(MPI_Request* request)
+{
+    Wait(request, MPI_STATUSES_IGNORE);
+}
+
+void MPIWrapperShm::WaitAny(MPI_Request* requests, int numRequests, int* index)
+{
+    Waitany(numRequests, requests, index, MPI_STATUSES_IGNORE);
+}
+
+#pragma warning(pop)
+
 }}}
@@ -0,0 +1,611 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+// SharedMemoryCommunicator.cpp -- see SharedMemoryCommunicator.h
+//
+
+#include "Include/Basics.h"
+#include "Include/SharedMemoryCommunicator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "SharedMemoryCommunicator requires lock-free atomics to synchronize across processes.");
+
+static const uint64_t SharedMemoryMagic = 0x434e544b53484d31ull; // "CNTKSHM1"
+static const size_t PageSize = 4096;
+static const size_t CacheLineSize = 64;
+static const int AttachTimeoutInSeconds = 120;
+
+static size_t RoundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct SharedMemoryCommunicator::ControlBlock
+{
+    std::atomic<uint64_t> m_magic;
+    uint64_t m_numRanks;
+    uint64_t m_slotSize;
+    uint64_t m_mailboxSize;
+    alignas(CacheLineSize) std::atomic<uint32_t> m_barrierCount;
+    alignas(CacheLineSize) std::atomic<uint32_t> m_barrierGeneration;
+};
+
+// Head and tail are monotonically increasing byte counters; the consumer owns the head, the producer the tail.
+struct SharedMemoryCommunicator::MailboxHeader
+{
+    alignas(CacheLineSize) std::atomic<uint64_t> m_head;
+    alignas(CacheLineSize) std::atomic<uint64_t> m_tail;
+};
+
+// Header preceding every point-to-point message in a mailbox.
+struct MessageHeader
+{
+    int32_t m_tag;
+    uint32_t m_reserved;
+    uint64_t m_bytes;
+};
+
+// Spins briefly, then yields, so that waiting ranks do not starve the ones doing work on oversubscribed hosts.
+static inline void Backoff(size_t& spins)
+{
+    if (++spins > 1000)
+        std::this_thread::yield();
+}
+
+#ifndef _WIN32
+
+SharedMemoryCommunicator::SharedMemoryCommunicator(const std::string& name, size_t rank, size_t numRanks, size_t slotSizeInBytes, size_t mailboxSizeInBytes)
+    : m_name(name[0] == '/' ? name : "/" + name), m_rank(rank), m_numRanks(numRanks),
+      m_slotSize(RoundUp(slotSizeInBytes, PageSize)), m_mailboxSize(RoundUp(mailboxSizeInBytes, CacheLineSize)),
+      m_segment(nullptr), m_control(nullptr), m_publishedSizes(nullptr), m_nextRequestId(1),
+      m_sendQueues(numRanks), m_postedRecvs(numRanks), m_unexpected(numRanks), m_incoming(numRanks)
+{
+    if (numRanks == 0 || rank >= numRanks)
+        InvalidArgument("SharedMemoryCommunicator: invalid rank %d for %d ranks.", (int)rank, (int)numRanks);
+
+    m_slotsOffset = RoundUp(sizeof(ControlBlock) + numRanks * sizeof(uint64_t), PageSize);
+    m_mailboxesOffset = m_slotsOffset + numRanks * m_slotSize;
+    m_mailboxStride = RoundUp(sizeof(MailboxHeader) + m_mailboxSize, PageSize);
+    m_segmentSize = m_mailboxesOffset + numRanks * numRanks * m_mailboxStride;
+
+    int fd = -1;
+    if (rank == 0)
+    {
+        shm_unlink(m_name.c_str()); // remove leftovers of a crashed run with the same name
+        fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            RuntimeError("SharedMemoryCommunicator: failed to create shared memory segment %s (errno %d).", m_name.c_str(), errno);
+        if (ftruncate(fd, (off_t)m_segmentSize) != 0)
+            RuntimeError("SharedMemoryCommunicator: failed to resize shared memory segment %s to %d MB (errno %d).", m_name.c_str(), (int)(m_segmentSize >> 20), errno);
+    }
+    else
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(AttachTimeoutInSeconds);
+        for (;;)
+        {
+            fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= m_segmentSize)
+                break;
+            if (fd >= 0)
+                close(fd);
+            if (std::chrono::steady_clock::now() > deadline)
+                RuntimeError("SharedMemoryCommunicator: timed out waiting for rank 0 to create shared memory segment %s.", m_name.c_str());
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    void* p = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        RuntimeError("SharedMemoryCommunicator: failed to map shared memory segment %s (errno %d).", m_name.c_str(), errno);
+
+    m_segment = static_cast<char*>(p);
+    m_control = reinterpret_cast<ControlBlock*>(m_segment);
+    m_publishedSizes = reinterpret_cast<uint64_t*>(m_segment + sizeof(ControlBlock));
+
+    if (rank == 0)
+    {
+        // The segment is zero-filled by ftruncate; publish the geometry last.
+        m_control->m_numRanks = numRanks;
+        m_control->m_slotSize = m_slotSize;
+        m_control->m_mailboxSize = m_mailboxSize;
+        m_control->m_magic.store(SharedMemoryMagic, std::memory_order_release);
+    }
+    else
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(AttachTimeoutInSeconds);
+        while (m_control->m_magic.load(std::memory_order_acquire) != SharedMemoryMagic)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                RuntimeError("SharedMemoryCommunicator: timed out waiting for shared memory segment %s to be initialized.", m_name.c_str());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (m_control->m_numRanks != numRanks || m_control->m_slotSize != m_slotSize || m_control->m_mailboxSize != m_mailboxSize)
+            RuntimeError("SharedMemoryCommunicator: shared memory segment %s was created with a different configuration.", m_name.c_str());
+    }
+
+    // First touch: the own slot and the incoming mailboxes are placed on this rank's NUMA node.
+    memset(Slot(rank), 0, m_slotSize);
+    for (size_t source = 0; source < numRanks; ++source)
+        memset(MailboxData(source, rank), 0, m_mailboxSize);
+
+    for (size_t source = 0; source < numRanks; ++source)
+        m_incoming[source].m_active = false;
+
+    Barrier();
+}
+
+SharedMemoryCommunicator::~SharedMemoryCommunicator()
+{
+    if (!m_segment)
+        return;
+
+    if (!std::uncaught_exception())
+        Barrier(); // nobody may still be reading from our slot
+
+    munmap(m_segment, m_segmentSize);
+    if (m_rank == 0)
+        shm_unlink(m_name.c_str());
+}
+
+#else // _WIN32
+
+SharedMemoryCommunicator::SharedMemoryCommunicator(const std::string&, size_t, size_t, size_t, size_t)
+    : m_segment(nullptr)
+{
+    RuntimeError("SharedMemoryCommunicator: POSIX shared memory is not supported on this platform.");
+}
+
+SharedMemoryCommunicator::~SharedMemoryCommunicator()
+{
+}
+
+#endif
+
+char* SharedMemoryCommunicator::Slot(size_t rank) const
+{
+    return m_segment + m_slotsOffset + rank * m_slotSize;
+}
+
+SharedMemoryCommunicator::MailboxHeader* SharedMemoryCommunicator::Mailbox(size_t source, size_t dest) const
+{
+    return reinterpret_cast<MailboxHeader*>(m_segment + m_mailboxesOffset + (source * m_numRanks + dest) * m_mailboxStride);
+}
+
+char* SharedMemoryCommunicator::MailboxData(size_t source, size_t dest) const
+{
+    return reinterpret_cast<char*>(Mailbox(source, dest)) + sizeof(MailboxHeader);
+}
+
+// Sense-reversing barrier: the last rank to arrive resets the count and advances the generation.
+void SharedMemoryCommunicator::Barrier()
+{
+    uint32_t generation = m_control->m_barrierGeneration.load(std::memory_order_acquire);
+    if (m_control->m_barrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == m_numRanks)
+    {
+        m_control->m_barrierCount.store(0, std::memory_order_relaxed);
+        m_control->m_barrierGeneration.fetch_add(1, std::memory_order_acq_rel);
+        return;
+    }
+
+    size_t spins = 0;
+    while (m_control->m_barrierGeneration.load(std::memory_order_acquire) == generation)
+        Backoff(spins);
+}
+
+// Splits [0, count) into one stripe per rank. Stripes start on cache line boundaries so that ranks never write the same line.
+void SharedMemoryCommunicator::StripeRange(size_t count, size_t elemSize, size_t rank, size_t& begin, size_t& end) const
+{
+    size_t elemsPerLine = std::max<size_t>(1, CacheLineSize / elemSize);
+    size_t numLines = (count + elemsPerLine - 1) / elemsPerLine;
+    size_t linesPerRank = numLines / m_numRanks;
+    size_t residue = numLines % m_numRanks;
+    size_t firstLine = linesPerRank * rank + std::min(residue, rank);
+    size_t lines = linesPerRank + (rank < residue ? 1 : 0);
+    begin = std::min(count, firstLine * elemsPerLine);
+    end = std::min(count, (firstLine + lines) * elemsPerLine);
+}
+
+template <class ElemType>
+static void ReduceInto(ElemType* dst, const ElemType* src, size_t count, SharedMemoryCommunicator::ReduceOp op)
+{
+    switch (op)
+    {
+    case SharedMemoryCommunicator::ReduceOp::Sum:
+        for (size_t i = 0; i < count; ++i)
+            dst[i] += src[i];
+        break;
+    case SharedMemoryCommunicator::ReduceOp::Max:
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = std::max(dst[i], src[i]);
+        break;
+    case SharedMemoryCommunicator::ReduceOp::Min:
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = std::min(dst[i], src[i]);
+        break;
+    }
+}
+
+template <class ElemType>
+void SharedMemoryCommunicator::AllReduce(ElemType* data, size_t count, ReduceOp op, const std::function<void(ElemType*, size_t)>& reducedStripe)
+{
+    const size_t chunkSize = m_slotSize / sizeof(ElemType);
+    ElemType* own = reinterpret_cast<ElemType*>(Slot(m_rank));
+    for (size_t offset = 0; offset < count; offset += chunkSize)
+    {
+        size_t n = std::min(chunkSize, count - offset);
+        memcpy(own, data + offset, n * sizeof(ElemType));
+        Barrier();
+
+        // reduce-scatter: reduce our stripe of every slot into our own slot
+        size_t begin, end;
+        StripeRange(n, sizeof(ElemType), m_rank, begin, end);
+        for (size_t r = 1; r < m_numRanks; ++r)
+        {
+            // start with a different peer on every rank to spread the remote reads
+            size_t peer = (m_rank + r) % m_numRanks;
+            ReduceInto(own + begin, reinterpret_cast<const ElemType*>(Slot(peer)) + begin, end - begin, op);
+        }
+
+        if (reducedStripe)
+            reducedStripe(own + begin, end - begin);
+        Barrier();
+
+        // all-gather: collect every rank's reduced stripe
+        for (size_t r = 0; r < m_numRanks; ++r)
+        {
+            StripeRange(n, sizeof(ElemType), r, begin, end);
+            memcpy(data + offset + begin, reinterpret_cast<const ElemType*>(Slot(r)) + begin, (end - begin) * sizeof(ElemType));
+        }
+        Barrier();
+    }
+}
+
+template void SharedMemoryCommunicator::AllReduce<int>(int*, size_t, ReduceOp, const std::function<void(int*, size_t)>&);
+template void SharedMemoryCommunicator::AllReduce<size_t>(size_t*, size_t, ReduceOp, const std::function<void(size_t*, size_t)>&);
+template void SharedMemoryCommunicator::AllReduce<float>(float*, size_t, ReduceOp, const std::function<void(float*, size_t)>&);
+template void SharedMemoryCommunicator::AllReduce<double>(double*, size_t, ReduceOp, const std::function<void(double*, size_t)>&);
+
+void SharedMemoryCommunicator::Broadcast(void* data, size_t bytes, size_t root)
+{
+    char* buffer = static_cast<char*>(data);
+    for (size_t offset = 0; offset < bytes; offset += m_slotSize)
+    {
+        size_t n = std::min(m_slotSize, bytes - offset);
+        if (m_rank == root)
+            memcpy(Slot(root), buffer + offset, n);
+        Barrier();
+        if (m_rank != root)
+            memcpy(buffer + offset, Slot(root), n);
+        Barrier();
+    }
+}
+
+void SharedMemoryCommunicator::AllGather(const void* send, size_t bytes, void* recv)
+{
+    const char* sendBuffer = static_cast<const char*>(send);
+    char* recvBuffer = static_cast<char*>(recv);
+    for (size_t offset = 0; offset < bytes; offset += m_slotSize)
+    {
+        size_t n = std::min(m_slotSize, bytes - offset);
+        memcpy(Slot(m_rank), sendBuffer + offset, n);
+        Barrier();
+        for (size_t r = 0; r < m_numRanks; ++r)
+            memcpy(recvBuffer + r * bytes + offset, Slot(r), n);
+        Barrier();
+    }
+}
+
+void SharedMemoryCommunicator::Gatherv(const void* send, size_t bytes, void* recv, const size_t* offsets, size_t root)
+{
+    // Only the root knows the receive counts, so every rank publishes its own size first.
+    m_publishedSizes[m_rank] = bytes;
+    Barrier();
+    size_t maxBytes = *std::max_element(m_publishedSizes, m_publishedSizes + m_numRanks);
+    std::vector<uint64_t> sizes(m_publishedSizes, m_publishedSizes + m_numRanks);
+    Barrier();
+
+    const char* sendBuffer = static_cast<const char*>(send);
+    char* recvBuffer = static_cast<char*>(recv);
+    for (size_t offset = 0; offset < maxBytes; offset += m_slotSize)
+    {
+        if (offset < bytes)
+            memcpy(Slot(m_rank), sendBuffer + offset, std::min(m_slotSize, bytes - offset));
+        Barrier();
+        if (m_rank == root)
+        {
+            for (size_t r = 0; r < m_numRanks; ++r)
+            {
+                if (offset < sizes[r])
+                    memcpy(recvBuffer + offsets[r] + offset, Slot(r), std::min<size_t>(m_slotSize, sizes[r] - offset));
+            }
+        }
+        Barrier();
+    }
+}
+
+// -----------------------------------------------------------------------
+// point-to-point messages
+// -----------------------------------------------------------------------
+
+SharedMemoryCommunicator::RequestId SharedMemoryCommunicator::NewRequest(const Request& request)
+{
+    RequestId id = m_nextRequestId++;
+    if (m_nextRequestId == 0)
+        m_nextRequestId = 1;
+    m_requests[id] = request;
+    return id;
+}
+
+SharedMemoryCommunicator::RequestId SharedMemoryCommunicator::Isend(const void* buffer, size_t bytes, size_t dest, int tag)
+{
+    if (dest >= m_numRanks)
+        InvalidArgument("SharedMemoryCommunicator::Isend: invalid destination rank %d.", (int)dest);
+
+    RequestId id = NewRequest(Request{ true, false, static_cast<const char*>(buffer), nullptr, bytes, dest, tag, 0, false });
+    m_sendQueues[dest].push_back(id);
+    Progress();
+    return id;
+}
+
+SharedMemoryCommunicator::RequestId SharedMemoryCommunicator::Irecv(void* buffer, size_t bytes, size_t source, int tag)
+{
+    if (source >= m_numRanks)
+        InvalidArgument("SharedMemoryCommunicator::Irecv: invalid source rank %d.", (int)source);
+
+    RequestId id = NewRequest(Request{ false, false, nullptr, static_cast<char*>(buffer), bytes, source, tag, 0, false });
+    auto& request = m_requests[id];
+
+    // Messages from one source with the same tag are matched in order; the oldest unclaimed one wins.
+    auto& unexpected = m_unexpected[source];
+    for (auto iter = unexpected.begin(); iter != unexpected.end(); ++iter)
+    {
+        if (iter->m_tag != tag || iter->m_boundRecv != 0)
+            continue;
+
+        if (iter->m_data.size() > bytes)
+            RuntimeError("SharedMemoryCommunicator::Irecv: message of %d bytes from rank %d does not fit into the receive buffer of %d bytes.", (int)iter->m_data.size(), (int)source, (int)bytes);
+
+        if (iter->m_complete)
+        {
+            memcpy(request.m_recvBuffer, iter->m_data.data(), iter->m_data.size());
+            request.m_transferred = iter->m_data.size();
+            request.m_done = true;
+            unexpected.erase(iter);
+        }
+        else
+            iter->m_boundRecv = id;
+        return id;
+    }
+
+    m_postedRecvs[source].push_back(id);
+    Progress();
+    return id;
+}
+
+SharedMemoryCommunicator::RequestId SharedMemoryCommunicator::CompletedRequest()
+{
+    return NewRequest(Request{ false, true, nullptr, nullptr, 0, m_rank, 0, 0, false });
+}
+
+bool SharedMemoryCommunicator::IsDone(RequestId request) const
+{
+    auto iter = m_requests.find(request);
+    if (iter == m_requests.end())
+        LogicError("SharedMemoryCommunicator: unknown request %u.", (unsigned int)request);
+    return iter->second.m_done;
+}
+
+void SharedMemoryCommunicator::Wait(RequestId request)
+{
+    if (request == 0)
+        return;
+
+    size_t spins = 0;
+    while (!IsDone(request))
+    {
+        Progress();
+        Backoff(spins);
+    }
+    m_requests.erase(request);
+}
+
+size_t SharedMemoryCommunicator::WaitAny(const RequestId* requests, size_t numRequests)
+{
+    size_t spins = 0;
+    for (;;)
+    {
+        bool anyActive = false;
+        for (size_t i = 0; i < numRequests; ++i)
+        {
+            if (requests[i] == 0)
+                continue;
+
+            anyActive = true;
+            if (IsDone(requests[i]))
+            {
+                m_requests.erase(requests[i]);
+                return i;
+            }
+        }
+
+        if (!anyActive)
+            return SIZE_MAX;
+
+        Progress();
+        Backoff(spins);
+    }
+}
+
+void SharedMemoryCommunicator::Progress()
+{
+    bool progressed;
+    do
+    {
+        progressed = false;
+        for (size_t peer = 0; peer < m_numRanks; ++peer)
+        {
+            progressed |= ProgressSend(peer);
+            progressed |= ProgressRecv(peer);
+        }
+    } while (progressed);
+}
+
+size_t SharedMemoryCommunicator::MailboxBytesFree(size_t dest) const
+{
+    auto mailbox = Mailbox(m_rank, dest);
+    return m_mailboxSize - (size_t)(mailbox->m_tail.load(std::memory_order_relaxed) - mailbox->m_head.load(std::memory_order_acquire));
+}
+
+size_t SharedMemoryCommunicator::MailboxBytesAvailable(size_t source) const
+{
+    auto mailbox = Mailbox(source, m_rank);
+    return (size_t)(mailbox->m_tail.load(std::memory_order_acquire) - mailbox->m_head.load(std::memory_order_relaxed));
+}
+
+size_t SharedMemoryCommunicator::WriteMailbox(size_t dest, const char* data, size_t bytes)
+{
+    auto mailbox = Mailbox(m_rank, dest);
+    char* ring = MailboxData(m_rank, dest);
+    bytes = std::min(bytes, MailboxBytesFree(dest));
+    uint64_t tail = mailbox->m_tail.load(std::memory_order_relaxed);
+    size_t pos = (size_t)(tail % m_mailboxSize);
+    size_t first = std::min(bytes, m_mailboxSize - pos);
+    memcpy(ring + pos, data, first);
+    memcpy(ring, data + first, bytes - first);
+    mailbox->m_tail.store(tail + bytes, std::memory_order_release);
+    return bytes;
+}
+
+size_t SharedMemoryCommunicator::ReadMailbox(size_t source, char* data, size_t bytes)
+{
+    auto mailbox = Mailbox(source, m_rank);
+    const char* ring = MailboxData(source, m_rank);
+    bytes = std::min(bytes, MailboxBytesAvailable(source));
+    uint64_t head = mailbox->m_head.load(std::memory_order_relaxed);
+    size_t pos = (size_t)(head % m_mailboxSize);
+    size_t first = std::min(bytes, m_mailboxSize - pos);
+    memcpy(data, ring + pos, first);
+    memcpy(data + first, ring, bytes - first);
+    mailbox->m_head.store(head + bytes, std::memory_order_release);
+    return bytes;
+}
+
+// Streams queued sends to 'dest' in order. A send is complete once all of its data is in the mailbox.
+bool SharedMemoryCommunicator::ProgressSend(size_t dest)
+{
+    bool progressed = false;
+    auto& queue = m_sendQueues[dest];
+    while (!queue.empty())
+    {
+        auto& request = m_requests[queue.front()];
+        if (!request.m_headerWritten)
+        {
+            if (MailboxBytesFree(dest) < sizeof(MessageHeader))
+                break;
+
+            MessageHeader header{ request.m_tag, 0, request.m_bytes };
+            WriteMailbox(dest, reinterpret_cast<const char*>(&header), sizeof(header));
+            request.m_headerWritten = true;
+            progressed = true;
+        }
+
+        size_t written = WriteMailbox(dest, request.m_sendBuffer + request.m_transferred, request.m_bytes - request.m_transferred);
+        request.m_transferred += written;
+        progressed |= written > 0;
+        if (request.m_transferred < request.m_bytes)
+            break;
+
+        request.m_done = true;
+        queue.pop_front();
+    }
+    return progressed;
+}
+
+// Reads messages from 'source' into the matching posted receive, or into an unexpected message buffer.
+bool SharedMemoryCommunicator::ProgressRecv(size_t source)
+{
+    bool progressed = false;
+    auto& incoming = m_incoming[source];
+    for (;;)
+    {
+        if (!incoming.m_active)
+        {
+            if (MailboxBytesAvailable(source) < sizeof(MessageHeader))
+                break;
+
+            MessageHeader header;
+            ReadMailbox(source, reinterpret_cast<char*>(&header), sizeof(header));
+            progressed = true;
+
+            incoming.m_active = true;
+            incoming.m_bytes = (size_t)header.m_bytes;
+            incoming.m_received = 0;
+            incoming.m_recv = 0;
+
+            auto& posted = m_postedRecvs[source];
+            auto match = std::find_if(posted.begin(), posted.end(), [&](RequestId id) { return m_requests[id].m_tag == header.m_tag; });
+            if (match != posted.end())
+            {
+                auto& request = m_requests[*match];
+                if (incoming.m_bytes > request.m_bytes)
+                    RuntimeError("SharedMemoryCommunicator: message of %d bytes from rank %d does not fit into the receive buffer of %d bytes.", (int)incoming.m_bytes, (int)source, (int)request.m_bytes);
+                incoming.m_recv = *match;
+                incoming.m_target = request.m_recvBuffer;
+                posted.erase(match);
+            }
+            else
+            {
+                auto& unexpected = m_unexpected[source];
+                unexpected.push_back(UnexpectedMessage{ header.m_tag, std::vector<char>(incoming.m_bytes), false, 0 });
+                incoming.m_unexpected = std::prev(unexpected.end());
+                incoming.m_target = incoming.m_unexpected->m_data.data();
+            }
+        }
+
+        size_t read = ReadMailbox(source, incoming.m_target + incoming.m_received, incoming.m_bytes - incoming.m_received);
+        incoming.m_received += read;
+        progressed |= read > 0;
+        if (incoming.m_received < incoming.m_bytes)
+            break;
+
+        incoming.m_active = false;
+        if (incoming.m_recv != 0)
+        {
+            auto& request = m_requests[incoming.m_recv];
+            request.m_transferred = incoming.m_bytes;
+            request.m_done = true;
+        }
+        else if (incoming.m_unexpected->m_boundRecv != 0)
+        {
+            // a receive was posted while the message was still arriving
+            auto& request = m_requests[incoming.m_unexpected->m_boundRecv];
+            memcpy(request.m_recvBuffer, incoming.m_unexpected->m_data.data(), incoming.m_bytes);
+            request.m_transferred = incoming.m_bytes;
+            request.m_done = true;
+            m_unexpected[source].erase(incoming.m_unexpected);
+        }
+        else
+            incoming.m_unexpected->m_complete = true;
+    }
+    return progressed;
+}
+
+}}}
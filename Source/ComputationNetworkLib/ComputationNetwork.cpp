@@ -31,6 +31,9 @@ using namespace std;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+std::atomic<size_t> ConvolutionEngineCache::m_numHits(0);
+std::atomic<size_t> ConvolutionEngineCache::m_numMisses(0);
+
 // -----------------------------------------------------------------------
 // MatrixPool methods
 // -----------------------------------------------------------------------
@@ -118,6 +121,10 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     wstring tmpFileName = fileName + L".tmp";
     SaveToFileImpl(tmpFileName, fileFormat);
     renameOrDie(tmpFileName, fileName);
+
+    // save the analysis of the network along with it, for Load() to pick it up
+    if (Globals::ShouldCacheCompiledPlans() && HasCompiledPlan())
+        SaveCompiledPlan(CompiledPlanFileName(fileName));
 }
 
 // TODO: how does the file distinguish float vs double nodes?
@@ -486,6 +493,7 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(LatticeSequenceWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(TiledCrossEntropyWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassificationErrorNode) ||
         nodePtr->OperationName() == OperationNameOf(ForwardBackwardNode) ||
 #ifdef COMING_SOON
@@ -1118,67 +1126,78 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
                     keepRatio * 100, (int) r,
                     ((m + n) * r + 0.0f) / m / n * 100);
 
-            // redU in R^ {mXr}
-            Matrix<ElemType> redU = U.ColumnSlice(0, r);
-            Matrix<ElemType> redVT(-1);
+            ReplaceByLowRankFactors(name, U, S, VT, r);
+        }
+    }
 
-            // redVT in R^{rXn}
-            redVT.Resize(r, n);
-            redVT.AssignRowSliceValuesOf(VT, 0, r);
+    // redo necessary post-processing
+    CompileNetwork();
+}
 
-            Matrix<ElemType> redS(r, (size_t)1, A.GetDeviceId());
-            for (size_t i = 0; i < r; i++)
-            {
-                ElemType sqrtSigma = (ElemType) sqrt((double) S(i, 0));
-                redS(i, 0) = sqrtSigma;
-            }
+// replaces the [m x n] LearnableParameter 'name' by the product of two LearnableParameters name_U [m x r] and name_V [r x n]
+// that are formed from its SVD A = U * S * VT, truncated to the first r singular values (each factor takes sqrt(S); U is overwritten)
+// Where the parameter is immediately used in a product, the multiplication order is changed to U*(V*X).
+template <class ElemType>
+void ComputationNetwork::ReplaceByLowRankFactors(const wstring& name, Matrix<ElemType>& U, const Matrix<ElemType>& S, const Matrix<ElemType>& VT, size_t r)
+{
+    size_t n = VT.GetNumCols();
 
-            redU.RowElementMultiplyWith(redS.Transpose());
-            redVT.ColumnElementMultiplyWith(redS);
+    // redU in R^ {mXr}
+    Matrix<ElemType> redU = U.ColumnSlice(0, r);
+    Matrix<ElemType> redVT(-1);
 
-            // Step 2. create two new Parameter nodes and one Times node
-            wstring leftChildName = name + L"_U";
-            wstring rightChildName = name + L"_V";
-            shared_ptr<ComputationNode<ElemType>> pLeft = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, leftChildName, m, r));
-            shared_ptr<ComputationNode<ElemType>> pRight = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, rightChildName, r, n));
-            InitLearnableParameters(pLeft,  L"fixedValue", 0); // follow the protocol; otherwise deferred initialization will overwrite the SVD values in validation
-            InitLearnableParameters(pRight, L"fixedValue", 0);
+    // redVT in R^{rXn}
+    redVT.Resize(r, n);
+    redVT.AssignRowSliceValuesOf(VT, 0, r);
 
-            // TODO: We should be able to move instead of copy but it currently isn't straightforward
-            // due to redU and redVT being slices
-            pLeft->ValueAsMatrix()  = redU.DeepClone();
-            pRight->ValueAsMatrix() = redVT.DeepClone();
+    Matrix<ElemType> redS(r, (size_t)1, U.GetDeviceId());
+    for (size_t i = 0; i < r; i++)
+    {
+        ElemType sqrtSigma = (ElemType) sqrt((double) S(i, 0));
+        redS(i, 0) = sqrtSigma;
+    }
 
-            // Step 3. Change the network hierachy to include the SVD nodes
-            auto parentNodes = GetParentNodes(name);
+    redU.RowElementMultiplyWith(redS.Transpose());
+    redVT.ColumnElementMultiplyWith(redS);
 
-            for (auto& pParentNode : parentNodes)
-            {
-                // Change the hierarchy of the network if the node is immediately used in a product
-                auto pParentTimesNode = dynamic_pointer_cast<TimesNode<ElemType>>(pParentNode);
-                if (pParentTimesNode)
-                {
-                    // Change the hierarchy to ensure multiplication order
-                    // U*(V*X)
-                    shared_ptr<ComputationNode<ElemType>> pTimes = New<TimesNode<ElemType>>(m_deviceId, name + L"_SVD");
-                    pTimes->AttachInputs({ pLeft, pParentNode });
-                    
-                    InsertNode(pParentNode->GetName(), pTimes, pParentNode->GetTags());
-                    ReplaceLeafNode(name, pRight);
-                }
-                else
-                {
-                    // Default multiplication order
-                    shared_ptr<ComputationNode<ElemType>> pTimes = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(m_deviceId, name + L"_SVD"), { pLeft, pRight });
+    // Step 2. create two new Parameter nodes and one Times node
+    wstring leftChildName = name + L"_U";
+    wstring rightChildName = name + L"_V";
+    shared_ptr<ComputationNode<ElemType>> pLeft = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, leftChildName, U.GetNumRows(), r));
+    shared_ptr<ComputationNode<ElemType>> pRight = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, rightChildName, r, n));
+    InitLearnableParameters(pLeft,  L"fixedValue", 0); // follow the protocol; otherwise deferred initialization will overwrite the SVD values in validation
+    InitLearnableParameters(pRight, L"fixedValue", 0);
 
-                    ReplaceLeafNode(name, pTimes);
-                }
-            }
+    // TODO: We should be able to move instead of copy but it currently isn't straightforward
+    // due to redU and redVT being slices
+    pLeft->ValueAsMatrix()  = redU.DeepClone();
+    pRight->ValueAsMatrix() = redVT.DeepClone();
+
+    // Step 3. Change the network hierachy to include the SVD nodes
+    auto parentNodes = GetParentNodes(name);
+
+    for (auto& pParentNode : parentNodes)
+    {
+        // Change the hierarchy of the network if the node is immediately used in a product
+        auto pParentTimesNode = dynamic_pointer_cast<TimesNode<ElemType>>(pParentNode);
+        if (pParentTimesNode)
+        {
+            // Change the hierarchy to ensure multiplication order
+            // U*(V*X)
+            shared_ptr<ComputationNode<ElemType>> pTimes = New<TimesNode<ElemType>>(m_deviceId, name + L"_SVD");
+            pTimes->AttachInputs({ pLeft, pParentNode });
+            
+            InsertNode(pParentNode->GetName(), pTimes, pParentNode->GetTags());
+            ReplaceLeafNode(name, pRight);
         }
-    }
+        else
+        {
+            // Default multiplication order
+            shared_ptr<ComputationNode<ElemType>> pTimes = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(m_deviceId, name + L"_SVD"), { pLeft, pRight });
 
-    // redo necessary post-processing
-    CompileNetwork();
+            ReplaceLeafNode(name, pTimes);
+        }
+    }
 }
 
 // Helper class to form a logical DBN layer while exporting the network (used by SaveToDbnFile)
@@ -1548,6 +1567,7 @@ template void ComputationNetwork::InitLearnableParametersWithBilinearFill<float>
 template void ComputationNetwork::Read<float>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<float>(size_t modelVersion, File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::ReplaceByLowRankFactors<float>(const wstring& name, Matrix<float>& U, const Matrix<float>& S, const Matrix<float>& VT, size_t r);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
@@ -1557,6 +1577,7 @@ template void ComputationNetwork::InitLearnableParametersWithBilinearFill<double
 template void ComputationNetwork::Read<double>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<double>(size_t modelVersion, File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::ReplaceByLowRankFactors<double>(const wstring& name, Matrix<double>& U, const Matrix<double>& S, const Matrix<double>& VT, size_t r);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                       const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
@@ -59,6 +59,9 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_compiledPlanKey(0),
+        m_isCompiledFromPlan(false),
+        m_isAllocationPlanReplayed(false),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, ComputationNodeBase::DefaultDynamicAxisName)),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -113,6 +116,9 @@ public:
     template <class ElemType> void Load(const std::wstring& fileName)
     {
         Read<ElemType>(fileName);
+        // reuse the analysis saved along with the model by Save(), if any
+        if (Globals::ShouldCacheCompiledPlans() && fexists(CompiledPlanFileName(fileName)))
+            LoadCompiledPlans(CompiledPlanFileName(fileName));
         // perform all further post-processing, caching, etc.
         CompileNetwork();
     }
@@ -252,6 +258,8 @@ public:
     void ValidateNetwork();
 
 private:
+    bool ValidateNetworkFromPlan();
+    void FinalizeValidation(const list<ComputationNodeBasePtr>& nodes);
     size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
     void MarkValueNonSharableNodes();
@@ -263,10 +271,12 @@ private:
     void CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters);
     void ResetMBLayouts();
     bool IsCompiled() const { return m_isCompiled; }
-    bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void VerifyIsCompiled(const char* where) const;
 public:
+    bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // bytes the matrices shared through the MatrixPool take up for minibatches of 'numColumns' columns, see MatrixPool::GetAllocatedBytes()
+    size_t GetPooledMatrixBytes(size_t numColumns) const { return m_matrixPool.GetAllocatedBytes(numColumns); }
 
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
@@ -287,6 +297,38 @@ private:
     // The method below determines evaluation order, which is tricky in presence of recurrent loops.
     void FormRecurrentLoops();
 
+public:
+    // -----------------------------------------------------------------------
+    // compiled-plan cache
+    // If enabled by Globals::SetCompiledPlanCaching(), CompileNetwork() keeps the outcome of its analysis, that is,
+    // the evaluation order, the recurrent loops and the inferred dimensions of all nodes, in a process-wide cache,
+    // and so does AllocateAllMatrices() with the buffer assignment of the MatrixPool. A network with the same
+    // structure and the same input and parameter dimensions, e.g. a clone or the same model loaded again, is then
+    // compiled from the cached plan instead. Plans do not depend on node names.
+    // -----------------------------------------------------------------------
+
+    // Saves the plan of this compiled network; Load() picks it up from CompiledPlanFileName() of the model.
+    bool HasCompiledPlan() const { return !!m_compiledPlan; }
+    void SaveCompiledPlan(const std::wstring& fileName) const;
+    static void LoadCompiledPlans(const std::wstring& fileName);
+    static void ClearCompiledPlans();
+    static std::wstring CompiledPlanFileName(const std::wstring& modelFileName) { return modelFileName + L".plan"; }
+
+    // whether the last CompileNetwork() validated the network from a cached plan, and whether the last
+    // AllocateAllMatrices() replayed the buffer assignment of the plan
+    bool IsCompiledFromPlan() const { return m_isCompiledFromPlan; }
+    bool IsAllocationPlanReplayed() const { return m_isAllocationPlanReplayed; }
+
+    struct CompiledPlan; // (opaque, defined in ComputationNetworkPlanCache.cpp)
+
+private:
+    bool FormCanonicalOrder();
+    void RestoreFromCompiledPlan();
+    void RecordCompiledPlan();
+    uint64_t AllocationPlanKey(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, const ComputationNodeBasePtr& trainRootNode) const;
+    void PrepareAllocationFromPlan(uint64_t allocationPlanKey);
+    void RecordAllocationPlan(uint64_t allocationPlanKey);
+
 public:
     // -----------------------------------------------------------------------
     // evaluation: traversal
@@ -468,6 +510,7 @@ public:
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
     void ReplaceNode(wstring nodeName, ComputationNodeBasePtr newNode);
+    void SubstituteNode(ComputationNodeBasePtr oldNode, ComputationNodeBasePtr newNode);
     void InsertNode(wstring nodeName, ComputationNodeBasePtr newNode, const std::set<std::wstring>& newNodeTags);
     void ReplaceLeafNode(wstring oldNodeName, ComputationNodeBasePtr newNode);
     void ReplaceFinalCriterionNode(wstring oldNodeName, ComputationNodeBasePtr newNode);
@@ -846,9 +889,94 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // what OptimizeForInference() did
+    struct InferenceOptimizationStats
+    {
+        size_t m_numNodesBefore;
+        size_t m_numNodesAfter;
+        size_t m_numFoldedBatchNormalizations;
+        size_t m_numFoldedConstants;
+        size_t m_numFusedConvolutions;
+    };
+
+    // Rewrites the network for inference of the given outputs (the default outputs if none are given):
+    // BatchNormalization nodes are folded into the weights of a preceding Convolution or Times, subgraphs that only
+    // depend on LearnableParameters are replaced by their precomputed values, convolutions are fused with a following
+    // bias and activation, and nodes the outputs do not depend on are removed. The result can be saved, but is no
+    // longer trainable. Must be called before AllocateAllMatrices().
+    template <class ElemType>
+    InferenceOptimizationStats OptimizeForInference(const std::vector<std::wstring>& outputNodeNames);
+
+    // Moves the part of Times(W, RowStack(...)) nodes inside recurrent loops that multiplies RowStack inputs from outside
+    // the loop out of the loop, so that it is computed for all frames at once rather than frame by frame (see
+    // ComputationNetworkAnalysis.cpp). The network stays trainable. Must be called before AllocateAllMatrices().
+    // Returns the number of rewritten Times nodes.
+    template <class ElemType>
+    size_t HoistLoopInvariantProjections();
+
+    // what CompressForBudget() did to one layer
+    struct LayerCompressionStats
+    {
+        std::wstring m_nodeName; // the Times node whose weights were factored, or the Convolution node whose filters were pruned
+        bool m_isChannelPruning;
+        size_t m_sizeBefore;     // rank of the weights, or number of filters
+        size_t m_sizeAfter;
+        double m_flopsBefore;    // per sample; for pruned filters, including the following Convolution
+        double m_flopsAfter;
+        double m_latencyBefore;  // seconds per minibatch as profiled, 0 if not profiled
+        double m_latencyAfter;   // estimated
+        double m_relativeError;  // squared norm of the discarded part of the weights, relative to the whole
+    };
+
+    // the target of CompressForBudget(), and the profile it is estimated from
+    struct CompressionBudget
+    {
+        double m_latency = 0;                           // forward-pass time per minibatch in seconds, 0 for none
+        double m_flops = 0;                             // Times and Convolution operations per sample, 0 for none
+        double m_profiledLatency = 0;                   // forward-pass time per minibatch of the uncompressed network
+        std::map<std::wstring, double> m_nodeLatencies; // forward-pass time per minibatch of its Times and Convolution nodes
+        size_t m_alignment = 8;                         // kept ranks and filter counts are multiples of this
+        double m_maxLayerError = 0.5;                   // options that discard more of a layer's weights are not considered
+    };
+
+    // Shrinks the Times and Convolution layers the given outputs (the default outputs if none are given) depend on
+    // until the estimated latency and number of operations are within the budget: the weights of a Times node are
+    // factored by a truncated SVD (as in PerformSVDecomposition()), and the least important filters of a Convolution
+    // are pruned along with the matching input channels of the Convolution that consumes them. The rank or filter
+    // count of each layer is chosen greedily to keep the discarded part of the weights small. The network stays
+    // trainable. Must be called on a CPU network before AllocateAllMatrices(). Returns one entry per candidate layer.
+    template <class ElemType>
+    std::vector<LayerCompressionStats> CompressForBudget(const std::vector<std::wstring>& outputNodeNames, const CompressionBudget& budget);
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
+private:
+    size_t PruneNodesNotFeeding(const std::vector<ComputationNodeBasePtr>& rootNodes);
+    bool IsNetworkOutput(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames) const;
+    template <class ElemType>
+    bool TryFoldBatchNormalization(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames);
+    template <class ElemType>
+    bool TryFuseConvolution(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames);
+    template <class ElemType>
+    size_t FoldConstantSubgraphs(const std::vector<ComputationNodeBasePtr>& rootNodes, const std::vector<std::wstring>& outputNodeNames);
+    struct CompressionCandidate;
+    template <class ElemType>
+    bool TryGetLowRankCandidate(const ComputationNodeBasePtr& node, const std::map<ComputationNodeBasePtr, std::set<ComputationNodeBasePtr>>& parents,
+                                CompressionCandidate& candidate);
+    template <class ElemType>
+    bool TryGetChannelPruningCandidate(const ComputationNodeBasePtr& node, const std::map<ComputationNodeBasePtr, std::set<ComputationNodeBasePtr>>& parents,
+                                       const std::set<ComputationNodeBasePtr>& outputNodes, CompressionCandidate& candidate);
+    template <class ElemType>
+    void ApplyLowRank(const CompressionCandidate& candidate);
+    template <class ElemType>
+    void ApplyChannelPruning(const CompressionCandidate& candidate);
+    template <class ElemType>
+    void SubstituteParameter(const ComputationNodeBasePtr& parameter, const TensorShape& shape, std::vector<ElemType>& values);
+    template <class ElemType>
+    void ReplaceByLowRankFactors(const std::wstring& name, Matrix<ElemType>& U, const Matrix<ElemType>& S, const Matrix<ElemType>& VT, size_t r);
+public:
+
     // -----------------------------------------------------------------------
     // construction
     // -----------------------------------------------------------------------
@@ -1281,6 +1409,13 @@ private:
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_inputValues;         // [out node] -> all input nodes feeding into out node
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_learnableParameters; // [out node] -> all parameter nodes feeding into out node
 
+    // compiled plan, see FormCanonicalOrder()
+    std::vector<ComputationNodeBasePtr> m_canonicalOrder;        // name-independent order of all nodes, which plans refer to nodes by
+    uint64_t m_compiledPlanKey;                                  // hash of the structure and leaf dimensions in canonical order
+    std::shared_ptr<const CompiledPlan> m_compiledPlan;          // plan this network was compiled from or recorded into
+    bool m_isCompiledFromPlan;                                   // m_compiledPlan was found in the cache and matched the network
+    bool m_isAllocationPlanReplayed;                             // the MatrixPool served all requests according to m_compiledPlan
+
 private:
     // pool for matrices that can be shared across nodes
     // TODO: does this apply to anything else besides temporary node-internal intermediate results? What, for example?
@@ -9,8 +9,12 @@
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
+#include <algorithm>
 #include <string>
 #include <set>
+#include <map>
 
 using namespace std;
 
@@ -124,4 +128,138 @@ static int DetermineLoopDirection(const std::vector<ComputationNodeBasePtr>& nes
     return steppingDirection;
 }
 
+// -----------------------------------------------------------------------
+// loop-invariant hoisting
+// -----------------------------------------------------------------------
+
+// A recurrent loop runs its nodes frame by frame. Hand-built recurrences often project the input and the recurrent
+// state with a single weight matrix, Times(W, RowStack(x, PastValue(h))), which is then part of the loop and runs as
+// one skinny matrix product per frame, although its x part does not depend on the recurrence.
+// Since W [x; h] = W[:, x] x + W[:, h] h, such a Times node is rewritten as
+//     Plus(Times(Slice(W), x), Times(Slice(W), PastValue(h)))
+// The first term has no input from the loop, so FormRecurrentLoops() no longer puts it into the loop: it is computed
+// for all frames in a single product before the loop, and backpropagated after it. Only the second term stays in the loop.
+// The RowStack inputs that do not depend on the loop must be a leading or trailing range of its inputs.
+// The Plus node takes the name of the Times node. Returns the number of rewritten Times nodes.
+template <class ElemType>
+size_t ComputationNetwork::HoistLoopInvariantProjections()
+{
+    VerifyIsCompiled("HoistLoopInvariantProjections");
+    if (AreMatricesAllocated())
+        LogicError("HoistLoopInvariantProjections: The network must be rewritten before its matrices are allocated.");
+
+    map<ComputationNodeBasePtr, shared_ptr<SEQTraversalFlowControlNode>> loopOf;
+    for (const auto& loop : m_allSEQNodes)
+        for (const auto& node : loop->m_nestedNodes)
+            loopOf[node] = loop;
+    auto isInLoop = [&](const ComputationNodeBasePtr& node, const shared_ptr<SEQTraversalFlowControlNode>& loop)
+    {
+        auto iter = loopOf.find(node);
+        return iter != loopOf.end() && iter->second == loop;
+    };
+
+    // find all candidates first, since the loops are discarded by the first rewrite
+    struct Candidate
+    {
+        ComputationNodeBasePtr times;
+        ComputationNodeBasePtr loopRoot;
+        size_t invariantBegin;  // range of RowStack inputs that do not depend on the loop
+        size_t invariantEnd;
+    };
+    vector<Candidate> candidates;
+    for (const auto& loop : m_allSEQNodes)
+    {
+        for (const auto& node : loop->m_nestedNodes)
+        {
+            auto times = dynamic_pointer_cast<TimesNode<ElemType>>(node);
+            if (!times || times->OutputRank() != 1 || times->InferInputRankToMap() != TimesNode<ElemType>::NoInferredInputRank)
+                continue;
+            const auto& weights = node->Input(0);
+            const auto& rowStack = node->Input(1);
+            auto rowStackNode = dynamic_pointer_cast<RowStackNode<ElemType>>(rowStack);
+            if (!rowStackNode || rowStackNode->GetSpliceDim() != 1 || rowStack->GetSampleLayout().GetRank() != 1 ||
+                weights->HasMBLayout() || weights->GetSampleLayout().GetRank() != 2)
+                continue;
+
+            size_t numInputs = rowStack->GetNumInputs();
+            vector<bool> invariant(numInputs);
+            for (size_t i = 0; i < numInputs; i++)
+                invariant[i] = !isInLoop(rowStack->Input(i), loop);
+            size_t numInvariant = count(invariant.begin(), invariant.end(), true);
+            size_t numLeading = find(invariant.begin(), invariant.end(), false) - invariant.begin();
+            size_t numTrailing = find(invariant.rbegin(), invariant.rend(), false) - invariant.rbegin();
+            if (numInvariant == 0 || numInvariant == numInputs)
+                continue;
+            else if (numLeading == numInvariant)
+                candidates.push_back({ node, loop->m_sourceNode, 0, numLeading });
+            else if (numTrailing == numInvariant)
+                candidates.push_back({ node, loop->m_sourceNode, numInputs - numTrailing, numInputs });
+        }
+    }
+
+    size_t numHoisted = 0;
+    for (const auto& candidate : candidates)
+    {
+        const auto& times = candidate.times;
+        const auto weights = times->Input(0);
+        const auto rowStack = times->Input(1);
+        const wstring& name = times->NodeName();
+        size_t numInputs = rowStack->GetNumInputs();
+
+        bool namesExist = false;
+        for (const auto& suffix : { L".invariant", L".invariantWeights", L".invariantInput", L".recurrent", L".recurrentWeights", L".recurrentInput" })
+            namesExist |= NodeNameExists(name + suffix);
+        if (namesExist)
+            continue;
+
+        // the columns of W that multiply each RowStack input
+        vector<size_t> firstColumns(1, 0);
+        for (size_t i = 0; i < numInputs; i++)
+            firstColumns.push_back(firstColumns.back() + rowStack->Input(i)->GetSampleLayout().GetDimPadded(0));
+
+        // Times(Slice(W), RowStack inputs [begin, end))
+        auto partialProduct = [&](size_t begin, size_t end, const wstring& partName) -> ComputationNodeBasePtr
+        {
+            ComputationNodeBasePtr input = rowStack->Input(begin);
+            if (end - begin > 1)
+            {
+                input = AddNodeToNetWithElemType(New<RowStackNode<ElemType>>(m_deviceId, partName + L"Input"));
+                input->AttachInputs(vector<ComputationNodeBasePtr>(rowStack->GetInputs().begin() + begin, rowStack->GetInputs().begin() + end));
+            }
+            auto slice = AddNodeToNetWithElemType(New<SliceNode<ElemType>>(m_deviceId, partName + L"Weights",
+                                                                            vector<int>{ (int)firstColumns[begin] }, vector<int>{ (int)firstColumns[end] }, vector<int>{ 2 }));
+            slice->AttachInputs({ weights });
+            auto product = AddNodeToNetWithElemType(New<TimesNode<ElemType>>(m_deviceId, partName));
+            product->AttachInputs({ slice, input });
+            return product;
+        };
+
+        auto invariantProduct = partialProduct(candidate.invariantBegin, candidate.invariantEnd, name + L".invariant");
+        auto recurrentProduct = candidate.invariantBegin == 0 ? partialProduct(candidate.invariantEnd, numInputs, name + L".recurrent")
+                                                              : partialProduct(0, candidate.invariantBegin, name + L".recurrent");
+        auto plus = New<PlusNode<ElemType>>(m_deviceId, name);
+        plus->AttachInputs({ invariantProduct, recurrentProduct });
+        SubstituteNode(times, plus);
+
+        bool rowStackIsUsed = !CreateParentsMap()[rowStack].empty();
+        for (auto group : GetAllNodeGroups())
+            rowStackIsUsed |= find(group->begin(), group->end(), rowStack) != group->end();
+        if (!rowStackIsUsed)
+            DeleteNode(rowStack->NodeName());
+
+        if (TraceLevel() > 0)
+            fprintf(stderr, "HoistLoopInvariantProjections: moved the product of %ls with %d of the %d inputs of %ls out of the loop at %ls.\n",
+                    weights->NodeName().c_str(), (int)(candidate.invariantEnd - candidate.invariantBegin), (int)numInputs,
+                    rowStack->NodeName().c_str(), candidate.loopRoot->NodeName().c_str());
+        numHoisted++;
+    }
+
+    if (numHoisted > 0)
+        CompileNetwork();
+    return numHoisted;
+}
+
+template size_t ComputationNetwork::HoistLoopInvariantProjections<float>();
+template size_t ComputationNetwork::HoistLoopInvariantProjections<double>();
+
 }}}
@@ -205,6 +205,31 @@ void ComputationNetwork::ReplaceNode(wstring nodeName, ComputationNodeBasePtr ne
     }
 }
 
+// replace oldNode by newNode, which comes with its own inputs, including moving over all links to oldNode and its node group memberships
+// Unlike ReplaceNode(), the inputs of oldNode are not carried over; oldNode is detached from them instead.
+// newNode must have the same name as oldNode, so that the network can still be addressed by the same names.
+void ComputationNetwork::SubstituteNode(ComputationNodeBasePtr oldNode, ComputationNodeBasePtr newNode)
+{
+    if (newNode->NodeName() != oldNode->NodeName())
+        InvalidArgument("SubstituteNode: newNode must have the same name as the old node.");
+
+    InvalidateCompiledNetwork();
+
+    ChangeNodeInputs(oldNode, newNode);
+
+    RemoveNodeFromNet(oldNode);
+    oldNode->DetachInputs();
+    AddNodeToNet(newNode);
+
+    for (auto groupIter : GetAllNodeGroups())
+    {
+        auto& group = *groupIter;
+        for (int i = 0; i < group.size(); i++)
+            if (group[i] == oldNode)
+                group[i] = newNode;
+    }
+}
+
 // Inserts a newNode such that the inputNodeName serves as the input to the newNode
 // Prior to this call, inputNodeName should be set as the input to newNode.
 void ComputationNetwork::InsertNode(wstring inputNodeName, ComputationNodeBasePtr newNode, const std::set<std::wstring>& newNodeTags)
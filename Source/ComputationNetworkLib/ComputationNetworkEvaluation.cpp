@@ -11,6 +11,9 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#ifndef CNTK_UWP
+#include "PerformanceProfiler.h"
+#endif
 #include <string>
 #include <vector>
 #include <list>
@@ -481,6 +484,10 @@ void ComputationNetwork::InvalidateCompiledNetwork()
     m_nestedNetworks.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
+    m_canonicalOrder.clear();
+    m_compiledPlanKey = 0;
+    m_compiledPlan.reset();
+    m_isCompiledFromPlan = false;
 }
 
 // verify that network has undergone CompileNetwork()
@@ -516,9 +523,14 @@ void ComputationNetwork::CompileNetwork()
     // Note: Steps below are loops over root nodes. We will gradually push those loops through to the functions,
     //       to reduce redundant operation on shared portions of the network.
 
+    // STEP: Look up the plan of a network with the same structure, which holds the outcome of the analysis below.
+    if (Globals::ShouldCacheCompiledPlans() && FormCanonicalOrder())
+        RestoreFromCompiledPlan();
+
     // STEP: Create a depth-first tree-traversal order through complete graph.
     // TODO: Do not cache this before reordering; get list & pass to FormRecurrentLoops() which reorders it, then store it (such that GetEvalOrder(nullptr) is always valid w.r.t. loops).
-    FormEvalOrder(nullptr);
+    if (!m_compiledPlan)
+        FormEvalOrder(nullptr);
 
     // STEP: Form the m_inputValues and m_learnableParameters sets for the entire network.
     // Needed for ResetMBLayouts() below.
@@ -531,7 +543,8 @@ void ComputationNetwork::CompileNetwork()
     ResetMBLayouts();
 
     // STEP: Discover nested loops.
-    FormRecurrentLoops();
+    if (!m_compiledPlan)
+        FormRecurrentLoops();
 
     // STEP: Create loop-corrected depth-first traversals and cached input/parameter sets for every actual root node.
     for (auto& root : m_allRoots)
@@ -545,7 +558,15 @@ void ComputationNetwork::CompileNetwork()
         FormNestedNetwork(node);
 
     // STEP: Infer node dimensions.
-    ValidateNetwork();
+    // A cached plan may have been recorded from a network that differs in node attributes not covered by its key.
+    // Then the validation from scratch replaces it.
+    m_isCompiledFromPlan = m_compiledPlan && ValidateNetworkFromPlan();
+    if (!m_isCompiledFromPlan)
+    {
+        ValidateNetwork();
+        if (m_compiledPlanKey != 0)
+            RecordCompiledPlan();
+    }
 
     // STEP: Optimize the network.
     // :)
@@ -709,6 +730,12 @@ void ComputationNetwork::ValidateNetwork()
     if (toValidate != 0)
         LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
 
+    FinalizeValidation(nodes);
+}
+
+// checks and updates common to ValidateNetwork() and ValidateNetworkFromPlan()
+void ComputationNetwork::FinalizeValidation(const list<ComputationNodeBasePtr>& nodes)
+{
     // propagate some info to SEQTraversalFlowControlNode
     // TODO: In the future we should validate not on the flat list but the PARTraversalFlowControlNode structure. Then this will be unnecessary.
     for (auto& recInfo : m_allSEQNodes)
@@ -1064,6 +1091,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     if (AreMatricesAllocated())
         return;
 
+#ifndef CNTK_UWP
+    ScopeProfile profileAllocation("Allocate Matrices", profilerCatMemory);
+#endif
+
     // Allocate memory for forward/backward computation
     if (TraceLevel() > 0)
         fprintf(stderr, "\n\nAllocating matrices for forward and/or backward propagation.\n");
@@ -1154,6 +1185,14 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     m_matrixPool.Reset();
 
+    // the buffer assignment of a network with the same plan and roots is replayed, if the requests below match it
+    uint64_t allocationPlanKey = 0;
+    if (m_compiledPlan)
+    {
+        allocationPlanKey = AllocationPlanKey(forwardPropRoots, trainRootNode);
+        PrepareAllocationFromPlan(allocationPlanKey);
+    }
+
     TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, this](const ComputationNodeBasePtr& node) {
         if (node->Is<SEQTraversalFlowControlNode>())
         {
@@ -1264,7 +1303,9 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
-    m_matrixPool.OptimizedMemoryAllocation(); 
+    m_isAllocationPlanReplayed = m_matrixPool.OptimizedMemoryAllocation() && m_compiledPlan;
+    if (m_compiledPlan && !m_isAllocationPlanReplayed)
+        RecordAllocationPlan(allocationPlanKey);
     m_areMatricesAllocated = true;
 
     // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
@@ -0,0 +1,997 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputationNetworkOptimization.cpp -- inference-time rewrites and budgeted compression of a loaded network
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
+#include "NonlinearityNodes.h"
+#include "TrainingNodes.h"
+#include "MatrixPool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+static vector<ElemType> ValuesOf(const ComputationNodeBasePtr& node)
+{
+    const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    vector<ElemType> result(value.GetNumElements());
+    ElemType* data = result.data();
+    size_t size = result.size();
+    value.CopyToArray(data, size);
+    return result;
+}
+
+template <class ElemType>
+static void SetValuesOf(const ComputationNodeBasePtr& node, vector<ElemType>& values)
+{
+    auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), values.data());
+}
+
+static bool IsParameter(const ComputationNodeBasePtr& node)
+{
+    return node->OperationName() == OperationNameOf(LearnableParameter);
+}
+
+// compares two shapes, not counting trailing singleton dimensions (e.g. [32] and [32 x 1])
+static bool HaveSameDims(const TensorShape& a, const TensorShape& b)
+{
+    size_t rank = max(a.GetRank(), b.GetRank());
+    for (size_t k = 0; k < rank; k++)
+        if ((k < a.GetRank() ? a[k] : 1) != (k < b.GetRank() ? b[k] : 1))
+            return false;
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// OptimizeForInference() -- rewrite the network for inference of the given outputs
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+ComputationNetwork::InferenceOptimizationStats ComputationNetwork::OptimizeForInference(const std::vector<std::wstring>& outputNodeNames)
+{
+    VerifyIsCompiled("OptimizeForInference");
+    if (AreMatricesAllocated())
+        LogicError("OptimizeForInference: The network must be optimized before its matrices are allocated.");
+
+    // Nodes are substituted along the way, so the outputs are tracked by name.
+    vector<wstring> outputNames;
+    for (const auto& node : OutputNodesByName(outputNodeNames))
+        outputNames.push_back(node->NodeName());
+
+    InferenceOptimizationStats stats = {};
+    stats.m_numNodesBefore = GetTotalNumberOfNodes();
+
+    PruneNodesNotFeeding(OutputNodesByName(outputNames));
+
+    for (const auto& node : GetAllNodes())
+    {
+        // (a node folded earlier in this loop may have taken its input with it)
+        if (NodeNameExists(node->NodeName()) && TryFoldBatchNormalization<ElemType>(node, outputNames))
+            stats.m_numFoldedBatchNormalizations++;
+    }
+    CompileNetwork();
+
+    stats.m_numFoldedConstants = FoldConstantSubgraphs<ElemType>(OutputNodesByName(outputNames), outputNames);
+
+    // (after constant folding, which turns computed biases into parameters)
+    for (const auto& node : GetAllNodes())
+    {
+        if (NodeNameExists(node->NodeName()) && TryFuseConvolution<ElemType>(node, outputNames))
+            stats.m_numFusedConvolutions++;
+    }
+
+    PruneNodesNotFeeding(OutputNodesByName(outputNames));
+    CompileNetwork();
+
+    stats.m_numNodesAfter = GetTotalNumberOfNodes();
+    fprintf(stderr, "OptimizeForInference: %d nodes -> %d nodes (%d eliminated); folded %d BatchNormalization nodes and %d constant subgraphs, fused %d convolutions.\n",
+            (int)stats.m_numNodesBefore, (int)stats.m_numNodesAfter, (int)(stats.m_numNodesBefore - stats.m_numNodesAfter),
+            (int)stats.m_numFoldedBatchNormalizations, (int)stats.m_numFoldedConstants, (int)stats.m_numFusedConvolutions);
+    return stats;
+}
+
+// deletes all nodes that none of the rootNodes depends on, also from the node groups
+// Returns the number of deleted nodes.
+size_t ComputationNetwork::PruneNodesNotFeeding(const std::vector<ComputationNodeBasePtr>& rootNodes)
+{
+    set<ComputationNodeBasePtr> used;
+    vector<ComputationNodeBasePtr> stack(rootNodes.begin(), rootNodes.end());
+    while (!stack.empty())
+    {
+        auto node = stack.back();
+        stack.pop_back();
+        if (!node || !used.insert(node).second)
+            continue;
+        for (const auto& input : node->GetInputs())
+            stack.push_back(input);
+    }
+
+    vector<wstring> unused;
+    for (const auto& iter : m_nameToNodeMap)
+        if (used.find(iter.second) == used.end())
+            unused.push_back(iter.first);
+
+    for (const auto& name : unused)
+        DeleteNode(name);
+    return unused.size();
+}
+
+// a node whose value is requested: one of the given outputs, or a member of the output, criterion or evaluation group
+// Rewrites may substitute such a node by one with the same name and value, but must not rescale or delete it.
+bool ComputationNetwork::IsNetworkOutput(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames) const
+{
+    if (find(outputNodeNames.begin(), outputNodeNames.end(), node->NodeName()) != outputNodeNames.end())
+        return true;
+    for (const auto* group : { &m_outputNodes, &m_criterionNodes, &m_evaluationNodes })
+        if (find(group->begin(), group->end(), node) != group->end())
+            return true;
+    return false;
+}
+
+// BatchNormalization(Convolution(W, x)) or BatchNormalization(Times(W, x)), optionally with a Plus(., b) in between,
+// is in inference y = scale .* (W x + b - runMean) ./ sqrt(runVariance + epsilon) + bias.
+// With s = scale ./ sqrt(runVariance + epsilon), this is (s .* W) x + (bias + s .* (b - runMean)),
+// so W is scaled in place and the BatchNormalization node is substituted by a Plus node with the combined bias.
+// This requires that W (and the intermediate nodes) are used by nothing else and are no outputs, and that the normalization
+// factors do not vary where W is shared (i.e. a Convolution must be followed by a spatial BatchNormalization).
+template <class ElemType>
+bool ComputationNetwork::TryFoldBatchNormalization(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames)
+{
+    auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+    if (!bn)
+        return false;
+    const auto& bnInputs = node->GetInputs(); // data, scale, bias, runMean, runVariance[, runCount]
+
+    auto parents = CreateParentsMap();
+    auto isOnlyUsedBy = [&](const ComputationNodeBasePtr& input, const ComputationNodeBasePtr& user)
+    {
+        const auto& inputParents = parents[input];
+        return inputParents.size() == 1 && *inputParents.begin() == user && !IsNetworkOutput(input, outputNodeNames);
+    };
+
+    ComputationNodeBasePtr linear = bnInputs[0];
+    ComputationNodeBasePtr bias; // b, if any
+    if (linear->OperationName() == OperationNameOf(PlusNode))
+    {
+        if (!IsParameter(linear->Input(1)) || !isOnlyUsedBy(linear, bn))
+            return false;
+        bias = linear->Input(1);
+        if (!isOnlyUsedBy(linear->Input(0), linear))
+            return false;
+        linear = linear->Input(0);
+    }
+    else if (!isOnlyUsedBy(linear, bn))
+        return false;
+
+    bool isConvolution = linear->OperationName() == OperationNameOf(ConvolutionNode);
+    if (isConvolution)
+    {
+        auto conv = dynamic_pointer_cast<ConvolutionNode<ElemType>>(linear);
+        if (!conv || conv->Transpose() || conv->ImageLayout() != ImageLayoutKind::CHW)
+            return false;
+    }
+    else if (linear->OperationName() != OperationNameOf(TimesNode))
+        return false;
+
+    ComputationNodeBasePtr weights = linear->Input(0);
+    if (!IsParameter(weights) || !isOnlyUsedBy(weights, linear))
+        return false;
+    for (size_t i = 1; i < bnInputs.size(); i++)
+        if (!IsParameter(bnInputs[i]))
+            return false;
+
+    // Output element i of 'linear' is normalized by factor i / (outputSize / numFactors).
+    const auto& outputLayout = linear->GetSampleLayout();
+    size_t outputSize = outputLayout.GetNumElements();
+    size_t numFactors = bnInputs[1]->GetSampleLayout().GetNumElements();
+    if (numFactors == 0 || outputSize % numFactors != 0)
+        return false;
+    if (bn->Spatial() ? outputLayout.GetDims().back() != numFactors : numFactors != outputSize)
+        return false;
+    if (isConvolution && outputLayout.GetDims().back() != numFactors)
+        return false;
+
+    // the shape of the combined bias, which broadcasts over all but the channel axis in the spatial case
+    TensorShape biasShape = outputLayout;
+    if (numFactors != outputSize)
+    {
+        SmallVector<size_t> dims(outputLayout.GetRank(), 1);
+        dims.back() = numFactors;
+        biasShape = TensorShape(dims);
+    }
+    if (bias && (bias->GetSampleLayout().GetNumElements() != numFactors || !HaveSameDims(bias->GetSampleLayout(), biasShape)))
+        return false;
+
+    size_t weightsSize = weights->GetSampleLayout().GetNumElements();
+    // Convolution kernels have the output channel as their slowest axis; Times weights are a column-major [outputSize x inputSize] matrix.
+    if (isConvolution ? weightsSize % numFactors != 0 : weightsSize % outputSize != 0)
+        return false;
+
+    wstring biasName = bn->NodeName() + L".foldedBias";
+    if (NodeNameExists(biasName))
+        return false;
+
+    auto scale       = ValuesOf<ElemType>(bnInputs[1]);
+    auto shift       = ValuesOf<ElemType>(bnInputs[2]);
+    auto runMean     = ValuesOf<ElemType>(bnInputs[3]);
+    auto runVariance = ValuesOf<ElemType>(bnInputs[4]);
+    vector<ElemType> b = bias ? ValuesOf<ElemType>(bias) : vector<ElemType>(numFactors, 0);
+
+    vector<double> factors(numFactors);
+    vector<ElemType> foldedBias(numFactors);
+    for (size_t c = 0; c < numFactors; c++)
+    {
+        factors[c] = scale[c] / sqrt((double)runVariance[c] + bn->Epsilon());
+        foldedBias[c] = (ElemType)(shift[c] + factors[c] * ((double)b[c] - runMean[c]));
+    }
+
+    auto w = ValuesOf<ElemType>(weights);
+    size_t outputsPerFactor = outputSize / numFactors;
+    size_t weightsPerFactor = weightsSize / numFactors;
+    for (size_t k = 0; k < weightsSize; k++)
+    {
+        size_t c = isConvolution ? k / weightsPerFactor : (k % outputSize) / outputsPerFactor;
+        w[k] = (ElemType)(w[k] * factors[c]);
+    }
+    SetValuesOf(weights, w);
+
+    auto foldedBiasNode = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, biasName, biasShape));
+    InitLearnableParameters(foldedBiasNode, L"fixedValue", 0); // follow the protocol; otherwise deferred initialization will overwrite the values in validation
+    SetValuesOf(foldedBiasNode, foldedBias);
+
+    auto plus = New<PlusNode<ElemType>>(m_deviceId, bn->NodeName());
+    plus->AttachInputs({ linear, foldedBiasNode });
+    SubstituteNode(bn, plus);
+
+    fprintf(stderr, "OptimizeForInference: folded %ls into the weights of %ls %ls operation.\n",
+            plus->NodeName().c_str(), linear->NodeName().c_str(), linear->OperationName().c_str());
+    return true;
+}
+
+// Convolution(W, x) + b, optionally followed by a ReLU, Sigmoid or Tanh, becomes a FusedConvolution node
+// that adds the bias and applies the activation as the convolution outputs are stored.
+// b must be a LearnableParameter with one value per output channel, and the intermediate nodes must be used by
+// nothing else and be no outputs. The fused node takes the name of the last node it replaces; the others are deleted.
+template <class ElemType>
+bool ComputationNetwork::TryFuseConvolution(const ComputationNodeBasePtr& node, const std::vector<std::wstring>& outputNodeNames)
+{
+    auto conv = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node);
+    if (!conv || conv->Transpose() || conv->IsConvolution2D() || conv->ImageLayout() != ImageLayoutKind::CHW || conv->Groups() != 1)
+        return false;
+    const auto& dilation = conv->Dilation();
+    for (size_t k = 0; k < dilation.GetRank(); k++)
+        if (dilation[k] != 1)
+            return false;
+
+    auto parents = CreateParentsMap();
+    auto soleUser = [&](const ComputationNodeBasePtr& input) -> ComputationNodeBasePtr
+    {
+        const auto& inputParents = parents[input];
+        return inputParents.size() == 1 && !IsNetworkOutput(input, outputNodeNames) ? *inputParents.begin() : nullptr;
+    };
+
+    ComputationNodeBasePtr plus = soleUser(node);
+    if (!plus || plus->OperationName() != OperationNameOf(PlusNode) || plus->Input(0) != node || !IsParameter(plus->Input(1)))
+        return false;
+
+    // the bias must broadcast over all but the channel axis
+    ComputationNodeBasePtr bias = plus->Input(1);
+    const auto& outputLayout = node->GetSampleLayout();
+    size_t numChannels = outputLayout.GetDims().back();
+    SmallVector<size_t> biasDims(outputLayout.GetRank(), 1);
+    biasDims.back() = numChannels;
+    if (bias->GetSampleLayout().GetNumElements() != numChannels || !HaveSameDims(bias->GetSampleLayout(), TensorShape(biasDims)))
+        return false;
+
+    ComputationNodeBasePtr last = plus;
+    FusedActivationKind activation = FusedActivationKind::None;
+    ComputationNodeBasePtr user = soleUser(plus);
+    if (user)
+    {
+        if (user->OperationName() == OperationNameOf(RectifiedLinearNode))
+            activation = FusedActivationKind::ReLU;
+        else if (user->OperationName() == OperationNameOf(SigmoidNode))
+            activation = FusedActivationKind::Sigmoid;
+        else if (user->OperationName() == OperationNameOf(TanhNode))
+            activation = FusedActivationKind::Tanh;
+        if (activation != FusedActivationKind::None)
+            last = user;
+    }
+
+    auto fused = New<FusedConvolutionNode<ElemType>>(m_deviceId, last->NodeName(), conv->KernelShape(), conv->MapCount(), conv->Strides(),
+                                                     conv->Sharing(), conv->AutoPad(), conv->LowerPad(), conv->UpperPad(),
+                                                     conv->MaxTempMemSizeInSamples(), activation);
+    fused->AttachInputs({ node->Input(0), node->Input(1), bias });
+    SubstituteNode(last, fused);
+    if (last != plus)
+        DeleteNode(plus->NodeName());
+    DeleteNode(node->NodeName());
+
+    fprintf(stderr, "OptimizeForInference: fused %ls %ls operation with its bias%ls into %ls.\n",
+            node->NodeName().c_str(), node->OperationName().c_str(), last != plus ? L" and activation" : L"", fused->NodeName().c_str());
+    return true;
+}
+
+// replaces each maximal subgraph that only depends on LearnableParameters by a LearnableParameter that holds its value
+// Nodes that have a dynamic axis, state, or randomness are never constant, and outputs are left as they are.
+// Returns the number of replaced subgraphs.
+template <class ElemType>
+size_t ComputationNetwork::FoldConstantSubgraphs(const std::vector<ComputationNodeBasePtr>& rootNodes, const std::vector<std::wstring>& outputNodeNames)
+{
+    // determine the constant nodes, inputs first
+    map<ComputationNodeBasePtr, bool> isConstant;
+    vector<ComputationNodeBasePtr> constantNodes; // non-leaf ones, in evaluation order
+    function<bool(const ComputationNodeBasePtr&)> visit = [&](const ComputationNodeBasePtr& node) -> bool
+    {
+        auto iter = isConstant.find(node);
+        if (iter != isConstant.end())
+            return iter->second;
+        isConstant[node] = false; // (loops are not constant)
+
+        bool constant;
+        if (node->IsLeaf())
+            constant = IsParameter(node);
+        else
+        {
+            constant = !node->HasMBLayout() &&
+                       dynamic_pointer_cast<ComputationNode<ElemType>>(node) &&
+                       !dynamic_cast<IStatefulNode*>(node.get()) &&
+                       !dynamic_cast<IRngUser*>(node.get()) &&
+                       !dynamic_cast<MultiOutputNode<ElemType>*>(node.get()) &&
+                       !node->RequiresPreCompute() &&
+                       node->OperationName() != OperationNameOf(BatchNormalizationNode) &&
+                       !IsNetworkOutput(node, outputNodeNames);
+            for (const auto& input : node->GetInputs())
+                constant &= visit(input); // (visit all inputs, to get the order right)
+            if (constant)
+                constantNodes.push_back(node);
+        }
+        return isConstant[node] = constant;
+    };
+    for (const auto& root : rootNodes)
+        visit(root);
+
+    if (constantNodes.empty())
+        return 0;
+
+    // the subgraphs end in constant nodes that are used by non-constant ones, or are roots themselves
+    set<ComputationNodeBasePtr> subgraphRoots(rootNodes.begin(), rootNodes.end());
+    for (const auto& iter : isConstant)
+        if (!iter.second)
+            for (const auto& input : iter.first->GetInputs())
+                subgraphRoots.insert(input);
+
+    // evaluate them once, with matrices that are not shared with anything else
+    auto previousMode = Environment().SetOperationMode(NetworkOperationMode::inferring);
+    MatrixPool matrixPool;
+    for (const auto& node : constantNodes)
+    {
+        node->MarkValueNonSharable();
+        node->RequestMatricesBeforeForwardProp(matrixPool);
+    }
+    matrixPool.OptimizedMemoryAllocation();
+    for (const auto& node : constantNodes)
+    {
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(nullptr));
+        node->EndForwardProp();
+        node->BumpEvalTimeStamp();
+    }
+    Environment().SetOperationMode(previousMode);
+
+    size_t numFolded = 0;
+    for (const auto& node : constantNodes)
+    {
+        if (subgraphRoots.find(node) == subgraphRoots.end())
+            continue;
+
+        ComputationNodeBasePtr parameter = New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName(), node->GetSampleLayout());
+        InitLearnableParameters(parameter, L"fixedValue", 0);
+        auto values = ValuesOf<ElemType>(node);
+        SetValuesOf(parameter, values);
+        parameter->SetLearningRateMultiplier(0);
+        SubstituteNode(node, parameter);
+        numFolded++;
+    }
+    return numFolded;
+}
+
+// -----------------------------------------------------------------------
+// CompressForBudget() -- shrink Times and Convolution layers to meet a latency or FLOP budget
+// -----------------------------------------------------------------------
+
+// A layer that CompressForBudget() can shrink: a Times node by keeping m_size singular values of its weights,
+// or a Convolution node by keeping m_size of its filters (and the matching input channels of the next Convolution).
+struct ComputationNetwork::CompressionCandidate
+{
+    bool m_isChannelPruning;
+    wstring m_nodeName;           // the Times node, or the Convolution whose filters are pruned
+    wstring m_nextName;           // the Convolution that consumes the pruned channels
+    vector<wstring> m_chainNames; // the channel-wise nodes in between
+    size_t m_rows, m_cols;        // of the weights of a Times node
+    size_t m_fullSize;            // rank of the weights, or number of filters
+    vector<size_t> m_sizes;       // the sizes that save operations, in decreasing order
+    vector<double> m_errors;      // relative error when keeping the first k singular values or filters, for k = 0..m_fullSize
+    vector<size_t> m_ranking;     // filters by decreasing importance
+    double m_flops, m_nextFlops;  // per sample, of the (first) node and of the next Convolution
+    double m_latency, m_nextLatency;
+    int m_inputPruning;           // index of the candidate that prunes the input channels of the first Convolution, or -1
+    int m_outputPruning;          // index of the candidate that prunes the filters of the next Convolution, or -1
+    size_t m_size;                // current choice
+};
+
+typedef map<ComputationNodeBasePtr, set<ComputationNodeBasePtr>> ParentsMap;
+
+// the only node that uses 'node', or nullptr
+static ComputationNodeBasePtr SoleUserOf(const ComputationNodeBasePtr& node, const ParentsMap& parents)
+{
+    auto iter = parents.find(node);
+    return iter != parents.end() && iter->second.size() == 1 ? *iter->second.begin() : nullptr;
+}
+
+// the value of a per-axis setting for the given axis, where a single value applies to all axes
+static size_t DimOf(const TensorShape& shape, size_t axis, size_t defaultValue)
+{
+    if (shape.GetRank() == 1)
+        return shape[0];
+    return axis < shape.GetRank() ? shape[axis] : defaultValue;
+}
+
+static bool FlagOf(const vector<bool>& flags, size_t axis)
+{
+    if (flags.size() == 1)
+        return flags[0];
+    return axis < flags.size() && flags[axis];
+}
+
+static TensorShape WithDim(const TensorShape& shape, size_t axis, size_t dim)
+{
+    auto dims = shape.GetDims();
+    dims[axis] = dim;
+    return TensorShape(dims);
+}
+
+// the axis of a shape with one value per channel (e.g. [1 x 1 x C])
+static size_t ChannelAxisOf(const TensorShape& shape, size_t numChannels)
+{
+    for (size_t k = shape.GetRank(); k-- > 0;)
+        if (shape[k] == numChannels)
+            return k;
+    LogicError("ChannelAxisOf: No axis of [%s] has %d channels.", string(shape).c_str(), (int)numChannels);
+}
+
+// keeps the given channels of a tensor that is laid out as [inner x numChannels x outer]
+template <class ElemType>
+static vector<ElemType> KeepChannels(const vector<ElemType>& values, size_t inner, size_t numChannels, const vector<size_t>& channels)
+{
+    size_t outer = values.size() / (inner * numChannels);
+    vector<ElemType> result;
+    result.reserve(inner * channels.size() * outer);
+    for (size_t o = 0; o < outer; o++)
+    {
+        for (size_t c : channels)
+        {
+            auto begin = values.begin() + (o * numChannels + c) * inner;
+            result.insert(result.end(), begin, begin + inner);
+        }
+    }
+    return result;
+}
+
+// fraction of the total that is discarded when keeping the first k parts, for k = 0..parts.size()
+static vector<double> DiscardedFractions(const vector<double>& squaredNorms)
+{
+    vector<double> result(squaredNorms.size() + 1, 0);
+    for (size_t k = squaredNorms.size(); k-- > 0;)
+        result[k] = result[k + 1] + squaredNorms[k];
+    double total = result[0];
+    for (auto& fraction : result)
+        fraction = total > 0 ? fraction / total : 0;
+    return result;
+}
+
+// SVD of the matrix held by a rank-2 LearnableParameter, computed on the CPU
+template <class ElemType>
+static void SVDOf(const ComputationNodeBasePtr& weights, Matrix<ElemType>& S, Matrix<ElemType>& U, Matrix<ElemType>& VT)
+{
+    auto values = ValuesOf<ElemType>(weights);
+    const auto& shape = weights->GetSampleLayout();
+    Matrix<ElemType> A(shape[0], shape[1], values.data(), CPUDEVICE);
+    Matrix<ElemType> W(CPUDEVICE);
+    Matrix<ElemType>::SVD(A, S, U, VT, W);
+}
+
+// number of floating point operations per sample of a Times or Convolution node, 0 for other nodes
+template <class ElemType>
+static double FlopsPerSample(const ComputationNodeBasePtr& node)
+{
+    if (node->OperationName() == OperationNameOf(TimesNode) && !node->Input(0)->HasMBLayout())
+    {
+        // A product that reduces over K of the input elements has output = (weights / K) * (input / K) elements,
+        // each taking 2K operations, hence 2 * output * K = 2 * sqrt(output * weights * input).
+        return 2 * sqrt((double)node->GetSampleLayout().GetNumElements() * node->Input(0)->GetSampleLayout().GetNumElements() *
+                        node->Input(1)->GetSampleLayout().GetNumElements());
+    }
+    auto conv = dynamic_pointer_cast<ConvolutionNodeBase<ElemType>>(node);
+    if (conv && (node->OperationName() == OperationNameOf(ConvolutionNode) || node->OperationName() == OperationNameOf(FusedConvolutionNode)))
+    {
+        const auto& positions = conv->Transpose() ? node->Input(1)->GetSampleLayout() : node->GetSampleLayout();
+        return 2.0 * positions.GetNumElements() * conv->KernelShape().GetNumElements();
+    }
+    return 0;
+}
+
+// a Convolution whose weights are a [kernel x filters] LearnableParameter used by nothing else, and whose
+// kernel covers all input channels, so that filters and input channels can be removed
+template <class ElemType>
+static bool IsPrunableConvolution(const ComputationNodeBasePtr& node, const ParentsMap& parents)
+{
+    auto conv = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node);
+    if (!conv || conv->Transpose() || conv->IsConvolution2D() || conv->ImageLayout() != ImageLayoutKind::CHW || conv->Groups() != 1 || node->IsPartOfLoop())
+        return false;
+    const auto& dilation = conv->Dilation();
+    for (size_t k = 0; k < dilation.GetRank(); k++)
+        if (dilation[k] != 1)
+            return false;
+
+    ComputationNodeBasePtr weights = node->Input(0);
+    if (!IsParameter(weights) || SoleUserOf(weights, parents) != node)
+        return false;
+
+    const auto& kernel = conv->KernelShape();
+    const auto& inputLayout = node->Input(1)->GetSampleLayout();
+    size_t axis = inputLayout.GetRank() - 1;
+    if (kernel.GetRank() != inputLayout.GetRank() || kernel[axis] != inputLayout[axis] ||
+        FlagOf(conv->AutoPad(), axis) || DimOf(conv->LowerPad(), axis, 0) != 0 || DimOf(conv->UpperPad(), axis, 0) != 0)
+        return false;
+
+    size_t numFilters = conv->MapCount().GetNumElements();
+    const auto& weightsLayout = weights->GetSampleLayout();
+    return weightsLayout.GetRank() > 2 && weightsLayout.GetDims().back() == numFilters &&
+           weightsLayout.GetNumElements() == kernel.GetNumElements() * numFilters &&
+           node->GetSampleLayout().GetDims().back() == numFilters;
+}
+
+// a LearnableParameter with one value per channel that is used by nothing but 'user'
+static bool IsPerChannelParameter(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& user, const ParentsMap& parents, size_t numChannels)
+{
+    return IsParameter(node) && SoleUserOf(node, parents) == user && node->GetSampleLayout().GetNumElements() == numChannels;
+}
+
+// whether 'node' processes its first input channel by channel, with any parameters it takes being per-channel
+// ones that nothing else uses (such that channels can be removed)
+template <class ElemType>
+static bool IsChannelWise(const ComputationNodeBasePtr& node, const ParentsMap& parents, size_t numChannels)
+{
+    const auto& operation = node->OperationName();
+    if (operation == OperationNameOf(RectifiedLinearNode) || operation == OperationNameOf(SigmoidNode) ||
+        operation == OperationNameOf(TanhNode) || operation == OperationNameOf(DropoutNode))
+        return true;
+
+    size_t axis = node->Input(0)->GetSampleLayout().GetRank() - 1;
+    if (operation == OperationNameOf(PlusNode))
+    {
+        SmallVector<size_t> biasDims(axis + 1, 1);
+        biasDims.back() = numChannels;
+        return IsPerChannelParameter(node->Input(1), node, parents, numChannels) && HaveSameDims(node->Input(1)->GetSampleLayout(), TensorShape(biasDims));
+    }
+    if (operation == OperationNameOf(BatchNormalizationNode))
+    {
+        // scale, bias, runMean, runVariance (the runCount is a scalar)
+        auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+        if (!bn || !bn->Spatial())
+            return false;
+        for (size_t i = 1; i <= 4; i++)
+            if (!IsPerChannelParameter(node->Input(i), node, parents, numChannels))
+                return false;
+        return true;
+    }
+    if (operation == OperationNameOf(PoolingNode))
+    {
+        auto pooling = dynamic_pointer_cast<ConvolutionNodeBase<ElemType>>(node);
+        return pooling && DimOf(pooling->KernelShape(), axis, 1) == 1 && DimOf(pooling->Strides(), axis, 1) == 1 &&
+               DimOf(pooling->LowerPad(), axis, 0) == 0 && DimOf(pooling->UpperPad(), axis, 0) == 0;
+    }
+    return false;
+}
+
+// Times(W, x) with a matrix W that nothing else uses
+template <class ElemType>
+bool ComputationNetwork::TryGetLowRankCandidate(const ComputationNodeBasePtr& node, const ParentsMap& parents, CompressionCandidate& candidate)
+{
+    if (node->OperationName() != OperationNameOf(TimesNode))
+        return false;
+    ComputationNodeBasePtr weights = node->Input(0);
+    const auto& weightsLayout = weights->GetSampleLayout();
+    if (!IsParameter(weights) || SoleUserOf(weights, parents) != node || weightsLayout.GetRank() != 2)
+        return false;
+
+    size_t m = weightsLayout[0], n = weightsLayout[1];
+    size_t inputSize = node->Input(1)->GetSampleLayout().GetNumElements();
+    if (m < 2 || n < 2 || inputSize % n != 0 || node->GetSampleLayout().GetNumElements() != m * (inputSize / n))
+        return false;
+    const auto& name = weights->NodeName();
+    if (NodeNameExists(name + L"_U") || NodeNameExists(name + L"_V") || NodeNameExists(name + L"_SVD"))
+        return false;
+
+    Matrix<ElemType> S(CPUDEVICE), U(CPUDEVICE), VT(CPUDEVICE);
+    SVDOf<ElemType>(weights, S, U, VT);
+    vector<double> energies(S.GetNumRows());
+    for (size_t i = 0; i < energies.size(); i++)
+        energies[i] = (double)S(i, 0) * S(i, 0);
+
+    candidate.m_isChannelPruning = false;
+    candidate.m_nodeName = node->NodeName();
+    candidate.m_rows = m;
+    candidate.m_cols = n;
+    candidate.m_fullSize = energies.size();
+    candidate.m_errors = DiscardedFractions(energies);
+    candidate.m_flops = FlopsPerSample<ElemType>(node);
+    return true;
+}
+
+// Convolution(W1, x) followed by channel-wise nodes only, the last of which is the input of exactly one other
+// Convolution(W2, .). Filters of W1 are ranked by their norm, scaled by the factors of BatchNormalization nodes in between.
+template <class ElemType>
+bool ComputationNetwork::TryGetChannelPruningCandidate(const ComputationNodeBasePtr& node, const ParentsMap& parents,
+                                                       const set<ComputationNodeBasePtr>& outputNodes, CompressionCandidate& candidate)
+{
+    if (!IsPrunableConvolution<ElemType>(node, parents))
+        return false;
+    size_t numFilters = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node)->MapCount().GetNumElements();
+
+    vector<ComputationNodeBasePtr> chain;
+    ComputationNodeBasePtr last = node;
+    ComputationNodeBasePtr next;
+    while (!next)
+    {
+        // the channels of the outputs must not change
+        ComputationNodeBasePtr user = SoleUserOf(last, parents);
+        if (outputNodes.find(last) != outputNodes.end() || !user)
+            return false;
+        if (user->OperationName() == OperationNameOf(ConvolutionNode) && user->Input(1) == last && user->Input(0) != last)
+        {
+            if (!IsPrunableConvolution<ElemType>(user, parents) || dynamic_pointer_cast<ConvolutionNode<ElemType>>(user)->KernelShape().GetDims().back() != numFilters)
+                return false;
+            next = user;
+        }
+        else if (user->Input(0) == last && IsChannelWise<ElemType>(user, parents, numFilters))
+        {
+            for (size_t i = 1; i < user->GetNumInputs(); i++)
+                if (user->Input(i) == last)
+                    return false;
+            chain.push_back(user);
+            last = user;
+        }
+        else
+            return false;
+    }
+
+    auto w = ValuesOf<ElemType>(node->Input(0));
+    size_t kernelSize = w.size() / numFilters;
+    vector<double> importance(numFilters, 0);
+    for (size_t k = 0; k < w.size(); k++)
+        importance[k / kernelSize] += (double)w[k] * w[k];
+    for (const auto& chainNode : chain)
+    {
+        auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(chainNode);
+        if (!bn)
+            continue;
+        auto scale = ValuesOf<ElemType>(chainNode->Input(1));
+        auto runVariance = ValuesOf<ElemType>(chainNode->Input(4));
+        for (size_t c = 0; c < numFilters; c++)
+            importance[c] *= (double)scale[c] * scale[c] / ((double)runVariance[c] + bn->Epsilon());
+    }
+
+    vector<size_t> ranking(numFilters);
+    for (size_t c = 0; c < numFilters; c++)
+        ranking[c] = c;
+    stable_sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b) { return importance[a] > importance[b]; });
+    vector<double> rankedImportance;
+    for (size_t c : ranking)
+        rankedImportance.push_back(importance[c]);
+
+    candidate.m_isChannelPruning = true;
+    candidate.m_nodeName = node->NodeName();
+    candidate.m_nextName = next->NodeName();
+    candidate.m_chainNames.clear();
+    for (const auto& chainNode : chain)
+        candidate.m_chainNames.push_back(chainNode->NodeName());
+    candidate.m_fullSize = numFilters;
+    candidate.m_errors = DiscardedFractions(rankedImportance);
+    candidate.m_ranking = ranking;
+    candidate.m_flops = FlopsPerSample<ElemType>(node);
+    candidate.m_nextFlops = FlopsPerSample<ElemType>(next);
+    return true;
+}
+
+template <class ElemType>
+vector<ComputationNetwork::LayerCompressionStats> ComputationNetwork::CompressForBudget(const std::vector<std::wstring>& outputNodeNames, const CompressionBudget& budget)
+{
+    VerifyIsCompiled("CompressForBudget");
+    if (AreMatricesAllocated())
+        LogicError("CompressForBudget: The network must be compressed before its matrices are allocated.");
+    if (budget.m_alignment == 0)
+        InvalidArgument("CompressForBudget: The alignment must be at least 1.");
+    if (budget.m_latency > 0 && budget.m_profiledLatency <= 0)
+        InvalidArgument("CompressForBudget: A latency budget requires the profiled latency of the network.");
+
+    auto outputNodes = OutputNodesByName(outputNodeNames);
+    set<ComputationNodeBasePtr> protectedNodes(outputNodes.begin(), outputNodes.end());
+    for (const auto& node : OutputNodes())
+        protectedNodes.insert(node);
+
+    // collect the candidates, and the operations of the network
+    auto parents = CreateParentsMap();
+    auto latencyOf = [&](const wstring& name)
+    {
+        auto iter = budget.m_nodeLatencies.find(name);
+        return iter != budget.m_nodeLatencies.end() ? iter->second : 0;
+    };
+
+    vector<CompressionCandidate> candidates;
+    double flops = 0;
+    ExecutionGraph graph(outputNodes);
+    for (const auto& node : ::CNTK::PostOrderTraversal(graph, outputNodes))
+    {
+        flops += FlopsPerSample<ElemType>(node);
+
+        CompressionCandidate candidate;
+        if (TryGetLowRankCandidate<ElemType>(node, parents, candidate))
+        {
+            candidate.m_latency = latencyOf(candidate.m_nodeName);
+            // (only ranks for which the two factors are cheaper than the matrix)
+            for (size_t size = (candidate.m_fullSize - 1) / budget.m_alignment * budget.m_alignment; size > 0; size -= budget.m_alignment)
+                if (size * (candidate.m_rows + candidate.m_cols) < candidate.m_rows * candidate.m_cols)
+                    candidate.m_sizes.push_back(size);
+        }
+        else if (TryGetChannelPruningCandidate<ElemType>(node, parents, protectedNodes, candidate))
+        {
+            candidate.m_latency = latencyOf(candidate.m_nodeName);
+            candidate.m_nextLatency = latencyOf(candidate.m_nextName);
+            for (size_t size = (candidate.m_fullSize - 1) / budget.m_alignment * budget.m_alignment; size > 0; size -= budget.m_alignment)
+                candidate.m_sizes.push_back(size);
+        }
+        else
+            continue;
+
+        candidate.m_size = candidate.m_fullSize;
+        candidate.m_inputPruning = candidate.m_outputPruning = -1;
+        candidates.push_back(candidate);
+    }
+
+    // a Convolution can have its input channels pruned by one candidate and its filters by another
+    for (int i = 0; i < (int)candidates.size(); i++)
+    {
+        for (int j = 0; j < (int)candidates.size(); j++)
+        {
+            if (!candidates[i].m_isChannelPruning || !candidates[j].m_isChannelPruning)
+                continue;
+            if (candidates[j].m_nextName == candidates[i].m_nodeName)
+                candidates[i].m_inputPruning = j;
+            if (candidates[j].m_nodeName == candidates[i].m_nextName)
+                candidates[i].m_outputPruning = j;
+        }
+    }
+
+    // Latency is estimated from the profile, with the time of each node scaled by its remaining operations.
+    auto keptFraction = [&](int index)
+    {
+        return index < 0 ? 1.0 : (double)candidates[index].m_size / candidates[index].m_fullSize;
+    };
+    auto costOf = [&](const CompressionCandidate& candidate, size_t size, double& candidateFlops, double& candidateLatency)
+    {
+        if (!candidate.m_isChannelPruning)
+        {
+            double ratio = size < candidate.m_fullSize ? (double)size * (candidate.m_rows + candidate.m_cols) / ((double)candidate.m_rows * candidate.m_cols) : 1;
+            candidateFlops = candidate.m_flops * ratio;
+            candidateLatency = candidate.m_latency * ratio;
+        }
+        else
+        {
+            double ratio = (double)size / candidate.m_fullSize;
+            double firstRatio = ratio * keptFraction(candidate.m_inputPruning);
+            double nextRatio = ratio * keptFraction(candidate.m_outputPruning);
+            candidateFlops = candidate.m_flops * firstRatio + candidate.m_nextFlops * nextRatio;
+            candidateLatency = candidate.m_latency * firstRatio + candidate.m_nextLatency * nextRatio;
+        }
+    };
+
+    // Shrink greedily: each step takes the option with the smallest increase of the error per saving, where the
+    // saving counts relative to what is still missing for each target (and no more than that).
+    const double flopsBefore = flops;
+    double latency = budget.m_profiledLatency;
+    for (;;)
+    {
+        bool needFlops = budget.m_flops > 0 && flops > budget.m_flops;
+        bool needLatency = budget.m_latency > 0 && latency > budget.m_latency;
+        if (!needFlops && !needLatency)
+            break;
+
+        CompressionCandidate* best = nullptr;
+        size_t bestSize = 0;
+        double bestScore = numeric_limits<double>::infinity();
+        double bestFlopsSaved = 0, bestLatencySaved = 0;
+        for (auto& candidate : candidates)
+        {
+            double currentFlops, currentLatency;
+            costOf(candidate, candidate.m_size, currentFlops, currentLatency);
+            for (size_t size : candidate.m_sizes)
+            {
+                if (size >= candidate.m_size)
+                    continue;
+                if (candidate.m_errors[size] > budget.m_maxLayerError)
+                    break;
+
+                double newFlops, newLatency;
+                costOf(candidate, size, newFlops, newLatency);
+                double saving = (needFlops ? min((currentFlops - newFlops) / (flops - budget.m_flops), 1.0) : 0) +
+                                (needLatency ? min((currentLatency - newLatency) / (latency - budget.m_latency), 1.0) : 0);
+                if (saving <= 0)
+                    continue;
+                double score = (candidate.m_errors[size] - candidate.m_errors[candidate.m_size]) / saving;
+                if (score < bestScore)
+                {
+                    best = &candidate;
+                    bestSize = size;
+                    bestScore = score;
+                    bestFlopsSaved = currentFlops - newFlops;
+                    bestLatencySaved = currentLatency - newLatency;
+                }
+            }
+        }
+        if (!best)
+        {
+            fprintf(stderr, "CompressForBudget: WARNING: The budget cannot be met within the allowed error of %.2f per layer.\n", budget.m_maxLayerError);
+            break;
+        }
+
+        best->m_size = bestSize;
+        flops -= bestFlopsSaved;
+        latency -= bestLatencySaved;
+    }
+
+    // rewrite the network
+    vector<LayerCompressionStats> stats;
+    size_t numCompressed = 0;
+    for (const auto& candidate : candidates)
+    {
+        LayerCompressionStats layer;
+        layer.m_nodeName = candidate.m_nodeName;
+        layer.m_isChannelPruning = candidate.m_isChannelPruning;
+        layer.m_sizeBefore = candidate.m_fullSize;
+        layer.m_sizeAfter = candidate.m_size;
+        layer.m_flopsBefore = candidate.m_flops + (candidate.m_isChannelPruning ? candidate.m_nextFlops : 0);
+        layer.m_latencyBefore = candidate.m_latency + (candidate.m_isChannelPruning ? candidate.m_nextLatency : 0);
+        costOf(candidate, candidate.m_size, layer.m_flopsAfter, layer.m_latencyAfter);
+        layer.m_relativeError = candidate.m_errors[candidate.m_size];
+        stats.push_back(layer);
+
+        fprintf(stderr, "CompressForBudget: %-32ls %-15s %5d -> %-5d %10.3f -> %10.3f MFLOPs %9.3f -> %9.3f ms, error %.4f\n",
+                layer.m_nodeName.c_str(), layer.m_isChannelPruning ? "filters" : "rank",
+                (int)layer.m_sizeBefore, (int)layer.m_sizeAfter, layer.m_flopsBefore * 1e-6, layer.m_flopsAfter * 1e-6,
+                layer.m_latencyBefore * 1000, layer.m_latencyAfter * 1000, layer.m_relativeError);
+
+        if (candidate.m_size == candidate.m_fullSize)
+            continue;
+        if (candidate.m_isChannelPruning)
+            ApplyChannelPruning<ElemType>(candidate);
+        else
+            ApplyLowRank<ElemType>(candidate);
+        numCompressed++;
+    }
+    CompileNetwork();
+
+    fprintf(stderr, "CompressForBudget: compressed %d of %d candidate layers; %.3f -> %.3f MFLOPs per sample",
+            (int)numCompressed, (int)candidates.size(), flopsBefore * 1e-6, flops * 1e-6);
+    if (budget.m_profiledLatency > 0)
+        fprintf(stderr, ", estimated forward pass %.3f -> %.3f ms", budget.m_profiledLatency * 1000, latency * 1000);
+    fprintf(stderr, ".\n");
+    return stats;
+}
+
+template <class ElemType>
+void ComputationNetwork::ApplyLowRank(const CompressionCandidate& candidate)
+{
+    ComputationNodeBasePtr weights = GetNodeFromName(candidate.m_nodeName)->Input(0);
+    Matrix<ElemType> S(CPUDEVICE), U(CPUDEVICE), VT(CPUDEVICE);
+    SVDOf<ElemType>(weights, S, U, VT);
+    ReplaceByLowRankFactors(weights->NodeName(), U, S, VT, candidate.m_size);
+}
+
+// Removes the filters of the first Convolution that are not among the m_size most important ones, their entries
+// in the parameters of the nodes in between, and the matching input channels of the next Convolution.
+// The Convolution and BatchNormalization nodes are replaced by new ones, since they hold engines for their shapes.
+template <class ElemType>
+void ComputationNetwork::ApplyChannelPruning(const CompressionCandidate& candidate)
+{
+    size_t numFilters = candidate.m_fullSize;
+    vector<size_t> kept(candidate.m_ranking.begin(), candidate.m_ranking.begin() + candidate.m_size);
+    sort(kept.begin(), kept.end());
+
+    auto rebuild = [&](const ComputationNodeBasePtr& node, const TensorShape& kernelShape, const TensorShape& mapCount)
+    {
+        auto conv = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node);
+        auto newConv = New<ConvolutionNode<ElemType>>(m_deviceId, conv->NodeName(), kernelShape, mapCount, conv->Strides(), conv->Sharing(),
+                                                      conv->AutoPad(), conv->LowerPad(), conv->UpperPad(), conv->Transpose(), conv->OutputShape(),
+                                                      conv->ImageLayout(), conv->MaxTempMemSizeInSamples(), conv->Dilation(), conv->Groups());
+        newConv->AttachInputs({ node->Input(0), node->Input(1) });
+        SubstituteNode(node, newConv);
+    };
+
+    // filters of the first Convolution, its weights being [kernel x filters]
+    ComputationNodeBasePtr firstNode = GetNodeFromName(candidate.m_nodeName);
+    auto first = dynamic_pointer_cast<ConvolutionNode<ElemType>>(firstNode);
+    ComputationNodeBasePtr firstWeights = firstNode->Input(0);
+    const auto& firstLayout = firstWeights->GetSampleLayout();
+    auto w1 = KeepChannels(ValuesOf<ElemType>(firstWeights), first->KernelShape().GetNumElements(), numFilters, kept);
+    SubstituteParameter(firstWeights, WithDim(firstLayout, firstLayout.GetRank() - 1, kept.size()), w1);
+    rebuild(firstNode, first->KernelShape(), WithDim(first->MapCount(), ChannelAxisOf(first->MapCount(), numFilters), kept.size()));
+
+    for (const auto& name : candidate.m_chainNames)
+    {
+        ComputationNodeBasePtr node = GetNodeFromName(name);
+        bool isBatchNormalization = node->OperationName() == OperationNameOf(BatchNormalizationNode);
+        size_t numParameters = isBatchNormalization ? 4 : node->OperationName() == OperationNameOf(PlusNode) ? 1 : 0;
+        for (size_t i = 1; i <= numParameters; i++)
+        {
+            ComputationNodeBasePtr parameter = node->Input(i);
+            const auto& layout = parameter->GetSampleLayout();
+            auto values = KeepChannels(ValuesOf<ElemType>(parameter), 1, numFilters, kept);
+            SubstituteParameter(parameter, WithDim(layout, ChannelAxisOf(layout, numFilters), kept.size()), values);
+        }
+        if (isBatchNormalization)
+            SubstituteNode(node, node->Duplicate(name, CopyNodeFlags::copyNodeAll));
+    }
+
+    // input channels of the next Convolution, its weights being [kernel spatial x channels x filters]
+    ComputationNodeBasePtr nextNode = GetNodeFromName(candidate.m_nextName);
+    auto next = dynamic_pointer_cast<ConvolutionNode<ElemType>>(nextNode);
+    ComputationNodeBasePtr nextWeights = nextNode->Input(0);
+    const auto& kernel = next->KernelShape();
+    size_t channelAxis = kernel.GetRank() - 1;
+    auto w2 = KeepChannels(ValuesOf<ElemType>(nextWeights), kernel.GetNumElements() / numFilters, numFilters, kept);
+    SubstituteParameter(nextWeights, WithDim(nextWeights->GetSampleLayout(), channelAxis, kept.size()), w2);
+    rebuild(nextNode, WithDim(kernel, channelAxis, kept.size()), next->MapCount());
+
+    fprintf(stderr, "CompressForBudget: pruned %ls %ls operation from %d to %d filters.\n",
+            candidate.m_nodeName.c_str(), firstNode->OperationName().c_str(), (int)numFilters, (int)kept.size());
+}
+
+// replaces a LearnableParameter by one of the same name with the given shape and values
+template <class ElemType>
+void ComputationNetwork::SubstituteParameter(const ComputationNodeBasePtr& parameter, const TensorShape& shape, vector<ElemType>& values)
+{
+    ComputationNodeBasePtr newParameter = New<LearnableParameter<ElemType>>(m_deviceId, parameter->NodeName(), shape);
+    InitLearnableParameters(newParameter, L"fixedValue", 0); // follow the protocol; otherwise deferred initialization will overwrite the values in validation
+    SetValuesOf(newParameter, values);
+    newParameter->SetLearningRateMultiplier(parameter->GetLearningRateMultiplier());
+    SubstituteNode(parameter, newParameter);
+}
+
+template ComputationNetwork::InferenceOptimizationStats ComputationNetwork::OptimizeForInference<float>(const std::vector<std::wstring>& outputNodeNames);
+template ComputationNetwork::InferenceOptimizationStats ComputationNetwork::OptimizeForInference<double>(const std::vector<std::wstring>& outputNodeNames);
+template vector<ComputationNetwork::LayerCompressionStats> ComputationNetwork::CompressForBudget<float>(const std::vector<std::wstring>& outputNodeNames, const CompressionBudget& budget);
+template vector<ComputationNetwork::LayerCompressionStats> ComputationNetwork::CompressForBudget<double>(const std::vector<std::wstring>& outputNodeNames, const CompressionBudget& budget);
+
+}}}
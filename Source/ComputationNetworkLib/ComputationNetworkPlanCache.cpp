@@ -0,0 +1,584 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputationNetworkPlanCache.cpp -- cache of the outcome of CompileNetwork() and AllocateAllMatrices()
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// compiled plans
+// -----------------------------------------------------------------------
+
+// Everything CompileNetwork() and AllocateAllMatrices() derive from the structure of a network.
+// Nodes are referred to by their index in the canonical order of the network, see FormCanonicalOrder().
+struct ComputationNetwork::CompiledPlan
+{
+    static const size_t NoLayout = SIZE_MAX;
+
+    struct Loop
+    {
+        size_t m_sourceNode;
+        vector<size_t> m_nestedNodes; // in the order of evaluation inside the loop
+        int m_steppingDirection;
+    };
+
+    // validated state of a node
+    struct NodeState
+    {
+        vector<size_t> m_dims;
+        size_t m_layoutSource; // the first node in evaluation order that has the same MBLayout, or NoLayout
+        bool m_needsGradient;
+        bool m_needsDynamicValidation;
+    };
+
+    uint64_t m_key;
+    vector<size_t> m_evalOrder; // global evaluation order, with the nodes of each loop consecutive
+    vector<Loop> m_loops;       // [loopId]
+    vector<NodeState> m_nodeStates;
+    map<uint64_t, vector<MemAllocPlanEntry>> m_allocationPlans; // [AllocationPlanKey()] buffer assignment of the MatrixPool
+
+    void Save(File& fstream) const
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPlan");
+        fstream << m_key << m_evalOrder;
+
+        fstream << m_loops.size();
+        for (const auto& loop : m_loops)
+            fstream << loop.m_sourceNode << loop.m_nestedNodes << loop.m_steppingDirection;
+
+        fstream << m_nodeStates.size();
+        for (const auto& state : m_nodeStates)
+            fstream << state.m_dims << state.m_layoutSource << state.m_needsGradient << state.m_needsDynamicValidation;
+
+        fstream << m_allocationPlans.size();
+        for (const auto& allocationPlan : m_allocationPlans)
+        {
+            fstream << allocationPlan.first << allocationPlan.second.size();
+            for (const auto& entry : allocationPlan.second)
+            {
+                fstream << entry.allocStep << entry.releaseStep << entry.elementSize << entry.deviceId
+                        << entry.matrixSize << entry.mbScale << entry.isWorkSpace << entry.memoryId;
+            }
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPlan");
+    }
+
+    void Load(File& fstream)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPlan");
+        fstream >> m_key >> m_evalOrder;
+
+        size_t numLoops;
+        fstream >> numLoops;
+        m_loops.resize(numLoops);
+        for (auto& loop : m_loops)
+            fstream >> loop.m_sourceNode >> loop.m_nestedNodes >> loop.m_steppingDirection;
+
+        size_t numNodes;
+        fstream >> numNodes;
+        m_nodeStates.resize(numNodes);
+        for (auto& state : m_nodeStates)
+            fstream >> state.m_dims >> state.m_layoutSource >> state.m_needsGradient >> state.m_needsDynamicValidation;
+
+        size_t numAllocationPlans;
+        fstream >> numAllocationPlans;
+        for (size_t i = 0; i < numAllocationPlans; i++)
+        {
+            uint64_t allocationPlanKey;
+            size_t numEntries;
+            fstream >> allocationPlanKey >> numEntries;
+            auto& allocationPlan = m_allocationPlans[allocationPlanKey];
+            allocationPlan.resize(numEntries);
+            for (auto& entry : allocationPlan)
+            {
+                fstream >> entry.allocStep >> entry.releaseStep >> entry.elementSize >> entry.deviceId
+                        >> entry.matrixSize >> entry.mbScale >> entry.isWorkSpace >> entry.memoryId;
+            }
+        }
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPlan");
+
+        Verify();
+    }
+
+    // check that all node indices are in range, since they are used without further checks
+    void Verify() const
+    {
+        size_t numNodes = m_nodeStates.size();
+        bool isValid = m_evalOrder.size() == numNodes;
+        for (auto i : m_evalOrder)
+            isValid &= i < numNodes;
+        for (const auto& loop : m_loops)
+        {
+            isValid &= loop.m_sourceNode < numNodes && !loop.m_nestedNodes.empty();
+            for (auto i : loop.m_nestedNodes)
+                isValid &= i < numNodes;
+        }
+        for (const auto& state : m_nodeStates)
+            isValid &= state.m_layoutSource < numNodes || state.m_layoutSource == NoLayout;
+        if (!isValid)
+            RuntimeError("CompiledPlan: The plan for key %llx is corrupt.", (unsigned long long) m_key);
+    }
+};
+
+// process-wide cache of compiled plans
+// Plans are immutable once inserted; adding to a plan inserts a modified copy. The oldest plans are evicted first.
+class CompiledPlanCache
+{
+    typedef shared_ptr<const ComputationNetwork::CompiledPlan> CompiledPlanPtr;
+
+public:
+    static CompiledPlanCache& Instance()
+    {
+        static CompiledPlanCache s_instance;
+        return s_instance;
+    }
+
+    CompiledPlanPtr Find(uint64_t key)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto iter = m_plans.find(key);
+        return iter != m_plans.end() ? iter->second : nullptr;
+    }
+
+    void Insert(const CompiledPlanPtr& plan)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (m_plans.find(plan->m_key) == m_plans.end())
+            m_insertionOrder.push_back(plan->m_key);
+        m_plans[plan->m_key] = plan;
+        while (m_insertionOrder.size() > s_capacity)
+        {
+            m_plans.erase(m_insertionOrder.front());
+            m_insertionOrder.pop_front();
+        }
+    }
+
+    void Clear()
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_plans.clear();
+        m_insertionOrder.clear();
+    }
+
+private:
+    static const size_t s_capacity = 64;
+
+    mutex m_mutex;
+    map<uint64_t, CompiledPlanPtr> m_plans;
+    deque<uint64_t> m_insertionOrder;
+};
+
+// FNV-1a
+static const uint64_t s_hashBasis = 14695981039346656037ull;
+
+static void HashCombine(uint64_t& hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+static void HashCombine(uint64_t& hash, uint64_t value)
+{
+    HashCombine(hash, &value, sizeof(value));
+}
+
+static void HashCombine(uint64_t& hash, const wstring& value)
+{
+    HashCombine(hash, value.size());
+    for (auto c : value)
+        HashCombine(hash, (uint64_t) c);
+}
+
+static size_t ElementSizeOf(const ComputationNodeBasePtr& node)
+{
+    if (node->Is<ComputationNode<float>>())
+        return sizeof(float);
+    else if (node->Is<ComputationNode<double>>())
+        return sizeof(double);
+    else if (node->Is<ComputationNode<half>>())
+        return sizeof(half);
+    return 0;
+}
+
+// what a node contributes to the key of a plan, besides its connections
+// Inferred dimensions are determined by the leaves. The attributes of other nodes are not covered; a plan that does
+// not match them is detected by ValidateNetworkFromPlan().
+static uint64_t SignatureOf(const ComputationNodeBasePtr& node)
+{
+    uint64_t hash = s_hashBasis;
+    HashCombine(hash, node->OperationName());
+    HashCombine(hash, ElementSizeOf(node));
+    HashCombine(hash, node->GetNumInputs());
+    if (node->IsLeaf())
+    {
+        for (auto dim : node->GetSampleLayout().GetDims())
+            HashCombine(hash, dim);
+        HashCombine(hash, node->IsParameterUpdateRequired());
+        auto takesDynamicAxis = dynamic_pointer_cast<ITakesDynamicAxis>(node);
+        if (takesDynamicAxis)
+            HashCombine(hash, takesDynamicAxis->GetRequestedDynamicAxis());
+    }
+    return hash;
+}
+
+static map<ComputationNodeBasePtr, size_t> IndicesOf(const vector<ComputationNodeBasePtr>& nodes)
+{
+    map<ComputationNodeBasePtr, size_t> indices;
+    for (size_t i = 0; i < nodes.size(); i++)
+        indices[nodes[i]] = i;
+    return indices;
+}
+
+// Determine m_canonicalOrder, an order of all nodes that only depends on the structure of the network, and
+// m_compiledPlanKey, which identifies the structure and the leaf dimensions.
+// The canonical order is the post-order traversal from the roots, which are sorted by a hash of the subgraph below
+// them. (Node names only break ties between roots. Where they matter, a clone just misses the cache.)
+// Returns false if the network is not suitable for caching; FormRecurrentLoops() reports why.
+bool ComputationNetwork::FormCanonicalOrder()
+{
+    // hash of the subgraph below each root
+    // The inputs of recurrent nodes are not followed, which cuts all loops.
+    map<ComputationNodeBasePtr, uint64_t> subgraphHashes;
+    set<ComputationNodeBasePtr> onStack;
+    vector<pair<ComputationNodeBasePtr, size_t>> stack; // [node, next input to visit]
+    for (const auto& root : m_allRoots)
+    {
+        if (subgraphHashes.find(root) != subgraphHashes.end())
+            continue;
+        stack.push_back(make_pair(root, 0));
+        onStack.insert(root);
+        while (!stack.empty())
+        {
+            auto node = stack.back().first;
+            size_t numInputs = node->Is<IRecurrentNode>() ? 0 : node->GetNumInputs();
+            if (stack.back().second < numInputs)
+            {
+                auto input = node->Input(stack.back().second++);
+                if (subgraphHashes.find(input) != subgraphHashes.end())
+                    continue;
+                if (!onStack.insert(input).second)
+                    return false; // a loop without a recurrent node
+                stack.push_back(make_pair(input, 0));
+            }
+            else
+            {
+                uint64_t hash = SignatureOf(node);
+                for (size_t i = 0; i < numInputs; i++)
+                    HashCombine(hash, subgraphHashes[node->Input(i)]);
+                subgraphHashes[node] = hash;
+                onStack.erase(node);
+                stack.pop_back();
+            }
+        }
+    }
+
+    // m_allRoots is sorted by name, which breaks ties
+    auto roots = m_allRoots;
+    stable_sort(roots.begin(), roots.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+    {
+        return subgraphHashes[a] < subgraphHashes[b];
+    });
+
+    m_canonicalOrder.clear();
+    set<ComputationNodeBasePtr> visited;
+    for (const auto& root : roots)
+    {
+        if (!visited.insert(root).second)
+            continue;
+        stack.push_back(make_pair(root, 0));
+        while (!stack.empty())
+        {
+            auto node = stack.back().first;
+            if (stack.back().second < node->GetNumInputs())
+            {
+                auto input = node->Input(stack.back().second++);
+                if (visited.insert(input).second)
+                    stack.push_back(make_pair(input, 0));
+            }
+            else
+            {
+                m_canonicalOrder.push_back(node);
+                stack.pop_back();
+            }
+        }
+    }
+
+    // the key covers the nodes in canonical order with their connections, and the roots
+    auto canonicalIndices = IndicesOf(m_canonicalOrder);
+    uint64_t key = s_hashBasis;
+    HashCombine(key, m_canonicalOrder.size());
+    for (const auto& node : m_canonicalOrder)
+    {
+        HashCombine(key, SignatureOf(node));
+        for (const auto& input : node->GetInputs())
+            HashCombine(key, canonicalIndices[input]);
+    }
+    vector<size_t> rootIndices;
+    for (const auto& root : m_allRoots)
+        rootIndices.push_back(canonicalIndices[root]);
+    sort(rootIndices.begin(), rootIndices.end());
+    for (auto i : rootIndices)
+        HashCombine(key, i);
+
+    m_compiledPlanKey = key != 0 ? key : 1; // 0 means no key
+    return true;
+}
+
+// set up the global evaluation order and the loops from the cached plan for m_compiledPlanKey, if there is one
+// This replaces FormEvalOrder(nullptr) and FormRecurrentLoops(), and sets m_compiledPlan for the remaining steps.
+void ComputationNetwork::RestoreFromCompiledPlan()
+{
+    auto plan = CompiledPlanCache::Instance().Find(m_compiledPlanKey);
+    if (!plan || plan->m_nodeStates.size() != m_canonicalOrder.size())
+        return;
+
+    list<ComputationNodeBasePtr> evalOrder;
+    for (auto i : plan->m_evalOrder)
+        evalOrder.push_back(m_canonicalOrder[i]);
+    m_evalOrders[nullptr] = evalOrder;
+
+    for (size_t loopId = 0; loopId < plan->m_loops.size(); loopId++)
+    {
+        const auto& loop = plan->m_loops[loopId];
+        SEQTraversalFlowControlNode flowControlNode((int) loopId, m_canonicalOrder[loop.m_sourceNode]);
+        for (auto i : loop.m_nestedNodes)
+        {
+            flowControlNode.m_nestedNodes.push_back(m_canonicalOrder[i]);
+            m_canonicalOrder[i]->m_isPartOfLoop = true;
+        }
+        flowControlNode.m_steppingDirection = loop.m_steppingDirection;
+        m_allSEQNodes.push_back(make_shared<SEQTraversalFlowControlNode>(std::move(flowControlNode)));
+    }
+
+    m_compiledPlan = plan;
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "\nUsing the compiled plan of a network with the same structure: %d nodes, %d loops.\n",
+                (int) m_canonicalOrder.size(), (int) m_allSEQNodes.size());
+}
+
+// store the outcome of FormRecurrentLoops() and ValidateNetwork() as the plan for m_compiledPlanKey
+void ComputationNetwork::RecordCompiledPlan()
+{
+    auto canonicalIndices = IndicesOf(m_canonicalOrder);
+    const auto& evalOrder = GetEvalOrder(nullptr);
+    if (evalOrder.size() != m_canonicalOrder.size())
+        return; // nodes the roots do not depend on
+
+    auto plan = make_shared<CompiledPlan>();
+    plan->m_key = m_compiledPlanKey;
+    plan->m_nodeStates.resize(m_canonicalOrder.size());
+    map<MBLayoutPtr, size_t> layoutSources;
+    for (const auto& node : evalOrder)
+    {
+        auto iter = canonicalIndices.find(node);
+        if (iter == canonicalIndices.end())
+            return;
+        size_t i = iter->second;
+        plan->m_evalOrder.push_back(i);
+
+        auto& state = plan->m_nodeStates[i];
+        const auto& dims = node->GetSampleLayout().GetDims();
+        state.m_dims.assign(dims.begin(), dims.end());
+        if (node->HasMBLayout())
+            state.m_layoutSource = layoutSources.insert(make_pair(node->GetMBLayout(), i)).first->second;
+        else
+            state.m_layoutSource = CompiledPlan::NoLayout;
+        state.m_needsGradient = node->m_needsGradient;
+        state.m_needsDynamicValidation = node->m_needsDynamicValidation;
+    }
+
+    for (const auto& seqNode : m_allSEQNodes)
+    {
+        CompiledPlan::Loop loop;
+        loop.m_sourceNode = canonicalIndices.at(seqNode->m_sourceNode);
+        for (const auto& node : seqNode->m_nestedNodes)
+            loop.m_nestedNodes.push_back(canonicalIndices.at(node));
+        loop.m_steppingDirection = seqNode->m_steppingDirection;
+        plan->m_loops.push_back(loop);
+    }
+
+    m_compiledPlan = plan;
+    CompiledPlanCache::Instance().Insert(plan);
+}
+
+// validate the network starting out from the state of all nodes that is stored in the compiled plan
+// The nodes are seeded with the dimensions, MBLayouts and flags recorded in the plan and considered visited,
+// such that one pass verifies that the plan is a fixed point of validation, whereas ValidateNetwork() propagates
+// information through recurrent loops in as many passes as needed. The final pass is the same in both cases.
+// Returns false, with the seeded state reverted, if the plan does not match the network.
+bool ComputationNetwork::ValidateNetworkFromPlan()
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+    const auto& plan = *m_compiledPlan;
+
+    // leaves with dimensions yet to be inferred, e.g. parameters, get initialized during validation, which must not be based on seeded values
+    for (const auto& node : nodes)
+    {
+        if (node->IsLeaf() && node->GetSampleLayout().GetNumElements() == 0)
+            return false;
+    }
+
+    struct NodeState
+    {
+        TensorShape sampleLayout;
+        MBLayoutPtr pMBLayout;
+        bool needsGradient;
+        bool needsDynamicValidation;
+    };
+    vector<NodeState> savedStates;
+    savedStates.reserve(m_canonicalOrder.size());
+    for (const auto& node : m_canonicalOrder)
+        savedStates.push_back({ node->GetSampleLayout(), node->GetMBLayout(), node->m_needsGradient, node->m_needsDynamicValidation });
+
+    // seed the nodes in evaluation order, so that MBLayouts are taken from nodes that have been seeded already
+    map<ComputationNodeBasePtr, size_t> canonicalIndices;
+    for (size_t i = 0; i < m_canonicalOrder.size(); i++)
+        canonicalIndices[m_canonicalOrder[i]] = i;
+    for (const auto& node : nodes)
+    {
+        size_t i = canonicalIndices.at(node);
+        const auto& state = plan.m_nodeStates[i];
+        if (state.m_layoutSource == CompiledPlan::NoLayout)
+            node->LinkToMBLayout(nullptr);
+        else if (state.m_layoutSource != i) // nodes that own their MBLayout got it from ResetMBLayouts() or create it in Validate()
+            node->LinkToMBLayout(m_canonicalOrder[state.m_layoutSource]->GetMBLayout());
+        if (!node->IsLeaf())
+            node->SetDims(TensorShape(state.m_dims), node->HasMBLayout());
+        node->m_needsGradient = state.m_needsGradient;
+        node->m_needsDynamicValidation |= state.m_needsDynamicValidation;
+        node->m_visited = true;
+    }
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "\nValidating network from its compiled plan. %d nodes to process.\n\n", (int) nodes.size());
+    if (ValidateNodes(nodes, /*isFirstPass=*/true, false /*isFinalValidationPass*/) != 0)
+    {
+        if (TraceLevel() > 0)
+            fprintf(stderr, "\nThe compiled plan does not match the network, validating from scratch.\n");
+        for (size_t i = 0; i < m_canonicalOrder.size(); i++)
+        {
+            const auto& node = m_canonicalOrder[i];
+            const auto& state = savedStates[i];
+            node->LinkToMBLayout(state.pMBLayout);
+            node->SetDims(state.sampleLayout, node->HasMBLayout());
+            node->m_needsGradient = state.needsGradient;
+            node->m_needsDynamicValidation = state.needsDynamicValidation;
+        }
+        return false;
+    }
+
+    if (TraceLevel() > 0)
+        fprintf(stderr, "\nValidating network, final pass.\n\n");
+    if (ValidateNodes(nodes, /*isFirstPass=*/false, true /*isFinalValidationPass*/) != 0)
+        LogicError("ValidateNetworkFromPlan: ValidateNodes(true) unexpectedly returned with work left to do.");
+
+    FinalizeValidation(nodes);
+    return true;
+}
+
+// identifies the allocation for a set of roots within a plan, along with the settings that affect it
+uint64_t ComputationNetwork::AllocationPlanKey(const vector<ComputationNodeBasePtr>& forwardPropRoots, const ComputationNodeBasePtr& trainRootNode) const
+{
+    auto canonicalIndices = IndicesOf(m_canonicalOrder);
+    auto indexOf = [&](const ComputationNodeBasePtr& node)
+    {
+        auto iter = canonicalIndices.find(node);
+        return iter != canonicalIndices.end() ? iter->second : SIZE_MAX;
+    };
+
+    uint64_t key = s_hashBasis;
+    for (const auto& root : forwardPropRoots)
+        HashCombine(key, indexOf(root));
+    HashCombine(key, trainRootNode ? indexOf(trainRootNode) : SIZE_MAX);
+    HashCombine(key, Globals::ShouldOptimizeGradientAccumulation());
+    HashCombine(key, Globals::ShouldEnableShareNodeValueMatrices());
+    return key;
+}
+
+// pass the buffer assignment recorded for the given key, if any, to the MatrixPool for its next allocation
+void ComputationNetwork::PrepareAllocationFromPlan(uint64_t allocationPlanKey)
+{
+    auto iter = m_compiledPlan->m_allocationPlans.find(allocationPlanKey);
+    if (iter != m_compiledPlan->m_allocationPlans.end())
+        m_matrixPool.SetAllocationPlan(iter->second);
+}
+
+// add the buffer assignment of the last AllocateAllMatrices() to the plan of this network
+void ComputationNetwork::RecordAllocationPlan(uint64_t allocationPlanKey)
+{
+    auto plan = make_shared<CompiledPlan>(*m_compiledPlan);
+    plan->m_allocationPlans[allocationPlanKey] = m_matrixPool.GetAllocationPlan();
+    m_compiledPlan = plan;
+    CompiledPlanCache::Instance().Insert(plan);
+}
+
+// -----------------------------------------------------------------------
+// persistence
+// -----------------------------------------------------------------------
+
+static const size_t s_compiledPlanFormatVersion = 1;
+
+void ComputationNetwork::SaveCompiledPlan(const wstring& fileName) const
+{
+    VerifyIsCompiled("SaveCompiledPlan");
+    if (!m_compiledPlan)
+        LogicError("SaveCompiledPlan: The network has no compiled plan. Plans are only kept if compiled plan caching is enabled.");
+
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCompiledPlans");
+    fstream << s_compiledPlanFormatVersion << (size_t) 1;
+    m_compiledPlan->Save(fstream);
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECompiledPlans");
+}
+
+// add the plans saved by SaveCompiledPlan() to the cache
+/*static*/ void ComputationNetwork::LoadCompiledPlans(const wstring& fileName)
+{
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCompiledPlans");
+    size_t version, numPlans;
+    fstream >> version;
+    if (version != s_compiledPlanFormatVersion)
+    {
+        fprintf(stderr, "LoadCompiledPlans: WARNING: Ignoring '%ls', which was saved in an unsupported format (version %d).\n", fileName.c_str(), (int) version);
+        return;
+    }
+
+    fstream >> numPlans;
+    for (size_t i = 0; i < numPlans; i++)
+    {
+        auto plan = make_shared<CompiledPlan>();
+        plan->Load(fstream);
+        CompiledPlanCache::Instance().Insert(plan);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECompiledPlans");
+}
+
+/*static*/ void ComputationNetwork::ClearCompiledPlans()
+{
+    CompiledPlanCache::Instance().Clear();
+}
+
+}}}
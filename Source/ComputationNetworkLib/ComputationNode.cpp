@@ -814,7 +814,7 @@ template <class ElemType>
         sprintf_s(name, _countof(name), "%S%s", m_nodeName.c_str(), postfixes[phase]);
         timing.profilerName = name;
     }
-    ProfilerTimeEnd(timing.profilerId, timing.profilerName.c_str());
+    ProfilerTimeEnd(timing.profilerId, timing.profilerName.c_str(), profilerCatNode);
 #endif
 }
 
@@ -12,6 +12,34 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// ConvolutionEngineCache -- hit/miss counters of the engines reused by convolution and pooling nodes
+//
+// Each node keeps the engines it built for the most recently seen input shapes (up to
+// Globals::GetShapeSpecializationCacheCapacity(), see ConvolutionNodeBase::ReuseConvolutionEngine()),
+// so that inputs with free dimensions alternating among a few shapes do not rebuild the geometry,
+// its index maps and the engine state (e.g. autotuned algorithms) on every change.
+// -----------------------------------------------------------------------
+
+class ConvolutionEngineCache
+{
+public:
+    static void RecordHit() { m_numHits++; }
+    static void RecordMiss() { m_numMisses++; }
+
+    static size_t NumHits() { return m_numHits; }
+    static size_t NumMisses() { return m_numMisses; }
+    static void ResetCounters()
+    {
+        m_numHits = 0;
+        m_numMisses = 0;
+    }
+
+private:
+    static std::atomic<size_t> m_numHits;
+    static std::atomic<size_t> m_numMisses;
+};
+
 // -----------------------------------------------------------------------
 // ConvolutionNodeBase
 // -----------------------------------------------------------------------
@@ -171,6 +199,7 @@ public:
     PoolKind PoolingKind() const { return m_poolKind; }
     bool CeilOutDim() const { return m_ceilOutDim; }
     bool PoolIncludePad() const { return m_poolIncludePad; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayout; }
 
     // bottomlessly expand shape to filterRank, then expand to inputRank using defaults or given 'from' values
     template<class V, typename T>
@@ -253,6 +282,61 @@ protected:
     }
 
 protected:
+    // The engines a convolution node may choose from.
+    static ConvolutionEngineKind ConvolutionEngines()
+    {
+        return Globals::ShouldUseDirectConvolution() ? (ConvolutionEngineKind)((int)ConvolutionEngineKind::All | (int)ConvolutionEngineKind::Direct)
+                                                     : ConvolutionEngineKind::All;
+    }
+
+    // Makes m_convEng the engine previously built by this node for a geometry with the given input shape,
+    // if it is still among the most recently used ones. All other geometry parameters are attributes
+    // of the node, so the input shape identifies the geometry. Otherwise, the current engine is kept
+    // for later reuse and false is returned: the caller then creates a new m_convEng.
+    bool ReuseConvolutionEngine(const TensorShape& geometryInputShape)
+    {
+        size_t capacity = Globals::GetShapeSpecializationCacheCapacity();
+        if (capacity == 0)
+        {
+            m_inactiveConvEngs.clear();
+            return false;
+        }
+
+        if (m_convEng != nullptr && m_convEng->Geometry()->InputShape() == geometryInputShape)
+        {
+            ConvolutionEngineCache::RecordHit();
+            return true;
+        }
+
+        std::unique_ptr<ConvolutionEngine<ElemType>> cachedEngine;
+        auto iter = std::find_if(m_inactiveConvEngs.begin(), m_inactiveConvEngs.end(),
+                                 [&geometryInputShape](const std::unique_ptr<ConvolutionEngine<ElemType>>& engine)
+                                 {
+                                     return engine->Geometry()->InputShape() == geometryInputShape;
+                                 });
+        if (iter != m_inactiveConvEngs.end())
+        {
+            cachedEngine = std::move(*iter);
+            m_inactiveConvEngs.erase(iter);
+        }
+
+        // the current engine becomes the most recently used inactive one
+        if (m_convEng != nullptr)
+            m_inactiveConvEngs.push_front(std::move(m_convEng));
+        while (m_inactiveConvEngs.size() >= capacity)
+            m_inactiveConvEngs.pop_back();
+
+        if (cachedEngine == nullptr)
+        {
+            ConvolutionEngineCache::RecordMiss();
+            return false;
+        }
+
+        m_convEng = std::move(cachedEngine);
+        ConvolutionEngineCache::RecordHit();
+        return true;
+    }
+
     TensorShape m_kernelShape;
     TensorShape m_mapCount;
     TensorShape m_stride;
@@ -272,6 +356,8 @@ protected:
     shared_ptr<Matrix<ElemType>> m_tempMatrixBackward;
 
     std::unique_ptr<ConvolutionEngine<ElemType>> m_convEng;
+    // engines built for other input shapes, most recently used first (see ReuseConvolutionEngine())
+    std::list<std::unique_ptr<ConvolutionEngine<ElemType>>> m_inactiveConvEngs;
 };
 
 #define UsingConvolutionNodeBaseMembers     \
@@ -294,6 +380,9 @@ protected:                                  \
     using Base::m_tempMatrixForward;        \
     using Base::m_tempMatrixBackward;       \
     using Base::m_convEng;                  \
+    using Base::m_inactiveConvEngs;         \
+    using Base::ReuseConvolutionEngine;     \
+    using Base::ConvolutionEngines;         \
     using Base::InferConvolution2DReductionDims; \
     using Base::InferReductionDims;         \
 public:
@@ -582,14 +671,14 @@ public:
         {
             bool recomputeConvGeometry = (m_convEng == nullptr) ? false : // For first minibatch, this flag must be false, so initial mem allocation can happen.
                                           (outputShape != m_convEng->Geometry()->OutputShape()) || (inputShape != m_convEng->Geometry()->InputShape());
-            if ((m_convEng == nullptr) || ((m_convEng != nullptr) && recomputeConvGeometry))
+            if (((m_convEng == nullptr) || recomputeConvGeometry) && !ReuseConvolutionEngine(!m_transpose ? inputShape : outputShape))
             {
                 auto geometry = std::make_shared<ConvolveGeometry>(!m_transpose ? inputShape : outputShape,
                                                                    m_kernelShape, m_mapCount, m_stride,
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad, m_dilation, false, m_groups);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms(),
+                                                                ConvolutionEngines(), NodeName(), Globals::ShouldForceDeterministicAlgorithms(),
                                                                 false, recomputeConvGeometry);
             }
 
@@ -631,9 +720,13 @@ public:
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
         if (m_convEng != nullptr)
             m_convEng->SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
+        for (auto& engine : m_inactiveConvEngs)
+            engine->SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
     }
 
     bool IsConvolution2D() const { return m_convolution2D; }
+    TensorShape Dilation() const { return m_dilation; }
+    size_t Groups() const { return m_groups; }
 
     bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
@@ -678,6 +771,228 @@ protected:
     bool m_convolution2D;
 };
 
+// -----------------------------------------------------------------------
+// FusedConvolutionNode (convolutionWeights, inputFeature, bias)
+// activation(Convolution(convolutionWeights, inputFeature) + bias), with one bias value per output channel.
+// ComputationNetwork::OptimizeForInference() substitutes it for such subgraphs. Engines that implement
+// ForwardFused() (the direct CPU engine) add the bias and apply the activation while storing the convolution
+// outputs; others run them as in-place passes over the output.
+// Only plain 2D/ND convolutions in CHW layout are supported: no transpose, dilation or groups.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FusedConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<3>
+{
+    typedef ConvolutionNodeBase<ElemType> Base; UsingConvolutionNodeBaseMembers;
+    static const std::wstring TypeName() { return L"FusedConvolution"; }
+public:
+    FusedConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_activation(FusedActivationKind::None)
+    {
+    }
+    FusedConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& strideShape,
+                         const std::vector<bool>& sharing, const std::vector<bool>& autoPadding, const TensorShape& lowerPad, const TensorShape& upperPad,
+                         size_t maxTempMemSizeInSamples, FusedActivationKind activation)
+        : Base(deviceId, name, kernelShape, mapCount, strideShape, sharing, autoPadding, lowerPad, upperPad, PoolKind::None, false, false, TensorShape(0), false, ImageLayoutKind::CHW, maxTempMemSizeInSamples),
+        m_activation(activation)
+    {
+    }
+    FusedConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : FusedConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelShape"), configp->Get(L"mapCount"), configp->Get(L"strideShape"),
+                               configp->Get(L"dimSharing"), configp->Get(L"dimPadding"), configp->Get(L"dimPadLower"), configp->Get(L"dimPadUpper"),
+                               configp->Get(L"maxTempMemSizeInSamples"), FusedActivationKindFrom(configp->Get(L"activation")))
+    {
+        AttachInputsFromConfig(configp, GetExpectedNumInputs());
+    }
+
+public:
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << (int32_t)m_activation;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        int32_t activation;
+        fstream >> activation;
+        m_activation = (FusedActivationKind)activation;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedConvolutionNode<ElemType>>(nodeP);
+            node->m_activation = m_activation;
+        }
+    }
+
+    void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override
+    {
+        Base::DumpNodeInfo(printValues, printMetadata, fstream);
+        fstream << "Activation: " << (int)m_activation << "\n";
+    }
+
+    void ForwardProp(const FrameRange& fr) override
+    {
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        const Matrix<ElemType>& input0 = InputRef(0).ValueAsMatrix();
+        Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
+        if (m_convEng->ImplementsFusedForward())
+        {
+            m_convEng->ForwardFused(sliceInput1Value, input0, InputRef(2).ValueAsMatrix(), m_activation, sliceOutputValue, *m_tempMatrixForward);
+            return;
+        }
+
+        m_convEng->Forward(sliceInput1Value, input0, sliceOutputValue, *m_tempMatrixForward);
+        size_t rank = GetSampleLayout().GetRank();
+        auto output = ValueTensorFor(rank, fr);
+        output.AddCopyOf(BiasTensor(InputRef(2).ValuePtr()));
+        switch (m_activation)
+        {
+        case FusedActivationKind::ReLU:    output.AssignLinearRectifierOf(output); break;
+        case FusedActivationKind::Sigmoid: output.AssignSigmoidOf(output); break;
+        case FusedActivationKind::Tanh:    output.AssignTanhOf(output); break;
+        default: break;
+        }
+    }
+
+    void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        // this potentially computes over time, so we must mask gaps to 0
+        if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
+            MaskMissingGradientColumnsToZero(fr);
+        if (inputIndex < 2 && Input(inputIndex)->ReducesInTimeWrt(Input(1 - inputIndex)))
+            Input(1 - inputIndex)->MaskMissingValueColumnsToZero(fr);
+
+        // the gradient before the activation, computed from the output (elementwise, so it is cheap to redo for each input)
+        size_t rank = GetSampleLayout().GetRank();
+        bool hasActivation = m_activation != FusedActivationKind::None;
+        if (hasActivation)
+        {
+            m_gradientBeforeActivation->Resize(Value().GetNumRows(), Value().GetNumCols());
+            auto gradientBeforeActivation = DataTensorFor(m_gradientBeforeActivation, rank, fr);
+            auto outputGrad = GradientTensorFor(rank, fr);
+            auto output = ValueTensorFor(rank, fr);
+            switch (m_activation)
+            {
+            case FusedActivationKind::ReLU:    gradientBeforeActivation.AssignElementwiseProductWithLinearRectifierDerivativeFromOutputOf(outputGrad, output); break;
+            case FusedActivationKind::Sigmoid: gradientBeforeActivation.AssignElementwiseProductWithSigmoidDerivativeFromOutputOf(outputGrad, output); break;
+            case FusedActivationKind::Tanh:    gradientBeforeActivation.AssignElementwiseProductWithTanhDerivativeFromOutputOf(outputGrad, output); break;
+            default: break;
+            }
+        }
+        Matrix<ElemType> sliceOutputGrad = hasActivation ? DataFor(*m_gradientBeforeActivation, fr) : GradientFor(fr);
+
+        if (inputIndex == 0) // derivative with respect to the weight matrix
+        {
+            auto& grad = InputRef(0).GradientAsMatrix();
+            auto sliceInput1Value = InputRef(1).ValueFor(fr);
+            m_convEng->BackwardKernel(sliceOutputGrad, sliceInput1Value, grad, !Input(inputIndex)->IsGradientInitializedBy(this), fr.IsAllFrames(), *m_tempMatrixBackward);
+        }
+        else if (inputIndex == 1) // derivative with respect to the input feature
+        {
+            auto& input0 = InputRef(0).ValueAsMatrix();
+            auto sliceInput1Grad = InputRef(1).GradientFor(fr);
+            m_convEng->BackwardData(sliceOutputGrad, input0, sliceInput1Grad, !Input(inputIndex)->IsGradientInitializedBy(this), *m_tempMatrixBackward);
+        }
+        else if (inputIndex == 2) // derivative with respect to the bias: summed over the positions and samples
+        {
+            auto gradientBeforeActivation = hasActivation ? DataTensorFor(m_gradientBeforeActivation, rank, fr) : GradientTensorFor(rank, fr);
+            BiasTensor(InputRef(2).GradientPtr()).AddCopyOf(gradientBeforeActivation);
+        }
+    }
+
+    bool OutputUsedInComputingInputNodesGradients() const override { return m_activation != FusedActivationKind::None; }
+
+    void Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        if (m_transpose || m_imageLayout != ImageLayoutKind::CHW)
+            InvalidArgument("%ls %ls supports only convolutions in CHW layout that are not transposed.", NodeName().c_str(), OperationName().c_str());
+
+        TensorShape inputShape = GetInputSampleLayout(1);
+        // infer reduction dimensions if not given
+        InferReductionDims(inputShape, inputShape);
+        TensorShape outputShape = this->ComputeOutputShape(inputShape, TensorShape(1), /*ceilOutDim*/false, isFinalValidationPass);
+        SetDims(outputShape, HasMBLayout());
+
+        if (isFinalValidationPass)
+        {
+            bool recomputeConvGeometry = (m_convEng == nullptr) ? false : // For first minibatch, this flag must be false, so initial mem allocation can happen.
+                                          (outputShape != m_convEng->Geometry()->OutputShape()) || (inputShape != m_convEng->Geometry()->InputShape());
+            if (((m_convEng == nullptr) || recomputeConvGeometry) && !ReuseConvolutionEngine(inputShape))
+            {
+                auto geometry = std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
+                                                                   m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
+                                                                m_maxTempMemSizeInSamples, m_poolKind,
+                                                                ConvolutionEngines(), NodeName(), Globals::ShouldForceDeterministicAlgorithms(),
+                                                                false, recomputeConvGeometry);
+            }
+
+            if (Input(0)->GetSampleLayout().GetNumElements() != m_kernelShape.GetNumElements() * m_convEng->Geometry()->KernelCount())
+            {
+                LogicError("Convolution weight matrix %ls should have dimension [(filter shape) x (input channels) x (output channels)]",
+                           Input(0)->NodeName().c_str());
+            }
+            if (Input(2)->GetSampleLayout().GetNumElements() != m_convEng->Geometry()->KernelCount() || Input(2)->HasMBLayout())
+            {
+                LogicError("%ls %ls: bias %ls should have one value per output channel (%d).", NodeName().c_str(), OperationName().c_str(),
+                           Input(2)->NodeName().c_str(), (int)m_convEng->Geometry()->KernelCount());
+            }
+        }
+    }
+
+    void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_tempMatrixForward, matrixPool, 0, false, true);
+    }
+
+    // m_tempMatrixForward is only used as workspace for convolution, we can release it immediately afterwards
+    void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_tempMatrixForward, matrixPool);
+    }
+
+    void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_tempMatrixBackward, matrixPool, 0, false, true);
+        if (m_activation != FusedActivationKind::None)
+            RequestMatrixFromPool(m_gradientBeforeActivation, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout());
+    }
+
+    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_tempMatrixBackward, matrixPool);
+        if (m_activation != FusedActivationKind::None)
+            ReleaseMatrixToPool(m_gradientBeforeActivation, matrixPool);
+    }
+
+    FusedActivationKind Activation() const { return m_activation; }
+
+private:
+    // the bias as a [1 x ... x 1 x K] tensor, which broadcasts over the positions of the output
+    TensorView<ElemType> BiasTensor(const MatrixBasePtr& data) const
+    {
+        SmallVector<size_t> dims(GetSampleLayout().GetRank(), 1);
+        dims.back() = GetSampleLayout().GetDims().back();
+        return TensorView<ElemType>(data, TensorShape(dims));
+    }
+
+    FusedActivationKind m_activation;
+    shared_ptr<Matrix<ElemType>> m_gradientBeforeActivation;
+};
+
 // -----------------------------------------------------------------------
 // ROIPoolingNode (inputFeatures, inputROIs)--pooling for object detection.
 //
@@ -974,7 +1289,7 @@ public:
         {
             bool recomputeConvGeometry = (m_convEng == nullptr) ? false : // For first minibatch, this flag must be false, so initial mem allocation can happen.
                 (outDims != m_convEng->Geometry()->OutputShape()) || (inputShape != m_convEng->Geometry()->InputShape());
-            if ((m_convEng == nullptr) || ((m_convEng != nullptr) && recomputeConvGeometry))
+            if (((m_convEng == nullptr) || recomputeConvGeometry) && !ReuseConvolutionEngine(inputShape))
             {
                 auto geometry = std::make_shared<ConvolveGeometry>(inputShape, m_kernelShape, m_mapCount, m_stride,
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad, TensorShape(1), m_ceilOutDim);
@@ -1104,7 +1419,7 @@ public:
         {
             bool recomputeConvGeometry = (m_convEng == nullptr) ? false : // For first minibatch, this flag must be false, so initial mem allocation can happen.
                 (outputShape != m_convEng->Geometry()->OutputShape()) || (inputShape != m_convEng->Geometry()->InputShape());
-            if ((m_convEng == nullptr) || ((m_convEng != nullptr) && recomputeConvGeometry))
+            if (((m_convEng == nullptr) || recomputeConvGeometry) && !ReuseConvolutionEngine(outputShape))
             {
                 auto geometry = std::make_shared<ConvolveGeometry>(outputShape, m_kernelShape, m_mapCount, m_stride,
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad);
@@ -15,6 +15,8 @@
 #include <stdexcept>
 #include <list>
 #include <memory>
+#include <limits>
+#include <unordered_map>
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -460,6 +462,7 @@ template class NDCG1EvalNode<double>;
 
 // Edit distance error evaluation node with the option of specifying penalty of substitution, deletion and insertion, as well as squashing the input sequences and ignoring certain samples.
 // Using the classic DP algorithm as described in https://en.wikipedia.org/wiki/Edit_distance, adjusted to take into account the penalties.
+// The sequences of a minibatch are aligned in parallel, with a bit-parallel algorithm if all penalties are 1 and a banded DP otherwise.
 // 
 // The node allows to squash sequences of repeating labels and ignore certain labels. For example, if squashInputs is true and tokensToIgnore contains index of label '-' then
 // given first input sequence as s1="a-ab-" and second as s2="-aa--abb" the edit distance will be computed against s1' = "aab" and s2' = "aab".
@@ -579,24 +582,10 @@ public:
     ElemType ComputeEditDistanceError(Matrix<ElemType>& firstSeq, const Matrix<ElemType> & secondSeq, MBLayoutPtr pMBLayout, 
         float subPen, float delPen, float insPen, bool squashInputs, const vector<size_t>& tokensToIgnore)
     {
-        std::vector<int> firstSeqVec, secondSeqVec;
-
-        // Edit distance between subsequences
-        Matrix<float> grid(CPUDEVICE);
-        
-        // Number of insertions between subsequences
-        Matrix<float> insMatrix(CPUDEVICE);
-        
-        //Number of deletions between subsequences
-        Matrix<float> delMatrix(CPUDEVICE);
-
-        // Number of substitutions between subsequences
-        Matrix<float> subMatrix(CPUDEVICE);
-
-        float del, ins, sub;
-        ElemType wrongSampleNum = 0.0;
+        // extract all sequences first, then align them in parallel
+        std::vector<std::vector<int>> firstSeqVecs, secondSeqVecs;
         size_t totalSampleNum = 0, totalframeNum = 0;
-        size_t sequenceStartFrame = 0;
+        bool isV2Library = Base::HasEnvironmentPtr() && Base::Environment().IsV2Library();
 
         for (const auto& sequence : pMBLayout->GetAllSequences())
         {
@@ -611,84 +600,203 @@ public:
 
                 auto columnIndices = pMBLayout->GetColumnIndices(sequence);
 
-                ExtractSampleSequence(firstSeq, columnIndices, squashInputs, tokensToIgnore, firstSeqVec);
-                ExtractSampleSequence(secondSeq, columnIndices, squashInputs, tokensToIgnore, secondSeqVec);
+                firstSeqVecs.emplace_back();
+                secondSeqVecs.emplace_back();
+                ExtractSampleSequence(firstSeq, columnIndices, squashInputs, tokensToIgnore, firstSeqVecs.back());
+                ExtractSampleSequence(secondSeq, columnIndices, squashInputs, tokensToIgnore, secondSeqVecs.back());
 
-                //calculate edit distance
-                size_t firstSize = firstSeqVec.size();
-                size_t secondSize = secondSeqVec.size();
-                if (Base::HasEnvironmentPtr() && Base::Environment().IsV2Library())
-                    totalSampleNum += secondSize;
+                if (isV2Library)
+                    totalSampleNum += secondSeqVecs.back().size();
                 else 
-                    totalSampleNum += firstSize;
+                    totalSampleNum += firstSeqVecs.back().size();
+            }
+        }
 
-                grid.Resize(firstSize + 1, secondSize + 1);
-                insMatrix.Resize(firstSize + 1, secondSize + 1);
-                delMatrix.Resize(firstSize + 1, secondSize + 1);
-                subMatrix.Resize(firstSize + 1, secondSize + 1);
-                insMatrix.SetValue(0.0f);
-                delMatrix.SetValue(0.0f);
-                subMatrix.SetValue(0.0f);
+        // with unit penalties, the number of errors along the DP path is the Levenshtein distance
+        bool isUnitPenalty = subPen == 1.0f && delPen == 1.0f && insPen == 1.0f;
+        std::vector<size_t> numErrors(firstSeqVecs.size());
+#pragma omp parallel for schedule(dynamic)
+        for (long i = 0; i < (long) firstSeqVecs.size(); i++)
+        {
+            if (isUnitPenalty)
+                numErrors[i] = LevenshteinDistance(firstSeqVecs[i], secondSeqVecs[i]);
+            else
+                numErrors[i] = CountEditErrors(firstSeqVecs[i], secondSeqVecs[i], subPen, delPen, insPen);
+        }
+
+        ElemType wrongSampleNum = 0.0;
+        for (auto n : numErrors)
+            wrongSampleNum += (float) n;
+
+        return (ElemType)(wrongSampleNum * totalframeNum / totalSampleNum);
+    }
 
-                for (size_t i = 0; i < firstSize + 1; i++)
+    // Edit distance with unit penalties, computed with the bit-parallel algorithm of Myers
+    // (H. Hyyro, "Explaining and extending the bit-parallel approximate string matching algorithm of Myers", 2001).
+    // The vertical differences of a DP column are kept in bit vectors of the length of the shorter sequence,
+    // and the column is advanced by one sample of the longer sequence with a few word operations.
+    static size_t LevenshteinDistance(const std::vector<int>& firstSeqVec, const std::vector<int>& secondSeqVec)
+    {
+        const auto& pattern = firstSeqVec.size() <= secondSeqVec.size() ? firstSeqVec : secondSeqVec;
+        const auto& text = firstSeqVec.size() <= secondSeqVec.size() ? secondSeqVec : firstSeqVec;
+        size_t n = pattern.size();
+        if (n == 0)
+            return text.size();
+
+        const size_t numWords = (n + 63) / 64;
+        const size_t lastBit = (n - 1) % 64;
+
+        // positions of each sample in the pattern
+        std::unordered_map<int, std::vector<uint64_t>> peq;
+        for (size_t i = 0; i < n; i++)
+        {
+            auto& bits = peq[pattern[i]];
+            if (bits.empty())
+                bits.resize(numWords, 0);
+            bits[i / 64] |= uint64_t(1) << (i % 64);
+        }
+
+        // the first column holds 0..n, i.e. only positive vertical differences
+        std::vector<uint64_t> vp(numWords, ~uint64_t(0)), vn(numWords, 0);
+        const std::vector<uint64_t> noMatch(numWords, 0);
+        size_t score = n;
+        for (auto sample : text)
+        {
+            auto match = peq.find(sample);
+            const auto& eq = match != peq.end() ? match->second : noMatch;
+
+            // the first row holds 0..m, so the horizontal difference shifted into the first word is +1
+            uint64_t carry = 0, phIn = 1, mhIn = 0;
+            for (size_t w = 0; w < numWords; w++)
+            {
+                uint64_t xv = eq[w] | vn[w];
+                uint64_t x = eq[w] & vp[w];
+                uint64_t sum = x + vp[w];
+                uint64_t sumWithCarry = sum + carry;
+                carry = (sum < x || sumWithCarry < sum) ? 1 : 0;
+                uint64_t xh = (sumWithCarry ^ vp[w]) | eq[w];
+                uint64_t ph = vn[w] | ~(xh | vp[w]);
+                uint64_t mh = vp[w] & xh;
+
+                if (w == numWords - 1)
                 {
-                    grid(i, 0) = (float)(i * delPen);
-                    delMatrix(i, 0) = (float)i;
+                    if ((ph >> lastBit) & 1)
+                        score++;
+                    else if ((mh >> lastBit) & 1)
+                        score--;
                 }
 
-                for (size_t j = 0; j < secondSize + 1; j++)
+                uint64_t phOut = ph >> 63, mhOut = mh >> 63;
+                ph = (ph << 1) | phIn;
+                mh = (mh << 1) | mhIn;
+                phIn = phOut;
+                mhIn = mhOut;
+
+                vp[w] = mh | ~(xv | ph);
+                vn[w] = ph & xv;
+            }
+        }
+        return score;
+    }
+
+    // Number of insertions, deletions and substitutions along the path of the weighted DP, computed with two rows
+    // in a band of diagonals around the main one and the one of the final cell.
+    // A path that leaves a band of width w needs at least |n - m| + 2w + 2 insertions and deletions. While the cost found in
+    // the band is lower than that, the DP path lies in the band, where the cells on it have the same costs as in the full DP,
+    // and the others costs that are not lower, so the path and its counts are exactly the ones of the full DP.
+    // Otherwise the band is doubled, up to the full DP. Negative or zero penalties use the full DP.
+    static size_t CountEditErrors(const std::vector<int>& firstSeqVec, const std::vector<int>& secondSeqVec, float subPen, float delPen, float insPen)
+    {
+        const size_t n = firstSeqVec.size(), m = secondSeqVec.size();
+        const size_t diagonalDistance = n > m ? n - m : m - n;
+        const float minIndelPen = std::min(delPen, insPen);
+        const bool canBand = subPen >= 0 && minIndelPen > 0;
+
+        for (size_t width = 32;; width *= 2)
+        {
+            bool isFullDP = !canBand || width >= std::max(n, m);
+            if (isFullDP)
+                width = std::max(n, m);
+
+            float cost;
+            size_t numErrors = CountEditErrorsInBand(firstSeqVec, secondSeqVec, subPen, delPen, insPen, width, cost);
+            if (isFullDP || cost < (double) minIndelPen * (diagonalDistance + 2 * width + 2))
+                return numErrors;
+        }
+    }
+
+    // Cells of row i are the columns j with -width <= j - i - min(0, m - n) and j - i - max(0, m - n) <= width.
+    static size_t CountEditErrorsInBand(const std::vector<int>& firstSeqVec, const std::vector<int>& secondSeqVec,
+                                        float subPen, float delPen, float insPen, size_t width, float& cost)
+    {
+        const ptrdiff_t n = firstSeqVec.size(), m = secondSeqVec.size();
+        const ptrdiff_t minDiagonal = std::min<ptrdiff_t>(0, m - n) - (ptrdiff_t) width;
+        const ptrdiff_t maxDiagonal = std::max<ptrdiff_t>(0, m - n) + (ptrdiff_t) width;
+        const float outOfBand = std::numeric_limits<float>::infinity();
+
+        // edit distance and number of errors between subsequences, in the previous and the current row
+        std::vector<float> prevGrid(m + 1), grid(m + 1);
+        std::vector<size_t> prevErrors(m + 1), errors(m + 1);
+
+        ptrdiff_t hi = std::min(m, maxDiagonal);
+        for (ptrdiff_t j = 0; j <= hi; j++)
+        {
+            grid[j] = (float)(j * insPen);
+            errors[j] = j;
+        }
+        if (hi < m)
+            grid[hi + 1] = outOfBand;
+
+        for (ptrdiff_t i = 1; i <= n; i++)
+        {
+            std::swap(prevGrid, grid);
+            std::swap(prevErrors, errors);
+
+            ptrdiff_t lo = std::max<ptrdiff_t>(0, i + minDiagonal);
+            hi = std::min(m, i + maxDiagonal);
+            if (lo > 0)
+                grid[lo - 1] = outOfBand;
+
+            for (ptrdiff_t j = lo; j <= hi; j++)
+            {
+                if (j == 0)
+                {
+                    grid[j] = (float)(i * delPen);
+                    errors[j] = i;
+                }
+                else if (firstSeqVec[i - 1] == secondSeqVec[j - 1])
                 {
-                    grid(0, j) = (float)(j * insPen);
-                    insMatrix(0, j) = (float)j;
+                    grid[j] = prevGrid[j - 1];
+                    errors[j] = prevErrors[j - 1];
                 }
-                for (size_t i = 1; i < firstSize + 1; i++)
+                else
                 {
-                    for (size_t j = 1; j < secondSize + 1; j++)
+                    float del = prevGrid[j] + delPen;  // deletion
+                    float ins = grid[j - 1] + insPen;  // insertion
+                    float sub = prevGrid[j - 1] + subPen; // substitution
+                    if (sub <= del && sub <= ins)
+                    {
+                        grid[j] = sub;
+                        errors[j] = prevErrors[j - 1] + 1;
+                    }
+                    else if (del < ins)
+                    {
+                        grid[j] = del;
+                        errors[j] = prevErrors[j] + 1;
+                    }
+                    else
                     {
-                        if (firstSeqVec[i - 1] == secondSeqVec[j - 1])
-                        {
-                            grid(i, j) = grid(i - 1, j - 1);
-                            insMatrix(i, j) = insMatrix(i - 1, j - 1);
-                            delMatrix(i, j) = delMatrix(i - 1, j - 1);
-                            subMatrix(i, j) = subMatrix(i - 1, j - 1);
-                        }
-                        else
-                        {
-                            del = grid(i - 1, j) + delPen; //deletion 
-                            ins = grid(i, j - 1) + insPen;  //insertion
-                            sub = grid(i - 1, j - 1) + subPen; //substitution 
-                            if (sub <= del && sub <= ins)
-                            {
-                                insMatrix(i, j) = insMatrix(i - 1, j - 1);
-                                delMatrix(i, j) = delMatrix(i - 1, j - 1);
-                                subMatrix(i, j) = subMatrix(i - 1, j - 1) + 1.0f;
-                                grid(i, j) = sub;
-                            }
-                            else if (del < ins)
-                            {
-                                insMatrix(i, j) = insMatrix(i - 1, j);
-                                subMatrix(i, j) = subMatrix(i - 1, j);
-                                delMatrix(i, j) = delMatrix(i - 1, j) + 1.0f;
-                                grid(i, j) = del;
-                            }
-                            else
-                            {
-                                delMatrix(i, j) = delMatrix(i, j - 1);
-                                subMatrix(i, j) = subMatrix(i, j - 1);
-                                insMatrix(i, j) = insMatrix(i, j - 1) + 1.0f;
-                                grid(i, j) = ins;
-                            }
-                        }
+                        grid[j] = ins;
+                        errors[j] = errors[j - 1] + 1;
                     }
                 }
-
-                wrongSampleNum += insMatrix(firstSize, secondSize) + delMatrix(firstSize, secondSize) + subMatrix(firstSize, secondSize);
             }
-
-            sequenceStartFrame += numFrames;
+            if (hi < m)
+                grid[hi + 1] = outOfBand;
         }
 
-        return (ElemType)(wrongSampleNum * totalframeNum / totalSampleNum);
+        cost = grid[m];
+        return errors[m];
     }
 
     virtual void Save(File& fstream) const override
@@ -900,49 +1008,23 @@ class SequenceDecoderNode : public ComputationNodeNonLooping /*ComputationNode*/
 private:
     // TODO: member variables go to the end
     Matrix<ElemType> mAlpha;
-    Matrix<ElemType> mBacktrace;
-
-    int mStartLab; // the starting output label
-    int mEndLab;   // the ending output label, if available
-    ElemType m_default_activity;
 
 public:
     DeclareConstructorFromConfigWithNumInputs(SequenceDecoderNode);
     SequenceDecoderNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          mAlpha(deviceId),
-          mBacktrace(deviceId),
-          mStartLab(-1),
-          mEndLab(-1)
+          mAlpha(deviceId)
     {
     }
 
-    static void DecideStartEndingOutputLab(const Matrix<ElemType>& lbls, int& stt, int& stp)
+    // returns the first label set in column 'j' of 'lbls'
+    static size_t FirstActiveLabel(const Matrix<ElemType>& lbls, size_t j)
     {
-        if (stt != -1 && stp != -1)
-            return; // have computed before
-
-        int iNumPos = lbls.GetNumCols();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        int lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, iNumPos - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        stt = firstLbl;
-        stp = lastLbl;
-    };
+        for (size_t ik = 0; ik < lbls.GetNumRows(); ik++)
+            if (lbls(ik, j) != 0)
+                return ik;
+        InvalidArgument("SequenceDecoderNode: the label column %d has no label set.", (int) j);
+    }
 
     virtual void BackpropToNonLooping(size_t /*inputIndex*/) override // scaled by 2*number of elements in the Matrix<ElemType>
     {
@@ -958,101 +1040,39 @@ public:
         return false;
     }
 
-    // compute posterior probability of label y at position t
+    // decodes all sequences of the minibatch at once
+    // The pseudo labels of each sequence tell the decoder its beginning and ending output symbols,
+    // which constrain the search space.
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        DecideStartEndingOutputLab(InputRef(0).Value(), mStartLab, mEndLab);
-        ForwardPropS(mAlpha, mBacktrace, Value(), InputRef(1).Value(),
-                     InputRef(2).Value(), mStartLab, mEndLab);
-    }
-
-    // compute forward backward algorithm
-    void ForwardPropS(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& functionValues, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const size_t stt, const size_t stp)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        // change to other values so can support multiple sentences in each minibatch
-        ForwardCompute(alpha, backtrace, pos_scores, pair_scores, stt);
-        BackwardCompute(functionValues, backtrace, stp);
-    };
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               Matrix<ElemType>& backtrace,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
-                               const size_t stt)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = pos_scores.GetNumCols();
-        int iNumLab = pos_scores.GetNumRows();
-        size_t iTmp = 0;
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-        backtrace.Resize(iNumLab, iNumPos);
+        const auto& pMBLayout = InputRef(1).GetMBLayout();
+        const auto& lbls = InputRef(0).Value();
+        size_t numChannels = pMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
 
-        for (int t = 0; t < iNumPos; t++)
+        vector<size_t> uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, uttEndLabel;
+        for (const auto& sequence : pMBLayout->GetAllSequences())
         {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                if (t > 1)
-                {
-                    for (int j = 0; j < iNumLab; j++)
-                    {
-                        ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
-                        if (fAlpha > fTmp)
-                        {
-                            fTmp = fAlpha;
-                            iTmp = j;
-                        }
-                    }
-                    fTmp += pos_scores(k, t); // include position dependent score
-                }
-                else
-                {
-                    // with constrain that the first word is labeled as a given symbol
-                    iTmp = stt;
-                    fTmp = 0;
-                    if (t == 1)
-                    {
-                        fTmp = alpha(iTmp, t - 1);
-                        fTmp += pair_scores(k, iTmp);
-                        fTmp += pos_scores(k, t);
-                    }
-                    else
-                    {
-                        fTmp = (k == stt) ? pos_scores(k, t) : (ElemType) LZERO;
-                    }
-                }
-                alpha(k, t) = fTmp;
-                backtrace(k, t) = (ElemType) iTmp;
-            }
-        }
-    };
-
-    // compute backward algorithm
-    static void BackwardCompute(
-        Matrix<ElemType>& decodedpath,
-        const Matrix<ElemType>& backtrace, const size_t stp)
-    {
-        int iNumPos = backtrace.GetNumCols();
-        int iNumLab = backtrace.GetNumRows();
-
-        decodedpath.Resize(iNumLab, iNumPos);
-        decodedpath.SetValue(0);
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
 
-        size_t lastlbl = stp;
-        decodedpath(lastlbl, iNumPos - 1) = 1;
+            // only the part of the sequence within this minibatch is decoded
+            size_t tBegin = (size_t) max(sequence.tBegin, (ptrdiff_t) 0);
+            size_t tEnd = min(sequence.tEnd, numTimeSteps);
+            if (tEnd <= tBegin)
+                continue;
 
-        for (int t = iNumPos - 1; t > 0; t--)
-        {
-            lastlbl = (size_t) backtrace(lastlbl, t);
-            decodedpath(lastlbl, t - 1) = 1;
+            uttToChanInd.push_back(sequence.s);
+            uttBeginFrame.push_back(tBegin);
+            uttFrameNum.push_back(tEnd - tBegin);
+            uttStartLabel.push_back(FirstActiveLabel(lbls, tBegin * numChannels + sequence.s));
+            uttEndLabel.push_back(FirstActiveLabel(lbls, (tEnd - 1) * numChannels + sequence.s));
         }
-    };
+
+        Matrix<ElemType>::CRFViterbiDecode(InputRef(1).Value(), InputRef(2).Value(),
+                                           uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, uttEndLabel, numChannels,
+                                           mAlpha, Value());
+    }
 
     // need to feed in pseudo label data, which tells the decoder what is the beginning
     // and ending output symbol. these symbols will constrain the search space
@@ -1069,8 +1089,7 @@ public:
             {
                 LogicError("The Matrix<ElemType>  dimension in the SequenceDecoderNode operation does not match.");
             }
-        // BUGBUG: No SetDims()?
-        m_sampleLayout = TensorShape();
+        SetDims(Input(1)); // one-hot decoded labels
     }
 };
 
@@ -62,6 +62,16 @@ public:
         LearnableParameter(deviceId, name, TensorShape(rows, cols))
     {
     }
+    // The value is a reference to 'value' rather than a matrix of its own, so that networks can share the storage of a parameter.
+    // Nothing is allocated or initialized.
+    LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape, const Matrix<ElemType>& value) :
+        LearnableParameter(deviceId, name)
+    {
+        SetDims(shape, false);
+        this->CreateValueMatrixIfNull();
+        Value() = value.AsReference();
+        m_initString.clear();
+    }
     LearnableParameter(const ScriptableObjects::IConfigRecordPtr configp);
 
     // initialize after plain constructor; for use by NDL
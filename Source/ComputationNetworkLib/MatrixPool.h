@@ -9,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <map>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -61,6 +63,28 @@ struct MemAllocInfo
     }
 };
 
+// the buffer that OptimizedMemoryAllocation() assigned to a memory request
+// Requests are identified by their allocation step, which is unique across element types. The other fields are
+// those the assignment depends on; a recorded plan is only replayed if they all match.
+struct MemAllocPlanEntry
+{
+    int allocStep;
+    int releaseStep;
+    size_t elementSize;                         // sizeof(ElemType) of the request
+    DEVICEID_TYPE deviceId;
+    size_t matrixSize;
+    bool mbScale;
+    bool isWorkSpace;
+    int memoryId;
+
+    template <class ElemType>
+    bool Matches(const MemRequestInfo<ElemType>& memInfo) const
+    {
+        return allocStep == memInfo.allocStep && releaseStep == memInfo.releaseStep && elementSize == sizeof(ElemType) &&
+               deviceId == memInfo.deviceId && matrixSize == memInfo.matrixSize && mbScale == memInfo.mbScale && isWorkSpace == memInfo.isWorkSpace;
+    }
+};
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
@@ -95,6 +119,10 @@ protected:
     unordered_map<AliasNodePtr, AliasInfo> m_aliasGroups;
     unordered_map<AliasNodePtr, AliasNodePtr> m_aliasLookup;
 
+    // plan to replay by the next OptimizedMemoryAllocation(), and the one it actually carried out
+    vector<MemAllocPlanEntry> m_allocationPlan;
+    vector<MemAllocPlanEntry> m_lastAllocation;
+
 public:
 
     void Reset()
@@ -147,13 +175,40 @@ public:
         *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
     }
 
-    void OptimizedMemoryAllocation()
+    // Returns true if the requests were served according to the plan passed to SetAllocationPlan().
+    bool OptimizedMemoryAllocation()
     {
+        m_lastAllocation.clear();
         // MatrixPool is not templated, so we call both float and double versions here 
-        OptimizedMemoryAllocationFunc<float>(); 
-        OptimizedMemoryAllocationFunc<double>();
-        OptimizedMemoryAllocationFunc<half>();
-        return; 
+        bool replayed = OptimizedMemoryAllocationFunc<float>(); 
+        replayed &= OptimizedMemoryAllocationFunc<double>();
+        replayed &= OptimizedMemoryAllocationFunc<half>();
+        m_allocationPlan.clear();
+        return replayed; 
+    }
+
+    // Sets the buffer assignment for the next OptimizedMemoryAllocation() to use instead of searching for one.
+    // Typically this is what GetAllocationPlan() returned for a network with the same structure and shapes.
+    // The plan is ignored if it does not match the requests exactly.
+    void SetAllocationPlan(const vector<MemAllocPlanEntry>& plan) { m_allocationPlan = plan; }
+
+    // the buffer assignment carried out by the last OptimizedMemoryAllocation()
+    const vector<MemAllocPlanEntry>& GetAllocationPlan() const { return m_lastAllocation; }
+
+    // bytes of the buffers assigned by the last OptimizedMemoryAllocation() once minibatches have 'numColumns' columns
+    // A buffer grows to the largest request that shares it. Workspaces are not counted, their size is only known when used.
+    size_t GetAllocatedBytes(size_t numColumns) const
+    {
+        map<tuple<size_t, DEVICEID_TYPE, bool, int>, size_t> bufferBytes;
+        for (const auto& entry : m_lastAllocation)
+        {
+            auto& bytes = bufferBytes[make_tuple(entry.elementSize, entry.deviceId, entry.isWorkSpace, entry.memoryId)];
+            bytes = max(bytes, entry.elementSize * entry.matrixSize * (entry.mbScale ? numColumns : 1));
+        }
+        size_t totalBytes = 0;
+        for (const auto& buffer : bufferBytes)
+            totalBytes += buffer.second;
+        return totalBytes;
     }
 
     void SetAliasInfo(
@@ -247,12 +302,38 @@ private:
         return bRet;
     }
 
+    // assign the memory ids of the plan set with SetAllocationPlan(), if it covers exactly the given requests
     template <class ElemType>
-    void OptimizedMemoryAllocationFunc()
+    bool ReplayAllocationPlan(vector<MemRequestInfo<ElemType>>& memInfoVec) const
+    {
+        unordered_map<int, const MemAllocPlanEntry*> planEntries;
+        for (const auto& entry : m_allocationPlan)
+        {
+            if (entry.elementSize == sizeof(ElemType))
+                planEntries[entry.allocStep] = &entry;
+        }
+        if (planEntries.size() != memInfoVec.size())
+            return false;
+
+        for (const auto& memInfo : memInfoVec)
+        {
+            auto iter = planEntries.find(memInfo.allocStep);
+            if (iter == planEntries.end() || !iter->second->Matches(memInfo))
+                return false;
+        }
+
+        for (auto& memInfo : memInfoVec)
+            memInfo.SetMemoryId(planEntries[memInfo.allocStep]->memoryId);
+        return true;
+    }
+
+    // returns true if the memory ids came from the plan set with SetAllocationPlan()
+    template <class ElemType>
+    bool OptimizedMemoryAllocationFunc()
     {
         vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
         if (memInfoVec.empty())
-            return; 
+            return true; 
 
         // remove all requests that has been marked as sparse matrices, those will not participate in memory sharing 
         for (auto iter = memInfoVec.begin(); iter != memInfoVec.end(); )
@@ -276,6 +357,13 @@ private:
         // sort the memory request from largest size to smallest 
         std::sort(memInfoVec.begin(), memInfoVec.end(), greater_than_mem_req_size<ElemType>());
 
+        if (ReplayAllocationPlan(memInfoVec))
+        {
+            AssignReplayedMatrices(memInfoVec);
+            RecordAllocation(memInfoVec);
+            return true;
+        }
+
         std::vector<bool> workspaceFlagVec = {true, false};
         for (auto& devId : m_deviceIDSet)
         {
@@ -387,6 +475,32 @@ private:
                 }
             }
         }
+
+        RecordAllocation(memInfoVec);
+        return false;
+    }
+
+    // give the requests that share a memory id in the replayed plan the same matrix
+    template <class ElemType>
+    void AssignReplayedMatrices(vector<MemRequestInfo<ElemType>>& memInfoVec) const
+    {
+        map<tuple<DEVICEID_TYPE, bool, int>, shared_ptr<Matrix<ElemType>>> matrices;
+        for (auto& memInfo : memInfoVec)
+        {
+            auto& matrixPtr = matrices[make_tuple(memInfo.deviceId, memInfo.isWorkSpace, memInfo.memoryId)];
+            if (!matrixPtr)
+                matrixPtr = make_shared<Matrix<ElemType>>(memInfo.deviceId);
+            for (auto pOutMatrixPtr : memInfo.pMatrixPtrs)
+                *pOutMatrixPtr = matrixPtr;
+        }
+    }
+
+    // append the memory ids of the requests to the plan returned by GetAllocationPlan()
+    template <class ElemType>
+    void RecordAllocation(const vector<MemRequestInfo<ElemType>>& memInfoVec)
+    {
+        for (const auto& memInfo : memInfoVec)
+            m_lastAllocation.push_back({ memInfo.allocStep, memInfo.releaseStep, sizeof(ElemType), memInfo.deviceId, memInfo.matrixSize, memInfo.mbScale, memInfo.isWorkSpace, memInfo.memoryId });
     }
 };
 
@@ -241,6 +241,204 @@ protected:
 template class CrossEntropyWithSoftmaxNode<float>;
 template class CrossEntropyWithSoftmaxNode<double>;
 
+// -----------------------------------------------------------------------
+// TiledCrossEntropyWithSoftmaxNode (labels, hidden, weight)
+//  - Input(0) [V x T] labels
+//  - Input(1) [H x T] hidden layer activation
+//  - Input(2) [H x V] weight matrix of the output projection
+// calculates: -sum(left_i * log(softmax_i(weight' * hidden))), i.e. CrossEntropyWithSoftmax(labels, TransposeTimes(weight, hidden)),
+// without storing the [V x T] logits: they are formed m_tileSize rows at a time and reduced into a log-sum-exp per column,
+// and recomputed the same way for the gradients. This bounds the temporary memory by [m_tileSize x T] for large vocabularies.
+// Only implemented on the CPU.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class TiledCrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"TiledCrossEntropyWithSoftmax"; }
+
+    // our inputs
+    static const size_t LABELDATA = 0;
+    static const size_t INPUTDATA = 1;
+    static const size_t WEIGHTMATRIX = 2;
+
+public:
+    TiledCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t tileSize = 0)
+        : Base(deviceId, name), m_tileSize(tileSize), m_ones(deviceId), m_isLabelsTermDone()
+    {
+    }
+    TiledCrossEntropyWithSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : TiledCrossEntropyWithSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"tileSize"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_tileSize;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_tileSize;
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (inputIndex == LABELDATA)
+            InvalidArgument("%ls %ls operation only takes gradients with respect to the hidden activation and the weight.", NodeName().c_str(), OperationName().c_str());
+
+        FrameRange fr(InputRef(LABELDATA).GetMBLayout());
+        auto labels = InputRef(LABELDATA).ValueFor(fr); // (gaps were masked in ForwardProp)
+        auto hidden = InputRef(INPUTDATA).ValueFor(fr);
+        auto& weight = InputRef(WEIGHTMATRIX).ValueAsMatrix();
+        ElemType gradient = Gradient().Get00Element();
+
+        // The gradient w.r.t. the logits is gradient * (labelSums(j) * softmax(logits(., j)) - labels(., j)).
+        // The labels term does not need the logits.
+        if (inputIndex == INPUTDATA)
+        {
+            auto hiddenGradient = InputRef(INPUTDATA).GradientFor(fr);
+            Matrix<ElemType>::ScaleAndAdd(-gradient, *m_weightedLabels, hiddenGradient);
+        }
+        else
+            Matrix<ElemType>::MultiplyAndWeightedAdd(-gradient, hidden, false, labels, true, 1, InputRef(WEIGHTMATRIX).GradientAsMatrix());
+
+        // The softmax term recomputes the logits, so it is done once for both inputs, by whichever call comes last
+        // of the inputs that need a gradient (the gradients of all of them have been initialized by then).
+        m_isLabelsTermDone[inputIndex] = true;
+        if ((InputRef(INPUTDATA).NeedsGradient() && !m_isLabelsTermDone[INPUTDATA]) ||
+            (InputRef(WEIGHTMATRIX).NeedsGradient() && !m_isLabelsTermDone[WEIGHTMATRIX]))
+            return;
+        m_isLabelsTermDone[INPUTDATA] = m_isLabelsTermDone[WEIGHTMATRIX] = false;
+
+        m_scaledLabelSums->AssignProductOf(gradient, *m_labelSums);
+        auto weightGradient = InputRef(WEIGHTMATRIX).NeedsGradient() ? &InputRef(WEIGHTMATRIX).GradientAsMatrix() : nullptr;
+        if (InputRef(INPUTDATA).NeedsGradient())
+        {
+            auto hiddenGradient = InputRef(INPUTDATA).GradientFor(fr);
+            Matrix<ElemType>::TiledLogSumExpOfTransposeProductBackprop(weight, hidden, *m_logSumExp, *m_scaledLabelSums, GetTileSize(hidden.GetNumCols()), &hiddenGradient, weightGradient);
+        }
+        else
+            Matrix<ElemType>::TiledLogSumExpOfTransposeProductBackprop(weight, hidden, *m_logSumExp, *m_scaledLabelSums, GetTileSize(hidden.GetNumCols()), nullptr, weightGradient);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+
+    // -sum(left_i * log(softmax_i(weight' * hidden))) = sum_j (labelSums(j) * logSumExp(j) - labels(., j)' * weight' * hidden(., j))
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(InputRef(LABELDATA).GetMBLayout());
+        // flatten all gaps to zero, such that gaps will contribute zero to the sum
+        auto labels = InputRef(LABELDATA).MaskedValueFor(fr);
+        auto hidden = InputRef(INPUTDATA).MaskedValueFor(fr);
+        auto& weight = InputRef(WEIGHTMATRIX).ValueAsMatrix();
+
+        Matrix<ElemType>::TiledLogSumExpOfTransposeProduct(weight, hidden, GetTileSize(hidden.GetNumCols()), *m_logSumExp);
+
+        if (m_ones.GetNumRows() != 1 || m_ones.GetNumCols() != weight.GetNumCols())
+        {
+            m_ones.Resize(1, weight.GetNumCols());
+            m_ones.SetValue(1);
+        }
+        m_labelSums->AssignProductOf(m_ones, false, labels, false);
+        m_weightedLabels->AssignProductOf(weight, false, labels, false);
+        m_isLabelsTermDone[INPUTDATA] = m_isLabelsTermDone[WEIGHTMATRIX] = false;
+
+        Value().VerifySize(1, 1);
+        Value().SetValue(Matrix<ElemType>::InnerProductOfMatrices(*m_labelSums, *m_logSumExp) - Matrix<ElemType>::InnerProductOfMatrices(*m_weightedLabels, hidden));
+#if NANCHECK
+        Value().HasNan("TiledCrossEntropyWithSoftmax");
+#endif
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        // the weight can be inferred from the hidden and label dimensions
+        Input(WEIGHTMATRIX)->ValidateInferInputDimsFrom(TensorShape(Input(INPUTDATA)->GetSampleMatrixNumRows(), Input(LABELDATA)->GetSampleMatrixNumRows()));
+
+        if (isFinalValidationPass)
+        {
+            if (Input(WEIGHTMATRIX)->HasMBLayout())
+                InvalidArgument("%ls %ls operation requires the weight (input 2) not to have a dynamic axis.", NodeName().c_str(), OperationName().c_str());
+            if (Input(INPUTDATA)->GetSampleMatrixNumRows() != Input(WEIGHTMATRIX)->GetAsMatrixNumRows() ||
+                Input(LABELDATA)->GetSampleMatrixNumRows() != Input(WEIGHTMATRIX)->GetAsMatrixNumCols())
+                InvalidArgument("%ls %ls operation requires the weight (input 2) to be a [%d x %d] matrix for the hidden activation and labels, but it is [%s].",
+                                NodeName().c_str(), OperationName().c_str(), (int)Input(INPUTDATA)->GetSampleMatrixNumRows(), (int)Input(LABELDATA)->GetSampleMatrixNumRows(),
+                                string(Input(WEIGHTMATRIX)->GetSampleLayout()).c_str());
+            if (!Input(LABELDATA)->HasMBLayout() || Input(LABELDATA)->GetMBLayout() != Input(INPUTDATA)->GetMBLayout())
+                InvalidArgument("%ls %ls operation requires that the labels (input 0) and hidden activation (input 1) have the same dynamic axes.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TiledCrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
+            node->m_tileSize = m_tileSize;
+        }
+    }
+
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_logSumExp, matrixPool);
+        RequestMatrixFromPool(m_labelSums, matrixPool);
+        RequestMatrixFromPool(m_weightedLabels, matrixPool);
+    }
+
+    // request matrices that are needed for gradient computation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_scaledLabelSums, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_logSumExp, matrixPool);
+        ReleaseMatrixToPool(m_labelSums, matrixPool);
+        ReleaseMatrixToPool(m_weightedLabels, matrixPool);
+        ReleaseMatrixToPool(m_scaledLabelSums, matrixPool);
+    }
+
+    size_t TileSize() const { return m_tileSize; }
+
+private:
+    // rows of the logits formed at a time; by default as many as fit into about 1 MB for the given number of columns
+    size_t GetTileSize(size_t numColumns) const
+    {
+        if (m_tileSize > 0)
+            return m_tileSize;
+        return std::max<size_t>(64, (1 << 20) / (std::max<size_t>(numColumns, 1) * sizeof(ElemType)));
+    }
+
+protected:
+    size_t m_tileSize; // 0 = chosen from the minibatch size
+    Matrix<ElemType> m_ones;
+    shared_ptr<Matrix<ElemType>> m_logSumExp;       // [1 x T] log-sum-exp of the columns of the logits
+    shared_ptr<Matrix<ElemType>> m_labelSums;       // [1 x T] sum of the labels of each column
+    shared_ptr<Matrix<ElemType>> m_weightedLabels;  // [H x T] weight * labels
+    shared_ptr<Matrix<ElemType>> m_scaledLabelSums; // [1 x T] m_labelSums scaled by the gradient, in BackpropTo
+    bool m_isLabelsTermDone[3];                     // inputs whose gradients got the labels term, but not yet the softmax term
+};
+
+template class TiledCrossEntropyWithSoftmaxNode<float>;
+template class TiledCrossEntropyWithSoftmaxNode<double>;
+
 // -----------------------------------------------------------------------
 /// CrossEntropyNode (labels, prediction)
 // -----------------------------------------------------------------------
@@ -1906,10 +2104,6 @@ public:
                                const Matrix<ElemType>& lbls,
                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
     {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
         int firstLbl = -1;
         for (int ik = 0; ik < lbls.GetNumRows(); ik++)
             if (lbls(ik, 0) != 0)
@@ -1917,26 +2111,13 @@ public:
                 firstLbl = ik;
                 break;
             }
+        if (firstLbl < 0)
+            InvalidArgument("CRFNode: the first label column has no label set.");
 
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
+        // a single sequence, see the BUGBUG in ForwardPropNonLooping()
+        Matrix<ElemType>::CRFForwardCompute(pos_scores, pair_scores,
+                                            vector<size_t>(1, 0), vector<size_t>(1, 0), vector<size_t>(1, lbls.GetNumCols()),
+                                            vector<size_t>(1, (size_t) firstLbl), 1, alpha);
     }
 
     // compute backward algorithm
@@ -2905,8 +3086,10 @@ public:
             if (m_bnEng == nullptr)
             {
                 auto shape = GetSampleLayout();
+                // The direct engine is the CPU counterpart of the CNTK engine.
+                auto cntkEngines = (BatchNormEngineKind)((int)BatchNormEngineKind::Cntk | (int)BatchNormEngineKind::Direct);
                 m_bnEng = BatchNormEngine<ElemType, StatType>::Create(m_deviceId, shape, m_spatial, m_imageLayoutKind,
-                                                            m_useCntkEngine ? BatchNormEngineKind::Cntk : BatchNormEngineKind::CuDnn);
+                                                            m_useCntkEngine ? cntkEngines : BatchNormEngineKind::CuDnn);
             }
 
             if (m_disableRegularization)
@@ -253,6 +253,8 @@ template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
+    if (this->m_config(L"optimizeForInference", false) && !this->m_net->AreMatricesAllocated())
+        this->m_net->template OptimizeForInference<ElemType>(outputNodeNames);
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
     // allocate memory for forward computation
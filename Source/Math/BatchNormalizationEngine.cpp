@@ -7,6 +7,7 @@
 #include "BatchNormalizationEngine.h"
 #include "CuDnnFactories.h"
 #include "MklDnnCommon.h"
+#include "DirectBatchNormalization.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -446,6 +447,195 @@ template class CntkBatchNormEngine<float, float>;
 template class CntkBatchNormEngine<double, double>;
 template class CntkBatchNormEngine<half, float>;
 
+//------------------------------------------------------------------
+// Direct batch normalization engine: single pass statistics and fused per-channel transforms on CPU.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectBatchNormEngine : public BatchNormEngine<ElemType, ElemType>
+{
+public:
+    using Base = BatchNormEngine<ElemType, ElemType>;
+    using typename Base::InoutMat;
+    using typename Base::StatMat;
+
+public:
+    DirectBatchNormEngine(DEVICEID_TYPE deviceId, const TensorShape& inOutT, bool spatial, ImageLayoutKind imageLayout)
+        : Base(deviceId, inOutT, spatial, imageLayout)
+    {
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, bool spatial, ImageLayoutKind imageLayout)
+    {
+        return deviceId < 0 && !(spatial && imageLayout == ImageLayoutKind::HWC);
+    }
+
+protected:
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_inOutT;
+    using Base::m_spatial;
+
+    void EnsureCompatible() override
+    {
+        if (m_spatial && m_imageLayout == ImageLayoutKind::HWC)
+            InvalidArgument("Direct batch normalization engine supports only cudnn(CHW) layout.");
+        if (m_deviceId >= 0)
+            InvalidArgument("Direct batch normalization engine supports only CPU device.");
+    }
+
+    // Same statistics, running averages and blending as the GPU kernels of the CNTK engine (CntkBatchNormalization.cuh).
+    // The normalization itself is then out = in * a + b with a = scale * invStdDev and b = bias - mean * a.
+    void ForwardCore(const InoutMat& in, const StatMat& scale, const StatMat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, StatMat& runMean, StatMat& runVariance,
+                     InoutMat& out, double epsilon, StatMat& savedMean, StatMat& savedInvStdDev) override
+    {
+        size_t channels = scale.GetNumRows();
+        size_t batchSize = in.GetNumCols();
+        auto& kernel = Kernel(channels);
+
+        const ElemType* runMeanData = runMean.Data();
+        const ElemType* runVarianceData = runVariance.Data();
+        const ElemType* scaleData = scale.Data();
+        const ElemType* biasData = bias.Data();
+        m_a.resize(channels);
+        m_b.resize(channels);
+        if (inferenceOnly)
+        {
+            savedMean.Resize(0, 0);
+            savedInvStdDev.Resize(0, 0);
+            for (size_t c = 0; c < channels; c++)
+            {
+                double a = scaleData[c] / sqrt((double)runVarianceData[c] + epsilon);
+                m_a[c] = (ElemType)a;
+                m_b[c] = (ElemType)(biasData[c] - runMeanData[c] * a);
+            }
+        }
+        else
+        {
+            savedMean.Resize(runMean);
+            savedInvStdDev.Resize(runMean);
+            ElemType* xMean = savedMean.Data();
+            ElemType* xInvStdDev = savedInvStdDev.Data();
+            ElemType* runMeanOut = runMean.Data();
+            ElemType* runVarianceOut = runVariance.Data();
+            if (expAvgFactor != 0 || blendFactor != 1)
+            {
+                m_mean.resize(channels);
+                m_m2.resize(channels);
+                kernel.Statistics(in.Data(), batchSize, m_mean.data(), m_m2.data());
+                double count = (double)batchSize * kernel.SpatialSize();
+                for (size_t c = 0; c < channels; c++)
+                {
+                    runMeanOut[c] = (ElemType)(expAvgFactor * m_mean[c] + (1.0 - expAvgFactor) * runMeanOut[c]);
+                    xMean[c] = (ElemType)(blendFactor * runMeanOut[c] + (1.0 - blendFactor) * m_mean[c]);
+
+                    double variance = count == 1 ? 0 : m_m2[c] / (count - 1);
+                    runVarianceOut[c] = (ElemType)(expAvgFactor * variance + (1.0 - expAvgFactor) * runVarianceOut[c]);
+                    double invStdDev = 1 / sqrt(m_m2[c] / count + epsilon);
+                    if (blendFactor != 0)
+                        invStdDev = blendFactor / sqrt((double)runVarianceOut[c] + epsilon) + (1.0 - blendFactor) * invStdDev;
+                    xInvStdDev[c] = (ElemType)invStdDev;
+                }
+            }
+            else
+            {
+                for (size_t c = 0; c < channels; c++)
+                {
+                    xMean[c] = runMeanOut[c];
+                    xInvStdDev[c] = (ElemType)(1 / sqrt((double)runVarianceOut[c] + epsilon));
+                }
+            }
+            for (size_t c = 0; c < channels; c++)
+            {
+                m_a[c] = scaleData[c] * xInvStdDev[c];
+                m_b[c] = biasData[c] - xMean[c] * m_a[c];
+            }
+        }
+
+        kernel.ScaleShift(in.Data(), out.Data(), batchSize, m_a.data(), m_b.data());
+    }
+
+    // With xHat = (in - mean) * invStdDev and w = 1 - blendFactor (the weight of the minibatch statistics),
+    //   grad += scale * invStdDev * (srcGrad - w * (xHat * scaleGrad + biasGrad) / count),
+    // which is grad += srcGrad * a + in * b + c with per-channel a, b, c once scaleGrad and biasGrad are known.
+    void BackwardCore(const InoutMat& in, const InoutMat& srcGrad, InoutMat& grad, const StatMat& scale, double blendFactor, const StatMat& savedMean, const StatMat& savedInvStdDev,
+                      StatMat& scaleGrad, StatMat& biasGrad, bool accumulateDataGrad) override
+    {
+        size_t channels = scale.GetNumRows();
+        size_t batchSize = in.GetNumCols();
+        auto& kernel = Kernel(channels);
+
+        const ElemType* mean = savedMean.Data();
+        const ElemType* invStdDev = savedInvStdDev.Data();
+        const ElemType* scaleData = scale.Data();
+        kernel.ScaleBiasGradients(in.Data(), srcGrad.Data(), batchSize, mean, invStdDev, scaleGrad.Data(), biasGrad.Data());
+
+        const ElemType* dScale = scaleGrad.Data();
+        const ElemType* dBias = biasGrad.Data();
+        double weight = (1 - blendFactor) / ((double)batchSize * kernel.SpatialSize());
+        m_a.resize(channels);
+        m_b.resize(channels);
+        m_c.resize(channels);
+        for (size_t c = 0; c < channels; c++)
+        {
+            double a = (double)scaleData[c] * invStdDev[c];
+            double b = a * weight * dScale[c] * invStdDev[c];
+            m_a[c] = (ElemType)a;
+            m_b[c] = (ElemType)-b;
+            m_c[c] = (ElemType)(b * mean[c] - a * weight * dBias[c]);
+        }
+
+        kernel.InputGradient(in.Data(), srcGrad.Data(), grad.Data(), batchSize, m_a.data(), m_b.data(), m_c.data(), accumulateDataGrad);
+    }
+
+private:
+    DirectBatchNormalization<ElemType>& Kernel(size_t channels)
+    {
+        if (!m_kernel || m_kernel->Channels() != channels)
+            m_kernel = std::make_unique<DirectBatchNormalization<ElemType>>(m_inOutT.GetNumElements() / channels, channels);
+        return *m_kernel;
+    }
+
+    std::unique_ptr<DirectBatchNormalization<ElemType>> m_kernel;
+    // Per-channel statistics and coefficients of the transforms.
+    std::vector<double> m_mean;
+    std::vector<double> m_m2;
+    std::vector<ElemType> m_a;
+    std::vector<ElemType> m_b;
+    std::vector<ElemType> m_c;
+};
+
+template class DirectBatchNormEngine<float>;
+template class DirectBatchNormEngine<double>;
+
+// The direct engine computes its statistics in the type of its inputs, so it exists only if both types are the same.
+template <class InoutType, class StatType>
+struct DirectBatchNormEngineFactory
+{
+    static bool IsSupported(DEVICEID_TYPE, bool, ImageLayoutKind)
+    {
+        return false;
+    }
+
+    static std::unique_ptr<BatchNormEngine<InoutType, StatType>> Create(DEVICEID_TYPE, const TensorShape&, bool, ImageLayoutKind)
+    {
+        return nullptr;
+    }
+};
+
+template <class ElemType>
+struct DirectBatchNormEngineFactory<ElemType, ElemType>
+{
+    static bool IsSupported(DEVICEID_TYPE deviceId, bool spatial, ImageLayoutKind imageLayout)
+    {
+        return DirectBatchNormEngine<ElemType>::IsSupported(deviceId, spatial, imageLayout);
+    }
+
+    static std::unique_ptr<BatchNormEngine<ElemType, ElemType>> Create(DEVICEID_TYPE deviceId, const TensorShape& inOutT, bool spatial, ImageLayoutKind imageLayout)
+    {
+        return std::make_unique<DirectBatchNormEngine<ElemType>>(deviceId, inOutT, spatial, imageLayout);
+    }
+};
+
 template <typename T> bool HasFlag(T src, T testFlag)
 {
     return ((int)src & (int)testFlag) != 0;
@@ -456,6 +646,21 @@ std::unique_ptr<BatchNormEngine<InoutType, StatType>> BatchNormEngine<InoutType,
                                                                              bool spatial, ImageLayoutKind imageLayout,
                                                                              BatchNormEngineKind enabledEngines)
 {
+    // On CPU the direct engine is preferred, unless the CNTK engine can use MKL-DNN.
+    bool mklEnabled = false;
+#ifdef USE_MKL2017DNN
+    mklEnabled = true;
+#endif
+    if (HasFlag(enabledEngines, BatchNormEngineKind::Direct) &&
+        (!mklEnabled || !HasFlag(enabledEngines, BatchNormEngineKind::Cntk)) &&
+        DirectBatchNormEngineFactory<InoutType, StatType>::IsSupported(deviceId, spatial, imageLayout))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "Using direct batch normalization engine.\n");
+
+        return DirectBatchNormEngineFactory<InoutType, StatType>::Create(deviceId, inOutT, spatial, imageLayout);
+    }
+
     // Use CNTK as default batch norm engine.
     if (HasFlag(enabledEngines, BatchNormEngineKind::Cntk))
     {
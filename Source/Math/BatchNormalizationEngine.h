@@ -18,8 +18,9 @@ enum class BatchNormEngineKind
     None  = 0,
     Cntk  = 1,
     CuDnn = 1 << 1,
+    Direct = 1 << 2, // Single pass statistics and fused per-channel transforms, CPU only.
 
-    All  = Cntk  | CuDnn
+    All  = Cntk  | CuDnn | Direct
 };
 
 #pragma warning(push)
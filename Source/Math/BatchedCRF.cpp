@@ -0,0 +1,211 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "BatchedCRF.h"
+#include "CommonMatrix.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define SIMD_PRAGMA(x) _Pragma(#x)
+#define SIMD_LOOP _Pragma("omp simd")
+#define SIMD_MAX_LOOP(...) SIMD_PRAGMA(omp simd reduction(max : __VA_ARGS__))
+#define SIMD_SUM_LOOP(...) SIMD_PRAGMA(omp simd reduction(+ : __VA_ARGS__))
+#else
+#define SIMD_LOOP
+#define SIMD_MAX_LOOP(...)
+#define SIMD_SUM_LOOP(...)
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+BatchedCRF<ElemType>::BatchedCRF(const ElemType* pairScores, size_t numLabels)
+    : m_numLabels(numLabels), m_transposedPairScores(numLabels * numLabels)
+{
+    if (numLabels == 0)
+        InvalidArgument("BatchedCRF: the number of labels must be positive.");
+
+    for (size_t k = 0; k < numLabels; k++)
+        for (size_t j = 0; j < numLabels; j++)
+            m_transposedPairScores[j + k * numLabels] = pairScores[k + j * numLabels];
+}
+
+template <class ElemType>
+void BatchedCRF<ElemType>::CheckLabels(const std::vector<size_t>& labels) const
+{
+    for (size_t i = 0; i < labels.size(); i++)
+        if (labels[i] >= m_numLabels)
+            InvalidArgument("BatchedCRF: the label %d of sequence %d is out of range.", (int) labels[i], (int) i);
+}
+
+template <class ElemType>
+/*static*/ ElemType BatchedCRF<ElemType>::ArgMax(const ElemType* x, size_t n, ElemType floor, size_t& index)
+{
+    ElemType maxV = x[0];
+    SIMD_MAX_LOOP(maxV)
+    for (size_t j = 1; j < n; j++)
+        maxV = x[j] > maxV ? x[j] : maxV;
+
+    // same result as a scan with a strict comparison starting from 'floor'
+    if (maxV > floor)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            if (x[j] == maxV)
+            {
+                index = j;
+                break;
+            }
+        }
+    }
+    return maxV;
+}
+
+template <class ElemType>
+/*static*/ ElemType BatchedCRF<ElemType>::LogSumExp(const ElemType* x, size_t n)
+{
+    ElemType maxV = x[0];
+    SIMD_MAX_LOOP(maxV)
+    for (size_t j = 1; j < n; j++)
+        maxV = x[j] > maxV ? x[j] : maxV;
+
+    ElemType sum = 0;
+    SIMD_SUM_LOOP(sum)
+    for (size_t j = 0; j < n; j++)
+        sum += exp(x[j] - maxV);
+
+    return maxV + log(sum);
+}
+
+template <class ElemType>
+void BatchedCRF<ElemType>::Viterbi(const ElemType* posScores, size_t numChannels,
+                                   const std::vector<size_t>& uttToChanInd, const std::vector<size_t>& uttBeginFrame, const std::vector<size_t>& uttFrameNum,
+                                   const std::vector<size_t>& uttStartLabel, const std::vector<size_t>& uttEndLabel,
+                                   ElemType* alpha, ElemType* decodedPath) const
+{
+    const size_t numLabels = m_numLabels;
+    const ElemType logZero = (ElemType) LZERO;
+    CheckLabels(uttStartLabel);
+    CheckLabels(uttEndLabel);
+
+#pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < (long) uttFrameNum.size(); i++)
+    {
+        const size_t numFrames = uttFrameNum[i];
+        if (numFrames == 0)
+            continue;
+
+        const size_t startLabel = uttStartLabel[i];
+        const size_t endLabel = uttEndLabel[i];
+        auto Offset = [&](size_t t) { return ((uttBeginFrame[i] + t) * numChannels + uttToChanInd[i]) * numLabels; };
+
+        std::vector<size_t> backtrace(numLabels * numFrames);
+        std::vector<ElemType> scores(numLabels);
+
+        // the first label is constrained to the start label
+        ElemType* cur = alpha + Offset(0);
+        const ElemType* pos = posScores + Offset(0);
+        for (size_t k = 0; k < numLabels; k++)
+        {
+            cur[k] = (k == startLabel) ? pos[k] : logZero;
+            backtrace[k] = startLabel;
+        }
+
+        if (numFrames > 1)
+        {
+            const ElemType startScore = cur[startLabel];
+            cur = alpha + Offset(1);
+            pos = posScores + Offset(1);
+            for (size_t k = 0; k < numLabels; k++)
+            {
+                cur[k] = startScore + m_transposedPairScores[startLabel + k * numLabels] + pos[k];
+                backtrace[k + numLabels] = startLabel;
+            }
+        }
+
+        // like the per-sequence loop, a label none of whose predecessors scores above LZERO inherits the
+        // back pointer of the label before it
+        size_t best = startLabel;
+        for (size_t t = 2; t < numFrames; t++)
+        {
+            const ElemType* prev = alpha + Offset(t - 1);
+            cur = alpha + Offset(t);
+            pos = posScores + Offset(t);
+            for (size_t k = 0; k < numLabels; k++)
+            {
+                const ElemType* transitions = m_transposedPairScores.data() + k * numLabels;
+                SIMD_LOOP
+                for (size_t j = 0; j < numLabels; j++)
+                    scores[j] = prev[j] + transitions[j];
+
+                ElemType maxV = ArgMax(scores.data(), numLabels, logZero, best);
+                cur[k] = (maxV > logZero ? maxV : logZero) + pos[k];
+                backtrace[k + t * numLabels] = best;
+            }
+        }
+
+        for (size_t t = 0; t < numFrames; t++)
+            std::fill(decodedPath + Offset(t), decodedPath + Offset(t) + numLabels, (ElemType) 0);
+
+        size_t label = endLabel;
+        decodedPath[Offset(numFrames - 1) + label] = 1;
+        for (size_t t = numFrames - 1; t > 0; t--)
+        {
+            label = backtrace[label + t * numLabels];
+            decodedPath[Offset(t - 1) + label] = 1;
+        }
+    }
+}
+
+template <class ElemType>
+void BatchedCRF<ElemType>::Forward(const ElemType* posScores, size_t numChannels,
+                                   const std::vector<size_t>& uttToChanInd, const std::vector<size_t>& uttBeginFrame, const std::vector<size_t>& uttFrameNum,
+                                   const std::vector<size_t>& uttStartLabel,
+                                   ElemType* alpha) const
+{
+    const size_t numLabels = m_numLabels;
+    CheckLabels(uttStartLabel);
+
+#pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < (long) uttFrameNum.size(); i++)
+    {
+        const size_t numFrames = uttFrameNum[i];
+        if (numFrames == 0)
+            continue;
+
+        const size_t startLabel = uttStartLabel[i];
+        auto Offset = [&](size_t t) { return ((uttBeginFrame[i] + t) * numChannels + uttToChanInd[i]) * numLabels; };
+
+        // the alphas before the first frame
+        std::vector<ElemType> initial(numLabels, (ElemType) LZERO);
+        initial[startLabel] = 0;
+        std::vector<ElemType> scores(numLabels);
+
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            const ElemType* prev = (t == 0) ? initial.data() : alpha + Offset(t - 1);
+            ElemType* cur = alpha + Offset(t);
+            const ElemType* pos = posScores + Offset(t);
+            for (size_t k = 0; k < numLabels; k++)
+            {
+                const ElemType* transitions = m_transposedPairScores.data() + k * numLabels;
+                SIMD_LOOP
+                for (size_t j = 0; j < numLabels; j++)
+                    scores[j] = prev[j] + transitions[j];
+
+                cur[k] = LogSumExp(scores.data(), numLabels) + pos[k];
+            }
+        }
+    }
+}
+
+template class BatchedCRF<float>;
+template class BatchedCRF<double>;
+
+}}}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BatchedCRF.h -- CPU Viterbi decoding and forward (alpha) recursion of a linear-chain CRF for all sequences
+// of a minibatch at once.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Scores are matrices of [numLabels x numColumns] (column-major) in the minibatch layout: frame t of
+// sequence i is the column (uttBeginFrame[i] + t) * numChannels + uttToChanInd[i].
+// pairScores(k, j) is the score of label j followed by label k.
+//
+// The recursions over time are the ones of SequenceDecoderNode (Viterbi) and CRFNode (forward):
+// the first label of each sequence is constrained to uttStartLabel[i], and the decoded path ends in uttEndLabel[i].
+// Viterbi paths are identical to the ones of the per-sequence loops, including ties, which go to the lowest
+// previous label. The forward recursion sums over the previous labels as max + log(sum(exp(x - max)))
+// rather than with a chain of LogAdd() calls, so alphas differ in the last bits.
+//
+// For each label, the scores of all previous labels are combined in contiguous loops that vectorize:
+// the transition matrix is kept transposed, so that pairScores(k, .) is a contiguous row.
+// Sequences are processed in parallel, each by a single thread.
+template <class ElemType>
+class BatchedCRF
+{
+public:
+    BatchedCRF(const ElemType* pairScores, size_t numLabels);
+
+    size_t NumLabels() const { return m_numLabels; }
+
+    // Writes the Viterbi scores to 'alpha' and the one-hot decoded paths to 'decodedPath'.
+    // Columns of 'decodedPath' that belong to no sequence are left untouched.
+    void Viterbi(const ElemType* posScores, size_t numChannels,
+                 const std::vector<size_t>& uttToChanInd, const std::vector<size_t>& uttBeginFrame, const std::vector<size_t>& uttFrameNum,
+                 const std::vector<size_t>& uttStartLabel, const std::vector<size_t>& uttEndLabel,
+                 ElemType* alpha, ElemType* decodedPath) const;
+
+    // Writes the log-domain forward scores to 'alpha'.
+    void Forward(const ElemType* posScores, size_t numChannels,
+                 const std::vector<size_t>& uttToChanInd, const std::vector<size_t>& uttBeginFrame, const std::vector<size_t>& uttFrameNum,
+                 const std::vector<size_t>& uttStartLabel,
+                 ElemType* alpha) const;
+
+private:
+    // Sequences are checked before the parallel loops, which must not throw.
+    void CheckLabels(const std::vector<size_t>& labels) const;
+
+    // Returns the maximum of x[0..n-1] and, if it is above 'floor', sets 'index' to its first position.
+    static ElemType ArgMax(const ElemType* x, size_t n, ElemType floor, size_t& index);
+    // Returns log(sum(exp(x[0..n-1]))).
+    static ElemType LogSumExp(const ElemType* x, size_t n);
+
+    size_t m_numLabels;
+    std::vector<ElemType> m_transposedPairScores; // [j + k * numLabels] = pairScores(k, j)
+};
+
+}}}
@@ -0,0 +1,600 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "BlockedConvolution.h"
+#include "ConvolutionEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef USE_MKL
+#include <mkl_cblas.h>
+#else
+#include <cblas.h>
+#endif
+
+// Without the hint, compilers tend to vectorize the direct kernel across pixels instead of across channels.
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define SIMD_LOOP _Pragma("omp simd")
+#else
+#define SIMD_LOOP
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Number of output pixels of a row the direct kernel computes at once.
+static const size_t DirectRowBlock = 4;
+
+// Number of elements of a Winograd F(2x2,3x3) tile in the transformed domain.
+static const size_t WinogradTileSize = 16;
+
+// Winograd processes samples in chunks of about this many tiles, which bounds the workspace
+// and still gives the per tile element GEMMs enough columns.
+static const size_t WinogradTilesPerChunk = 2048;
+
+// Column-major GEMM: c = alpha * op(a) * op(b) + beta * c.
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda,
+                 const float* b, size_t ldb, float beta, float* c, size_t ldc)
+{
+    cblas_sgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, (int)m, (int)n, (int)k,
+                alpha, a, (int)lda, b, (int)ldb, beta, c, (int)ldc);
+}
+
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, double alpha, const double* a, size_t lda,
+                 const double* b, size_t ldb, double beta, double* c, size_t ldc)
+{
+    cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans, (int)m, (int)n, (int)k,
+                alpha, a, (int)lda, b, (int)ldb, beta, c, (int)ldc);
+}
+
+// Range [begin, end) of outputs o for which o * stride + offset is in [0, inSize).
+static void ValidOutputRange(int inSize, int outSize, int stride, int offset, size_t& begin, size_t& end)
+{
+    int first = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+    int last = inSize - 1 - offset >= 0 ? (inSize - 1 - offset) / stride : -1;
+    begin = (size_t)std::min(first, outSize);
+    end = (size_t)std::max((int)begin, std::min(last + 1, outSize));
+}
+
+static inline size_t WeightIndex(const BlockedConvolutionShape& s, size_t k, size_t c, size_t y, size_t x)
+{
+    return ((k * s.inC + c) * s.kernelH + y) * s.kernelW + x;
+}
+
+template <class ElemType>
+static inline ElemType Sigmoid(ElemType v)
+{
+    // exp() of a positive argument could overflow.
+    if (v >= 0)
+        return 1 / (1 + exp(-v));
+    ElemType e = exp(v);
+    return e / (1 + e);
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::Store(const Epilogue& epilogue, size_t k, const ElemType* values, size_t stride, size_t count, ElemType* dst)
+{
+    if (epilogue.accumulate)
+    {
+        for (size_t i = 0; i < count; i++)
+            dst[i] += values[i * stride];
+        return;
+    }
+
+    ElemType bias = epilogue.bias != nullptr ? epilogue.bias[k] : 0;
+    switch (epilogue.activation)
+    {
+    case FusedActivationKind::ReLU:
+        for (size_t i = 0; i < count; i++)
+            dst[i] = std::max(values[i * stride] + bias, (ElemType)0);
+        break;
+    case FusedActivationKind::Sigmoid:
+        for (size_t i = 0; i < count; i++)
+            dst[i] = Sigmoid(values[i * stride] + bias);
+        break;
+    case FusedActivationKind::Tanh:
+        for (size_t i = 0; i < count; i++)
+            dst[i] = tanh(values[i * stride] + bias);
+        break;
+    default:
+        for (size_t i = 0; i < count; i++)
+            dst[i] = values[i * stride] + bias;
+        break;
+    }
+}
+
+template <class ElemType>
+BlockedConvolution<ElemType>::BlockedConvolution(const BlockedConvolutionShape& shape)
+    : m_shape(shape), m_algorithm(AlgorithmFor(shape))
+{
+}
+
+template <class ElemType>
+typename BlockedConvolution<ElemType>::Algorithm BlockedConvolution<ElemType>::AlgorithmFor(const BlockedConvolutionShape& s)
+{
+    if (s.kernelW == 3 && s.kernelH == 3 && s.strideW == 1 && s.strideH == 1)
+        return Algorithm::Winograd;
+    if (s.kernelW == 1 && s.kernelH == 1 && s.strideW == 1 && s.strideH == 1 && s.padW == 0 && s.padH == 0 &&
+        s.outW == s.inW && s.outH == s.inH)
+        return Algorithm::Pointwise;
+    return Algorithm::Direct;
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::SetWeights(const ElemType* weights)
+{
+    const auto& s = m_shape;
+    size_t taps = s.kernelW * s.kernelH;
+    if (m_algorithm == Algorithm::Pointwise)
+    {
+        m_weights.assign(weights, weights + s.outC * s.inC);
+        return;
+    }
+
+    if (m_algorithm == Algorithm::Direct)
+    {
+        m_weights.assign(NumOutBlocks() * s.inC * taps * BlockSize, 0);
+        for (size_t k = 0; k < s.outC; k++)
+        {
+            for (size_t c = 0; c < s.inC; c++)
+            {
+                for (size_t t = 0; t < taps; t++)
+                    m_weights[((k / BlockSize * s.inC + c) * taps + t) * BlockSize + k % BlockSize] = weights[(k * s.inC + c) * taps + t];
+            }
+        }
+        return;
+    }
+
+    m_weights.resize(WinogradTileSize * s.inC * s.outC);
+    size_t stride = s.inC * s.outC;
+    for (size_t k = 0; k < s.outC; k++)
+    {
+        for (size_t c = 0; c < s.inC; c++)
+        {
+            const ElemType* g = weights + WeightIndex(s, k, c, 0, 0);
+            // G g, with G = [1 0 0; 1/2 1/2 1/2; 1/2 -1/2 1/2; 0 0 1], rows are y.
+            ElemType gg[4][3];
+            for (size_t x = 0; x < 3; x++)
+            {
+                gg[0][x] = g[x];
+                gg[1][x] = (g[x] + g[3 + x] + g[6 + x]) / 2;
+                gg[2][x] = (g[x] - g[3 + x] + g[6 + x]) / 2;
+                gg[3][x] = g[6 + x];
+            }
+            // (G g) G^T
+            ElemType* u = m_weights.data() + c * s.outC + k;
+            for (size_t i = 0; i < 4; i++)
+            {
+                u[(i * 4 + 0) * stride] = gg[i][0];
+                u[(i * 4 + 1) * stride] = (gg[i][0] + gg[i][1] + gg[i][2]) / 2;
+                u[(i * 4 + 2) * stride] = (gg[i][0] - gg[i][1] + gg[i][2]) / 2;
+                u[(i * 4 + 3) * stride] = gg[i][2];
+            }
+        }
+    }
+}
+
+template <class ElemType>
+size_t BlockedConvolution<ElemType>::WinogradSamplesPerChunk(size_t batchSize) const
+{
+    return std::max((size_t)1, std::min(batchSize, WinogradTilesPerChunk / WinogradTilesPerSample()));
+}
+
+template <class ElemType>
+size_t BlockedConvolution<ElemType>::ForwardWorkspaceSize(size_t batchSize) const
+{
+    if (m_algorithm != Algorithm::Winograd)
+        return 0;
+    // Transformed input tiles and their products with the transformed kernels.
+    return WinogradTileSize * (m_shape.inC + m_shape.outC) * WinogradTilesPerSample() * WinogradSamplesPerChunk(batchSize);
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::Forward(const ElemType* in, ElemType* out, size_t batchSize, bool accumulate, ElemType* workspace) const
+{
+    Forward(in, out, batchSize, Epilogue{ accumulate, nullptr, FusedActivationKind::None }, workspace);
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::ForwardBiasActivation(const ElemType* in, ElemType* out, size_t batchSize, const ElemType* bias,
+                                                         FusedActivationKind activation, ElemType* workspace) const
+{
+    Forward(in, out, batchSize, Epilogue{ false, bias, activation }, workspace);
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::Forward(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue, ElemType* workspace) const
+{
+    if (m_algorithm == Algorithm::Winograd)
+        return ForwardWinograd(in, out, batchSize, epilogue, workspace);
+    if (m_algorithm == Algorithm::Pointwise)
+        return ForwardPointwise(in, out, batchSize, epilogue);
+
+    size_t numBlocks = NumOutBlocks();
+    size_t outH = m_shape.outH;
+    long work = (long)(batchSize * numBlocks * outH);
+#pragma omp parallel for
+    for (long i = 0; i < work; i++)
+    {
+        size_t n = i / (numBlocks * outH);
+        size_t rest = i % (numBlocks * outH);
+        ForwardDirect(in + n * InSize(), out + n * OutSize(), epilogue, rest / outH, rest % outH);
+    }
+}
+
+// Accumulates DirectRowBlock pixels of a row whose taps are all inside of the input in the columns.
+// Kept separate so that the accumulators stay in registers.
+template <class ElemType, size_t BlockSize>
+static inline void DirectInteriorBlock(const BlockedConvolutionShape& s, const ElemType* blockWeights, const ElemType* in,
+                                       int ihOrigin, int iwOrigin, ElemType (&result)[DirectRowBlock][BlockSize])
+{
+    ElemType acc[DirectRowBlock][BlockSize] = {};
+    const size_t taps = s.kernelW * s.kernelH;
+    const size_t strideW = s.strideW;
+    for (size_t c = 0; c < s.inC; c++)
+    {
+        for (size_t y = 0; y < s.kernelH; y++)
+        {
+            int ih = ihOrigin + (int)y;
+            if (ih < 0 || ih >= (int)s.inH)
+                continue;
+            const ElemType* pixel = in + (c * s.inH + ih) * s.inW + iwOrigin;
+            const ElemType* w = blockWeights + (c * taps + y * s.kernelW) * BlockSize;
+            for (size_t x = 0; x < s.kernelW; x++, w += BlockSize, pixel++)
+            {
+                ElemType wv[BlockSize];
+                for (size_t l = 0; l < BlockSize; l++)
+                    wv[l] = w[l];
+                ElemType v[DirectRowBlock];
+                for (size_t r = 0; r < DirectRowBlock; r++)
+                    v[r] = pixel[r * strideW];
+                for (size_t r = 0; r < DirectRowBlock; r++)
+                {
+                    SIMD_LOOP
+                    for (size_t l = 0; l < BlockSize; l++)
+                        acc[r][l] += v[r] * wv[l];
+                }
+            }
+        }
+    }
+    memcpy(result, acc, sizeof(acc));
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::ForwardDirect(const ElemType* in, ElemType* out, const Epilogue& epilogue, size_t outBlock, size_t oh) const
+{
+    const auto& s = m_shape;
+    const size_t taps = s.kernelW * s.kernelH;
+    const ElemType* blockWeights = m_weights.data() + outBlock * s.inC * taps * BlockSize;
+    size_t kEnd = std::min(s.outC, (outBlock + 1) * BlockSize);
+    int ihOrigin = (int)(oh * s.strideH) - s.padH;
+
+    // Pixels whose taps are all inside of the input in the columns.
+    size_t interiorBegin, interiorEnd;
+    ValidOutputRange((int)s.inW - (int)s.kernelW + 1, (int)s.outW, (int)s.strideW, -s.padW, interiorBegin, interiorEnd);
+
+    for (size_t ow = 0; ow < s.outW; ow += DirectRowBlock)
+    {
+        size_t rb = std::min(DirectRowBlock, s.outW - ow);
+        int iwOrigin = (int)(ow * s.strideW) - s.padW;
+
+        ElemType acc[DirectRowBlock][BlockSize] = {};
+        if (rb == DirectRowBlock && ow >= interiorBegin && ow + rb <= interiorEnd)
+            DirectInteriorBlock(s, blockWeights, in, ihOrigin, iwOrigin, acc);
+        else
+        {
+            for (size_t c = 0; c < s.inC; c++)
+            {
+                for (size_t y = 0; y < s.kernelH; y++)
+                {
+                    int ih = ihOrigin + (int)y;
+                    if (ih < 0 || ih >= (int)s.inH)
+                        continue;
+                    const ElemType* row = in + (c * s.inH + ih) * s.inW;
+                    const ElemType* w = blockWeights + (c * taps + y * s.kernelW) * BlockSize;
+                    for (size_t x = 0; x < s.kernelW; x++, w += BlockSize)
+                    {
+                        for (size_t r = 0; r < rb; r++)
+                        {
+                            int iw = iwOrigin + (int)(r * s.strideW + x);
+                            if (iw < 0 || iw >= (int)s.inW)
+                                continue;
+                            ElemType v = row[iw];
+                            for (size_t l = 0; l < BlockSize; l++)
+                                acc[r][l] += v * w[l];
+                        }
+                    }
+                }
+            }
+        }
+
+        for (size_t k = outBlock * BlockSize; k < kEnd; k++)
+            Store(epilogue, k, &acc[0][k % BlockSize], BlockSize, rb, out + (k * s.outH + oh) * s.outW + ow);
+    }
+}
+
+// Winograd F(2x2,3x3) (Lavin & Gray, 2015): every 2x2 output tile is A^T [sum over c of (G g G^T) .* (B^T d B)] A,
+// where d is the 4x4 input tile and g the 3x3 kernel. The sum over input channels is one GEMM per tile element.
+template <class ElemType>
+void BlockedConvolution<ElemType>::ForwardWinograd(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue, ElemType* workspace) const
+{
+    const auto& s = m_shape;
+    size_t tileRows = (s.outH + 1) / 2;
+    size_t tileCols = (s.outW + 1) / 2;
+    size_t tilesPerSample = WinogradTilesPerSample();
+    size_t samplesPerChunk = WinogradSamplesPerChunk(batchSize);
+    for (size_t start = 0; start < batchSize; start += samplesPerChunk)
+    {
+        size_t numSamples = std::min(samplesPerChunk, batchSize - start);
+        size_t numTiles = numSamples * tilesPerSample;
+        // [inC x tiles] and [outC x tiles] column-major matrices, one per tile element.
+        ElemType* transformedIn = workspace;
+        ElemType* transformedOut = workspace + WinogradTileSize * s.inC * numTiles;
+
+        // B^T d B, with B^T = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1].
+        long work = (long)(numSamples * tileRows);
+#pragma omp parallel for
+        for (long i = 0; i < work; i++)
+        {
+            size_t n = i / tileRows;
+            size_t tileRow = i % tileRows;
+            const ElemType* sample = in + (start + n) * InSize();
+            int ihOrigin = (int)(tileRow * 2) - s.padH;
+            size_t stride = numTiles * s.inC;
+            for (size_t tc = 0; tc < tileCols; tc++)
+            {
+                size_t tile = n * tilesPerSample + tileRow * tileCols + tc;
+                int iwOrigin = (int)(tc * 2) - s.padW;
+                for (size_t c = 0; c < s.inC; c++)
+                {
+                    ElemType d[4][4];
+                    for (int r = 0; r < 4; r++)
+                    {
+                        int ih = ihOrigin + r;
+                        for (int j = 0; j < 4; j++)
+                        {
+                            int iw = iwOrigin + j;
+                            bool inside = ih >= 0 && ih < (int)s.inH && iw >= 0 && iw < (int)s.inW;
+                            d[r][j] = inside ? sample[(c * s.inH + ih) * s.inW + iw] : 0;
+                        }
+                    }
+                    ElemType bd[4][4];
+                    for (int j = 0; j < 4; j++)
+                    {
+                        bd[0][j] = d[0][j] - d[2][j];
+                        bd[1][j] = d[1][j] + d[2][j];
+                        bd[2][j] = d[2][j] - d[1][j];
+                        bd[3][j] = d[1][j] - d[3][j];
+                    }
+                    ElemType* v = transformedIn + tile * s.inC + c;
+                    for (int r = 0; r < 4; r++)
+                    {
+                        v[(r * 4 + 0) * stride] = bd[r][0] - bd[r][2];
+                        v[(r * 4 + 1) * stride] = bd[r][1] + bd[r][2];
+                        v[(r * 4 + 2) * stride] = bd[r][2] - bd[r][1];
+                        v[(r * 4 + 3) * stride] = bd[r][1] - bd[r][3];
+                    }
+                }
+            }
+        }
+
+        for (size_t e = 0; e < WinogradTileSize; e++)
+        {
+            Gemm(false, false, s.outC, numTiles, s.inC, 1, m_weights.data() + e * s.outC * s.inC, s.outC,
+                 transformedIn + e * s.inC * numTiles, s.inC, 0, transformedOut + e * s.outC * numTiles, s.outC);
+        }
+
+        // A^T m A, with A^T = [1 1 1 0; 0 1 -1 -1].
+#pragma omp parallel for
+        for (long i = 0; i < work; i++)
+        {
+            size_t n = i / tileRows;
+            size_t tileRow = i % tileRows;
+            ElemType* sample = out + (start + n) * OutSize();
+            size_t oh = tileRow * 2;
+            size_t rows = std::min((size_t)2, s.outH - oh);
+            size_t stride = numTiles * s.outC;
+            for (size_t tc = 0; tc < tileCols; tc++)
+            {
+                size_t tile = n * tilesPerSample + tileRow * tileCols + tc;
+                size_t ow = tc * 2;
+                size_t cols = std::min((size_t)2, s.outW - ow);
+                const ElemType* m = transformedOut + tile * s.outC;
+                for (size_t k = 0; k < s.outC; k++)
+                {
+                    ElemType am[2][4];
+                    for (size_t j = 0; j < 4; j++)
+                    {
+                        am[0][j] = m[j * stride + k] + m[(4 + j) * stride + k] + m[(8 + j) * stride + k];
+                        am[1][j] = m[(4 + j) * stride + k] - m[(8 + j) * stride + k] - m[(12 + j) * stride + k];
+                    }
+                    ElemType y[2][2];
+                    for (size_t r = 0; r < 2; r++)
+                    {
+                        y[r][0] = am[r][0] + am[r][1] + am[r][2];
+                        y[r][1] = am[r][1] - am[r][2] - am[r][3];
+                    }
+                    for (size_t r = 0; r < rows; r++)
+                        Store(epilogue, k, y[r], 1, cols, sample + (k * s.outH + oh + r) * s.outW + ow);
+                }
+            }
+        }
+    }
+}
+
+// A sample is a column-major [outW * outH x inC] matrix, so a pointwise convolution is a single GEMM with the weights.
+template <class ElemType>
+void BlockedConvolution<ElemType>::ForwardPointwise(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue) const
+{
+    size_t mapSize = m_shape.inW * m_shape.inH;
+    bool hasEpilogue = !epilogue.accumulate && (epilogue.bias != nullptr || epilogue.activation != FusedActivationKind::None);
+    for (size_t n = 0; n < batchSize; n++)
+    {
+        ElemType* sample = out + n * OutSize();
+        Gemm(false, false, mapSize, m_shape.outC, m_shape.inC, 1, in + n * InSize(), mapSize,
+             m_weights.data(), m_shape.inC, epilogue.accumulate ? 1 : 0, sample, mapSize);
+        // While the sample is still in cache.
+        if (hasEpilogue)
+        {
+#pragma omp parallel for
+            for (long k = 0; k < (long)m_shape.outC; k++)
+                Store(epilogue, k, sample + k * mapSize, 1, mapSize, sample + k * mapSize);
+        }
+    }
+}
+
+// Unrolls a sample into a column-major [outW * outH x kernelW * kernelH * inC] matrix, column (x, y, c) holding
+// the input values tap (x, y) of channel c reads for every output pixel (zero outside of the input).
+template <class ElemType>
+void BlockedConvolution<ElemType>::Unroll(const ElemType* in, ElemType* unrolled) const
+{
+    const auto& s = m_shape;
+    size_t outMapSize = s.outW * s.outH;
+    long work = (long)s.inC;
+#pragma omp parallel for
+    for (long c = 0; c < work; c++)
+    {
+        const ElemType* map = in + c * s.inH * s.inW;
+        for (size_t y = 0; y < s.kernelH; y++)
+        {
+            size_t ohBegin, ohEnd;
+            ValidOutputRange((int)s.inH, (int)s.outH, (int)s.strideH, (int)y - s.padH, ohBegin, ohEnd);
+            for (size_t x = 0; x < s.kernelW; x++)
+            {
+                size_t owBegin, owEnd;
+                ValidOutputRange((int)s.inW, (int)s.outW, (int)s.strideW, (int)x - s.padW, owBegin, owEnd);
+                ElemType* column = unrolled + ((c * s.kernelH + y) * s.kernelW + x) * outMapSize;
+                memset(column, 0, outMapSize * sizeof(ElemType));
+                for (size_t oh = ohBegin; oh < ohEnd; oh++)
+                {
+                    const ElemType* row = map + ((int)(oh * s.strideH + y) - s.padH) * (int)s.inW;
+                    ElemType* dst = column + oh * s.outW;
+                    for (size_t ow = owBegin; ow < owEnd; ow++)
+                        dst[ow] = row[(int)(ow * s.strideW + x) - s.padW];
+                }
+            }
+        }
+    }
+}
+
+// The reverse of Unroll(): adds every unrolled value to the input element it was read from.
+template <class ElemType>
+void BlockedConvolution<ElemType>::AddRolled(const ElemType* unrolled, ElemType* in) const
+{
+    const auto& s = m_shape;
+    size_t outMapSize = s.outW * s.outH;
+    long work = (long)s.inC;
+#pragma omp parallel for
+    for (long c = 0; c < work; c++)
+    {
+        ElemType* map = in + c * s.inH * s.inW;
+        for (size_t y = 0; y < s.kernelH; y++)
+        {
+            size_t ohBegin, ohEnd;
+            ValidOutputRange((int)s.inH, (int)s.outH, (int)s.strideH, (int)y - s.padH, ohBegin, ohEnd);
+            for (size_t x = 0; x < s.kernelW; x++)
+            {
+                size_t owBegin, owEnd;
+                ValidOutputRange((int)s.inW, (int)s.outW, (int)s.strideW, (int)x - s.padW, owBegin, owEnd);
+                const ElemType* column = unrolled + ((c * s.kernelH + y) * s.kernelW + x) * outMapSize;
+                for (size_t oh = ohBegin; oh < ohEnd; oh++)
+                {
+                    ElemType* row = map + ((int)(oh * s.strideH + y) - s.padH) * (int)s.inW;
+                    const ElemType* src = column + oh * s.outW;
+                    for (size_t ow = owBegin; ow < owEnd; ow++)
+                        row[(int)(ow * s.strideW + x) - s.padW] += src[ow];
+                }
+            }
+        }
+    }
+}
+
+// With stride 1, input gradients are the convolution of the output gradients with the weights, input and output
+// channels swapped and rotated by 180 degrees, so they are computed by the same kernels as the forward pass.
+// With a larger stride the transposed convolution is not a convolution of the same kind, so the gradients are
+// computed as unrolled input gradients, one sample at a time, and added to the input gradients.
+template <class ElemType>
+void BlockedConvolution<ElemType>::SetBackwardDataWeights(const ElemType* weights)
+{
+    const auto& s = m_shape;
+    if (s.strideW != 1 || s.strideH != 1)
+    {
+        m_backwardDataWeights.assign(weights, weights + s.outC * s.inC * s.kernelH * s.kernelW);
+        return;
+    }
+
+    auto t = s.Transposed();
+    if (!m_transposed)
+        m_transposed.reset(new BlockedConvolution<ElemType>(t));
+
+    std::vector<ElemType> rotated(s.outC * s.inC * s.kernelH * s.kernelW);
+    for (size_t k = 0; k < s.outC; k++)
+        for (size_t c = 0; c < s.inC; c++)
+            for (size_t y = 0; y < s.kernelH; y++)
+                for (size_t x = 0; x < s.kernelW; x++)
+                    rotated[WeightIndex(t, c, k, s.kernelH - 1 - y, s.kernelW - 1 - x)] = weights[WeightIndex(s, k, c, y, x)];
+    m_transposed->SetWeights(rotated.data());
+}
+
+template <class ElemType>
+size_t BlockedConvolution<ElemType>::BackwardDataWorkspaceSize(size_t batchSize) const
+{
+    if (m_shape.strideW == 1 && m_shape.strideH == 1)
+        return BlockedConvolution<ElemType>(m_shape.Transposed()).ForwardWorkspaceSize(batchSize);
+    return UnrolledSize();
+}
+
+template <class ElemType>
+void BlockedConvolution<ElemType>::BackwardData(const ElemType* srcGrad, ElemType* grad, size_t batchSize, ElemType* workspace) const
+{
+    if (m_transposed)
+    {
+        m_transposed->Forward(srcGrad, grad, batchSize, /*accumulate=*/true, workspace);
+        return;
+    }
+
+    size_t outMapSize = m_shape.outW * m_shape.outH;
+    size_t unrollCols = m_shape.kernelW * m_shape.kernelH * m_shape.inC;
+    for (size_t n = 0; n < batchSize; n++)
+    {
+        // [outW * outH x outC] * [kernelW * kernelH * inC x outC]^T
+        Gemm(false, true, outMapSize, unrollCols, m_shape.outC, 1, srcGrad + n * OutSize(), outMapSize,
+             m_backwardDataWeights.data(), unrollCols, 0, workspace, outMapSize);
+        AddRolled(workspace, grad + n * InSize());
+    }
+}
+
+template <class ElemType>
+size_t BlockedConvolution<ElemType>::BackwardKernelWorkspaceSize(size_t /*batchSize*/) const
+{
+    return m_algorithm == Algorithm::Pointwise ? 0 : UnrolledSize();
+}
+
+// The kernel gradient is the product of the unrolled input and the output gradients of a sample, summed over the batch.
+// Pointwise convolutions do not need to be unrolled. Only one sample is unrolled at a time.
+template <class ElemType>
+void BlockedConvolution<ElemType>::BackwardKernel(const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t batchSize, ElemType* workspace) const
+{
+    size_t outMapSize = m_shape.outW * m_shape.outH;
+    size_t unrollCols = m_shape.kernelW * m_shape.kernelH * m_shape.inC;
+    for (size_t n = 0; n < batchSize; n++)
+    {
+        const ElemType* unrolled = in + n * InSize();
+        if (m_algorithm != Algorithm::Pointwise)
+        {
+            Unroll(unrolled, workspace);
+            unrolled = workspace;
+        }
+        // [outW * outH x kernelW * kernelH * inC]^T * [outW * outH x outC]
+        Gemm(true, false, unrollCols, m_shape.outC, outMapSize, 1, unrolled, outMapSize,
+             srcGrad + n * OutSize(), outMapSize, 1, kernelGrad, unrollCols);
+    }
+}
+
+template class BlockedConvolution<float>;
+template class BlockedConvolution<double>;
+
+}}}
@@ -0,0 +1,134 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BlockedConvolution.h -- CPU kernels of the direct convolution engine: Winograd F(2x2,3x3) for 3x3 convolutions
+// with stride 1, a GEMM per sample for pointwise (1x1) convolutions, and a register-blocked direct convolution
+// on weights packed in blocks of output channels for everything else.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class FusedActivationKind; // ConvolutionEngine.h
+
+// 2D convolution of one sample, CNTK CHW layout (column-major [W x H x C]).
+// Output (ow, oh) reads input (ow * strideW - padW + x, oh * strideH - padH + y); taps outside of the input are zero.
+struct BlockedConvolutionShape
+{
+    size_t inW, inH, inC;
+    size_t outW, outH, outC;
+    size_t kernelW, kernelH;
+    size_t strideW, strideH;
+    int padW, padH;
+
+    // The shape of the convolution that computes input gradients from output gradients of this one.
+    // Only valid for stride 1.
+    BlockedConvolutionShape Transposed() const
+    {
+        return BlockedConvolutionShape{ outW, outH, outC, inW, inH, inC, kernelW, kernelH, 1, 1,
+                                        (int)kernelW - 1 - padW, (int)kernelH - 1 - padH };
+    }
+};
+
+// Activations stay in CHW: Winograd transforms tiles straight from and to it, and the direct kernel reads input
+// values in place and scatters its blocks of output channels on store, so the forward pass needs neither a layout
+// conversion pass over the minibatch nor an unrolled input. Only the weights are packed. Kernel gradients (and input
+// gradients of strided convolutions) unroll one sample at a time instead of the whole minibatch.
+//
+// Weights are given in CNTK's kernel layout [kernelW x kernelH x inC x outC] (i.e. outC is the slowest dimension).
+// Samples are contiguous, each one is a column of a CNTK matrix.
+template <class ElemType>
+class BlockedConvolution
+{
+public:
+    static const size_t BlockSize = 8;
+
+    enum class Algorithm
+    {
+        Direct,
+        Winograd,
+        Pointwise
+    };
+
+    explicit BlockedConvolution(const BlockedConvolutionShape& shape);
+
+    static Algorithm AlgorithmFor(const BlockedConvolutionShape& shape);
+
+    const BlockedConvolutionShape& Shape() const { return m_shape; }
+    Algorithm GetAlgorithm() const { return m_algorithm; }
+
+    // Packs (and for Winograd, transforms) the weights Forward() uses.
+    void SetWeights(const ElemType* weights);
+
+    size_t ForwardWorkspaceSize(size_t batchSize) const;
+
+    // out = conv(in), or out += conv(in) if 'accumulate' is true.
+    void Forward(const ElemType* in, ElemType* out, size_t batchSize, bool accumulate, ElemType* workspace) const;
+
+    // out = activation(conv(in) + bias), bias holding one value per output channel. Bias and activation are applied
+    // as the outputs are stored (after each sample's GEMM for pointwise convolutions), not in a pass of their own.
+    void ForwardBiasActivation(const ElemType* in, ElemType* out, size_t batchSize, const ElemType* bias,
+                               FusedActivationKind activation, ElemType* workspace) const;
+
+    // Packs the weights BackwardData() uses.
+    void SetBackwardDataWeights(const ElemType* weights);
+
+    size_t BackwardDataWorkspaceSize(size_t batchSize) const;
+
+    // grad += conv^T(srcGrad).
+    void BackwardData(const ElemType* srcGrad, ElemType* grad, size_t batchSize, ElemType* workspace) const;
+
+    size_t BackwardKernelWorkspaceSize(size_t batchSize) const;
+
+    // kernelGrad += sum over the batch of srcGrad (x) in, in the layout of the weights.
+    void BackwardKernel(const ElemType* srcGrad, const ElemType* in, ElemType* kernelGrad, size_t batchSize, ElemType* workspace) const;
+
+private:
+    // What the forward kernels do with the values they compute: add them to the output, or store them,
+    // after adding the bias of their channel (if any) and applying the activation.
+    struct Epilogue
+    {
+        bool accumulate;
+        const ElemType* bias;
+        FusedActivationKind activation;
+    };
+
+    // Stores 'count' values of output channel k, 'stride' apart, to the contiguous 'dst'.
+    static void Store(const Epilogue& epilogue, size_t k, const ElemType* values, size_t stride, size_t count, ElemType* dst);
+
+    size_t InSize() const { return m_shape.inW * m_shape.inH * m_shape.inC; }
+    size_t OutSize() const { return m_shape.outW * m_shape.outH * m_shape.outC; }
+    size_t NumOutBlocks() const { return (m_shape.outC + BlockSize - 1) / BlockSize; }
+    size_t UnrolledSize() const { return m_shape.outW * m_shape.outH * m_shape.kernelW * m_shape.kernelH * m_shape.inC; }
+
+    size_t WinogradTilesPerSample() const { return ((m_shape.outH + 1) / 2) * ((m_shape.outW + 1) / 2); }
+    size_t WinogradSamplesPerChunk(size_t batchSize) const;
+
+    void Forward(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue, ElemType* workspace) const;
+    void ForwardDirect(const ElemType* in, ElemType* out, const Epilogue& epilogue, size_t outBlock, size_t oh) const;
+    void ForwardWinograd(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue, ElemType* workspace) const;
+    void ForwardPointwise(const ElemType* in, ElemType* out, size_t batchSize, const Epilogue& epilogue) const;
+    void Unroll(const ElemType* in, ElemType* unrolled) const;
+    void AddRolled(const ElemType* unrolled, ElemType* in) const;
+
+    BlockedConvolutionShape m_shape;
+    Algorithm m_algorithm;
+
+    // Direct:    [BlockSize x kernelW x kernelH x inC x outC / BlockSize].
+    // Winograd:  [outC x inC x 16], the transformed kernels G g G^T, one column-major [outC x inC] matrix per tile element.
+    // Pointwise: the weights, a column-major [inC x outC] matrix.
+    std::vector<ElemType> m_weights;
+
+    // With stride 1, input gradients are the Transposed() convolution of the output gradients.
+    std::unique_ptr<BlockedConvolution<ElemType>> m_transposed;
+    // Otherwise the weights are used as they are.
+    std::vector<ElemType> m_backwardDataWeights;
+};
+
+}}}
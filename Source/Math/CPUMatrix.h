@@ -319,6 +319,13 @@ public:
 
     CPUMatrix<ElemType>& AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c);
 
+    // logSumExp(j) = log(sum_v exp((weight' * hidden)(v, j))), computed in tiles of tileSize rows of weight' * hidden
+    static void TiledLogSumExpOfTransposeProduct(const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& hidden, size_t tileSize, CPUMatrix<ElemType>& logSumExp);
+    // adds the gradients of sum_j scale(j) * logSumExp(j) to hiddenGradient and weightGradient (either may be null)
+    static void TiledLogSumExpOfTransposeProductBackprop(const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& hidden,
+                                                         const CPUMatrix<ElemType>& logSumExp, const CPUMatrix<ElemType>& scale, size_t tileSize,
+                                                         CPUMatrix<ElemType>* hiddenGradient, CPUMatrix<ElemType>* weightGradient);
+
     void VectorNormInf(CPUMatrix<ElemType>& c, const bool isColWise) const;
     CPUMatrix<ElemType>& AssignVectorNormInfOf(CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -579,6 +586,16 @@ public:
                                      const size_t tPos // position
                                      );
 
+    // batched CRF recursions over all sequences of a minibatch, see BatchedCRF.h
+    static void CRFViterbiDecode(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                 const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                 const vector<size_t>& uttStartLabel, const vector<size_t>& uttEndLabel, const size_t numChannels,
+                                 CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& decodedPath);
+    static void CRFForwardCompute(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                  const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                  const vector<size_t>& uttStartLabel, const size_t numChannels,
+                                  CPUMatrix<ElemType>& alpha);
+
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
@@ -113,6 +113,24 @@ void CPUMatrix<half>::AveragePoolingBackward(const CPUMatrix<int>& mpRowCol, con
     RuntimeError("half AveragePoolingBackward not supported.");
 }
 
+template <>
+void CPUMatrix<half>::CRFViterbiDecode(const CPUMatrix<half>& posScores, const CPUMatrix<half>& pairScores,
+                                       const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                       const vector<size_t>& uttStartLabel, const vector<size_t>& uttEndLabel, const size_t numChannels,
+                                       CPUMatrix<half>& alpha, CPUMatrix<half>& decodedPath)
+{
+    RuntimeError("half CRFViterbiDecode not supported.");
+}
+
+template <>
+void CPUMatrix<half>::CRFForwardCompute(const CPUMatrix<half>& posScores, const CPUMatrix<half>& pairScores,
+                                        const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                        const vector<size_t>& uttStartLabel, const size_t numChannels,
+                                        CPUMatrix<half>& alpha)
+{
+    RuntimeError("half CRFForwardCompute not supported.");
+}
+
 // explicit instantiations, due to CPUMatrix being too big and causing VS2015 cl crash.
 template class MATH_API CPUMatrix<half>;
 template<> int CPUMatrix<half>::m_optimizationFlags = 0;
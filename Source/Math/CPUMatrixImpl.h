@@ -11,6 +11,7 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "BatchedCRF.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -5350,6 +5351,104 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNCEDerivative(const CPUMatrix<El
     return *this;
 }
 
+// Tiles of weight' * hidden are formed by GEMM on tileSize columns of the weight at a time, and reduced into a running
+// maximum and a running sum of exponentials per column (rescaled whenever the maximum grows), then discarded.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::TiledLogSumExpOfTransposeProduct(const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& hidden, size_t tileSize, CPUMatrix<ElemType>& logSumExp)
+{
+    if (weight.IsEmpty() || hidden.IsEmpty())
+        LogicError("TiledLogSumExpOfTransposeProduct: one of the input matrices is empty.");
+    if (weight.GetNumRows() != hidden.GetNumRows())
+        InvalidArgument("TiledLogSumExpOfTransposeProduct: The number of rows of the weight (%d) and hidden (%d) matrices should match.", (int) weight.GetNumRows(), (int) hidden.GetNumRows());
+
+    const long n = (long) hidden.GetNumCols();
+    const size_t vocabSize = weight.GetNumCols();
+    tileSize = std::max<size_t>(1, std::min(tileSize, vocabSize));
+
+    CPUMatrix<ElemType> runningMax(1, n);
+    CPUMatrix<ElemType> runningSum(1, n);
+    CPUMatrix<ElemType> tile(tileSize, n);
+    for (size_t tileStart = 0; tileStart < vocabSize; tileStart += tileSize)
+    {
+        size_t tileRows = std::min(tileSize, vocabSize - tileStart);
+        tile.RequireSize(tileRows, n);
+        MultiplyAndWeightedAdd(1, weight.ColumnSlice(tileStart, tileRows), true, hidden, false, 0, tile);
+
+#pragma omp parallel for
+        for (long j = 0; j < n; j++)
+        {
+            ElemType maxV = tile(0, j);
+            for (size_t i = 1; i < tileRows; i++)
+                maxV = std::max(maxV, tile(i, j));
+
+            ElemType sum = 0;
+            if (tileStart > 0)
+            {
+                if (runningMax(0, j) < maxV)
+                    sum = runningSum(0, j) * exp(runningMax(0, j) - maxV);
+                else
+                {
+                    maxV = runningMax(0, j);
+                    sum = runningSum(0, j);
+                }
+            }
+
+            for (size_t i = 0; i < tileRows; i++)
+                sum += exp(tile(i, j) - maxV);
+            runningMax(0, j) = maxV;
+            runningSum(0, j) = sum;
+        }
+    }
+
+    logSumExp.RequireSize(1, n);
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+        logSumExp(0, j) = runningMax(0, j) + log(runningSum(0, j));
+}
+
+// The tiles are recomputed, turned into scale(j) * softmax(tile)(., j) in place, and multiplied into the gradients.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::TiledLogSumExpOfTransposeProductBackprop(const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& hidden,
+                                                                              const CPUMatrix<ElemType>& logSumExp, const CPUMatrix<ElemType>& scale, size_t tileSize,
+                                                                              CPUMatrix<ElemType>* hiddenGradient, CPUMatrix<ElemType>* weightGradient)
+{
+    if (weight.IsEmpty() || hidden.IsEmpty())
+        LogicError("TiledLogSumExpOfTransposeProductBackprop: one of the input matrices is empty.");
+    if (logSumExp.GetNumElements() != hidden.GetNumCols() || scale.GetNumElements() != hidden.GetNumCols())
+        InvalidArgument("TiledLogSumExpOfTransposeProductBackprop: logSumExp and scale should have one element per column of hidden.");
+    if ((hiddenGradient && (hiddenGradient->GetNumRows() != hidden.GetNumRows() || hiddenGradient->GetNumCols() != hidden.GetNumCols())) ||
+        (weightGradient && (weightGradient->GetNumRows() != weight.GetNumRows() || weightGradient->GetNumCols() != weight.GetNumCols())))
+        InvalidArgument("TiledLogSumExpOfTransposeProductBackprop: The gradients should have the dimensions of the hidden and weight matrices.");
+
+    const long n = (long) hidden.GetNumCols();
+    const size_t vocabSize = weight.GetNumCols();
+    tileSize = std::max<size_t>(1, std::min(tileSize, vocabSize));
+
+    CPUMatrix<ElemType> tile(tileSize, n);
+    for (size_t tileStart = 0; tileStart < vocabSize; tileStart += tileSize)
+    {
+        size_t tileRows = std::min(tileSize, vocabSize - tileStart);
+        tile.RequireSize(tileRows, n);
+        auto weightTile = weight.ColumnSlice(tileStart, tileRows);
+        MultiplyAndWeightedAdd(1, weightTile, true, hidden, false, 0, tile);
+
+#pragma omp parallel for
+        for (long j = 0; j < n; j++)
+        {
+            for (size_t i = 0; i < tileRows; i++)
+                tile(i, j) = scale(0, j) * exp(tile(i, j) - logSumExp(0, j));
+        }
+
+        if (hiddenGradient)
+            MultiplyAndWeightedAdd(1, weightTile, false, tile, false, 1, *hiddenGradient);
+        if (weightGradient)
+        {
+            auto weightGradientTile = weightGradient->ColumnSlice(tileStart, tileRows);
+            MultiplyAndWeightedAdd(1, hidden, false, tile, true, 1, weightGradientTile);
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const CPUMatrix<ElemType>& a,
                                                            const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& tmp, CPUMatrix<ElemType>& c)
@@ -6967,6 +7066,45 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+
+// Viterbi decoding of all sequences of a minibatch; columns of posScores, alpha and decodedPath follow the minibatch layout.
+// Columns that belong to no sequence are zero in decodedPath.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::CRFViterbiDecode(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                                      const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                                      const vector<size_t>& uttStartLabel, const vector<size_t>& uttEndLabel, const size_t numChannels,
+                                                      CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& decodedPath)
+{
+    if (posScores.IsEmpty() || pairScores.IsEmpty())
+        LogicError("CRFViterbiDecode: one of the input matrices is empty.");
+    if (pairScores.GetNumRows() != posScores.GetNumRows() || pairScores.GetNumCols() != posScores.GetNumRows())
+        InvalidArgument("CRFViterbiDecode: the transition scores should be a [%d x %d] matrix.", (int) posScores.GetNumRows(), (int) posScores.GetNumRows());
+
+    alpha.RequireSize(posScores.GetNumRows(), posScores.GetNumCols());
+    decodedPath.RequireSize(posScores.GetNumRows(), posScores.GetNumCols());
+    decodedPath.SetValue(0);
+
+    BatchedCRF<ElemType> crf(pairScores.Data(), pairScores.GetNumRows());
+    crf.Viterbi(posScores.Data(), numChannels, uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, uttEndLabel, alpha.Data(), decodedPath.Data());
+}
+
+// Forward (alpha) recursion of CRF training for all sequences of a minibatch.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::CRFForwardCompute(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                                       const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                                       const vector<size_t>& uttStartLabel, const size_t numChannels,
+                                                       CPUMatrix<ElemType>& alpha)
+{
+    if (posScores.IsEmpty() || pairScores.IsEmpty())
+        LogicError("CRFForwardCompute: one of the input matrices is empty.");
+    if (pairScores.GetNumRows() != posScores.GetNumRows() || pairScores.GetNumCols() != posScores.GetNumRows())
+        InvalidArgument("CRFForwardCompute: the transition scores should be a [%d x %d] matrix.", (int) posScores.GetNumRows(), (int) posScores.GetNumRows());
+
+    alpha.RequireSize(posScores.GetNumRows(), posScores.GetNumCols());
+
+    BatchedCRF<ElemType> crf(pairScores.Data(), pairScores.GetNumRows());
+    crf.Forward(posScores.Data(), numChannels, uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, alpha.Data());
+}
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
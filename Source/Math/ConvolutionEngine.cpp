@@ -7,6 +7,8 @@
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
 #include "MklDnnCommon.h"
+#include "BlockedConvolution.h"
+#include "DirectPooling.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,6 +32,26 @@ void ConvolutionEngine<ElemType>::Forward(const Mat& in, const Mat& kernel, Mat&
     ForwardCore(in, kernel, out, workspace);
 }
 
+template <class ElemType>
+void ConvolutionEngine<ElemType>::ForwardFused(const Mat& in, const Mat& kernel, const Mat& bias, FusedActivationKind activation, Mat& out, Mat& workspace)
+{
+    const auto& g = *m_geometry;
+    assert(g.InputShape().GetNumElements() == in.GetNumRows());
+    assert(g.OutputShape().GetNumElements() == out.GetNumRows());
+    assert(in.GetNumCols() == out.GetNumCols());
+    assert(g.KernelShape().GetNumElements() * g.KernelCount() == kernel.GetNumElements());
+    assert(g.KernelCount() == bias.GetNumElements());
+#ifdef NDEBUG
+    UNUSED(g);
+#endif
+
+    if (!ImplementsFusedForward())
+        LogicError("This convolution engine does not implement fused bias and activation.");
+    EnsureCompatible();
+    EnsureConvolutionInitialized();
+    ForwardFusedCore(in, kernel, bias, activation, out, workspace);
+}
+
 template <class ElemType>
 void ConvolutionEngine<ElemType>::BackwardData(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace)
 {
@@ -202,12 +224,51 @@ protected:
                                                            const_cast<int*>(m_geometry->MpRowIndices().data()), m_deviceId, flags);
             m_indices = std::make_unique<Matrix<int>>(m_geometry->Indices().size(), 1,
                                                       const_cast<int*>(m_geometry->Indices().data()), m_deviceId, flags);
+
+            // 2D pooling on CPU does not need the maps.
+            if (!IsGpu(m_deviceId) && IsDirectPoolingSupported(*m_geometry))
+            {
+                const auto& g = *m_geometry;
+                DirectPoolingShape shape;
+                shape.inW = g.InputShape()[0];
+                shape.inH = g.InputShape()[1];
+                shape.outW = g.OutputShape()[0];
+                shape.outH = g.OutputShape()[1];
+                shape.channels = g.InputShape()[2];
+                shape.windowW = g.KernelShape()[0];
+                shape.windowH = g.KernelShape()[1];
+                shape.strideW = g.GetStride(0);
+                shape.strideH = g.GetStride(1);
+                shape.padW = g.GetLowerPad(0);
+                shape.padH = g.GetLowerPad(1);
+                m_directPooling = std::make_unique<DirectPooling<ElemType>>(shape);
+            }
         }
     }
 
+    // Pooling of each channel of a 2D input over a window that is not larger than the input.
+    static bool IsDirectPoolingSupported(const ConvolveGeometry& g)
+    {
+        const auto& inT = g.InputShape();
+        const auto& kernT = g.KernelShape();
+        const auto& outT = g.OutputShape();
+        return inT.GetRank() == 3 && kernT.GetRank() == 3 && outT.GetRank() == 3 &&
+               kernT[2] == 1 && g.GetStride(2) == 1 && g.GetLowerPad(2) == 0 && outT[2] == inT[2] &&
+               kernT[0] <= inT[0] && kernT[1] <= inT[1] &&
+               g.GetDilation(0) == 1 && g.GetDilation(1) == 1 &&
+               g.KernelCount() == 1;
+    }
+
     void ForwardPoolingCore(const Mat& in, Mat& out) override
     {
-        if (m_poolKind == PoolKind::Max)
+        if (m_directPooling != nullptr && (m_poolKind == PoolKind::Max || m_poolKind == PoolKind::Average))
+        {
+            if (m_poolKind == PoolKind::Max)
+                m_directPooling->MaxForward(in.Data(), out.Data(), in.GetNumCols());
+            else
+                m_directPooling->AverageForward(in.Data(), out.Data(), in.GetNumCols(), m_poolIncludePad);
+        }
+        else if (m_poolKind == PoolKind::Max)
         {
             in.MaxPoolingForward(m_mpRowCol, *m_mpRowIndices, *m_indices, out);
         }
@@ -222,7 +283,16 @@ protected:
 
     void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, bool accumulateGradient) override
     {
-        if (m_poolKind == PoolKind::Max)
+        if (m_directPooling != nullptr && (m_poolKind == PoolKind::Max || m_poolKind == PoolKind::Average))
+        {
+            if (!accumulateGradient)
+                grad.SetValue(0);
+            if (m_poolKind == PoolKind::Max)
+                m_directPooling->MaxBackward(out.Data(), srcGrad.Data(), in.Data(), grad.Data(), srcGrad.GetNumCols());
+            else
+                m_directPooling->AverageBackward(srcGrad.Data(), grad.Data(), srcGrad.GetNumCols(), m_poolIncludePad);
+        }
+        else if (m_poolKind == PoolKind::Max)
         {
             srcGrad.MaxPoolingBackward(out, in, m_mpRowCol, *m_mpRowIndices, *m_indices, grad, accumulateGradient);
         }
@@ -253,6 +323,8 @@ protected:
     // Pooling-specific maps.
     IntMatPtr m_mpRowIndices;
     IntMatPtr m_indices;
+    // Replaces the maps for 2D pooling on CPU.
+    std::unique_ptr<DirectPooling<ElemType>> m_directPooling;
 };
 
 //------------------------------------------------------------------
@@ -1148,6 +1220,117 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Direct convolution engine: Winograd, pointwise and register-blocked direct 2D convolutions on CPU.
+// See BlockedConvolution.h for the kernels.
+// Pooling is delegated to the reference engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (IsGpu(m_deviceId))
+            LogicError("Direct convolution engine supports only CPU device.");
+        if (!IsSupported(m_deviceId, m_geometry))
+            LogicError("Direct convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+        if (m_conv != nullptr)
+            return;
+
+        const auto& g = *m_geometry;
+        BlockedConvolutionShape shape;
+        shape.inW = g.InputShape()[0];
+        shape.inH = g.InputShape()[1];
+        shape.inC = g.InputShape()[2];
+        shape.outW = g.OutputShape()[0];
+        shape.outH = g.OutputShape()[1];
+        shape.outC = g.OutputShape()[2];
+        shape.kernelW = g.KernelShape()[0];
+        shape.kernelH = g.KernelShape()[1];
+        shape.strideW = g.GetStride(0);
+        shape.strideH = g.GetStride(1);
+        shape.padW = g.GetLowerPad(0);
+        shape.padH = g.GetLowerPad(1);
+        m_conv = std::make_unique<BlockedConvolution<ElemType>>(shape);
+    }
+
+    // Weights are repacked on every call: they change after each update, and packing them costs
+    // a small fraction of a minibatch of convolutions.
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        size_t batchSize = in.GetNumCols();
+        m_conv->SetWeights(kernel.Data());
+        workspace.Resize(1, max(m_conv->ForwardWorkspaceSize(batchSize), (size_t)1));
+        m_conv->Forward(in.Data(), out.Data(), batchSize, false, workspace.Data());
+    }
+
+    void ForwardFusedCore(const Mat& in, const Mat& kernel, const Mat& bias, FusedActivationKind activation, Mat& out, Mat& workspace) override
+    {
+        size_t batchSize = in.GetNumCols();
+        m_conv->SetWeights(kernel.Data());
+        workspace.Resize(1, max(m_conv->ForwardWorkspaceSize(batchSize), (size_t)1));
+        m_conv->ForwardBiasActivation(in.Data(), out.Data(), batchSize, bias.Data(), activation, workspace.Data());
+    }
+
+    // Like the GEMM engine, always adds to the existing gradients.
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool /*accumulateGradient*/, Mat& workspace) override
+    {
+        size_t batchSize = srcGrad.GetNumCols();
+        m_conv->SetBackwardDataWeights(kernel.Data());
+        workspace.Resize(1, max(m_conv->BackwardDataWorkspaceSize(batchSize), (size_t)1));
+        m_conv->BackwardData(srcGrad.Data(), grad.Data(), batchSize, workspace.Data());
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*accumulateGradient*/, bool /*allowReuse*/, Mat& workspace) override
+    {
+        size_t batchSize = srcGrad.GetNumCols();
+        workspace.Resize(1, max(m_conv->BackwardKernelWorkspaceSize(batchSize), (size_t)1));
+        m_conv->BackwardKernel(srcGrad.Data(), in.Data(), kernelGrad.Data(), batchSize, workspace.Data());
+    }
+
+public:
+    bool ImplementsFusedForward() const override { return true; }
+
+    // 2D convolutions (rank 3 tensors, the kernel spans all input channels) with full sharing and no dilation, on CPU.
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        return deviceId < 0 &&
+               inT.GetRank() == 3 && kernT.GetRank() == 3 && outT.GetRank() == 3 &&
+               kernT[2] == inT[2] && outT[2] == geometry->KernelCount() &&
+               geometry->GetLowerPad(2) == 0 &&
+               geometry->GetDilation(0) == 1 && geometry->GetDilation(1) == 1 &&
+               geometry->Groups() == 1 &&
+               find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing());
+    }
+
+private:
+    std::unique_ptr<BlockedConvolution<ElemType>> m_conv;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -1188,6 +1371,18 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
 
     if (geometry->Groups() == 1)
     {
+        // The direct engine is only used if enabled explicitly. With MKL-DNN the GEMM engine is faster,
+        // so the direct engine is only used then if GEMM is disabled.
+        if (isEnabled(ConvolutionEngineKind::Direct) && poolKind == PoolKind::None &&
+            (!GemmConvolutionEngine<ElemType>::IsMklEnabled() || !isEnabled(ConvolutionEngineKind::Gemm)) &&
+            DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad);
+        }
+
         if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
         {
             if (GetMathLibTraceLevel() > 0)
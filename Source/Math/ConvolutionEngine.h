@@ -22,6 +22,8 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Direct    = 1 << 4, // Winograd/direct CPU convolutions on blocked weights. Works only for 2D convos with full sharing.
+                        // Not part of All: it must be enabled explicitly (see Globals::SetDirectConvolution()).
 
     All       = Reference | CuDnn | Legacy | Gemm
 };
@@ -33,6 +35,15 @@ enum class PoolKind
     Average
 };
 
+// Activation a fused convolution applies after adding the bias.
+enum class FusedActivationKind
+{
+    None,
+    ReLU,
+    Sigmoid,
+    Tanh
+};
+
 #pragma warning(push)
 #pragma warning(disable : 4251)
 
@@ -47,6 +58,10 @@ public:
 
     void Forward(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace);
 
+    // out = activation(conv(in) + bias), with bias holding one value per output channel.
+    // Only engines for which ImplementsFusedForward() is true support it.
+    void ForwardFused(const Mat& in, const Mat& kernel, const Mat& bias, FusedActivationKind activation, Mat& out, Mat& workspace);
+
     void BackwardData(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace);
 
     void BackwardKernel(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool allowReuse, Mat& workspace);
@@ -75,6 +90,8 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const { return false; }
 
+    virtual bool ImplementsFusedForward() const { return false; }
+
 protected:
     ConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad = false)
         : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind), m_poolIncludePad(poolIncludePad)
@@ -88,6 +105,11 @@ protected:
 
     virtual void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) = 0;
 
+    virtual void ForwardFusedCore(const Mat& /*in*/, const Mat& /*kernel*/, const Mat& /*bias*/, FusedActivationKind /*activation*/, Mat& /*out*/, Mat& /*workspace*/)
+    {
+        LogicError("This convolution engine does not implement fused bias and activation.");
+    }
+
     virtual void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) = 0;
 
     virtual void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool allowReuse, Mat& workspace) = 0;
@@ -122,4 +144,17 @@ static inline PoolKind PoolKindFrom(const wstring& s)
     InvalidArgument("Unknown pooling kind: '%ls'. Supported values: 'none', 'max', 'average'.", s.c_str());
 }
 
+static inline FusedActivationKind FusedActivationKindFrom(const wstring& s)
+{
+    if (s.empty() || AreEqualIgnoreCase(s, L"none"))
+        return FusedActivationKind::None;
+    if (AreEqualIgnoreCase(s, L"relu"))
+        return FusedActivationKind::ReLU;
+    if (AreEqualIgnoreCase(s, L"sigmoid"))
+        return FusedActivationKind::Sigmoid;
+    if (AreEqualIgnoreCase(s, L"tanh"))
+        return FusedActivationKind::Tanh;
+    InvalidArgument("Unknown fused activation kind: '%ls'. Supported values: 'none', 'relu', 'sigmoid', 'tanh'.", s.c_str());
+}
+
 } } }
@@ -0,0 +1,381 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "DirectBatchNormalization.h"
+#include <algorithm>
+#include <vector>
+#include <omp.h>
+
+// Floating point sums are only vectorized when the compiler is allowed to reorder them.
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define SIMD_PRAGMA(x) _Pragma(#x)
+#define SIMD_LOOP _Pragma("omp simd")
+#define SIMD_SUM_LOOP(...) SIMD_PRAGMA(omp simd reduction(+ : __VA_ARGS__))
+#else
+#define SIMD_LOOP
+#define SIMD_SUM_LOOP(...)
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Count, mean and sum of squared deviations from the mean of a set of values.
+struct BatchMoments
+{
+    double count;
+    double mean;
+    double m2;
+
+    // Adds the values of 'other' to this set (Chan et al., "Updating formulae and a pairwise algorithm for computing sample variances").
+    void Merge(double otherCount, double otherMean, double otherM2)
+    {
+        if (otherCount == 0)
+            return;
+        double total = count + otherCount;
+        double delta = otherMean - mean;
+        mean += delta * otherCount / total;
+        m2 += otherM2 + delta * delta * count * otherCount / total;
+        count = total;
+    }
+};
+
+// Mean and sum of squared deviations of 'count' values that are small enough to stay in cache. The sum of the deviations
+// from a first estimate of the mean corrects for its rounding error.
+template <class ElemType>
+static void TileMoments(const ElemType* x, size_t count, double& mean, double& m2)
+{
+    ElemType sum = 0;
+    SIMD_SUM_LOOP(sum)
+    for (size_t i = 0; i < count; i++)
+        sum += x[i];
+    ElemType estimate = sum / (ElemType)count;
+
+    ElemType dev = 0;
+    ElemType sq = 0;
+    SIMD_SUM_LOOP(dev, sq)
+    for (size_t i = 0; i < count; i++)
+    {
+        ElemType d = x[i] - estimate;
+        dev += d;
+        sq += d * d;
+    }
+    mean = (double)estimate + (double)dev / count;
+    m2 = std::max(0.0, (double)sq - (double)dev * dev / count);
+}
+
+template <class ElemType>
+DirectBatchNormalization<ElemType>::DirectBatchNormalization(size_t spatialSize, size_t channels)
+    : m_spatialSize(spatialSize), m_channels(channels)
+{
+    if (spatialSize == 0 || channels == 0)
+        InvalidArgument("Direct batch normalization requires a non-empty sample.");
+}
+
+template <class ElemType>
+void DirectBatchNormalization<ElemType>::Partition(size_t batchSize, size_t& channelsPerItem, size_t& numParts) const
+{
+    size_t threads = (size_t)std::max(1, omp_get_max_threads());
+    size_t maxParts;
+    if (m_spatialSize > 1)
+    {
+        channelsPerItem = 1;
+        maxParts = batchSize;
+    }
+    else
+    {
+        channelsPerItem = ChannelBlockSize;
+        maxParts = (batchSize + ChunkSamples - 1) / ChunkSamples;
+    }
+    size_t numBlocks = (m_channels + channelsPerItem - 1) / channelsPerItem;
+    numParts = std::max<size_t>(1, std::min(maxParts, (threads + numBlocks - 1) / numBlocks));
+}
+
+template <class ElemType>
+void DirectBatchNormalization<ElemType>::Statistics(const ElemType* in, size_t batchSize, double* mean, double* m2) const
+{
+    size_t channelsPerItem, numParts;
+    Partition(batchSize, channelsPerItem, numParts);
+    size_t numBlocks = (m_channels + channelsPerItem - 1) / channelsPerItem;
+    std::vector<BatchMoments> partial(numParts * m_channels, BatchMoments{ 0, 0, 0 });
+
+#pragma omp parallel for
+    for (long item = 0; item < (long)(numBlocks * numParts); item++)
+    {
+        size_t part = item % numParts;
+        size_t c0 = (item / numParts) * channelsPerItem;
+        size_t c1 = std::min(c0 + channelsPerItem, m_channels);
+        size_t n0 = part * batchSize / numParts;
+        size_t n1 = (part + 1) * batchSize / numParts;
+        BatchMoments* result = partial.data() + part * m_channels;
+
+        if (m_spatialSize > 1)
+        {
+            // Tiles of the rows of channel c0.
+            for (size_t n = n0; n < n1; n++)
+            {
+                const ElemType* row = in + n * SampleSize() + c0 * m_spatialSize;
+                for (size_t t = 0; t < m_spatialSize; t += TileSize)
+                {
+                    size_t count = std::min(TileSize, m_spatialSize - t);
+                    double tileMean, tileM2;
+                    TileMoments(row + t, count, tileMean, tileM2);
+                    result[c0].Merge((double)count, tileMean, tileM2);
+                }
+            }
+        }
+        else
+        {
+            // Chunks of samples of channels [c0, c1), vectorized across the channels.
+            size_t width = c1 - c0;
+            std::vector<ElemType> estimate(width), dev(width), sq(width);
+            std::vector<double> runMean(width, 0), runM2(width, 0);
+            double runCount = 0;
+            for (size_t n = n0; n < n1; n += ChunkSamples)
+            {
+                size_t count = std::min(ChunkSamples, n1 - n);
+                const ElemType* chunk = in + n * m_channels + c0;
+
+                std::fill(estimate.begin(), estimate.end(), (ElemType)0);
+                for (size_t s = 0; s < count; s++)
+                {
+                    const ElemType* x = chunk + s * m_channels;
+                    ElemType* e = estimate.data();
+                    SIMD_LOOP
+                    for (size_t j = 0; j < width; j++)
+                        e[j] += x[j];
+                }
+                for (size_t j = 0; j < width; j++)
+                    estimate[j] /= (ElemType)count;
+
+                std::fill(dev.begin(), dev.end(), (ElemType)0);
+                std::fill(sq.begin(), sq.end(), (ElemType)0);
+                for (size_t s = 0; s < count; s++)
+                {
+                    const ElemType* x = chunk + s * m_channels;
+                    const ElemType* e = estimate.data();
+                    ElemType* dv = dev.data();
+                    ElemType* q = sq.data();
+                    SIMD_LOOP
+                    for (size_t j = 0; j < width; j++)
+                    {
+                        ElemType d = x[j] - e[j];
+                        dv[j] += d;
+                        q[j] += d * d;
+                    }
+                }
+
+                double total = runCount + count;
+                for (size_t j = 0; j < width; j++)
+                {
+                    double chunkMean = (double)estimate[j] + (double)dev[j] / count;
+                    double chunkM2 = std::max(0.0, (double)sq[j] - (double)dev[j] * dev[j] / count);
+                    double delta = chunkMean - runMean[j];
+                    runMean[j] += delta * count / total;
+                    runM2[j] += chunkM2 + delta * delta * runCount * count / total;
+                }
+                runCount = total;
+            }
+            for (size_t j = 0; j < width; j++)
+                result[c0 + j] = BatchMoments{ runCount, runMean[j], runM2[j] };
+        }
+    }
+
+    for (size_t c = 0; c < m_channels; c++)
+    {
+        BatchMoments m = partial[c];
+        for (size_t part = 1; part < numParts; part++)
+        {
+            const BatchMoments& p = partial[part * m_channels + c];
+            m.Merge(p.count, p.mean, p.m2);
+        }
+        mean[c] = m.mean;
+        m2[c] = m.m2;
+    }
+}
+
+template <class ElemType>
+void DirectBatchNormalization<ElemType>::ScaleShift(const ElemType* in, ElemType* out, size_t batchSize, const ElemType* a, const ElemType* b) const
+{
+    if (m_spatialSize > 1)
+    {
+#pragma omp parallel for
+        for (long r = 0; r < (long)(batchSize * m_channels); r++)
+        {
+            size_t c = r % m_channels;
+            const ElemType* x = in + r * m_spatialSize;
+            ElemType* y = out + r * m_spatialSize;
+            ElemType ac = a[c];
+            ElemType bc = b[c];
+            SIMD_LOOP
+            for (size_t i = 0; i < m_spatialSize; i++)
+                y[i] = x[i] * ac + bc;
+        }
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long n = 0; n < (long)batchSize; n++)
+        {
+            const ElemType* x = in + n * m_channels;
+            ElemType* y = out + n * m_channels;
+            SIMD_LOOP
+            for (size_t c = 0; c < m_channels; c++)
+                y[c] = x[c] * a[c] + b[c];
+        }
+    }
+}
+
+template <class ElemType>
+void DirectBatchNormalization<ElemType>::ScaleBiasGradients(const ElemType* in, const ElemType* srcGrad, size_t batchSize, const ElemType* mean, const ElemType* invStdDev,
+                                                            ElemType* scaleGrad, ElemType* biasGrad) const
+{
+    size_t channelsPerItem, numParts;
+    Partition(batchSize, channelsPerItem, numParts);
+    size_t numBlocks = (m_channels + channelsPerItem - 1) / channelsPerItem;
+    // Sums of srcGrad * (in - mean) and of srcGrad.
+    std::vector<double> partialScale(numParts * m_channels, 0);
+    std::vector<double> partialBias(numParts * m_channels, 0);
+
+#pragma omp parallel for
+    for (long item = 0; item < (long)(numBlocks * numParts); item++)
+    {
+        size_t part = item % numParts;
+        size_t c0 = (item / numParts) * channelsPerItem;
+        size_t c1 = std::min(c0 + channelsPerItem, m_channels);
+        size_t n0 = part * batchSize / numParts;
+        size_t n1 = (part + 1) * batchSize / numParts;
+        double* scaleSum = partialScale.data() + part * m_channels;
+        double* biasSum = partialBias.data() + part * m_channels;
+
+        if (m_spatialSize > 1)
+        {
+            ElemType mc = mean[c0];
+            for (size_t n = n0; n < n1; n++)
+            {
+                size_t offset = n * SampleSize() + c0 * m_spatialSize;
+                for (size_t t = 0; t < m_spatialSize; t += TileSize)
+                {
+                    size_t count = std::min(TileSize, m_spatialSize - t);
+                    const ElemType* x = in + offset + t;
+                    const ElemType* dy = srcGrad + offset + t;
+                    ElemType sx = 0;
+                    ElemType s = 0;
+                    SIMD_SUM_LOOP(sx, s)
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        sx += dy[i] * (x[i] - mc);
+                        s += dy[i];
+                    }
+                    scaleSum[c0] += sx;
+                    biasSum[c0] += s;
+                }
+            }
+        }
+        else
+        {
+            size_t width = c1 - c0;
+            std::vector<ElemType> sx(width), s(width);
+            for (size_t n = n0; n < n1; n += ChunkSamples)
+            {
+                size_t count = std::min(ChunkSamples, n1 - n);
+                std::fill(sx.begin(), sx.end(), (ElemType)0);
+                std::fill(s.begin(), s.end(), (ElemType)0);
+                for (size_t k = n; k < n + count; k++)
+                {
+                    const ElemType* x = in + k * m_channels + c0;
+                    const ElemType* dy = srcGrad + k * m_channels + c0;
+                    const ElemType* mc = mean + c0;
+                    ElemType* psx = sx.data();
+                    ElemType* ps = s.data();
+                    SIMD_LOOP
+                    for (size_t j = 0; j < width; j++)
+                    {
+                        psx[j] += dy[j] * (x[j] - mc[j]);
+                        ps[j] += dy[j];
+                    }
+                }
+                for (size_t j = 0; j < width; j++)
+                {
+                    scaleSum[c0 + j] += sx[j];
+                    biasSum[c0 + j] += s[j];
+                }
+            }
+        }
+    }
+
+    for (size_t c = 0; c < m_channels; c++)
+    {
+        double sx = 0;
+        double s = 0;
+        for (size_t part = 0; part < numParts; part++)
+        {
+            sx += partialScale[part * m_channels + c];
+            s += partialBias[part * m_channels + c];
+        }
+        scaleGrad[c] = (ElemType)(sx * invStdDev[c]);
+        biasGrad[c] = (ElemType)s;
+    }
+}
+
+template <class ElemType>
+void DirectBatchNormalization<ElemType>::InputGradient(const ElemType* in, const ElemType* srcGrad, ElemType* grad, size_t batchSize,
+                                                       const ElemType* a, const ElemType* b, const ElemType* c, bool accumulate) const
+{
+    // 'grad' may hold NaNs when it is not accumulated into, so it is not read then.
+    if (m_spatialSize > 1)
+    {
+#pragma omp parallel for
+        for (long r = 0; r < (long)(batchSize * m_channels); r++)
+        {
+            size_t k = r % m_channels;
+            const ElemType* x = in + r * m_spatialSize;
+            const ElemType* dy = srcGrad + r * m_spatialSize;
+            ElemType* dx = grad + r * m_spatialSize;
+            ElemType ak = a[k];
+            ElemType bk = b[k];
+            ElemType ck = c[k];
+            if (accumulate)
+            {
+                SIMD_LOOP
+                for (size_t i = 0; i < m_spatialSize; i++)
+                    dx[i] += dy[i] * ak + x[i] * bk + ck;
+            }
+            else
+            {
+                SIMD_LOOP
+                for (size_t i = 0; i < m_spatialSize; i++)
+                    dx[i] = dy[i] * ak + x[i] * bk + ck;
+            }
+        }
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long n = 0; n < (long)batchSize; n++)
+        {
+            const ElemType* x = in + n * m_channels;
+            const ElemType* dy = srcGrad + n * m_channels;
+            ElemType* dx = grad + n * m_channels;
+            if (accumulate)
+            {
+                SIMD_LOOP
+                for (size_t k = 0; k < m_channels; k++)
+                    dx[k] += dy[k] * a[k] + x[k] * b[k] + c[k];
+            }
+            else
+            {
+                SIMD_LOOP
+                for (size_t k = 0; k < m_channels; k++)
+                    dx[k] = dy[k] * a[k] + x[k] * b[k] + c[k];
+            }
+        }
+    }
+}
+
+template class DirectBatchNormalization<float>;
+template class DirectBatchNormalization<double>;
+
+}}}
@@ -0,0 +1,65 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectBatchNormalization.h -- CPU kernels of the direct batch normalization engine: per-channel statistics
+// in a single cache-blocked pass over the minibatch, and per-channel affine transforms for everything else.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A minibatch is viewed as [spatialSize x channels x batchSize] (column-major), i.e. a sample is a column of
+// a CNTK matrix whose rows hold 'spatialSize' consecutive values of each channel. Non-spatial batch normalization
+// is the case spatialSize == 1, where each row is a channel of its own.
+//
+// Statistics() reads the input once: it works on tiles small enough to stay in L1 (up to TileSize values of a row,
+// or ChunkSamples samples of a block of channels if spatialSize == 1), computes their mean and then their sum of
+// squared deviations from it while they are cached, and merges the tiles with the parallel variant of Welford's
+// algorithm (Chan et al.) in double precision. This is as robust as a two-pass computation but costs one pass.
+// The forward transform and both passes of the backward pass are then one multiply-add per value
+// with per-channel coefficients.
+//
+// Work is split over channels and, if there are fewer channels than threads, over ranges of samples whose partial
+// results are merged afterwards. Each thread writes only its own outputs, so no atomic updates are needed.
+template <class ElemType>
+class DirectBatchNormalization
+{
+public:
+    static const size_t TileSize = 1024;
+    static const size_t ChannelBlockSize = 256;
+    static const size_t ChunkSamples = 16;
+
+    DirectBatchNormalization(size_t spatialSize, size_t channels);
+
+    size_t SpatialSize() const { return m_spatialSize; }
+    size_t Channels() const { return m_channels; }
+
+    // Per-channel mean, and sum of squared deviations from it, over spatialSize * batchSize values.
+    void Statistics(const ElemType* in, size_t batchSize, double* mean, double* m2) const;
+
+    // out = in * a[c] + b[c]. 'out' may be 'in'.
+    void ScaleShift(const ElemType* in, ElemType* out, size_t batchSize, const ElemType* a, const ElemType* b) const;
+
+    // biasGrad[c] = sum of srcGrad, scaleGrad[c] = sum of srcGrad * (in - mean[c]) * invStdDev[c].
+    void ScaleBiasGradients(const ElemType* in, const ElemType* srcGrad, size_t batchSize, const ElemType* mean, const ElemType* invStdDev,
+                            ElemType* scaleGrad, ElemType* biasGrad) const;
+
+    // grad = srcGrad * a[c] + in * b[c] + c[c], or grad += that if 'accumulate' is true.
+    void InputGradient(const ElemType* in, const ElemType* srcGrad, ElemType* grad, size_t batchSize,
+                       const ElemType* a, const ElemType* b, const ElemType* c, bool accumulate) const;
+
+private:
+    size_t SampleSize() const { return m_spatialSize * m_channels; }
+
+    // Work items of a reduction over the minibatch: blocks of 'channelsPerItem' channels times 'numParts' ranges of samples.
+    void Partition(size_t batchSize, size_t& channelsPerItem, size_t& numParts) const;
+
+    size_t m_spatialSize;
+    size_t m_channels;
+};
+
+}}}
@@ -0,0 +1,321 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "DirectPooling.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define SIMD_LOOP _Pragma("omp simd")
+#else
+#define SIMD_LOOP
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Range [begin, end) of outputs o for which o * stride + offset is in [0, inSize).
+static void ValidOutputRange(int inSize, int outSize, int stride, int offset, size_t& begin, size_t& end)
+{
+    int first = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+    int last = inSize - 1 - offset >= 0 ? (inSize - 1 - offset) / stride : -1;
+    begin = (size_t)std::min(first, outSize);
+    end = (size_t)std::max((int)begin, std::min(last + 1, outSize));
+}
+
+// Range [begin, end) of the taps of a window starting at 'origin' that are inside of [0, inSize).
+static inline void ValidTapRange(int origin, size_t window, size_t inSize, size_t& begin, size_t& end)
+{
+    begin = (size_t)std::max(0, -origin);
+    end = (size_t)std::max((int)begin, std::min((int)window, (int)inSize - origin));
+}
+
+// Pools 'numRows' input rows into the outputs [begin, end) of a row, whose windows are inside of the input rows.
+// Non-zero KW/KH/SW are the window width/height/stride known at compile time (KH then equals 'numRows').
+template <class ElemType, bool IsMax, size_t KW, size_t KH, size_t SW>
+static void PoolRows(const ElemType* rows, size_t inW, size_t numRows, ElemType* acc, size_t begin, size_t end,
+                     size_t windowW, size_t strideW, int padW)
+{
+    const size_t kw = KW != 0 ? KW : windowW;
+    const size_t kh = KH != 0 ? KH : numRows;
+    const size_t sw = SW != 0 ? SW : strideW;
+    SIMD_LOOP
+    for (size_t ow = begin; ow < end; ow++)
+    {
+        const ElemType* window = rows + ((ptrdiff_t)(ow * sw) - padW);
+        ElemType a = acc[ow];
+        for (size_t y = 0; y < kh; y++)
+        {
+            for (size_t x = 0; x < kw; x++)
+            {
+                ElemType v = window[y * inW + x];
+                a = IsMax ? (a < v ? v : a) : a + v;
+            }
+        }
+        acc[ow] = a;
+    }
+}
+
+template <class ElemType, bool IsMax>
+static decltype(&PoolRows<ElemType, IsMax, 0, 0, 0>) SelectPoolRows(size_t windowW, size_t windowH, size_t strideW, size_t numRows)
+{
+    if (numRows == windowH && windowW == windowH)
+    {
+        if (windowW == 2 && strideW == 1)
+            return &PoolRows<ElemType, IsMax, 2, 2, 1>;
+        if (windowW == 2 && strideW == 2)
+            return &PoolRows<ElemType, IsMax, 2, 2, 2>;
+        if (windowW == 3 && strideW == 1)
+            return &PoolRows<ElemType, IsMax, 3, 3, 1>;
+        if (windowW == 3 && strideW == 2)
+            return &PoolRows<ElemType, IsMax, 3, 3, 2>;
+    }
+    return &PoolRows<ElemType, IsMax, 0, 0, 0>;
+}
+
+// Number of outputs of a row whose first maximum taps are searched at once.
+static const size_t MaxTapChunk = 64;
+
+// For the outputs [begin, end) of a row, whose windows are inside of the input rows, finds the offset (from 'rows')
+// of the first tap of the window that is not less than the maximum, or -1 if there is none. The taps are scanned
+// backwards without branches so that the search vectorizes across the outputs.
+template <class ElemType, size_t KW, size_t KH, size_t SW>
+static void FindFirstMaxTaps(const ElemType* rows, size_t inW, size_t numRows, const ElemType* maxima, size_t begin, size_t end,
+                             size_t windowW, size_t strideW, int padW, int* taps)
+{
+    const int kw = (int)(KW != 0 ? KW : windowW);
+    const int kh = (int)(KH != 0 ? KH : numRows);
+    const size_t sw = SW != 0 ? SW : strideW;
+    SIMD_LOOP
+    for (size_t ow = begin; ow < end; ow++)
+    {
+        int origin = (int)(ow * sw) - padW;
+        ElemType m = maxima[ow];
+        int tap = -1;
+        for (int y = kh - 1; y >= 0; y--)
+        {
+            for (int x = kw - 1; x >= 0; x--)
+            {
+                int offset = y * (int)inW + origin + x;
+                tap = rows[offset] >= m ? offset : tap;
+            }
+        }
+        taps[ow - begin] = tap;
+    }
+}
+
+template <class ElemType>
+static decltype(&FindFirstMaxTaps<ElemType, 0, 0, 0>) SelectFindFirstMaxTaps(size_t windowW, size_t windowH, size_t strideW, size_t numRows)
+{
+    if (numRows == windowH && windowW == windowH)
+    {
+        if (windowW == 2 && strideW == 1)
+            return &FindFirstMaxTaps<ElemType, 2, 2, 1>;
+        if (windowW == 2 && strideW == 2)
+            return &FindFirstMaxTaps<ElemType, 2, 2, 2>;
+        if (windowW == 3 && strideW == 1)
+            return &FindFirstMaxTaps<ElemType, 3, 3, 1>;
+        if (windowW == 3 && strideW == 2)
+            return &FindFirstMaxTaps<ElemType, 3, 3, 2>;
+    }
+    return &FindFirstMaxTaps<ElemType, 0, 0, 0>;
+}
+
+template <class ElemType>
+DirectPooling<ElemType>::DirectPooling(const DirectPoolingShape& shape)
+    : m_shape(shape)
+{
+    if (shape.windowW > shape.inW || shape.windowH > shape.inH)
+        InvalidArgument("Direct pooling requires windows that are not larger than the input.");
+
+    ValidOutputRange((int)shape.inW - (int)shape.windowW + 1, (int)shape.outW, (int)shape.strideW, -shape.padW, m_interiorBegin, m_interiorEnd);
+}
+
+template <class ElemType>
+template <bool IsMax>
+void DirectPooling<ElemType>::Forward(const ElemType* in, ElemType* out, size_t batchSize, bool includePad) const
+{
+    const auto& s = m_shape;
+    const ElemType init = IsMax ? -std::numeric_limits<ElemType>::infinity() : 0;
+
+    long planes = (long)(batchSize * s.channels);
+#pragma omp parallel for
+    for (long p = 0; p < planes; p++)
+    {
+        const ElemType* inPlane = in + p * InPlaneSize();
+        ElemType* outPlane = out + p * OutPlaneSize();
+        for (size_t oh = 0; oh < s.outH; oh++)
+        {
+            ElemType* acc = outPlane + oh * s.outW;
+            std::fill(acc, acc + s.outW, init);
+
+            int ihOrigin = (int)(oh * s.strideH) - s.padH;
+            size_t yBegin, yEnd;
+            ValidTapRange(ihOrigin, s.windowH, s.inH, yBegin, yEnd);
+            const ElemType* windowRows = inPlane + (ihOrigin + (int)yBegin) * (int)s.inW;
+            auto poolRows = SelectPoolRows<ElemType, IsMax>(s.windowW, s.windowH, s.strideW, yEnd - yBegin);
+            poolRows(windowRows, s.inW, yEnd - yBegin, acc, m_interiorBegin, m_interiorEnd, s.windowW, s.strideW, s.padW);
+
+            for (size_t y = yBegin; y < yEnd; y++)
+            {
+                const ElemType* row = inPlane + (ihOrigin + (int)y) * (int)s.inW;
+
+                // Outputs at the left and right borders, with windows that are cut off.
+                ForEachBorderOutput([&](size_t ow)
+                {
+                    int iwOrigin = (int)(ow * s.strideW) - s.padW;
+                    size_t xBegin, xEnd;
+                    ValidTapRange(iwOrigin, s.windowW, s.inW, xBegin, xEnd);
+                    ElemType a = acc[ow];
+                    for (size_t x = xBegin; x < xEnd; x++)
+                        a = IsMax ? std::max(a, row[iwOrigin + (int)x]) : a + row[iwOrigin + (int)x];
+                    acc[ow] = a;
+                });
+            }
+
+            if (IsMax)
+                continue;
+
+            // Like the reference engine, divide by the number of taps inside of the input, or by the window size.
+            size_t rows = yEnd - yBegin;
+            ElemType interiorCount = (ElemType)(includePad ? s.windowW * s.windowH : rows * s.windowW);
+            SIMD_LOOP
+            for (size_t ow = m_interiorBegin; ow < m_interiorEnd; ow++)
+                acc[ow] /= interiorCount;
+            ForEachBorderOutput([&](size_t ow)
+            {
+                size_t xBegin, xEnd;
+                ValidTapRange((int)(ow * s.strideW) - s.padW, s.windowW, s.inW, xBegin, xEnd);
+                acc[ow] /= (ElemType)(includePad ? s.windowW * s.windowH : rows * (xEnd - xBegin));
+            });
+        }
+    }
+}
+
+template <class ElemType>
+void DirectPooling<ElemType>::MaxForward(const ElemType* in, ElemType* out, size_t batchSize) const
+{
+    Forward<true>(in, out, batchSize, false);
+}
+
+template <class ElemType>
+void DirectPooling<ElemType>::AverageForward(const ElemType* in, ElemType* out, size_t batchSize, bool includePad) const
+{
+    Forward<false>(in, out, batchSize, includePad);
+}
+
+template <class ElemType>
+void DirectPooling<ElemType>::MaxBackward(const ElemType* out, const ElemType* srcGrad, const ElemType* in, ElemType* grad, size_t batchSize) const
+{
+    const auto& s = m_shape;
+    long planes = (long)(batchSize * s.channels);
+#pragma omp parallel for
+    for (long p = 0; p < planes; p++)
+    {
+        const ElemType* inPlane = in + p * InPlaneSize();
+        ElemType* gradPlane = grad + p * InPlaneSize();
+        const ElemType* outPlane = out + p * OutPlaneSize();
+        const ElemType* srcGradPlane = srcGrad + p * OutPlaneSize();
+        for (size_t oh = 0; oh < s.outH; oh++)
+        {
+            const ElemType* maxima = outPlane + oh * s.outW;
+            const ElemType* srcGradRow = srcGradPlane + oh * s.outW;
+            int ihOrigin = (int)(oh * s.strideH) - s.padH;
+            size_t yBegin, yEnd;
+            ValidTapRange(ihOrigin, s.windowH, s.inH, yBegin, yEnd);
+            size_t windowRowsOffset = (size_t)(ihOrigin + (int)yBegin) * s.inW;
+
+            // Windows of neighboring outputs may share the first maximum, so the gradients are added after the search.
+            auto findFirstMaxTaps = SelectFindFirstMaxTaps<ElemType>(s.windowW, s.windowH, s.strideW, yEnd - yBegin);
+            int taps[MaxTapChunk];
+            for (size_t begin = m_interiorBegin; begin < m_interiorEnd; begin += MaxTapChunk)
+            {
+                size_t end = std::min(begin + MaxTapChunk, m_interiorEnd);
+                findFirstMaxTaps(inPlane + windowRowsOffset, s.inW, yEnd - yBegin, maxima, begin, end, s.windowW, s.strideW, s.padW, taps);
+                for (size_t ow = begin; ow < end; ow++)
+                {
+                    if (taps[ow - begin] >= 0)
+                        gradPlane[windowRowsOffset + taps[ow - begin]] += srcGradRow[ow];
+                }
+            }
+
+            ForEachBorderOutput([&](size_t ow)
+            {
+                int iwOrigin = (int)(ow * s.strideW) - s.padW;
+                size_t xBegin, xEnd;
+                ValidTapRange(iwOrigin, s.windowW, s.inW, xBegin, xEnd);
+
+                // The gradient goes to the first tap that holds the maximum.
+                for (size_t y = yBegin; y < yEnd; y++)
+                {
+                    size_t rowOffset = (size_t)(ihOrigin + (int)y) * s.inW;
+                    for (size_t x = xBegin; x < xEnd; x++)
+                    {
+                        size_t i = rowOffset + (size_t)(iwOrigin + (int)x);
+                        if (inPlane[i] >= maxima[ow])
+                        {
+                            gradPlane[i] += srcGradRow[ow];
+                            return;
+                        }
+                    }
+                }
+            });
+        }
+    }
+}
+
+template <class ElemType>
+void DirectPooling<ElemType>::AverageBackward(const ElemType* srcGrad, ElemType* grad, size_t batchSize, bool includePad) const
+{
+    const auto& s = m_shape;
+    long planes = (long)(batchSize * s.channels);
+#pragma omp parallel for
+    for (long p = 0; p < planes; p++)
+    {
+        ElemType* gradPlane = grad + p * InPlaneSize();
+        const ElemType* srcGradPlane = srcGrad + p * OutPlaneSize();
+        for (size_t oh = 0; oh < s.outH; oh++)
+        {
+            const ElemType* srcGradRow = srcGradPlane + oh * s.outW;
+            int ihOrigin = (int)(oh * s.strideH) - s.padH;
+            size_t yBegin, yEnd;
+            ValidTapRange(ihOrigin, s.windowH, s.inH, yBegin, yEnd);
+            size_t rows = yEnd - yBegin;
+            ElemType interiorCount = (ElemType)(includePad ? s.windowW * s.windowH : rows * s.windowW);
+
+            for (size_t y = yBegin; y < yEnd; y++)
+            {
+                ElemType* gradRow = gradPlane + (ihOrigin + (int)y) * (int)s.inW;
+
+                // Windows of neighboring outputs overlap when the stride is smaller than the window, but
+                // for a fixed tap x the outputs of a row update distinct inputs.
+                for (size_t x = 0; x < s.windowW; x++)
+                {
+                    ElemType* taps = gradRow + ((ptrdiff_t)x - s.padW);
+                    SIMD_LOOP
+                    for (size_t ow = m_interiorBegin; ow < m_interiorEnd; ow++)
+                        taps[ow * s.strideW] += srcGradRow[ow] / interiorCount;
+                }
+
+                ForEachBorderOutput([&](size_t ow)
+                {
+                    int iwOrigin = (int)(ow * s.strideW) - s.padW;
+                    size_t xBegin, xEnd;
+                    ValidTapRange(iwOrigin, s.windowW, s.inW, xBegin, xEnd);
+                    ElemType count = (ElemType)(includePad ? s.windowW * s.windowH : rows * (xEnd - xBegin));
+                    ElemType g = srcGradRow[ow] / count;
+                    for (size_t x = xBegin; x < xEnd; x++)
+                        gradRow[iwOrigin + (int)x] += g;
+                });
+            }
+        }
+    }
+}
+
+template class DirectPooling<float>;
+template class DirectPooling<double>;
+
+}}}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectPooling.h -- CPU max and average pooling over 2D windows that walk the input planes directly
+// instead of the index maps of ConvolveGeometry.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// 2D pooling of one sample, CNTK CHW layout (column-major [W x H x C]), each channel pooled on its own.
+// Output (ow, oh) pools the input window starting at (ow * strideW - padW, oh * strideH - padH);
+// taps outside of the input are skipped.
+struct DirectPoolingShape
+{
+    size_t inW, inH;
+    size_t outW, outH;
+    size_t channels;
+    size_t windowW, windowH;
+    size_t strideW, strideH;
+    int padW, padH;
+};
+
+// Results match the reference engine's index map kernels (CPUMatrix::MaxPoolingForward and friends): windows are visited
+// in the same order, and max pooling routes each gradient to the first maximum of its window. Only the order in which
+// overlapping windows add to an input gradient differs.
+// The outputs of a row are pooled at once, so the inner loops vectorize across the width; 2x2 and 3x3 windows
+// with stride 1 or 2 run on kernels specialized for their geometry. Each channel of a sample is processed by a single
+// thread, so no atomic updates are needed.
+// Windows must not be larger than the input.
+template <class ElemType>
+class DirectPooling
+{
+public:
+    explicit DirectPooling(const DirectPoolingShape& shape);
+
+    const DirectPoolingShape& Shape() const { return m_shape; }
+
+    void MaxForward(const ElemType* in, ElemType* out, size_t batchSize) const;
+    // grad += gradient of max pooling.
+    void MaxBackward(const ElemType* out, const ElemType* srcGrad, const ElemType* in, ElemType* grad, size_t batchSize) const;
+
+    // If 'includePad' is true, sums are divided by the window size, otherwise by the number of taps inside of the input.
+    void AverageForward(const ElemType* in, ElemType* out, size_t batchSize, bool includePad) const;
+    // grad += gradient of average pooling.
+    void AverageBackward(const ElemType* srcGrad, ElemType* grad, size_t batchSize, bool includePad) const;
+
+private:
+    size_t InPlaneSize() const { return m_shape.inW * m_shape.inH; }
+    size_t OutPlaneSize() const { return m_shape.outW * m_shape.outH; }
+
+    template <bool IsMax>
+    void Forward(const ElemType* in, ElemType* out, size_t batchSize, bool includePad) const;
+
+    // Calls f(ow) for the outputs of a row whose windows are cut off by the borders of the input.
+    template <class F>
+    void ForEachBorderOutput(F f) const
+    {
+        for (size_t ow = 0; ow < m_interiorBegin; ow++)
+            f(ow);
+        for (size_t ow = m_interiorEnd; ow < m_shape.outW; ow++)
+            f(ow);
+    }
+
+    DirectPoolingShape m_shape;
+    // Outputs [m_interiorBegin, m_interiorEnd) of a row have their whole window inside of the input row.
+    size_t m_interiorBegin;
+    size_t m_interiorEnd;
+};
+
+}}}
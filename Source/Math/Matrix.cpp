@@ -5699,6 +5699,55 @@ Matrix<ElemType>& Matrix<ElemType>::AssignInnerProductOfMatrices(const Matrix<El
     return *this;
 }
 
+/// <summary>logSumExp(j) = log(sum_v exp((weight' * hidden)(v, j))), without storing weight' * hidden as a whole</summary>
+/// Only implemented for dense CPU matrices.
+/// <param name="weight">[hidden dim x vocabulary size] weight matrix</param>
+/// <param name="hidden">[hidden dim x N] input matrix</param>
+/// <param name="tileSize">Number of rows of weight' * hidden (columns of weight) computed at a time</param>
+/// <param name="logSumExp">[1 x N] resulting matrix</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::TiledLogSumExpOfTransposeProduct(const Matrix<ElemType>& weight, const Matrix<ElemType>& hidden, size_t tileSize, Matrix<ElemType>& logSumExp)
+{
+    DecideAndMoveToRightDevice(weight, hidden, logSumExp);
+    if (weight.GetMatrixType() != MatrixType::DENSE || hidden.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    logSumExp.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            &logSumExp,
+                            CPUMatrix<ElemType>::TiledLogSumExpOfTransposeProduct(*weight.m_CPUMatrix, *hidden.m_CPUMatrix, tileSize, *logSumExp.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+/// <summary>Adds the gradients of sum_j scale(j) * logSumExp(j) w.r.t. hidden and weight, see TiledLogSumExpOfTransposeProduct()</summary>
+/// <param name="logSumExp">[1 x N] result of TiledLogSumExpOfTransposeProduct()</param>
+/// <param name="scale">[1 x N] gradient w.r.t. logSumExp</param>
+/// <param name="hiddenGradient">Gradient to add to (same dimensions as hidden), or nullptr</param>
+/// <param name="weightGradient">Gradient to add to (same dimensions as weight), or nullptr</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::TiledLogSumExpOfTransposeProductBackprop(const Matrix<ElemType>& weight, const Matrix<ElemType>& hidden,
+                                                                           const Matrix<ElemType>& logSumExp, const Matrix<ElemType>& scale, size_t tileSize,
+                                                                           Matrix<ElemType>* hiddenGradient, Matrix<ElemType>* weightGradient)
+{
+    DecideAndMoveToRightDevice(weight, hidden, logSumExp, scale);
+    if (weight.GetMatrixType() != MatrixType::DENSE || hidden.GetMatrixType() != MatrixType::DENSE ||
+        (hiddenGradient && (hiddenGradient->GetDeviceId() != hidden.GetDeviceId() || hiddenGradient->GetMatrixType() != MatrixType::DENSE)) ||
+        (weightGradient && (weightGradient->GetDeviceId() != hidden.GetDeviceId() || weightGradient->GetMatrixType() != MatrixType::DENSE)))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            nullptr,
+                            CPUMatrix<ElemType>::TiledLogSumExpOfTransposeProductBackprop(*weight.m_CPUMatrix, *hidden.m_CPUMatrix, *logSumExp.m_CPUMatrix, *scale.m_CPUMatrix, tileSize,
+                                                                                          hiddenGradient ? hiddenGradient->m_CPUMatrix.get() : nullptr,
+                                                                                          weightGradient ? weightGradient->m_CPUMatrix.get() : nullptr),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::ElementWisePower(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c)
 {
@@ -6071,6 +6120,65 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+/// <summary>Viterbi decoding of a linear-chain CRF for all sequences of a minibatch</summary>
+/// Only implemented for dense CPU matrices.
+/// <param name="posScores">[labels x columns] position dependent scores, in the minibatch layout</param>
+/// <param name="pairScores">[labels x labels] transition scores, pairScores(k, j) for label j followed by k</param>
+/// <param name="uttToChanInd">Parallel sequence (channel) of each sequence</param>
+/// <param name="uttBeginFrame">First time step of each sequence in its channel</param>
+/// <param name="uttFrameNum">Number of time steps of each sequence</param>
+/// <param name="uttStartLabel">Label the first time step of each sequence is constrained to</param>
+/// <param name="uttEndLabel">Label the decoded path of each sequence ends in</param>
+/// <param name="numChannels">Number of parallel sequences of the minibatch</param>
+/// <param name="alpha">Resulting Viterbi scores, same dimensions as posScores</param>
+/// <param name="decodedPath">Resulting one-hot decoded paths, same dimensions as posScores</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::CRFViterbiDecode(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                                   const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                                   const vector<size_t>& uttStartLabel, const vector<size_t>& uttEndLabel, const size_t numChannels,
+                                                   Matrix<ElemType>& alpha, Matrix<ElemType>& decodedPath)
+{
+    DecideAndMoveToRightDevice(posScores, pairScores, alpha, decodedPath);
+    if (posScores.GetMatrixType() != MatrixType::DENSE || pairScores.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    alpha.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    decodedPath.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            nullptr,
+                            CPUMatrix<ElemType>::CRFViterbiDecode(*posScores.m_CPUMatrix, *pairScores.m_CPUMatrix,
+                                                                  uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, uttEndLabel, numChannels,
+                                                                  *alpha.m_CPUMatrix, *decodedPath.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+/// <summary>Forward (alpha) recursion of a linear-chain CRF for all sequences of a minibatch, see CRFViterbiDecode()</summary>
+/// Only implemented for dense CPU matrices.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::CRFForwardCompute(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                                    const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                                    const vector<size_t>& uttStartLabel, const size_t numChannels,
+                                                    Matrix<ElemType>& alpha)
+{
+    DecideAndMoveToRightDevice(posScores, pairScores, alpha);
+    if (posScores.GetMatrixType() != MatrixType::DENSE || pairScores.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    alpha.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            nullptr,
+                            CPUMatrix<ElemType>::CRFForwardCompute(*posScores.m_CPUMatrix, *pairScores.m_CPUMatrix,
+                                                                   uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, numChannels,
+                                                                   *alpha.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -627,6 +627,10 @@ public:
     static void Scale(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
     static void InnerProduct(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, const bool isColWise);
     static ElemType InnerProductOfMatrices(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
+    static void TiledLogSumExpOfTransposeProduct(const Matrix<ElemType>& weight, const Matrix<ElemType>& hidden, size_t tileSize, Matrix<ElemType>& logSumExp);
+    static void TiledLogSumExpOfTransposeProductBackprop(const Matrix<ElemType>& weight, const Matrix<ElemType>& hidden,
+                                                         const Matrix<ElemType>& logSumExp, const Matrix<ElemType>& scale, size_t tileSize,
+                                                         Matrix<ElemType>* hiddenGradient, Matrix<ElemType>* weightGradient);
     static void ElementWisePower(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
     static void BatchMatMul(ElemType beta, const Matrix<ElemType>& a, const bool transposeA, const int m, const Matrix<ElemType>& b, const bool transposeB, const int n, Matrix<ElemType>& c, const bool isColWise);
 
@@ -679,6 +683,16 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    static void CRFViterbiDecode(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                 const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                 const vector<size_t>& uttStartLabel, const vector<size_t>& uttEndLabel, const size_t numChannels,
+                                 Matrix<ElemType>& alpha, Matrix<ElemType>& decodedPath);
+
+    static void CRFForwardCompute(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                  const vector<size_t>& uttToChanInd, const vector<size_t>& uttBeginFrame, const vector<size_t>& uttFrameNum,
+                                  const vector<size_t>& uttStartLabel, const size_t numChannels,
+                                  Matrix<ElemType>& alpha);
+
     template <typename T>
     friend class MatrixQuantizer;
 
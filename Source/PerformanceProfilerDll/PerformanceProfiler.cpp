@@ -19,6 +19,9 @@
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <stdio.h>
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
@@ -48,25 +51,39 @@ struct FixedEventDesc
     char            eventDescription[64];
     FixedEventType  eventType;
     bool            syncGpu;
+    int             category;
 };
 
 static const FixedEventDesc c_fixedEvtDesc[profilerEvtMax] = {
-    { "Main Thread", profilerEvtSeparator, false },                 // profilerSepMainThread
-    { "", profilerEvtSeparator, false },                            // profilerSepSpace0
-
-    { "Epoch", profilerEvtTime, false },                            // profilerEvtMainEpoch
-    { "_Minibatch Iteration", profilerEvtTime, false },             // profilerEvtMainMinibatch
-    { "__Get Minibatch", profilerEvtTime, true },                   // profilerEvtMainGetMinibatch
-    { "__Forward + Backward", profilerEvtTime, true },              // profilerEvtMainFB
-    { "__Gradient Aggregation", profilerEvtTime, true },            // profilerEvtMainGradient
-    { "__Weight Update", profilerEvtTime, true },                   // profilerEvtMainWeights
-    { "__Post Processing", profilerEvtTime, true },                 // profilerEvtMainPost
-
-    { "", profilerEvtSeparator, false },                            // profilerSepSpace1
-    { "Data Reader", profilerEvtSeparator, false },                 // profilerSepDataReader
-    { "", profilerEvtSeparator, false },                            // profilerSepSpace2
-
-    { "Prefetch Minibatch", profilerEvtTime, false },               // profilerEvtPrefetchMinibatch
+    { "Main Thread", profilerEvtSeparator, false, profilerCatMain },                    // profilerSepMainThread
+    { "", profilerEvtSeparator, false, profilerCatMain },                               // profilerSepSpace0
+
+    { "Epoch", profilerEvtTime, false, profilerCatMain },                               // profilerEvtMainEpoch
+    { "_Minibatch Iteration", profilerEvtTime, false, profilerCatMain },                // profilerEvtMainMinibatch
+    { "__Get Minibatch", profilerEvtTime, true, profilerCatReader },                    // profilerEvtMainGetMinibatch
+    { "__Forward + Backward", profilerEvtTime, true, profilerCatMain },                 // profilerEvtMainFB
+    { "__Gradient Aggregation", profilerEvtTime, true, profilerCatDistributed },        // profilerEvtMainGradient
+    { "__Weight Update", profilerEvtTime, true, profilerCatMain },                      // profilerEvtMainWeights
+    { "__Post Processing", profilerEvtTime, true, profilerCatMain },                    // profilerEvtMainPost
+
+    { "", profilerEvtSeparator, false, profilerCatReader },                             // profilerSepSpace1
+    { "Data Reader", profilerEvtSeparator, false, profilerCatReader },                  // profilerSepDataReader
+    { "", profilerEvtSeparator, false, profilerCatReader },                             // profilerSepSpace2
+
+    { "Prefetch Minibatch", profilerEvtTime, false, profilerCatReader },                // profilerEvtPrefetchMinibatch
+    { "Read Chunk", profilerEvtThroughput, false, profilerCatReader },                  // profilerEvtReadChunk
+    { "Wait For Chunk", profilerEvtTime, false, profilerCatReader },                    // profilerEvtWaitForChunk
+    { "Wait For Prefetch", profilerEvtTime, false, profilerCatReader },                 // profilerEvtWaitForPrefetch
+};
+
+// Values of the "cat" field of the events in the detail log, indexed by ProfilerCategory
+static const char* c_categoryNames[profilerCatMax] = {
+    "main",                 // profilerCatMain
+    "node",                 // profilerCatNode
+    "memory",               // profilerCatMemory
+    "reader",               // profilerCatReader
+    "distributed",          // profilerCatDistributed
+    "custom",               // profilerCatCustom
 };
 
 
@@ -81,14 +98,17 @@ struct FixedEventRecord
 };
 
 //
-// The custom event record is a variable size datastructure in memory:
-// NULL terminated description string, followed by CustomEventRecord struct
+// The custom event buffer is an array of fixed size records, so that it can be used as a ring buffer.
+// Descriptions are stored once in ProfilerState::descriptions and referenced by index.
 //
 struct CustomEventRecord
 {
     long long       beginClock;
     long long       endClock;
+    long long       bytes;          // 0 if not applicable
+    unsigned int    descriptionId;
     unsigned int    threadId;
+    int             category;
 };
 
 
@@ -104,9 +124,14 @@ struct ProfilerState
     std::wstring            logSuffix;                   // Suffix to append to report/log file names
     FixedEventRecord        fixedEvents[profilerEvtMax]; // Profiling data for each fixed event
     bool                    customEventBufferFull;       // Is custom event buffer full?
-    unsigned long long      customEventBufferBytes;      // Number of bytes allocated for the custom event buffer
-    unsigned long long      customEventOffset;           // Offset to current place in buffer
-    unique_ptr<char[]>      customEventBuffer;           // Pointer to custom event buffer
+    unsigned long long      customEventCapacity;         // Number of records that fit in the custom event buffer
+    unsigned long long      customEventCount;            // Number of records written, in ring buffer mode including overwritten ones
+    unique_ptr<CustomEventRecord[]> customEventBuffer;   // Pointer to custom event buffer
+    std::vector<std::string> descriptions;               // Custom event descriptions, indexed by CustomEventRecord::descriptionId
+    std::unordered_map<std::string, unsigned int> descriptionIds;
+    bool                    traceRingBuffer;             // Overwrite the oldest custom events when the buffer is full
+    unsigned int            traceSamplingPeriod;         // Record custom events for one in every traceSamplingPeriod minibatches
+    unsigned long long      traceMinibatchCount;         // Number of minibatches ended while enabled
     long long               startClock;
 };
 
@@ -160,9 +185,13 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
     g_profilerState->logSuffix = logSuffix;
 
     g_profilerState->customEventBufferFull = false;
-    g_profilerState->customEventBufferBytes = customEventBufferBytes;
-    g_profilerState->customEventOffset = 0ull;
-    g_profilerState->customEventBuffer.reset(new char[customEventBufferBytes]);
+    g_profilerState->customEventCapacity = customEventBufferBytes / sizeof(CustomEventRecord);
+    g_profilerState->customEventCount = 0ull;
+    g_profilerState->customEventBuffer.reset(new CustomEventRecord[g_profilerState->customEventCapacity]);
+
+    g_profilerState->traceRingBuffer = false;
+    g_profilerState->traceSamplingPeriod = 1;
+    g_profilerState->traceMinibatchCount = 0ull;
 
     g_profilerState->syncGpu = syncGpu;
     g_profilerState->enabled = false;
@@ -193,6 +222,28 @@ void PERF_PROFILER_API ProfilerEnable(bool enable)
 }
 
 
+//
+// Switch the detail log to trace mode.
+// ringBuffer: Once the custom event buffer is full, overwrite the oldest events rather than dropping new ones.
+// samplingPeriod: Record custom events during one in every samplingPeriod minibatches only (1 records all).
+//
+void PERF_PROFILER_API ProfilerTraceMode(bool ringBuffer, unsigned int samplingPeriod)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    if (samplingPeriod == 0)
+    {
+        RuntimeError("Error: ProfilerTraceMode: The sampling period must be positive.\n");
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_profilerState->traceRingBuffer = ringBuffer;
+    g_profilerState->traceSamplingPeriod = samplingPeriod;
+}
+
+
 //
 // Internal helper functions to record fixed and custom profiling events.
 //
@@ -216,16 +267,18 @@ void ProfilerTimeRecordFixedEvent(const int eventId, const long long beginClock,
     g_profilerState->fixedEvents[eventId].cnt++;
 }
 
-void ProfilerTimeRecordToBuffer(const char* eventDescription, const long long beginClock, const long long endClock)
+void ProfilerTimeRecordToBuffer(const char* eventDescription, const int category, const long long beginClock, const long long endClock, const long long bytes)
 {
     std::lock_guard<std::mutex> lock(g_mutex);
 
     if (!g_profilerState->enabled)
         return;
 
-    auto eventDescriptionBytes = strlen(eventDescription) + 1;
-    auto requiredBufferBytes = eventDescriptionBytes + sizeof(CustomEventRecord);
-    if ((g_profilerState->customEventOffset + requiredBufferBytes) > g_profilerState->customEventBufferBytes)
+    if ((g_profilerState->traceMinibatchCount % g_profilerState->traceSamplingPeriod) != 0)
+        return;
+
+    if (g_profilerState->customEventCapacity == 0 ||
+        (g_profilerState->customEventCount == g_profilerState->customEventCapacity && !g_profilerState->traceRingBuffer))
     {
         if (!g_profilerState->customEventBufferFull)
         {
@@ -235,16 +288,31 @@ void ProfilerTimeRecordToBuffer(const char* eventDescription, const long long be
         return;
     }
 
-    strcpy(g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset, eventDescription);
-    g_profilerState->customEventOffset += eventDescriptionBytes;
+    auto description = g_profilerState->descriptionIds.find(eventDescription);
+    if (description == g_profilerState->descriptionIds.end())
+    {
+        description = g_profilerState->descriptionIds.insert(std::make_pair(std::string(eventDescription), (unsigned int)g_profilerState->descriptions.size())).first;
+        g_profilerState->descriptions.push_back(eventDescription);
+    }
 
-    CustomEventRecord eventRecord;
+    CustomEventRecord& eventRecord = g_profilerState->customEventBuffer[g_profilerState->customEventCount % g_profilerState->customEventCapacity];
     eventRecord.beginClock = beginClock;
     eventRecord.endClock = endClock;
+    eventRecord.bytes = bytes;
+    eventRecord.descriptionId = description->second;
     eventRecord.threadId = GetThreadId();
+    eventRecord.category = category;
+    g_profilerState->customEventCount++;
+}
 
-    memcpy(g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset, &eventRecord, sizeof(CustomEventRecord));
-    g_profilerState->customEventOffset += sizeof(CustomEventRecord);
+void ProfilerTraceEndMinibatch()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    if (!g_profilerState->enabled)
+        return;
+
+    g_profilerState->traceMinibatchCount++;
 }
 
 
@@ -270,17 +338,26 @@ void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const int eventI
 
     long long endClock = Clock::GetTimeStamp();
     ProfilerTimeRecordFixedEvent(eventId, stateId, endClock);
-    ProfilerTimeRecordToBuffer(c_fixedEvtDesc[eventId].eventDescription, stateId, endClock);
+    ProfilerTimeRecordToBuffer(c_fixedEvtDesc[eventId].eventDescription, c_fixedEvtDesc[eventId].category, stateId, endClock, 0);
+
+    if (eventId == profilerEvtMainMinibatch)
+        ProfilerTraceEndMinibatch();
 }
 
 
 void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* eventDescription)
+{
+    ProfilerTimeEnd(stateId, eventDescription, profilerCatCustom, 0);
+}
+
+
+void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* eventDescription, const int category, const long long bytes)
 {
     // A nullptr state indicates that the profiler is globally disabled, and not initialized
     if (g_profilerState == nullptr)
         return;
 
-    ProfilerTimeRecordToBuffer(eventDescription, stateId, Clock::GetTimeStamp());
+    ProfilerTimeRecordToBuffer(eventDescription, category, stateId, Clock::GetTimeStamp(), bytes);
 }
 
 
@@ -323,6 +400,8 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
     if (g_profilerState == nullptr)
         return;
 
+    ProfilerTimeRecordToBuffer(c_fixedEvtDesc[eventId].eventDescription, c_fixedEvtDesc[eventId].category, stateId, endClock, bytes);
+
     std::lock_guard<std::mutex> lock(g_mutex);
 
     if (!g_profilerState->enabled)
@@ -540,8 +619,37 @@ void FormatBytesStr(char* str, size_t strLen, long long bytes)
 
 
 
+//
+// Escape a string for use in a JSON string literal.
+//
+std::string FormatJsonStr(const std::string& str)
+{
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (unsigned char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c < 0x20)
+        {
+            char code[8];
+            sprintf_s(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
 //
 // Generate detail event file in chrome://tracing format (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/preview#heading=h.yr703knxre9f)
+// Every event is written as a complete ("X") event, i.e. a span with a start time and a duration in microseconds.
 //
 void ProfilerGenerateDetailFile(const std::wstring& fileName)
 {
@@ -551,33 +659,41 @@ void ProfilerGenerateDetailFile(const std::wstring& fileName)
         RuntimeError("Error: ProfilerGenerateDetailFile: Cannot create file <%ls>.\n", fileName.c_str());
     }
 
-    fprintfOrDie(f, "[\n");
+    std::vector<std::string> descriptions;
+    descriptions.reserve(g_profilerState->descriptions.size());
+    for (const auto& description : g_profilerState->descriptions)
+        descriptions.push_back(FormatJsonStr(description));
+
+    // In ring buffer mode, the oldest record that has not been overwritten is the next one to be written.
+    auto count = g_profilerState->customEventCount;
+    auto capacity = g_profilerState->customEventCapacity;
+    auto first = (count > capacity) ? (count % capacity) : 0ull;
+    auto numRecords = std::min(count, capacity);
+    if (count > capacity)
+    {
+        fprintf(stderr, "Warning: Performance Profiler: %llu of %llu events were overwritten in the ring buffer.\n", count - capacity, count);
+    }
 
-    char* eventPtr = g_profilerState->customEventBuffer.get();
+    fprintfOrDie(f, "[\n");
 
-    bool firstRecord = true;
     unsigned int pid = GetProcessId();
-    while (eventPtr < (g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset))
+    for (unsigned long long i = 0; i < numRecords; i++)
     {
-        char* descriptionStr = eventPtr;
-        eventPtr += strlen(descriptionStr) + 1;
+        const CustomEventRecord& eventRecord = g_profilerState->customEventBuffer[(first + i) % capacity];
 
-        CustomEventRecord* eventRecord = (CustomEventRecord*)eventPtr;
-        eventPtr += sizeof(CustomEventRecord);
-
-        fprintfOrDie(f, "%s  {\"pid\":%u, \"tid\":%u, \"name\":\"%s\", \"cat\":\"PERF\", \"ph\":\"B\", \"ts\":%llu}",
-            firstRecord ? "" : ",\n",
+        fprintfOrDie(f, "%s  {\"pid\":%u, \"tid\":%u, \"name\":\"%s\", \"cat\":\"%s\", \"ph\":\"X\", \"ts\":%.3f, \"dur\":%.3f",
+            (i == 0) ? "" : ",\n",
             pid,
-            eventRecord->threadId,
-            descriptionStr,
-            (unsigned long long)(1000000.0 * TicksToSeconds(eventRecord->beginClock - g_profilerState->startClock)));
+            eventRecord.threadId,
+            descriptions[eventRecord.descriptionId].c_str(),
+            c_categoryNames[eventRecord.category],
+            1000000.0 * TicksToSeconds(eventRecord.beginClock - g_profilerState->startClock),
+            1000000.0 * TicksToSeconds(eventRecord.endClock - eventRecord.beginClock));
 
-        firstRecord = false;
-        fprintfOrDie(f, ",\n  {\"pid\":%u, \"tid\":%u, \"name\":\"%s\", \"cat\":\"PERF\", \"ph\":\"E\", \"ts\":%llu}",
-            pid,
-            eventRecord->threadId,
-            descriptionStr,
-            (unsigned long long)(1000000.0 * TicksToSeconds(eventRecord->endClock - g_profilerState->startClock)));
+        if (eventRecord.bytes != 0)
+            fprintfOrDie(f, ", \"args\":{\"bytes\":%lld}", eventRecord.bytes);
+
+        fprintfOrDie(f, "}");
     }
 
     fprintfOrDie(f, "\n]\n");
@@ -611,6 +727,16 @@ ScopeProfile::ScopeProfile(int eventId)
 ScopeProfile::ScopeProfile(const char* description)
 {
     m_description = description;
+    m_category = profilerCatCustom;
+    m_bytes = 0;
+    m_stateId = ProfilerTimeBegin();
+}
+
+ScopeProfile::ScopeProfile(const char* description, int category, long long bytes)
+{
+    m_description = description;
+    m_category = category;
+    m_bytes = bytes;
     m_stateId = ProfilerTimeBegin();
 }
 
@@ -618,7 +744,7 @@ ScopeProfile::~ScopeProfile()
 {
     if (m_description)
     {
-        ProfilerTimeEnd(m_stateId, m_description);
+        ProfilerTimeEnd(m_stateId, m_description, m_category, m_bytes);
     }
     else
     {
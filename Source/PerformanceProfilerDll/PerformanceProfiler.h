@@ -26,6 +26,12 @@
 // and ProfilerThroughputEnd() calls should be used. The throughput APIs can only be used
 // with fixed events.
 //
+// The detail log is a Chrome/Perfetto trace (chrome://tracing, ui.perfetto.dev): every event is a span
+// on the timeline of the thread that recorded it, with a category and, for I/O and memory events, a byte
+// count. ProfilerTraceMode() turns the custom event buffer into a ring buffer that keeps the most recent
+// events, and optionally records only one in every N minibatches, so that long runs can be traced with
+// bounded memory.
+//
 // CNTK specifics
 //
 // The profiler is turned off during the very first epoch to avoid polluting profile data with
@@ -79,11 +85,30 @@ enum ProfilerEvents
 
     // Data reader events
     profilerEvtPrefetchMinibatch,           // Prefetching the next minibatch in a background thread
+    profilerEvtReadChunk,                   // Reading a chunk from the deserializer (estimated bytes)
+    profilerEvtWaitForChunk,                // Waiting for a chunk that is not read ahead yet
+    profilerEvtWaitForPrefetch,             // Waiting for the prefetched minibatch
 
     profilerEvtMax
 };
 
 
+//
+// Categories of the events in the detail log.
+//
+enum ProfilerCategory
+{
+    profilerCatMain = 0,                    // Main thread loop
+    profilerCatNode,                        // Forward/backward of a computation node (requires node timing)
+    profilerCatMemory,                      // Memory allocation
+    profilerCatReader,                      // Data reader and prefetching
+    profilerCatDistributed,                 // Gradient aggregation across workers
+    profilerCatCustom,                      // Custom events without a category
+
+    profilerCatMax
+};
+
+
 //
 // Initialize all resources to enable profiling.
 // profilerDir: Directory where the profiler logs will be saved.
@@ -103,14 +128,25 @@ void PERF_PROFILER_API ProfilerInit(const std::wstring& profilerDir, const unsig
 void PERF_PROFILER_API ProfilerEnable(bool enable);
 
 
+//
+// Switch the detail log to trace mode.
+// ringBuffer: Once the custom event buffer is full, overwrite the oldest events rather than dropping new ones.
+// samplingPeriod: Record custom events during one in every samplingPeriod minibatches only (1 records all).
+// Minibatches are delimited by the end of profilerEvtMainMinibatch events. The summary report is not affected.
+//
+void PERF_PROFILER_API ProfilerTraceMode(bool ringBuffer, unsigned int samplingPeriod);
+
+
 //
 // Measure either a fixed or custom event time.
 // ProfilerTimeBegin() returns a stateId that is passed to ProfilerTimeEnd().
 // If ProfilerTimeEnd() is not called, the event is not recorded.
+// Custom events can be given a ProfilerCategory and a number of bytes that are shown in the detail log.
 //
 long long PERF_PROFILER_API ProfilerTimeBegin();
 void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const int eventId);
 void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* eventDescription);
+void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* eventDescription, const int category, const long long bytes = 0);
 
 //
 // Conditionally sync the GPU if the syncGPU flag is set. This only needs to be excplicitly
@@ -151,12 +187,15 @@ struct PERF_PROFILER_API ScopeProfile
 {
     ScopeProfile(int eventId);
     ScopeProfile(const char* description);
+    ScopeProfile(const char* description, int category, long long bytes = 0);
     ~ScopeProfile();
 
 private:
     unsigned long long  m_stateId;
     int                 m_eventId;
     const char*         m_description;
+    int                 m_category;
+    long long           m_bytes;
 };
 
 #define PROFILE_SCOPE(eventId)      ScopeProfile __sp##eventId(eventId);
@@ -16,14 +16,6 @@ namespace CNTK {
 
 using namespace Microsoft::MSR::CNTK;
 
-enum class MatrixEncodingType : unsigned char
-{
-    dense = 0,
-    sparse_csc = 1,
-    // TODO: compressed_sparse_csc = 2, // indices are encoded as var-ints
-};
-
-
 void BinaryChunkDeserializer::ReadChunkTable()
 {
     uint64_t firstChunkOffset = m_chunkTableOffset;
@@ -34,16 +26,36 @@ void BinaryChunkDeserializer::ReadChunkTable()
     // Note we create m_numChunks + 1 since we want to be consistent with determining the size of each chunk.
     BinaryChunkInfo* chunks = new BinaryChunkInfo[m_numChunks + 1];
 
-    // Read in all of the offsets for the chunks
-    m_file.ReadOrDie(chunks, sizeof(BinaryChunkInfo), m_numChunks);
+    vector<pair<ChunkCodecType, uint64_t>> codecs;
+    if (m_version == 1)
+    {
+        // Read in all of the offsets for the chunks
+        m_file.ReadOrDie(chunks, sizeof(BinaryChunkInfo), m_numChunks);
+    }
+    else
+    {
+        // Version 2 entries additionally record the codec of each chunk.
+        vector<BinaryChunkInfoV2> entries(m_numChunks);
+        m_file.ReadOrDie(entries.data(), sizeof(BinaryChunkInfoV2), m_numChunks);
+
+        codecs.reserve(m_numChunks);
+        for (decltype(m_numChunks) i = 0; i < m_numChunks; i++)
+        {
+            if (entries[i].codec != ChunkCodecType::none && entries[i].codec != ChunkCodecType::lz4)
+                RuntimeError("Chunk %" PRIu32 " is compressed with an unsupported codec %" PRIu32 ".", i, (uint32_t)entries[i].codec);
+
+            chunks[i] = BinaryChunkInfo{ entries[i].offset, entries[i].numSequences, entries[i].numSamples };
+            codecs.push_back(make_pair(entries[i].codec, entries[i].decodedSize));
+        }
+    }
 
-    // We fill the final entry with the current position of the file
-    auto position = m_file.TellOrDie();
-    chunks[m_numChunks].offset = position;
+    // We fill the final entry with the start of the header, which immediately follows the last chunk
+    // (compressed chunks have to be read without any trailing bytes).
+    chunks[m_numChunks].offset = m_headerOffset;
     chunks[m_numChunks].numSamples = 0;
     chunks[m_numChunks].numSequences = 0;
 
-    m_chunkTable = make_unique<ChunkTable>(m_numChunks, chunks);
+    m_chunkTable = make_unique<ChunkTable>(m_numChunks, chunks, std::move(codecs));
 }
 
 BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helper) :
@@ -60,6 +72,7 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) :
     m_file(FileWrapper::OpenOrDie(filename, L"rb")),
     m_headerOffset(0),
     m_chunkTableOffset(0),
+    m_version(0),
     m_traceLevel(0)
 {
 }
@@ -71,11 +84,11 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // First, verify the magic number.
     CBFUtils::FindMagicOrDie(m_file);
     
-    // Second, read the version number of the data file, and (for now) make sure the reader version is the same.
-    uint32_t versionNumber = CBFUtils::GetVersionNumber(m_file);
-    if (versionNumber != s_currentVersion)
+    // Second, read the version number of the data file, and make sure the reader supports it.
+    m_version = CBFUtils::GetVersionNumber(m_file);
+    if (m_version == 0 || m_version > s_currentVersion)
         LogicError("The reader version is %" PRIu32 ", but the data file was created for version %" PRIu32 ".",
-            s_currentVersion, versionNumber);
+            s_currentVersion, m_version);
 
     // Now, find where the header is.
     m_headerOffset = CBFUtils::GetHeaderOffset(m_file);
@@ -99,9 +112,9 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
         MatrixEncodingType type;
         m_file.ReadOrDie(type);
         if (type == MatrixEncodingType::dense)
-            m_deserializers[i] = make_shared<DenseBinaryDataDeserializer>(m_file, precision);
+            m_deserializers[i] = make_shared<DenseBinaryDataDeserializer>(m_file, precision, m_version);
         else if (type == MatrixEncodingType::sparse_csc)
-            m_deserializers[i] = make_shared<SparseBinaryDataDeserializer>(m_file, precision);
+            m_deserializers[i] = make_shared<SparseBinaryDataDeserializer>(m_file, precision, m_version);
         else
             RuntimeError("Unknown encoding type %u requested.", (unsigned int)type);
 
@@ -190,10 +203,12 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    // Read the chunk into memory
+    // Read the chunk into memory, it gets decompressed and decoded once its sequences are requested
+    // (on the reader threads, rather than here where the chunks are read one at a time).
     unique_ptr<byte[]> buffer = ReadChunk(chunkId);
 
-    return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), std::move(buffer), m_deserializers);
+    return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), std::move(buffer), m_deserializers,
+        m_chunkTable->GetCodec(chunkId), m_chunkTable->GetChunkSize(chunkId), m_chunkTable->GetDecodedSize(chunkId));
 }
 
 void BinaryChunkDeserializer::SetTraceLevel(unsigned int traceLevel)
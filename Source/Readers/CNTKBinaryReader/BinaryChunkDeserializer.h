@@ -9,6 +9,7 @@
 #include "BinaryConfigHelper.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "CBFUtils.h"
 
 namespace CNTK {
 
@@ -20,14 +21,28 @@ struct BinaryChunkInfo
     uint32_t numSamples;
 };
 
+// Chunk table entry of version 2 files, which also records how the data portion of the chunk
+// (everything after the sequence lengths) is stored: the codec and its size once decompressed.
+struct BinaryChunkInfoV2
+{
+    int64_t offset;
+    uint32_t numSequences;
+    uint32_t numSamples;
+    uint64_t decodedSize;
+    ChunkCodecType codec;
+    uint32_t reserved;
+};
+
 // Chunk table used to find the chunks in the binary file. Added some helper methods around the core data.
 class ChunkTable {
 public:
 
-    ChunkTable(uint32_t numChunks, BinaryChunkInfo * offsetsTable) :
+    // The codecs are only present in version 2 files, otherwise all chunks are uncompressed.
+    ChunkTable(uint32_t numChunks, BinaryChunkInfo * offsetsTable, vector<pair<ChunkCodecType, uint64_t>> codecs = {}) :
         m_numChunks(numChunks),
         m_diskOffsetsTable(offsetsTable),
-        m_startIndex(numChunks)
+        m_startIndex(numChunks),
+        m_codecs(std::move(codecs))
     {
         uint64_t numSequences = 0;
         for (decltype(m_numChunks) i = 0; i < m_numChunks; i++)
@@ -70,10 +85,22 @@ public:
         return dataEndOffset - dataStartOffset;
     }
 
+    ChunkCodecType GetCodec(uint32_t index)
+    {
+        return m_codecs.empty() ? ChunkCodecType::none : m_codecs[index].first;
+    }
+
+    // Size of the data portion of the chunk once decompressed.
+    uint64_t GetDecodedSize(uint32_t index)
+    {
+        return m_codecs.empty() ? GetChunkSize(index) : m_codecs[index].second;
+    }
+
 private:
     uint32_t m_numChunks;
     unique_ptr<BinaryChunkInfo[]> m_diskOffsetsTable;
     vector<uint64_t> m_startIndex;
+    vector<pair<ChunkCodecType, uint64_t>> m_codecs;
 };
 
 typedef unique_ptr<ChunkTable> ChunkTablePtr;
@@ -127,10 +154,11 @@ private:
     
     uint32_t m_numChunks;
     uint32_t m_numInputs;
+    uint32_t m_version;
     
     unsigned int m_traceLevel;
 
-    static const uint32_t s_currentVersion = 1;
+    static const uint32_t s_currentVersion = CBFUtils::CURRENT_VERSION;
 
     friend class CNTKBinaryReaderTestRunner;
 
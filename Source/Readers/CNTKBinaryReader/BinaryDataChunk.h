@@ -9,6 +9,8 @@
 #include "BinaryConfigHelper.h"
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataDeserializer.h"
+#include "CBFCompression.h"
+#include <mutex>
 
 namespace CNTK {
 
@@ -18,11 +20,17 @@ public:
     explicit BinaryDataChunk(ChunkIdType chunkId,
         size_t numSequences, 
         unique_ptr<byte[]> buffer, 
-        std::vector<BinaryDataDeserializerPtr> deserializer)
+        std::vector<BinaryDataDeserializerPtr> deserializer,
+        ChunkCodecType codec = ChunkCodecType::none,
+        size_t bufferSize = 0,
+        size_t decodedSize = 0)
         : m_chunkId(chunkId),
         m_numSequences(numSequences), 
         m_buffer(std::move(buffer)), 
-        m_deserializers(deserializer)
+        m_deserializers(deserializer),
+        m_codec(codec),
+        m_bufferSize(bufferSize),
+        m_decodedSize(decodedSize)
     { }
 
     virtual ~BinaryDataChunk()
@@ -36,10 +44,12 @@ public:
             {
                 if (!s.unique())
                 {
-                    // create holding chunk if not already have one
+                    // create holding chunk if not already have one, it owns the chunk data along with the decoded values
                     if (!holdingBuffer)
                     {
-                        holdingBuffer.reset((uint8_t*)m_buffer.release());
+                        auto buffers = std::make_shared<std::vector<unique_ptr<byte[]>>>(std::move(m_decodedValues));
+                        buffers->push_back(std::move(m_buffer));
+                        holdingBuffer = std::shared_ptr<uint8_t>(buffers, (uint8_t*)buffers->back().get());
                     }
                     s->m_holdingBuffer = holdingBuffer;
                 }
@@ -51,8 +61,9 @@ public:
     void GetSequence(size_t sequenceIdx, std::vector<SequenceDataPtr>& result) override
     {
         // Check if we've already parsed the chunk. If not, parse it.
-        if (m_data.size() == 0)
-            ParseChunk();
+        // Sequences are retrieved concurrently by the randomizers, so the chunk is decompressed and decoded
+        // by the first reader thread that needs it, while different chunks are parsed in parallel.
+        std::call_once(m_parsed, [this]() { ParseChunk(); });
 
         assert(m_data.size() != 0);
 
@@ -74,13 +85,23 @@ public:
 protected:
     void ParseChunk()
     {
+        if (m_codec == ChunkCodecType::lz4)
+        {
+            unique_ptr<byte[]> decompressed(new byte[m_decodedSize]);
+            CBFCompression::Decompress((const char*)m_buffer.get(), m_bufferSize, (char*)decompressed.get(), m_decodedSize);
+            m_buffer = std::move(decompressed);
+        }
+        else if (m_codec != ChunkCodecType::none)
+            RuntimeError("Chunk %u is compressed with an unsupported codec %u.", (unsigned int)m_chunkId, (unsigned int)m_codec);
+
         m_data.resize(m_deserializers.size());
+        m_decodedValues.resize(m_deserializers.size());
 
         // the number of bytes of buffer that have been processed by the deserializer so far
         size_t bytesProcessed = 0;
         // Now call all of the deserializers on the chunk, in order
         for (size_t i = 0; i < m_deserializers.size(); i++)
-            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_buffer.get() + bytesProcessed, m_data[i]);
+            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_buffer.get() + bytesProcessed, m_data[i], m_decodedValues[i]);
     }
 
     // chunk id (copied from the descriptor)
@@ -95,6 +116,16 @@ protected:
 
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
+
+    // Codec the buffer is compressed with, the size of the buffer and of the data once decompressed.
+    ChunkCodecType m_codec;
+    size_t m_bufferSize;
+    size_t m_decodedSize;
+
+    // Values decoded from the encoding of the stream (one buffer per deserializer, empty if not needed).
+    std::vector<unique_ptr<byte[]>> m_decodedValues;
+
+    std::once_flag m_parsed;
     
     // The parsed data. We will parse each chunk once, and store the data here. 
     // If we want to delay parsing, we will add that later as/if needed.
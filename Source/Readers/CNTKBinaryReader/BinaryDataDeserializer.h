@@ -9,6 +9,7 @@
 #include "BinaryConfigHelper.h"
 #include "BinaryDataChunk.h"
 #include "FileWrapper.h"
+#include "CBFUtils.h"
 #include "Reader.h"
 
 namespace CNTK {
@@ -18,11 +19,14 @@ class BinaryDataDeserializer
 {
 public:
 
-    BinaryDataDeserializer(FileWrapper& file, DataType precision = DataType::Float)
+    BinaryDataDeserializer(FileWrapper& file, DataType precision = DataType::Float, uint32_t version = 1)
+        : m_valueEncoding(ValueEncodingType::none)
     {
         ReadName(file);
         ReadDataType(file);
         ReadSampleSize(file);
+        if (version >= 2)
+            ReadValueEncoding(file);
 
         if (precision != DataType::Float && precision != DataType::Double)
             LogicError("Unsupported precision type %u.", (unsigned int)precision);
@@ -35,7 +39,11 @@ public:
         m_precision = precision;
     }
 
-    virtual size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result) = 0;
+    // Creates the sequences of this stream from the chunk data and returns the number of bytes the stream takes.
+    // Values that are not stored as ElemType are decoded into the 'decodedValues' buffer, which has to stay alive
+    // as long as the sequences do.
+    virtual size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result,
+                                           unique_ptr<byte[]>& decodedValues) = 0;
 
     virtual StorageFormat GetStorageFormat() = 0;
 
@@ -64,6 +72,22 @@ public:
         LogicError("Unsupported input data type %u.", (unsigned int)m_dataType);
     }
 
+    // Number of bytes taken by 'count' values of a sequence in the chunk data.
+    size_t SizeOfEncodedValues(size_t count)
+    {
+        switch (m_valueEncoding)
+        {
+        case ValueEncodingType::none:
+            return SizeOfDataType() * count;
+        case ValueEncodingType::float16:
+            return sizeof(uint16_t) * count;
+        case ValueEncodingType::scaled_uint8:
+            return 2 * sizeof(float) + count;
+        default:
+            LogicError("Unsupported value encoding %u.", (unsigned int)m_valueEncoding);
+        }
+    }
+
 protected:
 
     enum class ReaderDataType : unsigned char
@@ -99,6 +123,61 @@ protected:
         file.ReadOrDie(m_sampleDimension);
     }
 
+    void ReadValueEncoding(FileWrapper& file)
+    {
+        file.ReadOrDie(m_valueEncoding);
+        if (m_valueEncoding > ValueEncodingType::scaled_uint8)
+            RuntimeError("Unsupported value encoding %u.", (unsigned int)m_valueEncoding);
+    }
+
+    // Allocates the buffer for 'count' decoded values, returns nullptr if the values are used as they are stored.
+    byte* AllocateDecodedValues(size_t count, unique_ptr<byte[]>& decodedValues)
+    {
+        if (m_valueEncoding == ValueEncodingType::none)
+            return nullptr;
+
+        decodedValues.reset(new byte[SizeOfDataType() * count]);
+        return decodedValues.get();
+    }
+
+    // Decodes 'count' values of a sequence (stored with the value encoding of the stream) into ElemType values.
+    // Returns the pointer past the last decoded value.
+    byte* DecodeValues(const char* encoded, size_t count, byte* decoded)
+    {
+        if (m_precision == DataType::Float)
+            DecodeValues(encoded, count, reinterpret_cast<float*>(decoded));
+        else
+            DecodeValues(encoded, count, reinterpret_cast<double*>(decoded));
+        return decoded + SizeOfDataType() * count;
+    }
+
+    template <class ElemType>
+    void DecodeValues(const char* encoded, size_t count, ElemType* decoded)
+    {
+        if (m_valueEncoding == ValueEncodingType::float16)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                unsigned short value;
+                memcpy(&value, encoded + i * sizeof(value), sizeof(value));
+                float result;
+                float16ToFloat(&value, &result);
+                decoded[i] = result;
+            }
+        }
+        else if (m_valueEncoding == ValueEncodingType::scaled_uint8)
+        {
+            float minimum, step;
+            memcpy(&minimum, encoded, sizeof(float));
+            memcpy(&step, encoded + sizeof(float), sizeof(float));
+            auto values = reinterpret_cast<const uint8_t*>(encoded + 2 * sizeof(float));
+            for (size_t i = 0; i < count; ++i)
+                decoded[i] = minimum + step * values[i];
+        }
+        else
+            LogicError("Unsupported value encoding %u.", (unsigned int)m_valueEncoding);
+    }
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         const void* GetDataBuffer() override
@@ -139,6 +218,7 @@ protected:
 
     DataType m_precision;
     ReaderDataType m_dataType;
+    ValueEncodingType m_valueEncoding;
     uint32_t m_sampleDimension;
     wstring m_name;
 };
@@ -152,21 +232,43 @@ public:
 
     virtual  StorageFormat GetStorageFormat() override { return StorageFormat::Dense; }
 
-    size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result)
+    size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result,
+                                   unique_ptr<byte[]>& decodedValues) override
     {
-        size_t valueSize = SizeOfDataType();
         result.resize(numSequences);
+
+        // Only needed for the encoded values: count the values to allocate all of them at once.
+        byte* decoded = nullptr;
+        if (m_valueEncoding != ValueEncodingType::none)
+        {
+            size_t numValues = 0;
+            for (size_t i = 0, offset = 0; i < numSequences; i++)
+            {
+                size_t count = m_sampleDimension * *(uint32_t*)((char*)data + offset);
+                numValues += count;
+                offset += sizeof(uint32_t) + SizeOfEncodedValues(count);
+            }
+            decoded = AllocateDecodedValues(numValues, decodedValues);
+        }
+
         size_t offset = 0;
         for (size_t i = 0; i < numSequences; i++)
         {
             shared_ptr<DenseInputStreamBuffer> sequenceDataPtr = make_shared<DenseInputStreamBuffer>();
             sequenceDataPtr->m_numberOfSamples = *(uint32_t*)((char*)data + offset);
             offset += sizeof(uint32_t);
-            sequenceDataPtr->m_data = (char*)data + offset;
+            size_t count = m_sampleDimension * sequenceDataPtr->m_numberOfSamples;
+            if (decoded)
+            {
+                sequenceDataPtr->m_data = decoded;
+                decoded = DecodeValues((char*)data + offset, count, decoded);
+            }
+            else
+                sequenceDataPtr->m_data = (char*)data + offset;
             sequenceDataPtr->m_sampleShape = GetSampleShape();
             sequenceDataPtr->m_elementType = m_precision;
             result[i]  = sequenceDataPtr;
-            offset += m_sampleDimension * valueSize * sequenceDataPtr->m_numberOfSamples;
+            offset += SizeOfEncodedValues(count);
         }
 
         return offset;
@@ -176,8 +278,8 @@ public:
 class SparseBinaryDataDeserializer : public BinaryDataDeserializer
 {
 public:
-    SparseBinaryDataDeserializer(FileWrapper& file, DataType precision = DataType::Float)
-        :BinaryDataDeserializer(file, precision)
+    SparseBinaryDataDeserializer(FileWrapper& file, DataType precision = DataType::Float, uint32_t version = 1)
+        :BinaryDataDeserializer(file, precision, version)
     {
         if (IndexType(m_sampleDimension) < 0)
         {
@@ -191,17 +293,35 @@ public:
     // sequence[numSequences], where each sequence consists of:
     //   uint32_t: numSamples
     //   uint32_t: nnz for the sequence
-    //   ElemType[nnz]: the values for the sparse sequences
+    //   ElemType[nnz]: the values for the sparse sequences (or their encoding, see ValueEncodingType)
     //   int32_t[nnz]: the row offsets for the sparse sequences
     //   int32_t[numSamples]: sizes (nnz counts) for each sample in the sequence
-    size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result)
+    size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result,
+                                   unique_ptr<byte[]>& decodedValues) override
     {
         size_t offset = 0;
         result.resize(numSequences);
+
+        // Only needed for the encoded values: count the values to allocate all of them at once.
+        byte* decoded = nullptr;
+        if (m_valueEncoding != ValueEncodingType::none)
+        {
+            size_t numValues = 0;
+            for (size_t i = 0; i < numSequences; i++)
+            {
+                uint32_t numSamples = *(uint32_t*)((char*)data + offset);
+                uint32_t nnz = *(uint32_t*)((char*)data + offset + sizeof(uint32_t));
+                numValues += nnz;
+                offset += 2 * sizeof(uint32_t) + SizeOfEncodedValues(nnz) + sizeof(int32_t) * (nnz + numSamples);
+            }
+            decoded = AllocateDecodedValues(numValues, decodedValues);
+            offset = 0;
+        }
+
         for (size_t i = 0; i < numSequences; i++)
         {
             shared_ptr<SparseInputStreamBuffer> sequenceDataPtr = make_shared<SparseInputStreamBuffer>();
-            offset += GetSequenceData((char*)data + offset, sequenceDataPtr);
+            offset += GetSequenceData((char*)data + offset, sequenceDataPtr, decoded);
             sequenceDataPtr->m_sampleShape = GetSampleShape();
             sequenceDataPtr->m_elementType = m_precision;
             result[i] = sequenceDataPtr;
@@ -210,9 +330,9 @@ public:
         return offset;
     }
 
-    size_t GetSequenceData(void* data, shared_ptr<SparseInputStreamBuffer>& sequence)
+    // If 'decoded' is not null, the values are decoded there and the pointer is moved past them.
+    size_t GetSequenceData(void* data, shared_ptr<SparseInputStreamBuffer>& sequence, byte*& decoded)
     {
-        size_t valueSize = SizeOfDataType();
         size_t offset = 0;
 
         // The very first value in the buffer is the number of samples in this sequence.
@@ -231,9 +351,15 @@ public:
         // the rest of this sequence
         // Since we're not templating on ElemType, we use void for the values. Note that this is the only place
         // this deserializer uses ElemType, the rest are int32_t for this deserializer.
-        // The data is already properly packed, so just use it.
-        sequence->m_data = (char*)data + offset;
-        offset += valueSize * sequence->m_totalNnzCount;
+        // The data is already properly packed, so just use it (unless the values have to be decoded first).
+        if (decoded)
+        {
+            sequence->m_data = decoded;
+            decoded = DecodeValues((char*)data + offset, sequence->m_totalNnzCount, decoded);
+        }
+        else
+            sequence->m_data = (char*)data + offset;
+        offset += SizeOfEncodedValues(sequence->m_totalNnzCount);
 
         // The indices are supposed to be correctly packed (i.e., in increasing order)
         sequence->m_indices = (int32_t*)((char*)data + offset);
@@ -0,0 +1,193 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "Basics.h"
+
+namespace CNTK {
+
+// A self-contained implementation of the LZ4 block format, used to compress the data portion
+// of the chunks in CBF files (ChunkCodecType::lz4).
+//
+// The compressor is a greedy single-probe hash matcher, which favors speed over the compression ratio.
+// The decompressor validates all lengths and offsets against the buffer bounds, so a corrupted chunk
+// results in an exception rather than an out of bounds access.
+class CBFCompression
+{
+public:
+    // Compresses the input, appending the compressed block to the output.
+    static void Compress(const char* input, size_t inputSize, std::vector<char>& output)
+    {
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(input);
+        output.reserve(output.size() + inputSize + inputSize / 255 + 16);
+
+        size_t anchor = 0;
+        if (inputSize > s_minInputSize)
+        {
+            std::vector<uint32_t> table(size_t(1) << s_hashBits, 0);
+
+            // The last match has to start at least 12 bytes and end at least 5 bytes before the end of the block.
+            const size_t matchStartLimit = inputSize - s_matchStartMargin;
+            const size_t matchEndLimit = inputSize - s_lastLiterals;
+
+            size_t position = 0;
+            while (position < matchStartLimit)
+            {
+                uint32_t sequence = Read32(src + position);
+                uint32_t& entry = table[Hash(sequence)];
+                size_t candidate = entry;
+                entry = static_cast<uint32_t>(position);
+
+                if (candidate >= position || position - candidate > s_maxOffset || Read32(src + candidate) != sequence)
+                {
+                    // Skip faster through data that does not compress.
+                    position += 1 + ((position - anchor) >> s_skipTrigger);
+                    continue;
+                }
+
+                size_t length = s_minMatch;
+                while (position + length < matchEndLimit && src[candidate + length] == src[position + length])
+                    length++;
+
+                WriteSequence(src + anchor, position - anchor, position - candidate, length, output);
+                position += length;
+                anchor = position;
+            }
+        }
+
+        // The block always ends with literals.
+        WriteLiterals(src + anchor, inputSize - anchor, 0, output);
+    }
+
+    // Decompresses the block into the output buffer, which is expected to be filled up completely.
+    static void Decompress(const char* input, size_t inputSize, char* output, size_t outputSize)
+    {
+        if (inputSize == 0)
+            RuntimeError("Corrupted compressed chunk: unexpected end of the block.");
+
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(input);
+        uint8_t* dst = reinterpret_cast<uint8_t*>(output);
+
+        size_t in = 0, out = 0;
+        for (;;)
+        {
+            if (in >= inputSize)
+                RuntimeError("Corrupted compressed chunk: unexpected end of the block.");
+
+            uint8_t token = src[in++];
+
+            size_t literals = ReadLength(token >> 4, src, inputSize, in);
+            if (literals > inputSize - in || literals > outputSize - out)
+                RuntimeError("Corrupted compressed chunk: literals exceed the block boundaries.");
+
+            if (literals > 0) // (the output of an empty block may be null)
+            {
+                memcpy(dst + out, src + in, literals);
+                in += literals;
+                out += literals;
+            }
+
+            if (in == inputSize)
+                break; // The last sequence consists of literals only.
+
+            if (inputSize - in < 2)
+                RuntimeError("Corrupted compressed chunk: unexpected end of the block.");
+
+            size_t offset = src[in] | (src[in + 1] << 8);
+            in += 2;
+            if (offset == 0 || offset > out)
+                RuntimeError("Corrupted compressed chunk: invalid match offset %d.", (int)offset);
+
+            size_t length = ReadLength(token & 0xf, src, inputSize, in) + s_minMatch;
+            if (length > outputSize - out)
+                RuntimeError("Corrupted compressed chunk: a match exceeds the size of the decompressed data.");
+
+            const uint8_t* match = dst + out - offset;
+            if (offset >= length)
+                memcpy(dst + out, match, length);
+            else
+            {
+                // Overlapping match, repeats the last 'offset' bytes.
+                for (size_t i = 0; i < length; ++i)
+                    dst[out + i] = match[i];
+            }
+            out += length;
+        }
+
+        if (out != outputSize)
+            RuntimeError("Corrupted compressed chunk: decompressed %d bytes, expected %d.", (int)out, (int)outputSize);
+    }
+
+private:
+    static const size_t s_minMatch = 4;
+    static const size_t s_lastLiterals = 5;
+    static const size_t s_matchStartMargin = 12;
+    static const size_t s_minInputSize = s_matchStartMargin;
+    static const size_t s_maxOffset = 65535;
+    static const int s_hashBits = 16;
+    static const int s_skipTrigger = 6;
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t Hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761U) >> (32 - s_hashBits);
+    }
+
+    static void WriteLength(size_t length, std::vector<char>& output)
+    {
+        for (; length >= 255; length -= 255)
+            output.push_back(static_cast<char>(255));
+        output.push_back(static_cast<char>(length));
+    }
+
+    static size_t ReadLength(size_t length, const uint8_t* src, size_t size, size_t& in)
+    {
+        if (length != 15)
+            return length;
+
+        uint8_t next;
+        do
+        {
+            if (in >= size)
+                RuntimeError("Corrupted compressed chunk: unexpected end of the block.");
+            next = src[in++];
+            length += next;
+        } while (next == 255);
+        return length;
+    }
+
+    // Writes the token and the literals, the lower half of the token is left for the match length.
+    static void WriteLiterals(const uint8_t* literals, size_t count, uint8_t matchToken, std::vector<char>& output)
+    {
+        output.push_back(static_cast<char>(((count < 15 ? count : 15) << 4) | matchToken));
+        if (count >= 15)
+            WriteLength(count - 15, output);
+        output.insert(output.end(), literals, literals + count);
+    }
+
+    static void WriteSequence(const uint8_t* literals, size_t count, size_t offset, size_t length, std::vector<char>& output)
+    {
+        length -= s_minMatch;
+        WriteLiterals(literals, count, static_cast<uint8_t>(length < 15 ? length : 15), output);
+        output.push_back(static_cast<char>(offset & 0xff));
+        output.push_back(static_cast<char>(offset >> 8));
+        if (length >= 15)
+            WriteLength(length - 15, output);
+    }
+
+    CBFCompression();
+};
+
+}
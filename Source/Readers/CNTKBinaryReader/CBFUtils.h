@@ -13,12 +13,39 @@ class FileWrapper;
 
 namespace CNTK {
 
+enum class MatrixEncodingType : unsigned char
+{
+    dense = 0,
+    sparse_csc = 1,
+    // TODO: compressed_sparse_csc = 2, // indices are encoded as var-ints
+};
+
+// How the values of a stream are stored (version 2 and above).
+enum class ValueEncodingType : unsigned char
+{
+    none = 0,         // as the element type declared in the header (float or double)
+    float16 = 1,      // IEEE 754 half precision
+    scaled_uint8 = 2, // one byte per value, affine-mapped onto the [min, max] range of each sequence:
+                      // every sequence starts with a float minimum and a float step, value = minimum + step * byte
+};
+
+// Codec the data portion of a chunk is compressed with (version 2 and above).
+enum class ChunkCodecType : uint32_t
+{
+    none = 0,
+    lz4 = 1, // LZ4 block format
+};
+
 // Implementation of a helper class for reading binary files with FileWrapper class
 class CBFUtils
 {
 public:
     static const uint64_t MAGIC_NUMBER = 0x636e746b5f62696eU;
 
+    // Version 2 adds per-stream value encodings and per-chunk compression,
+    // files of the older versions can still be read.
+    static const uint32_t CURRENT_VERSION = 2;
+
     static void FindMagicOrDie(FileWrapper& f)
     {
         // Read the magic number and make sure we're given a proper CBF file.
@@ -168,17 +168,7 @@ void TextParser<ElemType>::Initialize()
 
     attempt(m_numRetries, [this]()
     {
-        m_file = std::make_shared<FileWrapper>(m_filename, L"rbS");
-
-        m_file->CheckIsOpenOrDie();
-
-        if (m_file->CheckUnicode())
-        {
-            // Retrying won't help here, the file is UTF-16 encoded.
-            m_numRetries = 0;
-            RuntimeError("Found a UTF-16 BOM at the beginning of the input file (%ls). "
-                "UTF-16 encoding is currently not supported.", m_filename.c_str());
-        }
+        OpenFile();
 
         TextInputIndexBuilder builder(*m_file);
 
@@ -204,6 +194,48 @@ void TextParser<ElemType>::Initialize()
     assert(m_index != nullptr);
 }
 
+template <class ElemType>
+void TextParser<ElemType>::OpenFile()
+{
+    m_file = std::make_shared<FileWrapper>(m_filename, L"rbS");
+
+    m_file->CheckIsOpenOrDie();
+
+    if (m_file->CheckUnicode())
+    {
+        // Retrying won't help here, the file is UTF-16 encoded.
+        m_numRetries = 0;
+        RuntimeError("Found a UTF-16 BOM at the beginning of the input file (%ls). "
+            "UTF-16 encoding is currently not supported.", m_filename.c_str());
+    }
+}
+
+template <class ElemType>
+std::shared_ptr<TextParser<ElemType>> TextParser<ElemType>::CreateConcurrentParser() const
+{
+    if (m_index == nullptr)
+        LogicError("A concurrent parser can only be created after the input file (%ls) has been indexed.", m_filename.c_str());
+
+    std::shared_ptr<TextParser<ElemType>> parser(new TextParser<ElemType>(m_corpus, m_filename, m_streamDescriptors, m_primary));
+    parser->SetTraceLevel(m_traceLevel);
+    parser->SetMaxAllowedErrors(m_numAllowedErrors);
+    parser->SetSkipSequenceIds(m_skipSequenceIds);
+    parser->SetChunkSize(m_chunkSizeBytes);
+    parser->SetNumRetries(m_numRetries);
+    parser->SetCacheIndex(m_cacheIndex);
+
+    // The index is never modified once built, so it can be shared across parsers.
+    parser->m_index = m_index;
+
+    attempt(parser->m_numRetries, [&parser]()
+    {
+        parser->OpenFile();
+        parser->m_fileReader = std::make_shared<BufferedFileReader>(BUFFER_SIZE, *parser->m_file);
+    });
+
+    return parser;
+}
+
 template <class ElemType>
 std::vector<ChunkInfo> TextParser<ElemType>::ChunkInfos()
 {
@@ -16,6 +16,9 @@ namespace CNTK {
 template <class ElemType>
 class CNTKTextFormatReaderTestRunner;
 
+template <class ElemType>
+class TextToBinaryConverter;
+
 class FileWrapper;
 class BufferedFileReader;
 
@@ -38,12 +41,20 @@ public:
 
     bool GetSequenceInfoByKey(const SequenceKey&, SequenceInfo&) override;
 
+    // Creates a parser that shares the index (and all settings) of this one, but reads
+    // the input through its own file handle. Parsers are not thread-safe, but each parser
+    // of such a set can load chunks on its own thread.
+    std::shared_ptr<TextParser<ElemType>> CreateConcurrentParser() const;
+
 private:
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams, bool primary = true);
 
     // Builds an index of the input data.
     void Initialize();
 
+    // Opens the input file and checks that it can be parsed.
+    void OpenFile();
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         // capacity = expected number of samples * sample size
@@ -204,6 +215,7 @@ private:
     void SetCacheIndex(bool value);
 
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
+    friend class TextToBinaryConverter<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
 };
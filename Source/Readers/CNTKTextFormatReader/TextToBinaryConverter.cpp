@@ -0,0 +1,416 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <numeric>
+#include <thread>
+#include "TextToBinaryConverter.h"
+#include "FileWrapper.h"
+#include "ReaderConstants.h"
+#include "CBFUtils.h"
+#include "CBFCompression.h"
+
+namespace CNTK {
+
+using namespace Microsoft::MSR::CNTK;
+
+// Appends the binary representation of the values to the buffer.
+template <class T>
+static inline void Append(std::vector<char>& buffer, const T* values, size_t count)
+{
+    const char* begin = reinterpret_cast<const char*>(values);
+    buffer.insert(buffer.end(), begin, begin + sizeof(T) * count);
+}
+
+template <class T>
+static inline void Append(std::vector<char>& buffer, T value)
+{
+    Append(buffer, &value, 1);
+}
+
+// Appends the values to the buffer, stored with the given encoding.
+template <class ElemType>
+static void AppendValues(std::vector<char>& buffer, const ElemType* values, size_t count, ValueEncodingType encoding)
+{
+    if (encoding == ValueEncodingType::none)
+    {
+        Append(buffer, values, count);
+        return;
+    }
+
+    if (encoding == ValueEncodingType::float16)
+    {
+        size_t start = buffer.size();
+        buffer.resize(start + sizeof(unsigned short) * count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float value = static_cast<float>(values[i]);
+            unsigned short result;
+            floatToFloat16(&value, &result);
+            memcpy(&buffer[start + sizeof(unsigned short) * i], &result, sizeof(result));
+        }
+        return;
+    }
+
+    if (encoding != ValueEncodingType::scaled_uint8)
+        LogicError("Unsupported value encoding %u.", (unsigned int)encoding);
+
+    // The values of the sequence are mapped onto 256 equidistant points between their minimum and maximum.
+    float minimum = 0, step = 0;
+    if (count > 0)
+    {
+        auto range = std::minmax_element(values, values + count);
+        minimum = static_cast<float>(*range.first);
+        step = (static_cast<float>(*range.second) - minimum) / 255;
+    }
+
+    Append(buffer, minimum);
+    Append(buffer, step);
+
+    size_t start = buffer.size();
+    buffer.resize(start + count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        float level = step > 0 ? std::round((static_cast<float>(values[i]) - minimum) / step) : 0;
+        buffer[start + i] = static_cast<char>(static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, level))));
+    }
+}
+
+template <class ElemType>
+TextToBinaryConverter<ElemType>::TextToBinaryConverter(const std::wstring& inputFile, const std::vector<StreamDescriptor>& streams) :
+    m_inputFile(inputFile),
+    m_streams(streams),
+    m_chunkSizeBytes(g_32MB),
+    m_numThreads(0),
+    m_maxAllowedErrors(0),
+    m_traceLevel(0),
+    m_codec(ChunkCodecType::none),
+    m_valueEncodings(streams.size(), ValueEncodingType::none)
+{
+    if (m_streams.empty())
+        InvalidArgument("At least one input stream has to be specified to convert '%ls'.", m_inputFile.c_str());
+
+    for (const auto& stream : m_streams)
+    {
+        if (stream.m_alias.empty())
+            InvalidArgument("Input stream '%ls' does not have an alias.", stream.m_name.c_str());
+
+        if (stream.m_storageFormat != StorageFormat::Dense && stream.m_storageFormat != StorageFormat::SparseCSC)
+            InvalidArgument("Input stream '%ls' has an unsupported storage format.", stream.m_name.c_str());
+
+        if (stream.m_sampleDimension == 0 || stream.m_sampleDimension > std::numeric_limits<uint32_t>::max())
+            InvalidArgument("Input stream '%ls' has an invalid sample dimension (%" PRIu64 ").",
+                stream.m_name.c_str(), stream.m_sampleDimension);
+    }
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetChunkSize(size_t chunkSizeInBytes)
+{
+    m_chunkSizeBytes = chunkSizeInBytes;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetNumThreads(size_t numThreads)
+{
+    m_numThreads = numThreads;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetMaxAllowedErrors(unsigned int maxErrors)
+{
+    m_maxAllowedErrors = maxErrors;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetTraceLevel(unsigned int traceLevel)
+{
+    m_traceLevel = traceLevel;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetCompression(ChunkCodecType codec)
+{
+    if (codec != ChunkCodecType::none && codec != ChunkCodecType::lz4)
+        InvalidArgument("Unsupported chunk codec %u.", (unsigned int)codec);
+
+    m_codec = codec;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::SetValueEncoding(size_t streamIndex, ValueEncodingType encoding)
+{
+    if (streamIndex >= m_streams.size())
+        InvalidArgument("Invalid stream index %" PRIu64 ", the number of streams is %" PRIu64 ".", streamIndex, m_streams.size());
+
+    if (encoding > ValueEncodingType::scaled_uint8)
+        InvalidArgument("Unsupported value encoding %u for the input stream '%ls'.", (unsigned int)encoding, m_streams[streamIndex].m_name.c_str());
+
+    m_valueEncodings[streamIndex] = encoding;
+}
+
+template <class ElemType>
+uint32_t TextToBinaryConverter<ElemType>::GetVersion() const
+{
+    // Files that do not need any of the version 2 features stay readable by the older readers.
+    bool isEncoded = std::any_of(m_valueEncodings.begin(), m_valueEncodings.end(),
+                                 [](ValueEncodingType encoding) { return encoding != ValueEncodingType::none; });
+    return (isEncoded || m_codec != ChunkCodecType::none) ? CBFUtils::CURRENT_VERSION : 1;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::Convert(const std::wstring& outputFile)
+{
+    // Index the input only once, all other parsers share the index with this one.
+    TextParserPtr parser(new TextParser<ElemType>(std::make_shared<CorpusDescriptor>(true), m_inputFile, m_streams, true));
+    parser->SetTraceLevel(m_traceLevel);
+    parser->SetMaxAllowedErrors(m_maxAllowedErrors);
+    parser->SetChunkSize(m_chunkSizeBytes);
+    parser->Initialize();
+
+    const size_t numChunks = parser->m_index->Chunks().size();
+
+    size_t numThreads = m_numThreads ? m_numThreads : std::thread::hardware_concurrency();
+    numThreads = std::max<size_t>(1, std::min(numThreads, numChunks));
+
+    m_idleParsers.clear();
+    m_idleParsers.push_back(parser);
+    while (m_idleParsers.size() < numThreads)
+        m_idleParsers.push_back(parser->CreateConcurrentParser());
+
+    auto output = FileWrapper::OpenOrDie(outputFile, L"wb");
+
+    std::vector<char> preamble;
+    Append(preamble, CBFUtils::MAGIC_NUMBER);
+    Append(preamble, GetVersion());
+    output.WriteOrDie(preamble.data(), sizeof(char), preamble.size());
+
+    int64_t offset = preamble.size();
+    std::vector<ChunkTableEntry> chunkTable;
+    chunkTable.reserve(numChunks);
+
+    auto writeChunk = [&](const SerializedChunk& chunk)
+    {
+        chunkTable.push_back(ChunkTableEntry{ offset, chunk.m_numberOfSequences, chunk.m_numberOfSamples, chunk.m_codec, chunk.m_decodedSize });
+        output.WriteOrDie(chunk.m_data.data(), sizeof(char), chunk.m_data.size());
+        offset += chunk.m_data.size();
+    };
+
+    // Chunks are serialized concurrently, but written out in order. Once there are as many chunks
+    // in flight as there are parsers, wait for the oldest one to be written out before scheduling
+    // another one, this bounds both the memory footprint and the number of busy parsers.
+    std::deque<std::future<SerializedChunk>> pending;
+    for (ChunkIdType chunkId = 0; chunkId < numChunks; ++chunkId)
+    {
+        if (pending.size() == numThreads)
+        {
+            writeChunk(pending.front().get());
+            pending.pop_front();
+        }
+
+        pending.push_back(std::async(std::launch::async, [this, chunkId]() { return SerializeChunk(chunkId); }));
+    }
+
+    while (!pending.empty())
+    {
+        writeChunk(pending.front().get());
+        pending.pop_front();
+    }
+
+    m_idleParsers.clear();
+
+    auto header = SerializeHeader(chunkTable);
+    // The header offset is stored in the last 8 bytes of the file.
+    Append(header, offset);
+    output.WriteOrDie(header.data(), sizeof(char), header.size());
+    output.FlushOrDie();
+}
+
+template <class ElemType>
+typename TextToBinaryConverter<ElemType>::SerializedChunk TextToBinaryConverter<ElemType>::SerializeChunk(ChunkIdType chunkId)
+{
+    auto parser = AcquireParser();
+
+    ChunkPtr chunk;
+    size_t numberOfSequences;
+    try
+    {
+        chunk = parser->GetChunk(chunkId);
+        numberOfSequences = parser->m_index->Chunks()[chunkId].NumberOfSequences();
+    }
+    catch (...)
+    {
+        ReleaseParser(parser);
+        throw;
+    }
+    ReleaseParser(parser);
+
+    std::vector<std::vector<SequenceDataPtr>> sequences(numberOfSequences);
+    for (size_t i = 0; i < numberOfSequences; ++i)
+        chunk->GetSequence(i, sequences[i]);
+
+    SerializedChunk result;
+    result.m_numberOfSequences = static_cast<uint32_t>(numberOfSequences);
+    result.m_codec = ChunkCodecType::none;
+    auto& buffer = result.m_data;
+
+    // The chunk starts with the sequence lengths, which (as in ctf2bin.py) are computed
+    // as the maximum number of samples across all inputs.
+    size_t numberOfSamples = 0;
+    for (const auto& sequence : sequences)
+    {
+        uint32_t sequenceLength = 0;
+        for (const auto& data : sequence)
+            sequenceLength = std::max(sequenceLength, data->m_numberOfSamples);
+
+        Append(buffer, sequenceLength);
+        numberOfSamples += sequenceLength;
+    }
+
+    if (numberOfSamples > std::numeric_limits<uint32_t>::max())
+        RuntimeError("Chunk %u of '%ls' contains too many samples (%" PRIu64 "), please use a smaller chunk size.",
+            chunkId, m_inputFile.c_str(), numberOfSamples);
+
+    result.m_numberOfSamples = static_cast<uint32_t>(numberOfSamples);
+
+    // Followed by the data of each input, one sequence after another.
+    std::vector<ElemType> values;
+    std::vector<SparseIndexType> indices;
+    std::vector<size_t> order;
+    for (size_t streamIndex = 0; streamIndex < m_streams.size(); ++streamIndex)
+    {
+        const auto& stream = m_streams[streamIndex];
+        auto encoding = m_valueEncodings[streamIndex];
+        for (const auto& sequence : sequences)
+        {
+            const auto& data = sequence[streamIndex];
+            Append(buffer, data->m_numberOfSamples);
+
+            auto dataBuffer = static_cast<const ElemType*>(data->GetDataBuffer());
+            if (stream.m_storageFormat == StorageFormat::Dense)
+            {
+                AppendValues(buffer, dataBuffer, data->m_numberOfSamples * stream.m_sampleDimension, encoding);
+                continue;
+            }
+
+            // Sparse samples are stored as CSC columns, with row indices in the ascending order.
+            auto sparseData = static_cast<SparseSequenceData*>(data.get());
+            values.resize(sparseData->m_totalNnzCount);
+            indices.resize(sparseData->m_totalNnzCount);
+
+            size_t sampleOffset = 0;
+            for (auto nnzCount : sparseData->m_nnzCounts)
+            {
+                order.resize(nnzCount);
+                std::iota(order.begin(), order.end(), sampleOffset);
+                std::sort(order.begin(), order.end(), [sparseData](size_t a, size_t b)
+                {
+                    return sparseData->m_indices[a] < sparseData->m_indices[b];
+                });
+
+                for (size_t j = 0; j < order.size(); ++j)
+                {
+                    values[sampleOffset + j] = dataBuffer[order[j]];
+                    indices[sampleOffset + j] = sparseData->m_indices[order[j]];
+                }
+                sampleOffset += nnzCount;
+            }
+
+            Append(buffer, sparseData->m_totalNnzCount);
+            AppendValues(buffer, values.data(), values.size(), encoding);
+            Append(buffer, indices.data(), indices.size());
+            Append(buffer, sparseData->m_nnzCounts.data(), sparseData->m_nnzCounts.size());
+        }
+    }
+
+    // The sequence lengths are not compressed, the reader uses them to index the chunk.
+    size_t dataStart = sizeof(uint32_t) * numberOfSequences;
+    result.m_decodedSize = buffer.size() - dataStart;
+    if (m_codec == ChunkCodecType::lz4)
+    {
+        std::vector<char> compressed(buffer.begin(), buffer.begin() + dataStart);
+        CBFCompression::Compress(buffer.data() + dataStart, buffer.size() - dataStart, compressed);
+        if (compressed.size() < buffer.size())
+        {
+            buffer.swap(compressed);
+            result.m_codec = ChunkCodecType::lz4;
+        }
+    }
+
+    return result;
+}
+
+template <class ElemType>
+std::vector<char> TextToBinaryConverter<ElemType>::SerializeHeader(const std::vector<ChunkTableEntry>& chunkTable) const
+{
+    const uint32_t version = GetVersion();
+
+    std::vector<char> header;
+    Append(header, CBFUtils::MAGIC_NUMBER);
+    Append(header, static_cast<uint32_t>(chunkTable.size()));
+    Append(header, static_cast<uint32_t>(m_streams.size()));
+
+    for (size_t streamIndex = 0; streamIndex < m_streams.size(); ++streamIndex)
+    {
+        const auto& stream = m_streams[streamIndex];
+        Append(header, stream.m_storageFormat == StorageFormat::Dense ? MatrixEncodingType::dense : MatrixEncodingType::sparse_csc);
+
+        auto name = msra::strfun::utf8(stream.m_name);
+        Append(header, static_cast<uint32_t>(name.size()));
+        Append(header, name.data(), name.size());
+
+        // Element type: 0 for float, 1 for double.
+        Append(header, static_cast<unsigned char>(std::is_same<ElemType, float>::value ? 0 : 1));
+        Append(header, static_cast<uint32_t>(stream.m_sampleDimension));
+
+        if (version >= 2)
+            Append(header, m_valueEncodings[streamIndex]);
+    }
+
+    for (const auto& entry : chunkTable)
+    {
+        Append(header, entry.m_offset);
+        Append(header, entry.m_numberOfSequences);
+        Append(header, entry.m_numberOfSamples);
+
+        if (version >= 2)
+        {
+            Append(header, entry.m_decodedSize);
+            Append(header, entry.m_codec);
+            Append(header, static_cast<uint32_t>(0)); // reserved
+        }
+    }
+
+    return header;
+}
+
+template <class ElemType>
+typename TextToBinaryConverter<ElemType>::TextParserPtr TextToBinaryConverter<ElemType>::AcquireParser()
+{
+    std::lock_guard<std::mutex> lock(m_parsersLock);
+    if (m_idleParsers.empty())
+        LogicError("No idle parser available, the number of chunks in flight exceeds the number of parsers.");
+
+    auto parser = m_idleParsers.back();
+    m_idleParsers.pop_back();
+    return parser;
+}
+
+template <class ElemType>
+void TextToBinaryConverter<ElemType>::ReleaseParser(const TextParserPtr& parser)
+{
+    std::lock_guard<std::mutex> lock(m_parsersLock);
+    m_idleParsers.push_back(parser);
+}
+
+template class TextToBinaryConverter<float>;
+template class TextToBinaryConverter<double>;
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <mutex>
+#include "TextParser.h"
+#include "FileWrapper.h"
+#include "CBFUtils.h"
+
+namespace CNTK {
+
+// Converts a file in the CNTK text format (CTF) into the CNTK binary format (CBF)
+// consumed by the CNTKBinaryReader (a native counterpart of Scripts/ctf2bin.py).
+//
+// The input is indexed once (with the requested chunk size), then the chunks are
+// parsed and serialized by a number of worker threads, each using its own TextParser
+// instance that shares the index. Serialized chunks are written out strictly in the input
+// order, and at most one chunk per worker is held in memory (in addition to the one
+// being written out) at any point in time.
+//
+// By default, the output is a version 1 file. Setting a value encoding for any of the streams or
+// a chunk compression codec produces a version 2 file, the chunks of which are compressed by the workers.
+template <class ElemType>
+class TextToBinaryConverter
+{
+public:
+    // streams : input descriptions, the order of which defines the order of inputs in the output file,
+    //           the stream name is stored in the output header, the alias is used to find the input
+    //           in the text file.
+    TextToBinaryConverter(const std::wstring& inputFile, const std::vector<StreamDescriptor>& streams);
+
+    // Converts the input file and stores the result in the given output file.
+    void Convert(const std::wstring& outputFile);
+
+    // Sets the approximate size of a chunk (in bytes of the text input).
+    void SetChunkSize(size_t chunkSizeInBytes);
+
+    // Sets the number of chunks parsed concurrently (0 = one per hardware thread).
+    void SetNumThreads(size_t numThreads);
+
+    // Sets the number of parsing errors tolerated by each of the parsers.
+    void SetMaxAllowedErrors(unsigned int maxErrors);
+
+    void SetTraceLevel(unsigned int traceLevel);
+
+    // Sets the codec used to compress the chunks (chunks that do not get smaller are stored uncompressed).
+    void SetCompression(ChunkCodecType codec);
+
+    // Sets how the values of the stream with the given index are stored (float16 and scaled_uint8 are lossy).
+    void SetValueEncoding(size_t streamIndex, ValueEncodingType encoding);
+
+private:
+    typedef std::shared_ptr<TextParser<ElemType>> TextParserPtr;
+
+    // A chunk in its binary form, along with the information stored in the chunk table.
+    struct SerializedChunk
+    {
+        std::vector<char> m_data;
+        uint32_t m_numberOfSequences;
+        uint32_t m_numberOfSamples;
+        ChunkCodecType m_codec;
+        uint64_t m_decodedSize;
+    };
+
+    // An entry of the chunk table stored in the output header.
+    struct ChunkTableEntry
+    {
+        int64_t m_offset;
+        uint32_t m_numberOfSequences;
+        uint32_t m_numberOfSamples;
+        ChunkCodecType m_codec;
+        uint64_t m_decodedSize;
+    };
+
+    // Version of the output file, depends on the requested encodings.
+    uint32_t GetVersion() const;
+
+    // Loads the chunk with the given id and serializes it into the binary format.
+    SerializedChunk SerializeChunk(ChunkIdType chunkId);
+
+    // Serializes the header (stream descriptions followed by the chunk table).
+    std::vector<char> SerializeHeader(const std::vector<ChunkTableEntry>& chunkTable) const;
+
+    TextParserPtr AcquireParser();
+    void ReleaseParser(const TextParserPtr& parser);
+
+    const std::wstring m_inputFile;
+    const std::vector<StreamDescriptor> m_streams;
+
+    size_t m_chunkSizeBytes;
+    size_t m_numThreads;
+    unsigned int m_maxAllowedErrors;
+    unsigned int m_traceLevel;
+    ChunkCodecType m_codec;
+    std::vector<ValueEncodingType> m_valueEncodings;
+
+    // Parsers not currently used by any of the workers.
+    std::vector<TextParserPtr> m_idleParsers;
+    std::mutex m_parsersLock;
+
+    DISABLE_COPY_AND_MOVE(TextToBinaryConverter);
+};
+
+}
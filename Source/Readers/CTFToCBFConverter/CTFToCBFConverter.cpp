@@ -0,0 +1,184 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CTFToCBFConverter.cpp : converts files in the CNTK text format into the CNTK binary format.
+// A native replacement for Scripts/ctf2bin.py, which parses the input chunks in parallel.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms
+#include "Platform.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include "Basics.h"
+#include "TextToBinaryConverter.h"
+
+namespace CNTK {
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+        "Usage: ctf2cbf --input <file> --header <file> --output <file> [options]\n"
+        "Converts a CNTK Text Format file into the CNTK binary format.\n"
+        "\n"
+        "  --input <file>       CNTK Text Format file to convert.\n"
+        "  --header <file>      Header file describing each stream in the input, one per line:\n"
+        "                       <name> <alias> <dense|sparse> <sample dimension> [<none|float16|uint8>]\n"
+        "                       The optional last column selects a lossy storage of the values:\n"
+        "                       half precision floats or bytes scaled to the value range of each sequence.\n"
+        "  --output <file>      Name of the output file.\n"
+        "  --chunk_size <n>     Chunk size in bytes (default: 32 MB).\n"
+        "  --precision <p>      Floating point precision, 'float' (default) or 'double'.\n"
+        "  --compression <c>    Chunk compression, 'none' (default) or 'lz4'.\n"
+        "  --threads <n>        Number of chunks parsed in parallel (default: number of hardware threads).\n"
+        "  --max_errors <n>     Number of parsing errors tolerated by each of the parsing threads (default: 0).\n"
+        "  --trace_level <n>    0 = errors (default), 1 = warnings, 2 = info.\n");
+}
+
+// Reads stream descriptions in the same format as Scripts/ctf2bin.py,
+// optionally followed by the value encoding of each stream.
+static std::vector<StreamDescriptor> ReadStreamHeader(const std::string& headerFile, DataType elementType,
+                                                      std::vector<ValueEncodingType>& encodings)
+{
+    std::ifstream input(headerFile);
+    if (!input)
+        RuntimeError("Cannot open the header file '%s'.", headerFile.c_str());
+
+    std::vector<StreamDescriptor> streams;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        std::istringstream fields(line);
+        std::string name, alias, format, encoding = "none";
+        size_t dimension = 0;
+        if (!(fields >> name))
+            continue; // blank line
+
+        if (!(fields >> alias >> format >> dimension))
+            RuntimeError("Invalid stream description '%s' in the header file '%s'.", line.c_str(), headerFile.c_str());
+
+        StreamDescriptor stream;
+        stream.m_id = streams.size();
+        stream.m_name = msra::strfun::utf16(name);
+        stream.m_alias = alias;
+        stream.m_sampleDimension = dimension;
+        stream.m_elementType = elementType;
+        if (format == "dense")
+            stream.m_storageFormat = StorageFormat::Dense;
+        else if (format == "sparse")
+            stream.m_storageFormat = StorageFormat::SparseCSC;
+        else
+            RuntimeError("Invalid input format '%s' for the stream '%s'.", format.c_str(), name.c_str());
+
+        fields >> encoding;
+        if (encoding == "none")
+            encodings.push_back(ValueEncodingType::none);
+        else if (encoding == "float16")
+            encodings.push_back(ValueEncodingType::float16);
+        else if (encoding == "uint8")
+            encodings.push_back(ValueEncodingType::scaled_uint8);
+        else
+            RuntimeError("Invalid value encoding '%s' for the stream '%s'.", encoding.c_str(), name.c_str());
+
+        streams.push_back(stream);
+    }
+
+    return streams;
+}
+
+template <class ElemType>
+static void Convert(const std::string& inputFile, const std::string& outputFile, const std::vector<StreamDescriptor>& streams,
+                    const std::vector<ValueEncodingType>& encodings, ChunkCodecType codec,
+                    size_t chunkSize, size_t numThreads, unsigned int maxErrors, unsigned int traceLevel)
+{
+    TextToBinaryConverter<ElemType> converter(msra::strfun::utf16(inputFile), streams);
+    for (size_t i = 0; i < encodings.size(); ++i)
+        converter.SetValueEncoding(i, encodings[i]);
+    converter.SetCompression(codec);
+    converter.SetChunkSize(chunkSize);
+    converter.SetNumThreads(numThreads);
+    converter.SetMaxAllowedErrors(maxErrors);
+    converter.SetTraceLevel(traceLevel);
+    converter.Convert(msra::strfun::utf16(outputFile));
+}
+
+static int ConvertMain(int argc, char* argv[])
+{
+    std::string inputFile, headerFile, outputFile, precision = "float", compression = "none";
+    size_t chunkSize = 32 * 1024 * 1024, numThreads = 0;
+    unsigned int maxErrors = 0, traceLevel = 0;
+
+    try
+    {
+        for (int i = 1; i < argc; i += 2)
+        {
+            std::string option = argv[i];
+            if (option == "--help" || option == "-h")
+            {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            }
+
+            if (i + 1 >= argc)
+                InvalidArgument("Missing value for the option '%s'.", option.c_str());
+
+            std::string value = argv[i + 1];
+            if (option == "--input")
+                inputFile = value;
+            else if (option == "--header")
+                headerFile = value;
+            else if (option == "--output")
+                outputFile = value;
+            else if (option == "--precision")
+                precision = value;
+            else if (option == "--compression")
+                compression = value;
+            else if (option == "--chunk_size")
+                chunkSize = std::stoull(value);
+            else if (option == "--threads")
+                numThreads = std::stoull(value);
+            else if (option == "--max_errors")
+                maxErrors = std::stoul(value);
+            else if (option == "--trace_level")
+                traceLevel = std::stoul(value);
+            else
+                InvalidArgument("Unknown option '%s'.", option.c_str());
+        }
+
+        if (inputFile.empty() || headerFile.empty() || outputFile.empty())
+        {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+
+        if (precision != "float" && precision != "double")
+            InvalidArgument("Invalid precision '%s', expected 'float' or 'double'.", precision.c_str());
+
+        if (compression != "none" && compression != "lz4")
+            InvalidArgument("Invalid compression '%s', expected 'none' or 'lz4'.", compression.c_str());
+        auto codec = compression == "lz4" ? ChunkCodecType::lz4 : ChunkCodecType::none;
+
+        std::vector<ValueEncodingType> encodings;
+        auto streams = ReadStreamHeader(headerFile, precision == "float" ? DataType::Float : DataType::Double, encodings);
+
+        if (precision == "float")
+            Convert<float>(inputFile, outputFile, streams, encodings, codec, chunkSize, numThreads, maxErrors, traceLevel);
+        else
+            Convert<double>(inputFile, outputFile, streams, encodings, codec, chunkSize, numThreads, maxErrors, traceLevel);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    return CNTK::ConvertMain(argc, argv);
+}
@@ -163,9 +163,17 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
                 }
             }
 
+            // Number of length buckets sequences of a randomized chunk are sorted into, to reduce padding.
+            size_t lengthBuckets = config(L"lengthBuckets", 0);
+
+            // Number of chunks read ahead of the randomization window, and the cap on their estimated size in memory (0 - no cap).
+            size_t readAheadChunks = config(L"readAheadChunks", 1);
+            size_t readAheadMaxBytes = config(L"readAheadMaxBytes", 0);
+
             bool shouldPrefetch = true;
             m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, shouldPrefetch,
-                multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config));
+                multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config), lengthBuckets,
+                readAheadChunks, readAheadMaxBytes);
         }
         else
             m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization, maxErrors);
@@ -194,7 +202,8 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
             outputStreams,
             numAlternatingBuffers,
             localTimeline,
-            m_corpus);
+            m_corpus,
+            verbosity);
         break;
     case PackingMode::sequence:
         m_packer = std::make_shared<SequencePacker>(
@@ -202,7 +211,8 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
             outputStreams,
             numAlternatingBuffers,
             localTimeline,
-            m_corpus);
+            m_corpus,
+            verbosity);
         break;
     case PackingMode::truncated:
     {
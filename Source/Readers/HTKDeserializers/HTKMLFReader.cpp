@@ -157,10 +157,10 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
     switch (m_packingMode)
     {
     case PackingMode::sample:
-        m_packer = std::make_shared<FramePacker>(m_sequenceEnumerator, m_streams);
+        m_packer = std::make_shared<FramePacker>(m_sequenceEnumerator, m_streams, 2, false, nullptr, verbosity);
         break;
     case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(m_sequenceEnumerator, m_streams);
+        m_packer = std::make_shared<SequencePacker>(m_sequenceEnumerator, m_streams, 2, false, nullptr, verbosity);
         break;
     case PackingMode::truncated:
         m_packer = std::make_shared<TruncatedBPTTPacker>(m_sequenceEnumerator, m_streams);
@@ -24,7 +24,10 @@ BlockRandomizer::BlockRandomizer(
     bool multithreadedGetNextSequence,
     size_t maxNumberOfInvalidSequences,
     bool sampleBasedRandomizationWindow,
-    size_t seedOffset)
+    size_t seedOffset,
+    size_t numberOfLengthBuckets,
+    size_t readAheadChunks,
+    size_t readAheadMaxBytes)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -34,16 +37,16 @@ BlockRandomizer::BlockRandomizer(
       m_sweepSizeInSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRange, sampleBasedRandomizationWindow)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(ChunkIdMax),
+      m_readAheadChunks(readAheadChunks),
       m_cleaner(maxNumberOfInvalidSequences),
       m_seedOffset(seedOffset)
 {
     assert(deserializer != nullptr);
 
-    m_launchType = shouldPrefetch ? launch::async : launch::deferred;
+    m_prefetcher = std::make_unique<ChunkPrefetcher>(deserializer, shouldPrefetch && readAheadChunks > 0, readAheadMaxBytes);
 
     m_streams = m_deserializer->StreamInfos();
-    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
+    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer, numberOfLengthBuckets);
 
     // Calculate total number of samples.
     m_sweepSizeInSamples = 0;
@@ -234,8 +237,7 @@ std::pair<size_t, size_t> BlockRandomizer::LoadSequenceData(size_t globalSampleC
     }
 
     // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    m_prefetcher->Prefetch(GetChunksToPrefetch(windowRange));
 
     return { numGlobalSamples, numLocalSamples };
 }
@@ -395,31 +397,14 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
 
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
-        {
-            // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
-                ++numLoadedChunks);
-        }
-        else
-        {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
-
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+        bool prefetched = false;
+        m_chunks[chunk.m_original->m_id] = m_prefetcher->Take(chunk.m_original->m_id, prefetched);
+        if (m_verbosity >= Information)
+            fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in %s chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                prefetched ? "prefetched" : "randomized",
                 chunk.m_chunkId,
                 chunk.m_original->m_id,
                 ++numLoadedChunks);
-        }
     }
 
     if (m_verbosity >= Notification)
@@ -429,43 +414,27 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+// Identifies chunk ids that should be prefetched.
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = ChunkIdMax;
+    std::vector<ChunkIdType> toBePrefetched;
     auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    while (current < m_chunkRandomizer->GetRandomizedChunks().size() && toBePrefetched.size() < m_readAheadChunks)
     {
         const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
         if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
             m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
         {
-            toBePrefetched = chunk.m_original->m_id;
-            break;
+            toBePrefetched.push_back(chunk.m_original->m_id);
         }
         ++current;
     }
-    return toBePrefetched;
-}
-
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
-{
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != ChunkIdMax)
-    {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+    if (m_verbosity >= Debug && !toBePrefetched.empty())
+        fprintf(stderr, "BlockRandomizer::GetChunksToPrefetch: prefetching %" PRIu64 " chunks starting with original chunk %u\n",
+                toBePrefetched.size(), toBePrefetched.front());
 
-        if (m_verbosity >= Debug)
-            fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
-    }
+    return toBePrefetched;
 }
 
 void BlockRandomizer::SetState(const std::map<std::wstring, size_t>& state)
@@ -475,6 +444,11 @@ void BlockRandomizer::SetState(const std::map<std::wstring, size_t>& state)
         InvalidArgument("Checkpoint misses required field %ls", g_minibatchSourcePosition);
 
     auto currentSamplePosition = it->second;
+
+    // Chunks prefetched for the old position are stale when the reader is moved elsewhere (e.g. restored from a checkpoint).
+    if (currentSamplePosition != m_globalSamplePosition)
+        m_prefetcher->Clear();
+
     PrepareNewSweepIfNeeded(currentSamplePosition);
 
     // Sets sequence cursor to the sequence that corresponds to the epoch start position.
@@ -492,6 +466,7 @@ void BlockRandomizer::SetConfiguration(const ReaderConfiguration& config)
 {
     // If configuration changes this can lead to reinitialization of worker chunks.
     m_currentWindowRange = ClosedOpenChunkInterval{};
+    m_prefetcher->Clear();
 
     *((ReaderConfiguration*)&m_config) = config;
 }
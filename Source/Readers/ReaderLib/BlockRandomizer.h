@@ -12,7 +12,7 @@
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
 #include "ReaderUtil.h"
-#include <future>
+#include "ChunkPrefetcher.h"
 
 namespace CNTK {
 
@@ -32,6 +32,10 @@ namespace CNTK {
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
+// If numberOfLengthBuckets > 1, SequenceRandomizer orders the sequences of each randomized chunk
+// into that many length buckets, to reduce the padding in sequence mode (see SequenceRandomizer.h).
+// When prefetch is enabled, up to readAheadChunks chunks following the current window are read ahead
+// in the background, as long as their estimated size stays within readAheadMaxBytes (see ChunkPrefetcher.h).
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
 {
@@ -44,7 +48,10 @@ public:
         bool multithreadedGetNextSequences = false,
         size_t maxNumberOfInvalidSequences = 0, // per worker
         bool sampleBasedRandomizationWindow = true,
-        size_t seedOffset = 0);
+        size_t seedOffset = 0,
+        size_t numberOfLengthBuckets = 0,
+        size_t readAheadChunks = 1,
+        size_t readAheadMaxBytes = 0);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -63,14 +70,6 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     std::map<std::wstring, size_t> GetState() override;
 
-    ~BlockRandomizer()
-    {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
-    }
-
     void SetState(const std::map<std::wstring, size_t>& state) override;
 
     void SetConfiguration(const ReaderConfiguration& config) override;
@@ -97,11 +96,8 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
-
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Returns the next candidates for the prefetch following the given range, in the order of use.
+    std::vector<ChunkIdType> GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange);
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -153,12 +149,10 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
-    // Whether to have async or deferred prefetch.
-    launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    // Reads chunks ahead of the current window.
+    std::unique_ptr<ChunkPrefetcher> m_prefetcher;
+    // Number of chunks to read ahead.
+    size_t m_readAheadChunks;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ChunkPrefetcher.h"
+#include <algorithm>
+#include <set>
+#include "PerformanceProfiler.h"
+
+namespace CNTK {
+
+using namespace Microsoft::MSR::CNTK;
+
+// Estimated size of a sample in memory. Sparse streams are assumed to have a single non-zero value per sample
+// (i.e. one-hot labels), opaque and variable-shape streams are not accounted for.
+static size_t EstimateSampleSizeInBytes(const std::vector<StreamInformation>& streams)
+{
+    size_t result = 0;
+    for (const auto& stream : streams)
+    {
+        if (stream.m_isBinary || stream.m_elementType == DataType::Unknown ||
+            stream.m_sampleLayout.IsUnknown() || stream.m_sampleLayout.HasUnboundDimension())
+            continue;
+
+        size_t elementSize = DataTypeSize(stream.m_elementType);
+        if (stream.m_storageFormat == StorageFormat::Dense)
+            result += stream.m_sampleLayout.TotalSize() * elementSize;
+        else
+            result += elementSize + sizeof(SparseIndexType);
+    }
+    return result;
+}
+
+ChunkPrefetcher::ChunkPrefetcher(DataDeserializerPtr deserializer, bool async, size_t maxPinnedBytes)
+    : m_deserializer(deserializer),
+      m_async(async),
+      m_maxPinnedBytes(maxPinnedBytes),
+      m_pinnedBytes(0),
+      m_stop(false)
+{
+    size_t sampleSize = EstimateSampleSizeInBytes(m_deserializer->StreamInfos());
+    for (const auto& chunk : m_deserializer->ChunkInfos())
+    {
+        if (m_estimatedChunkSizeInBytes.size() <= chunk.m_id)
+            m_estimatedChunkSizeInBytes.resize(chunk.m_id + 1, 0);
+        m_estimatedChunkSizeInBytes[chunk.m_id] = chunk.m_numberOfSamples * sampleSize;
+    }
+
+    if (m_async)
+        m_worker = std::thread([this]() { WorkerLoop(); });
+}
+
+ChunkPrefetcher::~ChunkPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_workAvailable.notify_all();
+
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void ChunkPrefetcher::Prefetch(const std::vector<ChunkIdType>& chunks)
+{
+    if (!m_async)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::set<ChunkIdType> wanted(chunks.begin(), chunks.end());
+    for (auto it = m_pinned.begin(); it != m_pinned.end();)
+    {
+        auto current = it++;
+        if (wanted.find(current->first) == wanted.end())
+            Release(current);
+    }
+
+    bool queued = false;
+    for (auto chunkId : chunks)
+    {
+        if (m_pinned.find(chunkId) != m_pinned.end())
+            continue;
+
+        size_t bytes = EstimatedChunkSizeInBytes(chunkId);
+        if (m_maxPinnedBytes != 0 && !m_pinned.empty() && m_pinnedBytes + bytes > m_maxPinnedBytes)
+            break;
+
+        m_pinned[chunkId] = Entry{ State::Queued, bytes, nullptr, nullptr };
+        m_pinnedBytes += bytes;
+        m_queue.push_back(chunkId);
+        queued = true;
+    }
+
+    lock.unlock();
+    if (queued)
+        m_workAvailable.notify_one();
+}
+
+ChunkPtr ChunkPrefetcher::Take(ChunkIdType chunkId, bool& prefetched)
+{
+    if (!m_async)
+    {
+        prefetched = false;
+        return ReadChunk(chunkId);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_pinned.find(chunkId);
+    prefetched = it != m_pinned.end();
+    if (!prefetched)
+    {
+        size_t bytes = EstimatedChunkSizeInBytes(chunkId);
+        it = m_pinned.insert(std::make_pair(chunkId, Entry{ State::Queued, bytes, nullptr, nullptr })).first;
+        m_pinnedBytes += bytes;
+    }
+
+    if (it->second.m_state == State::Queued)
+    {
+        // Read it next.
+        m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), chunkId), m_queue.end());
+        m_queue.push_front(chunkId);
+        m_workAvailable.notify_one();
+    }
+
+    if (it->second.m_state != State::Done)
+    {
+        auto stateId = ProfilerTimeBegin();
+        m_chunkRead.wait(lock, [&]() { return it->second.m_state == State::Done; });
+        ProfilerTimeEnd(stateId, profilerEvtWaitForChunk);
+    }
+
+    ChunkPtr chunk = it->second.m_chunk;
+    std::exception_ptr error = it->second.m_error;
+    Release(it);
+
+    if (error)
+        std::rethrow_exception(error);
+
+    return chunk;
+}
+
+void ChunkPrefetcher::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_pinned.empty())
+        Release(m_pinned.begin());
+}
+
+void ChunkPrefetcher::Release(std::map<ChunkIdType, Entry>::iterator entry)
+{
+    // A queued chunk id stays in the queue, the worker skips ids that are not pinned.
+    m_pinnedBytes -= entry->second.m_estimatedBytes;
+    m_pinned.erase(entry);
+}
+
+ChunkPtr ChunkPrefetcher::ReadChunk(ChunkIdType chunkId)
+{
+    auto stateId = ProfilerThroughputBegin();
+    ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
+    ProfilerThroughputEnd(stateId, profilerEvtReadChunk, EstimatedChunkSizeInBytes(chunkId));
+    return chunk;
+}
+
+void ChunkPrefetcher::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_workAvailable.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_stop)
+            return;
+
+        ChunkIdType chunkId = m_queue.front();
+        m_queue.pop_front();
+
+        auto it = m_pinned.find(chunkId);
+        if (it == m_pinned.end() || it->second.m_state != State::Queued)
+            continue;
+
+        it->second.m_state = State::Reading;
+        lock.unlock();
+
+        ChunkPtr chunk;
+        std::exception_ptr error;
+        try
+        {
+            chunk = ReadChunk(chunkId);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+
+        // The chunk may have been released while it was being read.
+        it = m_pinned.find(chunkId);
+        if (it != m_pinned.end() && it->second.m_state == State::Reading)
+        {
+            it->second.m_state = State::Done;
+            it->second.m_chunk = chunk;
+            it->second.m_error = error;
+        }
+        m_chunkRead.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DataDeserializer.h"
+
+namespace CNTK {
+
+// Reads chunks ahead of their use on a background I/O thread.
+// The randomizer announces the chunks it will need next, in the order of use, and takes them when
+// they enter its window. A chunk stays pinned in memory from the moment it is queued until it is taken.
+// The number of queued chunks is limited by the estimated size of all pinned chunks.
+// A chunk that is taken before it has been read is read next, ahead of the rest of the queue.
+//
+// Chunks are read one at a time, because deserializers are not required to support concurrent
+// GetChunk calls (most of them read through a single file handle).
+// Prefetch, Take and Clear must be called from a single thread.
+class ChunkPrefetcher
+{
+public:
+    // If 'async' is false, nothing is read ahead and chunks are read when they are taken.
+    // maxPinnedBytes == 0 means no limit.
+    ChunkPrefetcher(DataDeserializerPtr deserializer, bool async, size_t maxPinnedBytes);
+
+    ~ChunkPrefetcher();
+
+    // Queues the given chunks, in this order, for reading. Pinned chunks that are not in the list are released.
+    // Stops queuing at the first chunk that would exceed the memory limit (at least one chunk is always pinned).
+    void Prefetch(const std::vector<ChunkIdType>& chunks);
+
+    // Returns the chunk, waiting for it to be read if necessary, and unpins it.
+    // 'prefetched' is set to true if the chunk was queued before.
+    ChunkPtr Take(ChunkIdType chunkId, bool& prefetched);
+
+    // Releases all pinned chunks. A chunk that is being read is dropped once the read completes.
+    void Clear();
+
+    // Estimated size of a chunk in memory.
+    size_t EstimatedChunkSizeInBytes(ChunkIdType chunkId) const
+    {
+        return m_estimatedChunkSizeInBytes[chunkId];
+    }
+
+private:
+    enum class State
+    {
+        Queued,
+        Reading,
+        Done
+    };
+
+    struct Entry
+    {
+        State m_state;
+        size_t m_estimatedBytes;
+        ChunkPtr m_chunk;
+        std::exception_ptr m_error;
+    };
+
+    // Reads the chunk and records the read throughput.
+    ChunkPtr ReadChunk(ChunkIdType chunkId);
+
+    void Release(std::map<ChunkIdType, Entry>::iterator entry);
+
+    void WorkerLoop();
+
+    DataDeserializerPtr m_deserializer;
+    bool m_async;
+    size_t m_maxPinnedBytes;
+
+    // Estimated chunk sizes, by original chunk id.
+    std::vector<size_t> m_estimatedChunkSizeInBytes;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_chunkRead;
+    std::deque<ChunkIdType> m_queue;
+    std::map<ChunkIdType, Entry> m_pinned;
+    size_t m_pinnedBytes;
+    bool m_stop;
+    std::thread m_worker;
+
+    DISABLE_COPY_AND_MOVE(ChunkPrefetcher);
+};
+
+}
@@ -18,8 +18,9 @@ public:
         const std::vector<StreamInformation>& streams,
         size_t numberOfBuffers = 2,
         bool useLocalTimeline = false,
-        CorpusDescriptorPtr corpus = nullptr) :
-        SequencePacker(sequenceEnumerator, streams, numberOfBuffers, useLocalTimeline, corpus)
+        CorpusDescriptorPtr corpus = nullptr,
+        int verbosity = 0) :
+        SequencePacker(sequenceEnumerator, streams, numberOfBuffers, useLocalTimeline, corpus, verbosity)
     {}
 
 protected:
@@ -269,7 +269,9 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     if (!m_prefetchTask.valid())
         StartAsyncPrefetching();
 
+    auto stateId = ProfilerTimeBegin();
     auto result = m_prefetchTask.get();
+    ProfilerTimeEnd(stateId, profilerEvtWaitForPrefetch);
 
     // Ok, prefetch is done.
 
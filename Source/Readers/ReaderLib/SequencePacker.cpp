@@ -62,7 +62,10 @@ Minibatch SequencePacker::ReadMinibatch()
 
     Minibatch minibatch(sequences.m_endOfSweep, sequences.m_endOfEpoch);
     if (batch.empty())
+    {
+        ReportPaddingStatistics(minibatch);
         return minibatch;
+    }
 
     auto& currentBuffer = m_streamBuffers[m_currentBufferIndex];
 
@@ -89,6 +92,8 @@ Minibatch SequencePacker::ReadMinibatch()
         else
             RuntimeError("Unsupported for packing type '%d'", (int)type);
 
+        UpdatePaddingStatistics(pMBLayout, streamBatch);
+
         auto& buffer = currentBuffer[streamIndex];
 
         auto streamMinibatch = std::make_shared<StreamMinibatch>();
@@ -100,11 +105,40 @@ Minibatch SequencePacker::ReadMinibatch()
     }
 
     EstablishIdToKey(minibatch, sequences);
+    ReportPaddingStatistics(minibatch);
 
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
     return minibatch;
 }
 
+void SequencePacker::UpdatePaddingStatistics(const MBLayoutPtr& layout, const StreamBatch& batch)
+{
+    size_t numberOfSamples = 0;
+    for (const auto& sequence : batch)
+        numberOfSamples += sequence->m_numberOfSamples;
+
+    // Every column of the layout that does not hold a sample is padding.
+    m_numberOfPackedSamples += numberOfSamples;
+    m_numberOfPaddedSamples += layout->GetNumCols() - std::min(layout->GetNumCols(), numberOfSamples);
+}
+
+void SequencePacker::ReportPaddingStatistics(const Minibatch& minibatch)
+{
+    if (!minibatch.m_endOfSweep && !minibatch.m_endOfEpoch)
+        return;
+
+    size_t numberOfColumns = m_numberOfPackedSamples + m_numberOfPaddedSamples;
+    if (m_verbosity >= 1 && numberOfColumns != 0)
+        fprintf(stderr, "SequencePacker: padding ratio %.2f%% (%" PRIu64 " padded of %" PRIu64 " packed columns) at the end of the %s\n",
+                100.0 * m_numberOfPaddedSamples / numberOfColumns,
+                m_numberOfPaddedSamples,
+                numberOfColumns,
+                minibatch.m_endOfEpoch ? "epoch" : "sweep");
+
+    m_numberOfPackedSamples = 0;
+    m_numberOfPaddedSamples = 0;
+}
+
 void SequencePacker::SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders)
 {
     PackerBase::SetConfiguration(config, memoryProviders);
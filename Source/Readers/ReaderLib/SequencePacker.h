@@ -19,11 +19,15 @@ public:
         const std::vector<StreamInformation>& streams,
         size_t numberOfBuffers = 2,
         bool useLocalTimeline = false,
-        CorpusDescriptorPtr corpus = nullptr) :
+        CorpusDescriptorPtr corpus = nullptr,
+        int verbosity = 0) :
         PackerBase(corpus, sequenceEnumerator, streams, numberOfBuffers),
         m_useLocalTimeline(useLocalTimeline),
+        m_verbosity(verbosity),
         m_globalMinibatchSizeInSamples(0),
-        m_localMinibatchSizeInSamples(0)
+        m_localMinibatchSizeInSamples(0),
+        m_numberOfPackedSamples(0),
+        m_numberOfPaddedSamples(0)
     {}
 
     virtual Minibatch ReadMinibatch() override;
@@ -45,15 +49,26 @@ protected:
 
     std::pair<vector<MBLayout::SequenceInfo>,size_t> CreateSequenceInfos(const StreamBatch& batch);
 
+    // Accumulates the padding statistics of a packed stream, and reports them at the end of a sweep or epoch.
+    void UpdatePaddingStatistics(const MBLayoutPtr& layout, const StreamBatch& batch);
+    void ReportPaddingStatistics(const Minibatch& minibatch);
+
     // A flag indicating whether to use local timeline for data.
     bool m_useLocalTimeline;
 
+    // Reader verbosity; padding statistics are reported from the notification level (1) on.
+    int m_verbosity;
+
     // A minibatch size for this worker in local samples.
     size_t m_localMinibatchSizeInSamples;
 
     // A minibatch size for this worker in global samples.
     size_t m_globalMinibatchSizeInSamples;
 
+    // Number of samples of all streams and of the gaps in their layouts since the last report.
+    size_t m_numberOfPackedSamples;
+    size_t m_numberOfPaddedSamples;
+
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -18,8 +18,11 @@ namespace CNTK {
     SequenceRandomizer::SequenceRandomizer(
         int verbosity,
         DataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer)
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t numberOfLengthBuckets)
         : m_verbosity(verbosity),
+        m_numberOfLengthBuckets(numberOfLengthBuckets),
+        m_seed(0),
         m_randomizedChunks(chunkRandomizer->GetRandomizedChunks()),
         m_chunkWindowBegin(0),
         m_randomizedWindowEnd(0),
@@ -45,6 +48,7 @@ namespace CNTK {
     // Resets the current sweep according to the randomization seed provided.
     void SequenceRandomizer::Reset(size_t randSeed)
     {
+        m_seed = randSeed;
         m_rng.seed((unsigned long)randSeed);
 
         m_sequenceWindow.clear();
@@ -232,6 +236,9 @@ namespace CNTK {
         // Let's recalculate number of samples in the randomized chunks for efficient indexing in seek.
         size_t sampleCount = 0;
         size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
+
+        // The chunk is at its final state now, the sequences can be bucketed.
+        BucketSequencesByLength(m_sequenceWindow[randomizedChunk]);
         for (size_t index = 0; index < m_sequenceWindow[randomizedChunk].size(); index++)
         {
             sampleCount += m_sequenceWindow[randomizedChunk][index].m_numberOfSamples;
@@ -285,7 +292,8 @@ namespace CNTK {
             if (m_verbosity)
                 fprintf(stderr, "SequenceRandomizer::Seek(): starting over \n");
 
-            Reset(sweep);
+            // Use the seed of the sweep, so that the randomization matches the randomized chunks.
+            Reset(m_seed);
         }
         else if (sweepSampleOffset < randomizedWindowEndInSamples)
         {
@@ -324,6 +332,34 @@ namespace CNTK {
         return m_currentSampleCursor;
     }
 
+    // Reorders the sequences of a fully randomized chunk into length buckets.
+    // The stable sort keeps the random order between sequences of the same length.
+    void SequenceRandomizer::BucketSequencesByLength(std::vector<RandomizedSequenceDescription>& sequences)
+    {
+        if (m_numberOfLengthBuckets <= 1 || sequences.size() <= 1)
+            return;
+
+        std::stable_sort(sequences.begin(), sequences.end(),
+            [](const RandomizedSequenceDescription& a, const RandomizedSequenceDescription& b) { return a.m_numberOfSamples < b.m_numberOfSamples; });
+
+        size_t numberOfBuckets = std::min(m_numberOfLengthBuckets, sequences.size());
+        std::vector<size_t> bucketOrder(numberOfBuckets);
+        for (size_t i = 0; i < numberOfBuckets; ++i)
+            bucketOrder[i] = i;
+        Microsoft::MSR::CNTK::RandomShuffleMT(bucketOrder, m_rng);
+
+        std::vector<RandomizedSequenceDescription> bucketed;
+        bucketed.reserve(sequences.size());
+        for (size_t bucket : bucketOrder)
+        {
+            size_t begin = bucket * sequences.size() / numberOfBuckets;
+            size_t end = (bucket + 1) * sequences.size() / numberOfBuckets;
+            bucketed.insert(bucketed.end(), sequences.begin() + begin, sequences.begin() + end);
+        }
+
+        sequences.swap(bucketed);
+    }
+
     // Checks if the randomized sequence is valid for a target chunk.
     bool SequenceRandomizer::IsValidForPosition(ChunkIdType chunkIndex, const RandomizedSequenceDescription& seqDesc) const
     {
@@ -29,13 +29,23 @@ struct RandomizedSequenceDescription
 // Class that given randomized chunks, randomizes sequence descriptions in a window of chunks.
 // TODO: This code is still based on the old behavior, so that all current tests pass.
 // TODO: Can be simplified if we only randomized sequences forward.
+//
+// If numberOfLengthBuckets > 1, sequences of each randomized chunk are additionally ordered by length
+// once the chunk is fully randomized: they are split into that many buckets of (approximately) the same
+// number of sequences, and the buckets are emitted one after another in a random order, so that
+// consecutive minibatches contain sequences of similar length and need less padding. Since a randomized
+// chunk holds sequences drawn from its whole randomization window, this buckets a random sample of the window.
+// Sequences never leave their randomized chunk, so the randomization window guarantees, the worker
+// decimation (which is based on the chunk a sequence originates from) and the sample positions of
+// randomized chunks (used by Seek) are not affected.
 class SequenceRandomizer
 {
 public:
     SequenceRandomizer(
         int verbosity,
         DataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer);
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t numberOfLengthBuckets = 0);
 
     // Resets the current sweep according to the randomization seed provided.
     void Reset(size_t seed);
@@ -76,6 +86,9 @@ private:
     // Release chunks from the chunk window that are not needed anymore.
     void ReleaseChunks();
 
+    // Reorders the sequences of a fully randomized chunk into length buckets.
+    void BucketSequencesByLength(std::vector<RandomizedSequenceDescription>& sequences);
+
     DataDeserializerPtr m_deserializer;
 
     // Used only as a buffer to get sequence descriptions without memory reallocation.
@@ -156,6 +169,12 @@ private:
     // General configuration
     int m_verbosity;
 
+    // Number of length buckets per randomized chunk, 0 or 1 if sequences are not bucketed.
+    size_t m_numberOfLengthBuckets;
+
+    // Seed of the current sweep.
+    size_t m_seed;
+
     std::mt19937_64 m_rng;
 };
 
@@ -202,6 +202,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                       IDataReader* trainSetDataReader,
                                       IDataReader* validationSetDataReader)
 {
+    if (m_hoistLoopInvariants)
+        net->HoistLoopInvariantProjections<ElemType>();
+
     let& criterionNodes = GetTrainCriterionNodes(net);
 
     fprintf(stderr, "\n");
@@ -2048,6 +2051,14 @@ size_t SGD<ElemType>::AdaptiveMinibatchSizing(ComputationNetworkPtr net,
             maxMinibatchSize = min(maxMinibatchSize, m_prevChosenMinibatchSize * 2);
         }
 
+        // sizes beyond the fastest one cost throughput, so only those up to it are tried for convergence
+        if (m_minibatchSearchByThroughput && minMinibatchSize <= maxMinibatchSize)
+        {
+            maxMinibatchSize = SearchForFastestMinibatchSize(net, epochNumber, trainSetDataReader,
+                                                             featureNodes, labelNodes, criterionNodes, inputMatrices,
+                                                             minMinibatchSize, maxMinibatchSize);
+        }
+
         chosenMinibatchSize = SearchForBestMinibatchSize(net, refNet, refNode, epochNumber,
                                                          numFramesToUseInSearch, trainSetDataReader,
                                                          learnRatePerSample, featureNodes,
@@ -2070,6 +2081,175 @@ static size_t RoundToMultipleOf64(size_t val)
     return 64 * ((val + 32) / 64);
 }
 
+// Measurements of earlier searches are kept next to the model, one line per trial minibatch size:
+// <minibatchSize> <seconds per sample> <memory in bytes>
+// and are reused instead of measuring again. Delete the file to measure again, e.g. after changing hardware.
+static std::wstring GetMinibatchThroughputLogPath(const std::wstring& modelPath)
+{
+    return modelPath + L".mbThroughput";
+}
+
+// uses a few minibatches of training data to time forward and backward propagation
+// (without updating the model) for various MB sizes; then picks the fastest per sample
+template <class ElemType>
+size_t SGD<ElemType>::SearchForFastestMinibatchSize(ComputationNetworkPtr net,
+                                                    const int epochNumber,
+                                                    IDataReader* trainSetDataReader,
+                                                    const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                    const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                    const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                    StreamMinibatchInputs* inputMatrices,
+                                                    const size_t minMinibatchSize, const size_t maxMinibatchSize)
+{
+    struct Measurement
+    {
+        double secondsPerSample;
+        size_t memoryInBytes;
+    };
+    std::map<size_t, Measurement> measurements;
+
+    let logPath = GetMinibatchThroughputLogPath(m_modelPath);
+    if (fexists(logPath))
+    {
+        FILE* f = fopenOrDie(logPath, L"r");
+        unsigned long long minibatchSize, memoryInBytes;
+        double secondsPerSample;
+        while (fscanf(f, "%llu %lf %llu", &minibatchSize, &secondsPerSample, &memoryInBytes) == 3)
+            measurements[(size_t)minibatchSize] = Measurement{ secondsPerSample, (size_t)memoryInBytes };
+        fcloseOrDie(f);
+    }
+
+    // the same trial sizes as SearchForBestMinibatchSize(), in increasing order
+    std::vector<size_t> trialMinibatchSizes;
+    const float minibatchSizeTuningFactor = sqrtf(2.0f);
+    for (float trialMinibatchSizeFloat = (float) minMinibatchSize;
+         trialMinibatchSizeFloat <= maxMinibatchSize;
+         trialMinibatchSizeFloat *= minibatchSizeTuningFactor)
+    {
+        size_t trialMinibatchSize = RoundToMultipleOf64(trialMinibatchSizeFloat);
+        if (trialMinibatchSize > 0 && (trialMinibatchSizes.empty() || trialMinibatchSizes.back() != trialMinibatchSize))
+            trialMinibatchSizes.push_back(trialMinibatchSize);
+    }
+
+    if (trialMinibatchSizes.empty())
+        return maxMinibatchSize;
+
+    // The memory of a size is what the MatrixPool allocation of the network needs for minibatches of that many columns.
+    auto criterionNode = dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0]);
+    bool measuredAny = false;
+    for (auto trialMinibatchSize : trialMinibatchSizes)
+    {
+        auto found = measurements.find(trialMinibatchSize);
+        if (found == measurements.end() && m_minibatchSearchMemoryCap != 0)
+        {
+            // a size that does not fit may not even run, so it is checked before it is measured
+            size_t estimatedMemoryInBytes = net->GetPooledMatrixBytes(trialMinibatchSize);
+            if (estimatedMemoryInBytes > m_minibatchSearchMemoryCap)
+            {
+                LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: minibatchSize=%d: %.1f MB (exceeds memory cap)\n",
+                          (int)epochNumber + 1, (int)trialMinibatchSize, estimatedMemoryInBytes / (1024.0 * 1024.0));
+                break;
+            }
+        }
+
+        if (found == measurements.end())
+        {
+            // Time 'm_numMinibatchesForThroughputSearch' minibatches after one warm-up minibatch, which also grows the matrices.
+            trainSetDataReader->StartMinibatchLoop(trialMinibatchSize, epochNumber, inputMatrices->GetStreamDescriptions(), m_epochSize);
+            net->StartEvaluateMinibatchLoop(criterionNodes);
+
+            double seconds = 0;
+            size_t numSamples = 0;
+            size_t maxNumColumns = 0;
+            for (size_t i = 0; i <= m_numMinibatchesForThroughputSearch; i++)
+            {
+                size_t actualMBSize = 0;
+                if (!DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
+                                                                          /*useDistributedMBReading=*/false, /*useParallelTrain=*/false,
+                                                                          *inputMatrices, actualMBSize, m_mpi))
+                    break;
+                if (actualMBSize == 0)
+                    continue;
+                maxNumColumns = max(maxNumColumns, net->GetMBLayoutPtrOfNetwork()->GetNumCols());
+
+                MarkDropoutNodesEvalTimeStampAsOutdated(net, criterionNodes[0]);
+                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+
+                Timer timer;
+                timer.Start();
+                net->ForwardProp(criterionNodes[0]);
+                net->Backprop(criterionNodes[0]);
+                criterionNode->Value().Get00Element(); // wait for the device
+                timer.Stop();
+
+                if (i > 0)
+                {
+                    seconds += timer.ElapsedSeconds();
+                    numSamples += actualMBSize;
+                }
+            }
+
+            if (numSamples == 0)
+            {
+                LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Not enough data to measure minibatchSize=%d\n",
+                          (int)epochNumber + 1, (int)trialMinibatchSize);
+                break;
+            }
+
+            found = measurements.insert(make_pair(trialMinibatchSize, Measurement{ seconds / numSamples, net->GetPooledMatrixBytes(maxNumColumns) })).first;
+            measuredAny = true;
+        }
+
+        bool exceedsMemoryCap = m_minibatchSearchMemoryCap != 0 && found->second.memoryInBytes > m_minibatchSearchMemoryCap;
+        LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: minibatchSize=%d: %.3f us per sample, %.1f MB%s\n",
+                  (int)epochNumber + 1, (int)trialMinibatchSize, found->second.secondsPerSample * 1e6,
+                  found->second.memoryInBytes / (1024.0 * 1024.0), exceedsMemoryCap ? " (exceeds memory cap)" : "");
+
+        // larger sizes need even more memory
+        if (exceedsMemoryCap)
+            break;
+    }
+
+    // The forward pass may have changed state that belongs to the model, e.g. batch normalization statistics.
+    if (measuredAny)
+        net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(epochNumber - 1));
+
+    size_t fastestMinibatchSize = 0;
+    double fastestSecondsPerSample = 0;
+    for (auto trialMinibatchSize : trialMinibatchSizes)
+    {
+        auto found = measurements.find(trialMinibatchSize);
+        if (found == measurements.end() || (m_minibatchSearchMemoryCap != 0 && found->second.memoryInBytes > m_minibatchSearchMemoryCap))
+            continue;
+        if (fastestMinibatchSize == 0 || found->second.secondsPerSample < fastestSecondsPerSample)
+        {
+            fastestMinibatchSize = trialMinibatchSize;
+            fastestSecondsPerSample = found->second.secondsPerSample;
+        }
+    }
+
+    // nothing fits: fall back to the smallest size
+    if (fastestMinibatchSize == 0)
+        fastestMinibatchSize = trialMinibatchSizes.front();
+
+    // workers measure on different data and hardware, all must use the same size
+    if (m_mpi != nullptr)
+        m_mpi->Bcast(&fastestMinibatchSize, 1, m_mpi->MainNodeRank());
+
+    if (measuredAny && (m_mpi == nullptr || m_mpi->IsMainNode()))
+    {
+        FILE* f = fopenOrDie(logPath, L"w");
+        for (const auto& measurement : measurements)
+            fprintfOrDie(f, "%llu %.9g %llu\n", (unsigned long long)measurement.first, measurement.second.secondsPerSample, (unsigned long long)measurement.second.memoryInBytes);
+        fcloseOrDie(f);
+    }
+
+    LOGPRINTF(stderr, " AdaptiveMinibatchSearch Epoch[%d]: Fastest minibatchSize is %d, searching for convergence up to it\n",
+              (int)epochNumber + 1, (int)fastestMinibatchSize);
+    return fastestMinibatchSize;
+}
+
 // uses a small percentage of training data of minibatch to
 // speculatively train with various MB sizes; then picks the best
 template <class ElemType>
@@ -2269,7 +2449,18 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
 {
     assert(GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD);
 
-    if (numGradientBits != (8 * sizeof(ElemType)))
+    if (m_gradientCompression == GradientCompressionType::topK)
+    {
+        if (traceLevel > 0)
+            fprintf(stderr, "Initializing dataParallelSGD for top-k sparsified aggregation (density %g, target %d bytes per step).\n", m_topKDensity, (int)m_topKTargetBytesPerStep);
+#ifdef CNTK_PARALLEL_TRAINING_SUPPORT
+        auto communicator = ::CNTK::SparsifiedMPICommunicator(m_topKDensity, m_topKTargetBytesPerStep, m_topKSampledThreshold);
+        m_distGradAgg = std::make_shared<V2AllReduceDistGradAggregator<ElemType>>(communicator, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
+#else
+        RuntimeError("Gradient sparsification is unsupported in CNTK binaries built without quantized gradient aggregation support!");
+#endif // !CNTK_PARALLEL_TRAINING_SUPPORT
+    }
+    else if (numGradientBits != (8 * sizeof(ElemType)))
     {
         if (traceLevel > 0)
             fprintf(stderr, "Initializing dataParallelSGD for %d-bit quantization.\n", numGradientBits);
@@ -2855,6 +3046,13 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
     else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD | dataParallelASGD)");
 }
 
+static GradientCompressionType ParseGradientCompressionType(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"quantization")) return GradientCompressionType::quantization;
+    else if (EqualCI(s, L"topK"))                            return GradientCompressionType::topK;
+    else InvalidArgument("ParseGradientCompressionType: Invalid gradient compression type. Valid values are (quantization | topK)");
+}
+
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
 {
     if      (EqualCI(s, L"false") || EqualCI(s, L"none")) return LearningRateSearchAlgorithm::None;
@@ -2901,6 +3099,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_minibatchSizeTuningFrequency = configAALR(L"minibatchSizeTuningFrequency", (size_t) 1);
     m_minibatchSizeTuningMax = configAALR(L"minibatchSizeTuningMax", (size_t) 1048576);
     m_minibatchSearchCriterionErrorMargin = configAALR(L"minibatchSearchCriterionErrorMargin", (size_t) 1);
+    m_minibatchSearchByThroughput = configAALR(L"minibatchSearchByThroughput", false);
+    m_minibatchSearchMemoryCap = configAALR(L"minibatchSearchMemoryCapInMB", (size_t) 0) * 1024 * 1024;
+    m_numMinibatchesForThroughputSearch = max((size_t) 1, (size_t) configAALR(L"numMinibatchesForThroughputSearch", (size_t) 5));
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
@@ -3028,6 +3229,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
 
+    // move the input projections of hand-built recurrences out of the frame-by-frame loops
+    m_hoistLoopInvariants = configSGD(L"hoistLoopInvariants", false);
+
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
     {
@@ -3129,6 +3333,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientCompression = GradientCompressionType::quantization;
+    m_topKDensity = 0.01;
+    m_topKTargetBytesPerStep = 0;
+    m_topKSampledThreshold = false;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -3162,6 +3370,12 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientCompression = ParseGradientCompressionType(configDataParallelSGD(L"gradientCompression", L"quantization"));
+            m_topKDensity = configDataParallelSGD(L"topKDensity", 0.01);
+            m_topKTargetBytesPerStep = configDataParallelSGD(L"topKTargetBytesPerStep", (size_t)0);
+            m_topKSampledThreshold = configDataParallelSGD(L"topKSampledThreshold", false);
+            if (m_topKDensity <= 0 || m_topKDensity > 1)
+                InvalidArgument("topKDensity must be in the range (0, 1].");
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
@@ -72,6 +72,13 @@ enum class ParallelizationMethod : int
     modelParallelSGD = (1 << 8) // Currently unsupported
 };
 
+// how dataParallelSGD compresses gradients before aggregating them
+enum class GradientCompressionType : int
+{
+    quantization, // quantize every entry to gradientBits bits (1-bit SGD)
+    topK          // send only the largest-magnitude entries of every stripe, keep the rest as residual
+};
+
 // configuration parameters associated with RMSProp learning algorithm
 struct RMSPropInfo
 {
@@ -240,6 +247,9 @@ protected:
     size_t m_minibatchSearchCriterionErrorMargin;
     size_t m_minibatchSizeTuningFrequency;
     size_t m_minibatchSizeTuningMax;
+    bool m_minibatchSearchByThroughput;             // first restrict the search to the minibatch size with the best measured throughput
+    size_t m_minibatchSearchMemoryCap;              // in bytes, 0 - no cap
+    size_t m_numMinibatchesForThroughputSearch;     // timed minibatches per trial size
 
     doubleargvector m_dropoutRates;
     doubleargvector m_batchNormalizationTimeConstant;
@@ -269,6 +279,8 @@ protected:
 
     bool m_useAllDataForPreComputedNode;
 
+    bool m_hoistLoopInvariants;
+
     // Parallel training
     MPIWrapperPtr m_mpi;
 
@@ -293,6 +305,10 @@ protected:
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    GradientCompressionType m_gradientCompression;
+    double m_topKDensity;             // fraction of gradient entries sent with topK compression
+    size_t m_topKTargetBytesPerStep;  // if non-zero, topK density is adapted to send this many bytes per step
+    bool m_topKSampledThreshold;      // estimate the topK threshold from a sample instead of exact selection
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -462,6 +478,17 @@ protected:
                                    std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts,
                                    const double learningRateAdjustmentFactor);
 
+    // measures per-sample forward/backward time and memory footprint for the trial MB sizes in the given range,
+    // without training; then picks the fastest size within the memory cap
+    size_t SearchForFastestMinibatchSize(ComputationNetworkPtr net,
+                                         const int epochNumber,
+                                         IDataReader* trainSetDataReader,
+                                         const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                         const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                         const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                         StreamMinibatchInputs* inputMatrices,
+                                         const size_t minMinibatchSize, const size_t maxMinibatchSize);
+
     // uses a small percentage of training data of minibatch to
     // speculatively train with various MB sizes; then picks the best
     size_t SearchForBestMinibatchSize(ComputationNetworkPtr net,
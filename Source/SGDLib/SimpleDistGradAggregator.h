@@ -16,6 +16,7 @@
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -261,6 +262,11 @@ private:
 
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
+        long long aggregateBytes = 0;
+        for (auto gradient : gradients)
+            aggregateBytes += gradient->GetNumElements() * sizeof(ElemType);
+        ScopeProfile profileAggregate("MPI Aggregate", profilerCatDistributed, aggregateBytes);
+
         Timer aggregationTimer;
         int deviceId = gradients[0]->GetDeviceId();
         if (showSyncPerfStats)
@@ -420,6 +426,7 @@ private:
         }
 
         // On the main node wait for the headers to arrive and aggregate
+        auto profWait = ProfilerTimeBegin();
         if (m_mpi->IsMainNode())
         {
             size_t numNodesHeadersReceivedFrom = 0;
@@ -463,6 +470,7 @@ private:
                 m_mpi->Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
             }
         }
+        ProfilerTimeEnd(profWait, "MPI Wait For AllReduce", profilerCatDistributed);
 
         // Copy data back to the packed gradients from the continous buffer
         offset = 0;
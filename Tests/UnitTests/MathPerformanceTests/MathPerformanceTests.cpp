@@ -11,10 +11,13 @@
 #include "CPUMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
+#include "BatchNormalizationEngine.h"
+#include "ConvolutionEngine.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <functional>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -336,8 +339,165 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// Reports the time of CPU batch normalization inference with the direct and the CNTK engines,
+// on a shape similar to the first layers of ResNet.
+void BatchNormalizationInferenceSpeedTest(size_t width, size_t height, size_t channels, size_t batchSize)
+{
+    int deviceId = -1;
+    TensorShape inOutT(width, height, channels);
+    size_t crow = inOutT.GetNumElements();
+
+    Matrix<float> x(crow, batchSize, deviceId);
+    randomInitializeMatrix<float>(x, -1, 2);
+    Matrix<float> scale(channels, 1, deviceId);
+    randomInitializeMatrix<float>(scale, -1, 2);
+    Matrix<float> bias(channels, 1, deviceId);
+    randomInitializeMatrix<float>(bias, -1, 2);
+    Matrix<float> runMean(channels, 1, deviceId);
+    randomInitializeMatrix<float>(runMean, -1, 2);
+    Matrix<float> runVariance(channels, 1, deviceId);
+    randomInitializeMatrix<float>(runVariance, 1, 1);
+    Matrix<float> out(crow, batchSize, deviceId);
+    Matrix<float> saveMean(deviceId);
+    Matrix<float> saveInvStdDev(deviceId);
+
+    const int repeats = 10;
+    auto timeEngine = [&](BatchNormEngineKind kind)
+    {
+        auto eng = BatchNormEngine<float>::Create(deviceId, inOutT, true, ImageLayoutKind::CHW, kind);
+        eng->Forward(x, scale, bias, true, 0, 1, runMean, runVariance, out, 1e-5, saveMean, saveInvStdDev);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
+            eng->Forward(x, scale, bias, true, 0, 1, runMean, runVariance, out, 1e-5, saveMean, saveInvStdDev);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    };
+
+    double elapsedDirect = timeEngine(BatchNormEngineKind::Direct);
+    double elapsedCntk = timeEngine(BatchNormEngineKind::Cntk);
+    cout << "Batch normalization inference, " << (string) inOutT << " x " << batchSize
+         << ": direct engine " << elapsedDirect << " ms, CNTK engine " << elapsedCntk << " ms" << endl;
+}
+
+// Reports the time of CPU forward and backward convolution with the direct and the GEMM engines,
+// for a 'kernel' x 'kernel' convolution with same padding.
+void ConvolutionSpeedTest(size_t width, size_t height, size_t channels, size_t kernel, size_t mapCount, size_t stride, size_t batchSize)
+{
+    int deviceId = -1;
+    auto geometry = std::make_shared<ConvolveGeometry>(TensorShape(width, height, channels),
+        TensorShape(kernel, kernel, channels), TensorShape(mapCount), TensorShape(stride, stride, channels),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0));
+    size_t crowIn = geometry->InputShape().GetNumElements();
+    size_t crowOut = geometry->OutputShape().GetNumElements();
+
+    Matrix<float> in(crowIn, batchSize, deviceId);
+    randomInitializeMatrix<float>(in, -1, 2);
+    Matrix<float> kernelWeights(mapCount, geometry->KernelShape().GetNumElements(), deviceId);
+    randomInitializeMatrix<float>(kernelWeights, -1, 2);
+    Matrix<float> srcGrad(crowOut, batchSize, deviceId);
+    randomInitializeMatrix<float>(srcGrad, -1, 2);
+    Matrix<float> out(crowOut, batchSize, deviceId);
+    Matrix<float> grad(crowIn, batchSize, deviceId);
+    Matrix<float> kernelGrad(mapCount, geometry->KernelShape().GetNumElements(), deviceId);
+
+    const int repeats = 10;
+    auto time = [&](const std::function<void()>& f)
+    {
+        f();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
+            f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    };
+
+    for (auto kind : { ConvolutionEngineKind::Direct, ConvolutionEngineKind::Gemm })
+    {
+        auto eng = ConvolutionEngine<float>::Create(geometry, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, kind);
+        Matrix<float> workspace(deviceId);
+        double elapsedForward = time([&] { eng->Forward(in, kernelWeights, out, workspace); });
+        double elapsedBackwardData = time([&] { eng->BackwardData(srcGrad, kernelWeights, grad, false, workspace); });
+        double elapsedBackwardKernel = time([&] { eng->BackwardKernel(srcGrad, in, kernelGrad, false, false, workspace); });
+        cout << "Convolution " << kernel << "x" << kernel << " stride " << stride << ", " << (string) geometry->InputShape() << " x " << batchSize
+             << " -> " << mapCount << " maps, " << (kind == ConvolutionEngineKind::Direct ? "direct" : "GEMM") << " engine: forward " << elapsedForward
+             << " ms, backward data " << elapsedBackwardData << " ms, backward kernel " << elapsedBackwardKernel << " ms" << endl;
+    }
+}
+
+// Reports the time of CPU forward and backward pooling of 2D inputs with the reference engine, which pools them
+// directly (DirectPooling), and with the index map kernels of the geometry that it used before.
+void PoolingSpeedTest(size_t width, size_t height, size_t channels, size_t window, size_t stride, PoolKind kind, size_t batchSize)
+{
+    int deviceId = -1;
+    auto geometry = std::make_shared<ConvolveGeometry>(TensorShape(width, height, channels),
+        TensorShape(window, window, 1), TensorShape(1), TensorShape(stride, stride, 1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0));
+    size_t crowIn = geometry->InputShape().GetNumElements();
+    size_t crowOut = geometry->OutputShape().GetNumElements();
+
+    Matrix<float> in(crowIn, batchSize, deviceId);
+    randomInitializeMatrix<float>(in, -1, 2);
+    Matrix<float> srcGrad(crowOut, batchSize, deviceId);
+    randomInitializeMatrix<float>(srcGrad, -1, 2);
+    Matrix<float> out(crowOut, batchSize, deviceId);
+    Matrix<float> grad(crowIn, batchSize, deviceId);
+
+    // The maps are owned by the geometry.
+    auto flags = matrixFlagDontOwnBuffer;
+    Matrix<int> mpRowCol(geometry->MpRowCol().size(), 1, const_cast<int*>(geometry->MpRowCol().data()), deviceId, flags);
+    Matrix<int> mpRowIndices(geometry->MpRowIndices().size(), 1, const_cast<int*>(geometry->MpRowIndices().data()), deviceId, flags);
+    Matrix<int> indices(geometry->Indices().size(), 1, const_cast<int*>(geometry->Indices().data()), deviceId, flags);
+
+    const int repeats = 10;
+    auto time = [&](const std::function<void()>& f)
+    {
+        f();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
+            f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    };
+
+    auto eng = ConvolutionEngine<float>::Create(geometry, deviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference);
+    double elapsedDirectForward = time([&] { eng->ForwardPooling(in, out); });
+    double elapsedDirectBackward = time([&] { eng->BackwardPooling(out, srcGrad, in, grad, false); });
+
+    double elapsedMapsForward, elapsedMapsBackward;
+    if (kind == PoolKind::Max)
+    {
+        elapsedMapsForward = time([&] { in.MaxPoolingForward(mpRowCol, mpRowIndices, indices, out); });
+        elapsedMapsBackward = time([&] { srcGrad.MaxPoolingBackward(out, in, mpRowCol, mpRowIndices, indices, grad, false); });
+    }
+    else
+    {
+        elapsedMapsForward = time([&] { in.AveragePoolingForward(mpRowCol, mpRowIndices, indices, out, false); });
+        elapsedMapsBackward = time([&] { srcGrad.AveragePoolingBackward(mpRowCol, mpRowIndices, indices, grad, false, false); });
+    }
+
+    cout << (kind == PoolKind::Max ? "Max" : "Average") << " pooling " << window << "x" << window << " stride " << stride << ", "
+         << (string) geometry->InputShape() << " x " << batchSize
+         << ": direct forward " << elapsedDirectForward << " ms, backward " << elapsedDirectBackward
+         << " ms; index maps forward " << elapsedMapsForward << " ms, backward " << elapsedMapsBackward << " ms" << endl;
+}
+
 int wmain()
 {
+    cout << endl << "********************BatchNormalization inference TEST********************" << endl;
+    BatchNormalizationInferenceSpeedTest(56, 56, 64, 16);
+
+    cout << endl << "********************Convolution TEST********************" << endl;
+    ConvolutionSpeedTest(56, 56, 64, 3, 64, 1, 16);
+    ConvolutionSpeedTest(56, 56, 64, 3, 128, 2, 16);
+    ConvolutionSpeedTest(56, 56, 64, 1, 256, 1, 16);
+    ConvolutionSpeedTest(28, 28, 32, 5, 64, 1, 16);
+    ConvolutionSpeedTest(224, 224, 3, 7, 64, 2, 16);
+
+    cout << endl << "********************Pooling TEST********************" << endl;
+    PoolingSpeedTest(56, 56, 64, 3, 2, PoolKind::Max, 32);
+    PoolingSpeedTest(28, 28, 128, 3, 1, PoolKind::Max, 32);
+    PoolingSpeedTest(28, 28, 128, 2, 2, PoolKind::Max, 32);
+    PoolingSpeedTest(28, 28, 128, 3, 1, PoolKind::Average, 32);
+
     // MandSTest<float>(100, 2);
 
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
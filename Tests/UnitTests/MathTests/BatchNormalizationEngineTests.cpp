@@ -68,6 +68,55 @@ std::vector<std::tuple<TensorShape, size_t, bool, double, double>> GenerateBNTes
     return res;
 }
 
+// Batch normalization of a CPU minibatch in double precision, with the semantics of the CNTK engine's GPU kernels.
+// Running statistics are updated in place; 'scaleBias' holds scale followed by bias.
+static void ReferenceBatchNormForward(const vec& in, size_t spatialSize, size_t channels, size_t batchSize, const vec& scaleBias,
+                                      bool inferenceOnly, double expAvgFactor, double blendFactor, double epsilon,
+                                      vec& runMean, vec& runVariance, vec& out, vec& saveMean, vec& saveInvStdDev)
+{
+    size_t sampleSize = spatialSize * channels;
+    double count = (double)spatialSize * batchSize;
+    out.resize(in.size());
+    saveMean.resize(channels);
+    saveInvStdDev.resize(channels);
+    for (size_t c = 0; c < channels; c++)
+    {
+        double mean = runMean[c];
+        double invStdDev = 1 / sqrt(runVariance[c] + epsilon);
+        if (!inferenceOnly)
+        {
+            double sum = 0;
+            for (size_t n = 0; n < batchSize; n++)
+                for (size_t i = 0; i < spatialSize; i++)
+                    sum += in[n * sampleSize + c * spatialSize + i];
+            double batchMean = sum / count;
+            double m2 = 0;
+            for (size_t n = 0; n < batchSize; n++)
+                for (size_t i = 0; i < spatialSize; i++)
+                {
+                    double d = in[n * sampleSize + c * spatialSize + i] - batchMean;
+                    m2 += d * d;
+                }
+            double newRunMean = expAvgFactor * batchMean + (1 - expAvgFactor) * runMean[c];
+            double newRunVariance = expAvgFactor * (count == 1 ? 0 : m2 / (count - 1)) + (1 - expAvgFactor) * runVariance[c];
+            mean = blendFactor * newRunMean + (1 - blendFactor) * batchMean;
+            invStdDev = 1 / sqrt(m2 / count + epsilon);
+            if (blendFactor != 0)
+                invStdDev = blendFactor / sqrt(newRunVariance + epsilon) + (1 - blendFactor) * invStdDev;
+            runMean[c] = (float)newRunMean;
+            runVariance[c] = (float)newRunVariance;
+            saveMean[c] = (float)mean;
+            saveInvStdDev[c] = (float)invStdDev;
+        }
+        for (size_t n = 0; n < batchSize; n++)
+            for (size_t i = 0; i < spatialSize; i++)
+            {
+                size_t idx = n * sampleSize + c * spatialSize + i;
+                out[idx] = (float)(scaleBias[c] * (in[idx] - mean) * invStdDev + scaleBias[channels + c]);
+            }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(BatchNormalizationSuite)
 
 BOOST_AUTO_TEST_CASE(BatchNormalizationForward)
@@ -325,6 +374,179 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+// The direct engine computes the statistics in a single pass; compares it with a double precision reference
+// for training (with running statistics and blending) and with the CNTK engine for inference.
+BOOST_AUTO_TEST_CASE(BatchNormalizationDirectForward)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    // Shape, batch size, spatial.
+    std::vector<std::tuple<TensorShape, size_t, bool>> configs = {
+        std::make_tuple(TensorShape(17, 6, 1), 13, false),
+        std::make_tuple(TensorShape(300), 40, false),
+        std::make_tuple(TensorShape(11, 11, 13), 11, true),
+        std::make_tuple(TensorShape(40, 30, 3), 5, true),
+        std::make_tuple(TensorShape(2, 2, 64), 1, true) };
+    // Exponential averaging and blend factors.
+    std::vector<std::pair<double, double>> factors = { { 1, 0 }, { 0.1, 0 }, { 0.1, 0.5 }, { 0, 1 } };
+
+    int deviceId = -1;
+    double eps = 1e-5;
+    for (const auto& cfg : configs)
+    {
+        const auto& inOutT = std::get<0>(cfg);
+        size_t batchSize = std::get<1>(cfg);
+        bool spatial = std::get<2>(cfg);
+        size_t crow = inOutT.GetNumElements();
+        size_t channels = spatial ? inOutT[inOutT.GetRank() - 1] : crow;
+        size_t spatialSize = crow / channels;
+
+        auto engDirect = BNEng::Create(deviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Direct);
+        auto engCntk = BNEng::Create(deviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Cntk);
+
+        // Offset from zero, so that a naive computation of the variance would lose precision.
+        vec in(crow * batchSize);
+        std::generate(begin(in), end(in), [&] { return 10 + 2 * nd(rng); });
+        vec scaleBias(2 * channels);
+        std::generate(begin(scaleBias), end(scaleBias), [&] { return nd(rng); });
+        vec runStats(2 * channels);
+        std::generate(begin(runStats), end(runStats), [&] { return std::abs(nd(rng)) + 1; });
+
+        SingleMatrix x(crow, batchSize, in.data(), deviceId, matrixFlagNormal);
+        SingleMatrix scale(channels, 1, scaleBias.data(), deviceId, matrixFlagNormal);
+        SingleMatrix bias(channels, 1, scaleBias.data() + channels, deviceId, matrixFlagNormal);
+
+        std::stringstream tmsg;
+        tmsg << "inOut tensor: " << (std::string)inOutT << ", batch = " << batchSize << ", spatial = " << (spatial ? "true" : "false");
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        for (const auto& f : factors)
+        {
+            vec runMeanRef(runStats.begin(), runStats.begin() + channels);
+            vec runVarianceRef(runStats.begin() + channels, runStats.end());
+            vec outRef, saveMeanRef, saveInvStdDevRef;
+            ReferenceBatchNormForward(in, spatialSize, channels, batchSize, scaleBias, false, f.first, f.second, eps,
+                                      runMeanRef, runVarianceRef, outRef, saveMeanRef, saveInvStdDevRef);
+
+            SingleMatrix runMean(channels, 1, runStats.data(), deviceId, matrixFlagNormal);
+            SingleMatrix runVariance(channels, 1, runStats.data() + channels, deviceId, matrixFlagNormal);
+            SingleMatrix out(crow, batchSize, deviceId);
+            SingleMatrix saveMean(deviceId);
+            SingleMatrix saveInvStdDev(deviceId);
+            engDirect->Forward(x, scale, bias, false, f.first, f.second, runMean, runVariance, out, eps, saveMean, saveInvStdDev);
+
+            std::string msg = " are not equal, " + tmsg.str() + ", expAvg = " + std::to_string(f.first) + ", blend = " + std::to_string(f.second);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, SingleMatrix(crow, batchSize, outRef.data(), deviceId, matrixFlagNormal), emsg, relErr, absErr * 20), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(runMean, SingleMatrix(channels, 1, runMeanRef.data(), deviceId, matrixFlagNormal), emsg, relErr, absErr), "runMean" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(runVariance, SingleMatrix(channels, 1, runVarianceRef.data(), deviceId, matrixFlagNormal), emsg, relErr, absErr), "runVariance" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveMean, SingleMatrix(channels, 1, saveMeanRef.data(), deviceId, matrixFlagNormal), emsg, relErr, absErr), "saveMean" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveInvStdDev, SingleMatrix(channels, 1, saveInvStdDevRef.data(), deviceId, matrixFlagNormal), emsg, relErr, absErr), "saveInvStdDev" << msg << ". " << emsg);
+        }
+
+        // Inference: a single multiply-add per value, same results as the CNTK engine.
+        SingleMatrix runMean(channels, 1, runStats.data(), deviceId, matrixFlagNormal);
+        SingleMatrix runVariance(channels, 1, runStats.data() + channels, deviceId, matrixFlagNormal);
+        SingleMatrix out(crow, batchSize, deviceId);
+        SingleMatrix outB(crow, batchSize, deviceId);
+        SingleMatrix saveMean(deviceId);
+        SingleMatrix saveInvStdDev(deviceId);
+        engDirect->Forward(x, scale, bias, true, 0, 1, runMean, runVariance, out, eps, saveMean, saveInvStdDev);
+        engCntk->Forward(x, scale, bias, true, 0, 1, runMean, runVariance, outB, eps, saveMean, saveInvStdDev);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr, absErr * 20), "inference out are not equal, " << tmsg.str() << ". " << emsg);
+        BOOST_REQUIRE(saveMean.IsEmpty() && saveInvStdDev.IsEmpty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchNormalizationDirectBackward)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    std::vector<std::tuple<TensorShape, size_t, bool>> configs = {
+        std::make_tuple(TensorShape(17, 6, 1), 13, false),
+        std::make_tuple(TensorShape(300), 40, false),
+        std::make_tuple(TensorShape(11, 11, 13), 11, true),
+        std::make_tuple(TensorShape(40, 30, 3), 5, true) };
+
+    int deviceId = -1;
+    for (const auto& cfg : configs)
+    {
+        const auto& inOutT = std::get<0>(cfg);
+        size_t batchSize = std::get<1>(cfg);
+        bool spatial = std::get<2>(cfg);
+        size_t crow = inOutT.GetNumElements();
+        size_t channels = spatial ? inOutT[inOutT.GetRank() - 1] : crow;
+        size_t spatialSize = crow / channels;
+        size_t sampleSize = crow;
+        double count = (double)spatialSize * batchSize;
+
+        auto eng = BNEng::Create(deviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Direct);
+
+        vec in(crow * batchSize), srcGrad(crow * batchSize);
+        std::generate(begin(in), end(in), [&] { return nd(rng); });
+        std::generate(begin(srcGrad), end(srcGrad), [&] { return nd(rng); });
+        vec scaleData(channels), meanData(channels), invStdDevData(channels);
+        std::generate(begin(scaleData), end(scaleData), [&] { return nd(rng); });
+        std::generate(begin(meanData), end(meanData), [&] { return nd(rng); });
+        std::generate(begin(invStdDevData), end(invStdDevData), [&] { return std::abs(nd(rng)) + 0.5f; });
+
+        SingleMatrix x(crow, batchSize, in.data(), deviceId, matrixFlagNormal);
+        SingleMatrix dy(crow, batchSize, srcGrad.data(), deviceId, matrixFlagNormal);
+        SingleMatrix scale(channels, 1, scaleData.data(), deviceId, matrixFlagNormal);
+        SingleMatrix saveMean(channels, 1, meanData.data(), deviceId, matrixFlagNormal);
+        SingleMatrix saveInvStdDev(channels, 1, invStdDevData.data(), deviceId, matrixFlagNormal);
+
+        for (double blendFactor : { 0.0, 0.5 })
+        {
+            vec dxRef(crow * batchSize), dScaleRef(channels), dBiasRef(channels);
+            for (size_t c = 0; c < channels; c++)
+            {
+                double ds = 0;
+                double db = 0;
+                for (size_t n = 0; n < batchSize; n++)
+                    for (size_t i = 0; i < spatialSize; i++)
+                    {
+                        size_t idx = n * sampleSize + c * spatialSize + i;
+                        ds += srcGrad[idx] * (in[idx] - meanData[c]) * invStdDevData[c];
+                        db += srcGrad[idx];
+                    }
+                dScaleRef[c] = (float)ds;
+                dBiasRef[c] = (float)db;
+                for (size_t n = 0; n < batchSize; n++)
+                    for (size_t i = 0; i < spatialSize; i++)
+                    {
+                        size_t idx = n * sampleSize + c * spatialSize + i;
+                        double xHat = (in[idx] - meanData[c]) * invStdDevData[c];
+                        // Accumulated on top of the gradient of the first call.
+                        dxRef[idx] = (float)(2 * scaleData[c] * invStdDevData[c] * (srcGrad[idx] - (1 - blendFactor) * (xHat * ds + db) / count));
+                    }
+            }
+
+            SingleMatrix dScale(channels, 1, deviceId);
+            SingleMatrix dBias(channels, 1, deviceId);
+            SingleMatrix dx(crow, batchSize, deviceId);
+            dx.SetValue(std::numeric_limits<float>::quiet_NaN());
+            eng->Backward(x, dy, dx, scale, blendFactor, saveMean, saveInvStdDev, dScale, dBias, false);
+            eng->Backward(x, dy, dx, scale, blendFactor, saveMean, saveInvStdDev, dScale, dBias, true);
+
+            std::stringstream tmsg;
+            tmsg << "inOut tensor: " << (std::string)inOutT << ", batch = " << batchSize
+                 << ", spatial = " << (spatial ? "true" : "false") << ", blend = " << blendFactor;
+            std::string msg = " are not equal, " + tmsg.str();
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            std::string emsg;
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dx, SingleMatrix(crow, batchSize, dxRef.data(), deviceId, matrixFlagNormal), emsg, relErr * 16, absErr * 64), "dx" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dScale, SingleMatrix(channels, 1, dScaleRef.data(), deviceId, matrixFlagNormal), emsg, relErr * 88, absErr * 16), "dScale" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dBias, SingleMatrix(channels, 1, dBiasRef.data(), deviceId, matrixFlagNormal), emsg, relErr * 88, absErr * 16), "dBias" << msg << ". " << emsg);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -1215,6 +1215,181 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherFromTarget, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(expect, 1e-6));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTiledLogSumExpOfTransposeProduct, RandomSeedFixture)
+{
+    const size_t hiddenDim = 5, vocabSize = 37, numCols = 4;
+    DMatrix weight = DMatrix::RandomUniform(hiddenDim, vocabSize, -3, 3, IncrementCounter());
+    DMatrix hidden = DMatrix::RandomUniform(hiddenDim, numCols, -3, 3, IncrementCounter());
+    DMatrix scale = DMatrix::RandomUniform(1, numCols, 0, 2, IncrementCounter());
+
+    // reference: from the full logits
+    DMatrix logits;
+    DMatrix::Multiply(weight, true, hidden, false, logits);
+    DMatrix softmax;
+    softmax.AssignLogSoftmaxOf(logits, true);
+    DMatrix expectedLogSumExp(1, numCols);
+    for (size_t j = 0; j < numCols; j++)
+        expectedLogSumExp(0, j) = logits(0, j) - softmax(0, j);
+    softmax.InplaceExp();
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t i = 0; i < vocabSize; i++)
+            softmax(i, j) *= scale(0, j);
+    DMatrix expectedHiddenGradient(hiddenDim, numCols), expectedWeightGradient(hiddenDim, vocabSize);
+    expectedHiddenGradient.SetValue(1);
+    expectedWeightGradient.SetValue(1);
+    DMatrix::MultiplyAndWeightedAdd(1, weight, false, softmax, false, 1, expectedHiddenGradient);
+    DMatrix::MultiplyAndWeightedAdd(1, hidden, false, softmax, true, 1, expectedWeightGradient);
+
+    // tiles that do and do not divide the vocabulary, and a single tile
+    for (size_t tileSize : { 1, 8, 37, 100 })
+    {
+        DMatrix logSumExp;
+        DMatrix::TiledLogSumExpOfTransposeProduct(weight, hidden, tileSize, logSumExp);
+        BOOST_CHECK(logSumExp.IsEqualTo(expectedLogSumExp, 1e-10));
+
+        // gradients are added to
+        DMatrix hiddenGradient(hiddenDim, numCols), weightGradient(hiddenDim, vocabSize);
+        hiddenGradient.SetValue(1);
+        weightGradient.SetValue(1);
+        DMatrix::TiledLogSumExpOfTransposeProductBackprop(weight, hidden, logSumExp, scale, tileSize, &hiddenGradient, &weightGradient);
+        BOOST_CHECK(hiddenGradient.IsEqualTo(expectedHiddenGradient, 1e-10));
+        BOOST_CHECK(weightGradient.IsEqualTo(expectedWeightGradient, 1e-10));
+    }
+}
+
+// Per-sequence Viterbi decoding and forward recursion of SequenceDecoderNode and CRFNode, used as reference
+// for the batched CRF recursions. 'pos' holds the columns of a single sequence.
+static void ReferenceCRFViterbi(const DMatrix& pos, const DMatrix& pair, size_t stt, size_t stp, DMatrix& alpha, DMatrix& decodedPath)
+{
+    size_t numLab = pos.GetNumRows(), numPos = pos.GetNumCols();
+    DMatrix backtrace(numLab, numPos);
+    alpha.Resize(numLab, numPos);
+    size_t iTmp = 0;
+    for (size_t t = 0; t < numPos; t++)
+    {
+        for (size_t k = 0; k < numLab; k++)
+        {
+            double fTmp = LZERO;
+            if (t > 1)
+            {
+                for (size_t j = 0; j < numLab; j++)
+                {
+                    double fAlpha = alpha(j, t - 1) + pair(k, j);
+                    if (fAlpha > fTmp)
+                    {
+                        fTmp = fAlpha;
+                        iTmp = j;
+                    }
+                }
+                fTmp += pos(k, t);
+            }
+            else
+            {
+                iTmp = stt;
+                if (t == 1)
+                    fTmp = alpha(iTmp, t - 1) + pair(k, iTmp) + pos(k, t);
+                else
+                    fTmp = (k == stt) ? pos(k, t) : LZERO;
+            }
+            alpha(k, t) = fTmp;
+            backtrace(k, t) = (double) iTmp;
+        }
+    }
+
+    decodedPath.Resize(numLab, numPos);
+    decodedPath.SetValue(0);
+    size_t lastlbl = stp;
+    decodedPath(lastlbl, numPos - 1) = 1;
+    for (size_t t = numPos - 1; t > 0; t--)
+    {
+        lastlbl = (size_t) backtrace(lastlbl, t);
+        decodedPath(lastlbl, t - 1) = 1;
+    }
+}
+
+static void ReferenceCRFForward(const DMatrix& pos, const DMatrix& pair, size_t firstLbl, DMatrix& alpha)
+{
+    auto logAdd = [](double x, double y) { return x < y ? y + log1p(exp(x - y)) : x + log1p(exp(y - x)); };
+    size_t numLab = pos.GetNumRows(), numPos = pos.GetNumCols();
+    alpha.Resize(numLab, numPos);
+    for (size_t t = 0; t < numPos; t++)
+    {
+        for (size_t k = 0; k < numLab; k++)
+        {
+            double fTmp = LZERO;
+            for (size_t j = 0; j < numLab; j++)
+            {
+                double fAlpha = (j == firstLbl) ? 0.0 : LZERO;
+                if (t > 0)
+                    fAlpha = alpha(j, t - 1);
+                fTmp = logAdd(fTmp, fAlpha + pair(k, j));
+            }
+            alpha(k, t) = fTmp + pos(k, t);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixBatchedCRF, RandomSeedFixture)
+{
+    const size_t numLabels = 7, numChannels = 3, numTimeSteps = 9;
+    // channel 0 holds one sequence, channel 1 two, channel 2 a single frame sequence and one followed by a gap
+    const vector<size_t> uttToChanInd = { 0, 1, 1, 2, 2 };
+    const vector<size_t> uttBeginFrame = { 0, 0, 4, 0, 2 };
+    const vector<size_t> uttFrameNum = { 9, 4, 5, 1, 6 };
+    const vector<size_t> uttStartLabel = { 0, 3, 6, 2, 0 };
+    const vector<size_t> uttEndLabel = { 1, 3, 0, 2, 5 };
+
+    // continuous scores, and small integral ones with many ties
+    for (bool withTies : { false, true })
+    {
+        DMatrix pos = DMatrix::RandomUniform(numLabels, numChannels * numTimeSteps, -3, 3, IncrementCounter());
+        DMatrix pair = DMatrix::RandomUniform(numLabels, numLabels, -3, 3, IncrementCounter());
+        if (withTies)
+        {
+            for (size_t n = 0; n < pos.GetNumElements(); n++)
+                pos.Data()[n] = floor(pos.Data()[n]);
+            for (size_t n = 0; n < pair.GetNumElements(); n++)
+                pair.Data()[n] = floor(pair.Data()[n]);
+        }
+
+        DMatrix alpha, decodedPath, forwardAlpha;
+        DMatrix::CRFViterbiDecode(pos, pair, uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, uttEndLabel, numChannels, alpha, decodedPath);
+        DMatrix::CRFForwardCompute(pos, pair, uttToChanInd, uttBeginFrame, uttFrameNum, uttStartLabel, numChannels, forwardAlpha);
+        BOOST_CHECK_EQUAL(decodedPath.GetNumRows(), numLabels);
+        BOOST_CHECK_EQUAL(decodedPath.GetNumCols(), numChannels * numTimeSteps);
+
+        for (size_t i = 0; i < uttFrameNum.size(); i++)
+        {
+            DMatrix seqPos(numLabels, uttFrameNum[i]);
+            for (size_t t = 0; t < uttFrameNum[i]; t++)
+                seqPos.SetColumn(pos.ColumnSlice((uttBeginFrame[i] + t) * numChannels + uttToChanInd[i], 1), t);
+
+            DMatrix expectedAlpha, expectedPath, expectedForwardAlpha;
+            ReferenceCRFViterbi(seqPos, pair, uttStartLabel[i], uttEndLabel[i], expectedAlpha, expectedPath);
+            ReferenceCRFForward(seqPos, pair, uttStartLabel[i], expectedForwardAlpha);
+
+            for (size_t t = 0; t < uttFrameNum[i]; t++)
+            {
+                size_t j = (uttBeginFrame[i] + t) * numChannels + uttToChanInd[i];
+                for (size_t k = 0; k < numLabels; k++)
+                {
+                    // the paths and Viterbi scores are identical, the forward scores are summed up in a different order
+                    BOOST_CHECK_EQUAL(decodedPath(k, j), expectedPath(k, t));
+                    BOOST_CHECK_EQUAL(alpha(k, j), expectedAlpha(k, t));
+                    BOOST_CHECK_CLOSE(forwardAlpha(k, j), expectedForwardAlpha(k, t), 1e-8);
+                }
+            }
+        }
+
+        // the gap is not decoded
+        for (size_t k = 0; k < numLabels; k++)
+        {
+            BOOST_CHECK_EQUAL(decodedPath(k, 1 * numChannels + 2), 0);
+            BOOST_CHECK_EQUAL(decodedPath(k, 8 * numChannels + 2), 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
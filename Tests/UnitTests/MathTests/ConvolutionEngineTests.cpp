@@ -99,6 +99,9 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Direct engine, CPU only. Falls back to reference engine for geometries it does not support.
+    res.push_back(std::make_tuple((ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Reference), -1, 0));
     return res;
 }
 
@@ -642,6 +645,229 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+// Compares the direct engine with the GEMM engine on CPU, so it runs without a GPU too.
+// Geometries cover each of the direct engine's algorithms: Winograd (3x3, stride 1), pointwise (1x1) and
+// direct convolution (everything else), with output channels that are not a multiple of the weight block size.
+BOOST_AUTO_TEST_CASE(DirectConvolutionVersusGemm)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    std::vector<ConvolveGeometryPtr> geometries;
+    // 3x3, stride 1, same padding.
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(15, 14, 16),
+        TensorShape(3, 3, 16), TensorShape(20), TensorShape(1, 1, 16),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    // 3x3, stride 2, same padding.
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(15, 14, 16),
+        TensorShape(3, 3, 16), TensorShape(32), TensorShape(2, 2, 16),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    // 1x1, stride 2 (ResNet shortcut).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(16, 16, 8),
+        TensorShape(1, 1, 8), TensorShape(12), TensorShape(2, 2, 8),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    // 7x7, stride 2, same padding (ResNet stem).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(32, 32, 3),
+        TensorShape(7, 7, 3), TensorShape(16), TensorShape(2, 2, 3),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    // 5x3, no padding.
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(12, 9, 5),
+        TensorShape(5, 3, 5), TensorShape(9), TensorShape(1, 1, 5),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+
+    int deviceId = -1;
+    for (const auto& g : geometries)
+    {
+        auto directEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+        auto gemmEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Gemm);
+
+        size_t n = 3;
+        size_t crowIn = g->InputShape().GetNumElements();
+        size_t crowOut = g->OutputShape().GetNumElements();
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        size_t kernelSize = g->KernelShape().GetNumElements();
+        auto randomMat = [&](size_t r, size_t c)
+        {
+            vec buf(r * c);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            return SingleMatrix(r, c, buf.data(), deviceId, matrixFlagNormal);
+        };
+
+        SingleMatrix in = randomMat(crowIn, n);
+        SingleMatrix kernel = randomMat(mapCount, kernelSize);
+        SingleMatrix srcGrad = randomMat(crowOut, n);
+        SingleMatrix grad = randomMat(crowIn, n);
+        SingleMatrix gradB(grad.DeepClone(), deviceId);
+        SingleMatrix kernelGrad = randomMat(mapCount, kernelSize);
+        SingleMatrix kernelGradB(kernelGrad.DeepClone(), deviceId);
+        SingleMatrix out(crowOut, n, deviceId);
+        SingleMatrix outB(crowOut, n, deviceId);
+        SingleMatrix workspace(deviceId);
+        SingleMatrix workspaceB(deviceId);
+
+        directEng->Forward(in, kernel, out, workspace);
+        gemmEng->Forward(in, kernel, outB, workspaceB);
+        directEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+        gemmEng->BackwardData(srcGrad, kernel, gradB, true, workspaceB);
+        directEng->BackwardKernel(srcGrad, in, kernelGrad, true, false, workspace);
+        gemmEng->BackwardKernel(srcGrad, in, kernelGradB, true, false, workspaceB);
+
+        std::string msg = " are not equal, Geometry: " + (std::string)(*g);
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr * 4, absErr * 14), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, relErr * 16, absErr * 16), "grad" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradB, emsg, relErr * 192, absErr * 32), "kernelGrad" << msg << ". " << emsg);
+    }
+}
+
+// The direct engine adds the bias and applies the activation while storing the convolution outputs;
+// compares that with a plain forward pass followed by both, for each of its algorithms.
+BOOST_AUTO_TEST_CASE(DirectConvolutionFusedBiasActivation)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    std::vector<ConvolveGeometryPtr> geometries;
+    // 3x3, stride 1, same padding (Winograd).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(15, 14, 16),
+        TensorShape(3, 3, 16), TensorShape(20), TensorShape(1, 1, 16),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+    // 1x1, stride 1 (pointwise).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(9, 7, 8),
+        TensorShape(1, 1, 8), TensorShape(12), TensorShape(1, 1, 8),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+    // 3x3, stride 2, same padding (direct).
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(15, 14, 16),
+        TensorShape(3, 3, 16), TensorShape(20), TensorShape(2, 2, 16),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+
+    std::vector<std::pair<FusedActivationKind, std::function<float(float)>>> activations = {
+        { FusedActivationKind::None, [](float v) { return v; } },
+        { FusedActivationKind::ReLU, [](float v) { return std::max(v, 0.0f); } },
+        { FusedActivationKind::Sigmoid, [](float v) { return 1 / (1 + std::exp(-v)); } },
+        { FusedActivationKind::Tanh, [](float v) { return std::tanh(v); } } };
+
+    int deviceId = -1;
+    for (const auto& g : geometries)
+    {
+        auto eng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+        BOOST_REQUIRE(eng->ImplementsFusedForward());
+
+        size_t n = 3;
+        size_t crowIn = g->InputShape().GetNumElements();
+        size_t crowOut = g->OutputShape().GetNumElements();
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        size_t mapSize = crowOut / mapCount;
+        size_t kernelSize = g->KernelShape().GetNumElements();
+        auto randomMat = [&](size_t r, size_t c)
+        {
+            vec buf(r * c);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            return SingleMatrix(r, c, buf.data(), deviceId, matrixFlagNormal);
+        };
+
+        SingleMatrix in = randomMat(crowIn, n);
+        SingleMatrix kernel = randomMat(mapCount, kernelSize);
+        SingleMatrix bias = randomMat(mapCount, 1);
+        SingleMatrix conv(crowOut, n, deviceId);
+        SingleMatrix workspace(deviceId);
+        eng->Forward(in, kernel, conv, workspace);
+
+        for (const auto& activation : activations)
+        {
+            SingleMatrix out(crowOut, n, deviceId);
+            eng->ForwardFused(in, kernel, bias, activation.first, out, workspace);
+
+            vec buf(crowOut * n);
+            for (size_t i = 0; i < buf.size(); i++)
+                buf[i] = activation.second(conv.Data()[i] + bias.Data()[(i % crowOut) / mapSize]);
+            SingleMatrix expected(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+
+            std::string msg = " are not equal, activation: " + std::to_string((int)activation.first) + ", Geometry: " + (std::string)(*g);
+            std::string emsg;
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, expected, emsg, Err<float>::Rel, Err<float>::Abs), "out" << msg << ". " << emsg);
+        }
+    }
+}
+
+// The reference engine pools 2D inputs on CPU without the index maps of the geometry; compares it with
+// the index map kernels, so it runs without a GPU too.
+BOOST_AUTO_TEST_CASE(DirectPoolingVersusIndexMaps)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    for (const auto& g : GeneratePoolTestConfigs())
+    {
+        for (auto kind : {PoolKind::Max, PoolKind::Average})
+        {
+            for (bool poolIncludePad : {false, true})
+            {
+                auto eng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::Reference, L"", false, poolIncludePad);
+
+                // The maps are owned by the geometry.
+                auto flags = matrixFlagDontOwnBuffer;
+                Matrix<int> mpRowCol(g->MpRowCol().size(), 1, const_cast<int*>(g->MpRowCol().data()), deviceId, flags);
+                Matrix<int> mpRowIndices(g->MpRowIndices().size(), 1, const_cast<int*>(g->MpRowIndices().data()), deviceId, flags);
+                Matrix<int> indices(g->Indices().size(), 1, const_cast<int*>(g->Indices().data()), deviceId, flags);
+
+                size_t n = 5;
+                size_t crowIn = g->InputShape().GetNumElements();
+                size_t crowOut = g->OutputShape().GetNumElements();
+                vec buf(crowIn * n);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                // Ties, so that max pooling gradients depend on which maximum is picked.
+                for (size_t i = 0; i + 1 < buf.size(); i += 3)
+                    buf[i + 1] = buf[i];
+                SingleMatrix in(crowIn, n, buf.data(), deviceId, matrixFlagNormal);
+                buf.resize(crowOut * n);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                SingleMatrix srcGrad(crowOut, n, buf.data(), deviceId, matrixFlagNormal);
+
+                SingleMatrix out(crowOut, n, deviceId);
+                SingleMatrix outB(crowOut, n, deviceId);
+                SingleMatrix grad(crowIn, n, deviceId);
+                SingleMatrix gradB(crowIn, n, deviceId);
+                grad.SetValue(1);
+                gradB.SetValue(1);
+
+                eng->ForwardPooling(in, out);
+                eng->BackwardPooling(out, srcGrad, in, grad, true);
+                if (kind == PoolKind::Max)
+                {
+                    in.MaxPoolingForward(mpRowCol, mpRowIndices, indices, outB);
+                    srcGrad.MaxPoolingBackward(outB, in, mpRowCol, mpRowIndices, indices, gradB, true);
+                }
+                else
+                {
+                    in.AveragePoolingForward(mpRowCol, mpRowIndices, indices, outB, poolIncludePad);
+                    srcGrad.AveragePoolingBackward(mpRowCol, mpRowIndices, indices, gradB, poolIncludePad, true);
+                }
+
+                std::stringstream tmsg;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", IncludePad: " << poolIncludePad;
+                std::string msg = " are not equal, " + tmsg.str();
+                std::string emsg;
+
+                BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, 0.0f, 0.0f), "out" << msg << ". " << emsg);
+                BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel, Err<float>::Abs), "grad" << msg << ". " << emsg);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(Half_ConvolutionSuite)
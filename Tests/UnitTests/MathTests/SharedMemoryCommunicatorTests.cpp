@@ -0,0 +1,161 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Common/Include/SharedMemoryCommunicator.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+#ifndef _WIN32
+
+// Runs 'body' in 'numRanks' forked processes that share one communicator. A rank reports failure through its exit code.
+// Small slots and mailboxes make every collective and message span several chunks.
+static void RunRanks(size_t numRanks, const std::function<bool(SharedMemoryCommunicator&)>& body)
+{
+    std::string name = "cntk-shm-test-" + std::to_string(getpid());
+    std::vector<pid_t> children;
+    for (size_t rank = 0; rank < numRanks; ++rank)
+    {
+        pid_t pid = fork();
+        BOOST_REQUIRE(pid >= 0);
+        if (pid == 0)
+        {
+            int exitCode = 1;
+            try
+            {
+                SharedMemoryCommunicator comm(name, rank, numRanks, 4096, 256);
+                exitCode = body(comm) ? 0 : 2;
+            }
+            catch (...)
+            {
+            }
+            _exit(exitCode);
+        }
+        children.push_back(pid);
+    }
+
+    for (size_t rank = 0; rank < numRanks; ++rank)
+    {
+        int status = 0;
+        BOOST_REQUIRE(waitpid(children[rank], &status, 0) == children[rank]);
+        BOOST_CHECK_MESSAGE(WIFEXITED(status) && WEXITSTATUS(status) == 0, "rank " << rank << " failed");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(SharedMemoryCommunicatorSuite)
+
+BOOST_AUTO_TEST_CASE(AllReduce)
+{
+    const size_t numRanks = 4;
+    RunRanks(numRanks, [](SharedMemoryCommunicator& comm)
+    {
+        // not a multiple of the slot size, nor of the stripe granularity
+        const size_t count = 3 * 1024 + 7;
+        std::vector<double> sum(count), max(count);
+        std::vector<int> min(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum[i] = (double)(i * (comm.Rank() + 1));
+            max[i] = (double)((i + comm.Rank()) % numRanks);
+            min[i] = (int)(comm.Rank() * i);
+        }
+
+        size_t reducedElements = 0;
+        comm.AllReduce<double>(sum.data(), count, SharedMemoryCommunicator::ReduceOp::Sum, [&](double*, size_t n) { reducedElements += n; });
+        comm.AllReduce<double>(max.data(), count, SharedMemoryCommunicator::ReduceOp::Max);
+        comm.AllReduce<int>(min.data(), count, SharedMemoryCommunicator::ReduceOp::Min);
+
+        // the stripes of all ranks cover each element exactly once
+        size_t totalReducedElements = reducedElements;
+        comm.AllReduce<size_t>(&totalReducedElements, 1, SharedMemoryCommunicator::ReduceOp::Sum);
+
+        bool ok = totalReducedElements == count;
+        for (size_t i = 0; i < count; ++i)
+            ok = ok && sum[i] == (double)(i * numRanks * (numRanks + 1) / 2) && max[i] == (double)(numRanks - 1) && min[i] == 0;
+        return ok;
+    });
+}
+
+BOOST_AUTO_TEST_CASE(BroadcastAndGather)
+{
+    const size_t numRanks = 3;
+    RunRanks(numRanks, [](SharedMemoryCommunicator& comm)
+    {
+        const size_t count = 2500;
+        std::vector<float> data(count, comm.Rank() == 1 ? 0.0f : -1.0f);
+        if (comm.Rank() == 1)
+            for (size_t i = 0; i < count; ++i)
+                data[i] = (float)i;
+        comm.Broadcast(data.data(), count * sizeof(float), 1);
+
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i)
+            ok = ok && data[i] == (float)i;
+
+        std::vector<int> gathered(numRanks * count);
+        std::vector<int> mine(count, (int)comm.Rank());
+        comm.AllGather(mine.data(), count * sizeof(int), gathered.data());
+        for (size_t i = 0; i < gathered.size(); ++i)
+            ok = ok && gathered[i] == (int)(i / count);
+
+        // rank r contributes r + 1 thousand chars
+        std::vector<char> send((comm.Rank() + 1) * 1000, (char)('a' + comm.Rank()));
+        std::vector<size_t> offsets = { 0, 1000, 3000 };
+        std::vector<char> recv(6000, 0);
+        comm.Gatherv(send.data(), send.size(), recv.data(), offsets.data(), 0);
+        if (comm.Rank() == 0)
+            for (size_t i = 0; i < recv.size(); ++i)
+                ok = ok && recv[i] == (char)('a' + (i < 1000 ? 0 : i < 3000 ? 1 : 2));
+        return ok;
+    });
+}
+
+BOOST_AUTO_TEST_CASE(PointToPoint)
+{
+    const size_t numRanks = 2;
+    RunRanks(numRanks, [](SharedMemoryCommunicator& comm)
+    {
+        // Messages are much larger than the mailboxes, both ranks send before receiving, and
+        // receives are posted in a different order than the sends.
+        const size_t count = 5000;
+        size_t peer = 1 - comm.Rank();
+        std::vector<int> first(count), second(count), recvFirst(count, -1), recvSecond(count, -1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            first[i] = (int)(comm.Rank() * count + i);
+            second[i] = -first[i];
+        }
+
+        SharedMemoryCommunicator::RequestId requests[4];
+        requests[0] = comm.Isend(first.data(), count * sizeof(int), peer, 1);
+        requests[1] = comm.Isend(second.data(), count * sizeof(int), peer, 2);
+        requests[2] = comm.Irecv(recvSecond.data(), count * sizeof(int), peer, 2);
+        requests[3] = comm.Irecv(recvFirst.data(), count * sizeof(int), peer, 1);
+
+        size_t completed = 0;
+        size_t index;
+        while ((index = comm.WaitAny(requests, 4)) != SIZE_MAX)
+        {
+            requests[index] = 0;
+            ++completed;
+        }
+
+        bool ok = completed == 4;
+        for (size_t i = 0; i < count; ++i)
+            ok = ok && recvFirst[i] == (int)(peer * count + i) && recvSecond[i] == -(int)(peer * count + i);
+        return ok;
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
+
+}}}}
@@ -0,0 +1,211 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the compiled-plan cache of ComputationNetworkPlanCache.cpp: networks compiled from a cached plan must
+// evaluate like the network the plan was recorded from, and networks that do not match a plan must be compiled from scratch.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "Globals.h"
+#include "TestHelpers.h"
+#include <boost/filesystem.hpp>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct CompiledPlanCacheFixture
+{
+    CompiledPlanCacheFixture()
+    {
+        Globals::SetCompiledPlanCaching(true);
+        ComputationNetwork::ClearCompiledPlans();
+    }
+
+    ~CompiledPlanCacheFixture()
+    {
+        Globals::SetCompiledPlanCaching(false);
+        ComputationNetwork::ClearCompiledPlans();
+    }
+};
+
+static const size_t c_inputDim = 4;
+static const size_t c_hiddenDim = 5;
+static const size_t c_outputDim = 3;
+
+// x [inputDim] -> h = Tanh(W x + R PastValue(h) + b) [5] -> z = V h [3] -> out = RowSlice(z, 0, numOutputRows)
+// All node names start with 'prefix', such that networks built with different prefixes are clones of each other.
+static ComputationNetworkPtr CreateRecurrentNetwork(unsigned int seed, const wstring& prefix, size_t inputDim = c_inputDim, size_t numOutputRows = c_outputDim)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(prefix + L"x", TensorShape(inputDim));
+    auto w = CreateRandomParameter(builder, prefix + L"W", TensorShape(c_hiddenDim, inputDim), rng);
+    auto r = CreateRandomParameter(builder, prefix + L"R", TensorShape(c_hiddenDim, c_hiddenDim), rng);
+    auto b = CreateRandomParameter(builder, prefix + L"b", TensorShape(c_hiddenDim), rng);
+    auto v = CreateRandomParameter(builder, prefix + L"V", TensorShape(c_outputDim, c_hiddenDim), rng);
+
+    // the input of the delay is replaced by h once h exists
+    auto delay = builder.PastValue(x, 0.1f, c_hiddenDim, 1, prefix + L"delay");
+    auto wx = builder.Times(w, x, 1, prefix + L"wx");
+    auto rh = builder.Times(r, delay, 1, prefix + L"rh");
+    auto sum = builder.Plus(builder.Plus(wx, rh, prefix + L"sum"), b, prefix + L"sumb");
+    auto h = builder.Tanh(sum, prefix + L"h");
+    static_pointer_cast<ComputationNodeBase>(delay)->SetInput(0, h);
+    auto z = builder.Times(v, h, 1, prefix + L"z");
+    auto out = builder.RowSlice(z, 0, numOutputRows, prefix + L"out");
+
+    net->AddToNodeGroup(L"output", out);
+    net->CompileNetwork();
+    return net;
+}
+
+// two sequences of 3 steps each
+static MBLayoutPtr SequenceLayout()
+{
+    auto layout = make_shared<MBLayout>();
+    layout->Init(2, 3);
+    layout->AddSequence(0, 0, 0, 3);
+    layout->AddSequence(1, 1, 0, 3);
+    return layout;
+}
+
+static vector<float> EvaluateRecurrentNetwork(const ComputationNetworkPtr& net, const wstring& prefix, size_t inputDim = c_inputDim)
+{
+    auto layout = SequenceLayout();
+    mt19937 rng(7);
+    uniform_real_distribution<float> distribution(-1, 1);
+    vector<float> x(inputDim * layout->GetNumCols());
+    for (auto& value : x)
+        value = distribution(rng);
+    return EvaluateNetwork<float>(net, { prefix + L"out" }, layout, { { prefix + L"x", x } })[0];
+}
+
+// names of the nodes in global evaluation order, without the given prefix
+static vector<wstring> EvalOrderOf(const ComputationNetworkPtr& net, const wstring& prefix)
+{
+    vector<wstring> names;
+    for (const auto& node : net->GetEvalOrder(nullptr))
+        names.push_back(node->NodeName().substr(prefix.size()));
+    return names;
+}
+
+static void CheckOutputsAreEqual(const vector<float>& expected, const vector<float>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_CHECK_EQUAL(expected[i], actual[i]);
+}
+
+BOOST_FIXTURE_TEST_SUITE(CompiledPlanCacheTests, CompiledPlanCacheFixture)
+
+BOOST_AUTO_TEST_CASE(CompiledPlanIsUsedByClone)
+{
+    auto net = CreateRecurrentNetwork(1, L"");
+    BOOST_CHECK(net->HasCompiledPlan());
+    BOOST_CHECK(!net->IsCompiledFromPlan());
+    auto expected = EvaluateRecurrentNetwork(net, L"");
+    BOOST_CHECK(!net->IsAllocationPlanReplayed());
+
+    auto clone = CreateRecurrentNetwork(1, L"clone.");
+    BOOST_CHECK(clone->IsCompiledFromPlan());
+    auto actual = EvaluateRecurrentNetwork(clone, L"clone.");
+    BOOST_CHECK(clone->IsAllocationPlanReplayed());
+
+    BOOST_CHECK(EvalOrderOf(net, L"") == EvalOrderOf(clone, L"clone."));
+    CheckOutputsAreEqual(expected, actual);
+}
+
+BOOST_AUTO_TEST_CASE(CompiledPlanIsUsedAfterReload)
+{
+    const wstring modelFileName = L"CompiledPlanIsUsedAfterReload.dnn";
+    auto net = CreateRecurrentNetwork(2, L"");
+    auto expected = EvaluateRecurrentNetwork(net, L"");
+    net->Save(modelFileName);
+
+    auto reloaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelFileName);
+    BOOST_CHECK(reloaded->IsCompiledFromPlan());
+    auto actual = EvaluateRecurrentNetwork(reloaded, L"");
+    BOOST_CHECK(reloaded->IsAllocationPlanReplayed());
+
+    BOOST_CHECK(EvalOrderOf(net, L"") == EvalOrderOf(reloaded, L""));
+    CheckOutputsAreEqual(expected, actual);
+
+    boost::filesystem::remove(modelFileName);
+    boost::filesystem::remove(ComputationNetwork::CompiledPlanFileName(modelFileName));
+}
+
+BOOST_AUTO_TEST_CASE(CompiledPlanFileRoundTrip)
+{
+    const wstring modelFileName = L"CompiledPlanFileRoundTrip.dnn";
+    const wstring planFileName = ComputationNetwork::CompiledPlanFileName(modelFileName);
+    auto net = CreateRecurrentNetwork(3, L"");
+    auto expected = EvaluateRecurrentNetwork(net, L"");
+    net->Save(modelFileName);
+    BOOST_REQUIRE(boost::filesystem::exists(planFileName));
+
+    // without the plan file, a new process compiles the model from scratch
+    auto planFileCopy = planFileName + L".copy";
+    boost::filesystem::rename(planFileName, planFileCopy);
+    ComputationNetwork::ClearCompiledPlans();
+    auto withoutPlan = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelFileName);
+    BOOST_CHECK(!withoutPlan->IsCompiledFromPlan());
+
+    // with it, the model is compiled from the plan that was saved, including the buffer assignment
+    boost::filesystem::rename(planFileCopy, planFileName);
+    ComputationNetwork::ClearCompiledPlans();
+    auto withPlan = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelFileName);
+    BOOST_CHECK(withPlan->IsCompiledFromPlan());
+    auto actual = EvaluateRecurrentNetwork(withPlan, L"");
+    BOOST_CHECK(withPlan->IsAllocationPlanReplayed());
+
+    BOOST_CHECK(EvalOrderOf(net, L"") == EvalOrderOf(withPlan, L""));
+    CheckOutputsAreEqual(expected, actual);
+
+    boost::filesystem::remove(modelFileName);
+    boost::filesystem::remove(planFileName);
+}
+
+BOOST_AUTO_TEST_CASE(CompiledPlanIsNotUsedForOtherShapes)
+{
+    CreateRecurrentNetwork(4, L"");
+
+    auto other = CreateRecurrentNetwork(4, L"other.", c_inputDim + 2);
+    BOOST_CHECK(!other->IsCompiledFromPlan());
+    auto actual = EvaluateRecurrentNetwork(other, L"other.", c_inputDim + 2);
+    BOOST_CHECK(!other->IsAllocationPlanReplayed());
+
+    Globals::SetCompiledPlanCaching(false);
+    auto reference = CreateRecurrentNetwork(4, L"reference.", c_inputDim + 2);
+    auto expected = EvaluateRecurrentNetwork(reference, L"reference.", c_inputDim + 2);
+    CheckOutputsAreEqual(expected, actual);
+}
+
+// Node attributes are not part of the key of a plan. A network that differs from the plan only in an attribute,
+// here the number of rows of the slice, finds the plan but must fall back to full validation.
+BOOST_AUTO_TEST_CASE(CompiledPlanFallsBackToFullValidation)
+{
+    CreateRecurrentNetwork(5, L"", c_inputDim, c_outputDim);
+
+    auto other = CreateRecurrentNetwork(5, L"other.", c_inputDim, c_outputDim - 1);
+    BOOST_CHECK(!other->IsCompiledFromPlan());
+    BOOST_CHECK_EQUAL(other->GetNodeFromName(L"other.out")->GetSampleLayout().GetNumElements(), c_outputDim - 1);
+    auto actual = EvaluateRecurrentNetwork(other, L"other.");
+    BOOST_CHECK(!other->IsAllocationPlanReplayed());
+
+    Globals::SetCompiledPlanCaching(false);
+    auto reference = CreateRecurrentNetwork(5, L"reference.", c_inputDim, c_outputDim - 1);
+    auto expected = EvaluateRecurrentNetwork(reference, L"reference.");
+    CheckOutputsAreEqual(expected, actual);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "EvaluationNodes.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -44,6 +45,107 @@ BOOST_AUTO_TEST_CASE(ComputeEditDistanceErrorTest)
     assert((int)ed == 1);
 }
 
+// Number of errors along the path of the full DP, as computed by the original implementation of the node.
+static size_t ReferenceEditErrors(const vector<int>& first, const vector<int>& second, float subPen, float delPen, float insPen)
+{
+    size_t n = first.size(), m = second.size();
+    vector<vector<float>> grid(n + 1, vector<float>(m + 1));
+    vector<vector<size_t>> errors(n + 1, vector<size_t>(m + 1));
+    for (size_t i = 0; i <= n; i++)
+    {
+        grid[i][0] = (float)(i * delPen);
+        errors[i][0] = i;
+    }
+    for (size_t j = 0; j <= m; j++)
+    {
+        grid[0][j] = (float)(j * insPen);
+        errors[0][j] = j;
+    }
+    for (size_t i = 1; i <= n; i++)
+    {
+        for (size_t j = 1; j <= m; j++)
+        {
+            float del = grid[i - 1][j] + delPen, ins = grid[i][j - 1] + insPen, sub = grid[i - 1][j - 1] + subPen;
+            if (first[i - 1] == second[j - 1])
+            {
+                grid[i][j] = grid[i - 1][j - 1];
+                errors[i][j] = errors[i - 1][j - 1];
+            }
+            else if (sub <= del && sub <= ins)
+            {
+                grid[i][j] = sub;
+                errors[i][j] = errors[i - 1][j - 1] + 1;
+            }
+            else if (del < ins)
+            {
+                grid[i][j] = del;
+                errors[i][j] = errors[i - 1][j] + 1;
+            }
+            else
+            {
+                grid[i][j] = ins;
+                errors[i][j] = errors[i][j - 1] + 1;
+            }
+        }
+    }
+    return errors[n][m];
+}
+
+BOOST_AUTO_TEST_CASE(ComputeEditDistanceErrorParallelSequencesTest)
+{
+    // two parallel sequences holding sequences of 150 and 40 + 110 frames; long enough for several bit vector words
+    // and for the DP band to be widened
+    const size_t numParallelSequences = 2, numTimeSteps = 150, numLabels = 5;
+    const vector<vector<size_t>> sequenceBounds = { { 0, 0, 150 }, { 1, 0, 40 }, { 1, 40, 150 } };
+    MBLayoutPtr pMBLayout = make_shared<MBLayout>(numParallelSequences, numTimeSteps, L"X");
+    for (size_t i = 0; i < sequenceBounds.size(); i++)
+        pMBLayout->AddSequence(i, sequenceBounds[i][0], sequenceBounds[i][1], sequenceBounds[i][2]);
+
+    std::mt19937 rng(1);
+    Matrix<float> firstSeq(CPUDEVICE);
+    Matrix<float> secondSeq(CPUDEVICE);
+    firstSeq.Resize(1, numParallelSequences * numTimeSteps);
+    secondSeq.Resize(1, numParallelSequences * numTimeSteps);
+    for (size_t j = 0; j < numParallelSequences * numTimeSteps; j++)
+    {
+        firstSeq(0, j) = (float)(rng() % numLabels);
+        // mostly the same labels, the second half of the first sequence shifted by one frame
+        size_t k = (j % numParallelSequences == 0 && j / numParallelSequences >= 75) ? j - numParallelSequences : j;
+        secondSeq(0, j) = (rng() % 4 == 0) ? (float)(rng() % numLabels) : firstSeq(0, k);
+    }
+
+    unique_ptr<EditDistanceErrorNode<float>> pEDNode(new EditDistanceErrorNode<float>(-1, L"ednode"));
+    const vector<vector<float>> penalties = { { 1, 1, 1 }, { 2, 2, 2 }, { 1, 2, 3 }, { 3, 1, 1 }, { 0.5f, 1, 0.25f } };
+    for (bool squashInputs : { false, true })
+    {
+        vector<size_t> tokensToIgnore = { 4 };
+        for (const auto& penalty : penalties)
+        {
+            size_t numErrors = 0, numSamples = 0;
+            for (const auto& bounds : sequenceBounds)
+            {
+                // repeated samples are squashed before the ignored ones are removed
+                vector<int> first, second;
+                for (auto seq : { make_pair(&firstSeq, &first), make_pair(&secondSeq, &second) })
+                {
+                    for (size_t t = bounds[1]; t < bounds[2]; t++)
+                    {
+                        int sample = (int)(*seq.first)(0, t * numParallelSequences + bounds[0]);
+                        bool isRepeated = t > bounds[1] && sample == (int)(*seq.first)(0, (t - 1) * numParallelSequences + bounds[0]);
+                        if (sample != (int)tokensToIgnore[0] && !(squashInputs && isRepeated))
+                            seq.second->push_back(sample);
+                    }
+                }
+                numErrors += ReferenceEditErrors(first, second, penalty[0], penalty[1], penalty[2]);
+                numSamples += first.size();
+            }
+
+            float ed = pEDNode->ComputeEditDistanceError(firstSeq, secondSeq, pMBLayout, penalty[0], penalty[1], penalty[2], squashInputs, tokensToIgnore);
+            BOOST_CHECK_EQUAL(ed, (float)numErrors * (numParallelSequences * numTimeSteps) / numSamples);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
\ No newline at end of file
@@ -0,0 +1,158 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of FusedConvolutionNode: its value and the gradients of the kernel, the bias and the input must match the ones
+// of Convolution -> Plus(bias) -> activation, on networks built from the same random seed.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "ConvolutionalNodes.h"
+#include "TestHelpers.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const float c_fusedConvolutionTolerance = 1e-4f;
+
+static const size_t c_numSamples = 3;
+
+// e [numSamples] -> x = Times(U, e) [5 x 5 x 2] -> y = activation(Convolution(W, x) + b) [5 x 5 x 4] -> ce = SquareError(target, y)
+// e holds a different unit vector for each sample, such that the gradient of U holds the gradient of x of each sample.
+static ComputationNetworkPtr CreateConvolutionNetwork(bool fused, FusedActivationKind activation)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(5);
+
+    auto e = builder.CreateInputNode(L"e", TensorShape(c_numSamples));
+    auto target = builder.CreateInputNode(L"target", TensorShape(5, 5, 4));
+    auto u = CreateRandomParameter(builder, L"U", TensorShape(5, 5, 2, c_numSamples), rng);
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(3, 3, 2, 4), rng);
+    auto b = CreateRandomParameter(builder, L"b", TensorShape(1, 1, 4), rng);
+    auto x = builder.Times(u, e, 3, L"x");
+
+    shared_ptr<ComputationNode<float>> y;
+    if (fused)
+    {
+        y = New<FusedConvolutionNode<float>>(CPUDEVICE, L"y", TensorShape(3, 3, 2), TensorShape(4), TensorShape(1, 1, 2),
+                                             vector<bool>{ true }, vector<bool>{ true, true, false }, TensorShape(0), TensorShape(0),
+                                             /*maxTempMemSizeInSamples=*/0, activation);
+        net->AddNodeToNetAndAttachInputs(y, { w, x, b });
+    }
+    else
+    {
+        auto conv = builder.Convolution(w, x, TensorShape(3, 3, 2), TensorShape(4), TensorShape(1, 1, 2), { true }, { true, true, false },
+                                        TensorShape(0), TensorShape(0), /*transpose=*/false, TensorShape(0), ImageLayoutKind::CHW,
+                                        /*maxTempMemSizeInSamples=*/0, L"conv");
+        y = builder.Plus(conv, b, L"plus");
+        switch (activation)
+        {
+        case FusedActivationKind::ReLU:    y = builder.RectifiedLinear(y, L"y"); break;
+        case FusedActivationKind::Sigmoid: y = builder.Sigmoid(y, L"y"); break;
+        case FusedActivationKind::Tanh:    y = builder.Tanh(y, L"y"); break;
+        default: break;
+        }
+    }
+
+    net->AddToNodeGroup(L"criterion", builder.SquareError(target, y, L"ce"));
+    net->CompileNetwork();
+    return net;
+}
+
+static vector<float> ValuesOf(const Matrix<float>& matrix)
+{
+    vector<float> values(matrix.GetNumElements());
+    float* data = values.data();
+    size_t size = values.size();
+    matrix.CopyToArray(data, size);
+    return values;
+}
+
+// runs one forward and backward pass of ce
+// Returns the value of ce and the gradients of W, b and U.
+static vector<vector<float>> EvaluateConvolutionNetwork(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto ce = net->GetNodeFromName(L"ce");
+    net->AllocateAllMatrices({}, {}, ce);
+    net->StartEvaluateMinibatchLoop(ce);
+
+    auto layout = make_shared<MBLayout>();
+    layout->InitAsFrameMode(c_numSamples);
+    net->GetMBLayoutPtrOfNetwork()->CopyFrom(layout, /*keepName=*/true);
+
+    vector<float> eValues(c_numSamples * c_numSamples, 0);
+    for (size_t s = 0; s < c_numSamples; s++)
+        eValues[s * c_numSamples + s] = 1;
+    mt19937 rng(17);
+    uniform_real_distribution<float> distribution(-1, 1);
+    vector<float> targetValues(5 * 5 * 4 * c_numSamples);
+    for (auto& value : targetValues)
+        value = distribution(rng);
+
+    auto e = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"e"));
+    auto target = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"target"));
+    e->Value().SetValue(c_numSamples, c_numSamples, e->GetDeviceId(), eValues.data());
+    target->Value().SetValue(5 * 5 * 4, c_numSamples, target->GetDeviceId(), targetValues.data());
+    ComputationNetwork::BumpEvalTimeStamp({ e, target });
+
+    net->ForwardProp(ce);
+    net->Backprop(ce);
+
+    vector<vector<float>> results = { ValuesOf(dynamic_pointer_cast<ComputationNode<float>>(ce)->Value()) };
+    for (const auto& name : { L"W", L"b", L"U" })
+        results.push_back(ValuesOf(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Gradient()));
+    return results;
+}
+
+// The direct engine, which only runs if enabled, implements the fused forward pass; the others run the fallback.
+static void CheckFusedConvolutionMatchesReference(FusedActivationKind activation)
+{
+    for (bool directConvolution : { false, true })
+    {
+        Globals::SetDirectConvolution(directConvolution);
+        auto expected = EvaluateConvolutionNetwork(CreateConvolutionNetwork(false, activation));
+        auto actual = EvaluateConvolutionNetwork(CreateConvolutionNetwork(true, activation));
+        Globals::SetDirectConvolution(false);
+
+        BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            BOOST_REQUIRE_EQUAL(expected[i].size(), actual[i].size());
+            BOOST_CHECK_MESSAGE(AreEqual(expected[i].data(), actual[i].data(), expected[i].size(), c_fusedConvolutionTolerance),
+                                "result " << i << " differs, direct convolution " << directConvolution);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(FusedConvolutionTests)
+
+BOOST_AUTO_TEST_CASE(FusedConvolutionReLU)
+{
+    CheckFusedConvolutionMatchesReference(FusedActivationKind::ReLU);
+}
+
+BOOST_AUTO_TEST_CASE(FusedConvolutionSigmoid)
+{
+    CheckFusedConvolutionMatchesReference(FusedActivationKind::Sigmoid);
+}
+
+BOOST_AUTO_TEST_CASE(FusedConvolutionTanh)
+{
+    CheckFusedConvolutionMatchesReference(FusedActivationKind::Tanh);
+}
+
+BOOST_AUTO_TEST_CASE(FusedConvolutionWithoutActivation)
+{
+    CheckFusedConvolutionMatchesReference(FusedActivationKind::None);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
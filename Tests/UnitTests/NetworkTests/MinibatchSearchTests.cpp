@@ -0,0 +1,187 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the throughput search of adaptive minibatch sizing (AutoAdjust/minibatchSearchByThroughput): it must not
+// measure or choose sizes whose MatrixPool allocation exceeds the memory cap, and must choose the fastest size that fits.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "DataReaderHelpers.h"
+#include "SGD.h"
+#include "TestHelpers.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// reader that returns minibatches of random values in frame mode, of the size the minibatch loop was started with
+class RandomDataReader : public IDataReader
+{
+public:
+    using IDataReader::StartMinibatchLoop;
+
+    virtual void Init(const ConfigParameters&) override {}
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override {}
+    virtual void Destroy() override {}
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples*/ = requestDataSize) override
+    {
+        m_mbSize = mbSize;
+    }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        for (auto& input : matrices)
+        {
+            auto& matrix = input.second.GetMatrix<float>();
+            matrix.Resize(input.second.sampleLayout.GetNumElements(), m_mbSize);
+            matrix.SetUniformRandomValue(-1, 1, (unsigned long) m_minibatchSizesRead.size() + 1);
+            input.second.pMBLayout->InitAsFrameMode(m_mbSize);
+        }
+        m_minibatchSizesRead.push_back(m_mbSize);
+        return true;
+    }
+
+    virtual size_t GetNumParallelSequencesForFixingBPTTMode() override
+    {
+        return 1;
+    }
+
+    vector<size_t> m_minibatchSizesRead;
+
+private:
+    size_t m_mbSize = 0;
+};
+
+// exposes the throughput search, and the memory cap that is otherwise configured in MB
+class MinibatchSearchSGD : public SGD<float>
+{
+public:
+    MinibatchSearchSGD(const ConfigParameters& config)
+        : SGD<float>(config)
+    {
+    }
+
+    using SGD<float>::SearchForFastestMinibatchSize;
+
+    void SetMemoryCap(size_t memoryCapInBytes)
+    {
+        m_minibatchSearchMemoryCap = memoryCapInBytes;
+    }
+};
+
+static const wstring c_modelPath = L"MinibatchSearch/model.dnn";
+static const int c_epochNumber = 1;
+
+// x [32] -> z = Times(W, x) + b [16] -> ce = SquareError(target, z)
+static ComputationNetworkPtr CreateMinibatchSearchNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(7);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(32));
+    auto target = builder.CreateInputNode(L"target", TensorShape(16));
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(16, 32), rng);
+    auto b = CreateRandomParameter(builder, L"b", TensorShape(16), rng);
+    auto z = builder.Plus(builder.Times(w, x, 1, L"Wx"), b, L"z");
+
+    net->AddToNodeGroup(L"feature", x);
+    net->AddToNodeGroup(L"label", target);
+    net->AddToNodeGroup(L"criterion", builder.SquareError(target, z, L"ce"));
+    net->CompileNetwork();
+    return net;
+}
+
+// map from minibatch size to the memory in bytes of the measurements stored next to the model
+static map<size_t, size_t> ReadMeasuredMemory()
+{
+    map<size_t, size_t> memory;
+    FILE* f = fopenOrDie(c_modelPath + L".mbThroughput", L"r");
+    unsigned long long minibatchSize, memoryInBytes;
+    double secondsPerSample;
+    while (fscanf(f, "%llu %lf %llu", &minibatchSize, &secondsPerSample, &memoryInBytes) == 3)
+        memory[(size_t) minibatchSize] = (size_t) memoryInBytes;
+    fcloseOrDie(f);
+    return memory;
+}
+
+static void WriteMeasurements(const map<size_t, pair<double, size_t>>& measurements)
+{
+    FILE* f = fopenOrDie(c_modelPath + L".mbThroughput", L"w");
+    for (const auto& measurement : measurements)
+        fprintfOrDie(f, "%llu %.9g %llu\n", (unsigned long long) measurement.first, measurement.second.first, (unsigned long long) measurement.second.second);
+    fcloseOrDie(f);
+}
+
+BOOST_AUTO_TEST_SUITE(MinibatchSearchTests)
+
+// The trial sizes between 64 and 256 are 64, 128, 192 and 256.
+BOOST_AUTO_TEST_CASE(MinibatchSearchRespectsMemoryCap)
+{
+    ConfigParameters config;
+    config.Parse("modelPath=" + string(c_modelPath.begin(), c_modelPath.end()) + "\nlearningRatesPerSample=0.01\nmaxEpochs=2");
+    MinibatchSearchSGD sgd(config);
+
+    auto net = CreateMinibatchSearchNetwork();
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto ce = net->GetNodeFromName(L"ce");
+    auto x = net->GetNodeFromName(L"x");
+    auto target = net->GetNodeFromName(L"target");
+    net->AllocateAllMatrices({}, {}, ce);
+    net->Save(sgd.GetModelNameForEpoch(c_epochNumber - 1));
+    _wunlink((c_modelPath + L".mbThroughput").c_str());
+
+    // the pooled matrices that scale with the minibatch hold at least the value of z
+    size_t bytes64 = net->GetPooledMatrixBytes(64);
+    size_t bytes128 = net->GetPooledMatrixBytes(128);
+    size_t bytes192 = net->GetPooledMatrixBytes(192);
+    size_t bytes256 = net->GetPooledMatrixBytes(256);
+    BOOST_REQUIRE_GE(bytes128 - bytes64, 64 * 16 * sizeof(float));
+    BOOST_REQUIRE_LT(bytes128, bytes192);
+    BOOST_REQUIRE_LT(bytes192, bytes256);
+
+    auto inputMatrices = DataReaderHelpers::RetrieveInputMatrices({ x, target });
+    auto search = [&](RandomDataReader& reader)
+    {
+        return sgd.SearchForFastestMinibatchSize(net, c_epochNumber, &reader, { x }, { target }, { ce }, &inputMatrices, 64, 256);
+    };
+
+    // Only the sizes that fit are measured; their memory is the one of the MatrixPool allocation.
+    sgd.SetMemoryCap((bytes128 + bytes192) / 2);
+    RandomDataReader reader;
+    size_t chosenMinibatchSize = search(reader);
+    BOOST_CHECK(chosenMinibatchSize == 64 || chosenMinibatchSize == 128);
+    BOOST_CHECK(!reader.m_minibatchSizesRead.empty());
+    for (auto minibatchSize : reader.m_minibatchSizesRead)
+        BOOST_CHECK_LE(minibatchSize, 128u);
+    auto measuredMemory = ReadMeasuredMemory();
+    BOOST_REQUIRE_EQUAL(measuredMemory.size(), 2u);
+    BOOST_CHECK_EQUAL(measuredMemory[64], bytes64);
+    BOOST_CHECK_EQUAL(measuredMemory[128], bytes128);
+
+    // With known measurements, the fastest size within the cap is chosen without reading any data.
+    WriteMeasurements({ { 64, { 3e-6, bytes64 } }, { 128, { 1e-6, bytes128 } }, { 192, { 0.5e-6, bytes192 } }, { 256, { 2e-6, bytes256 } } });
+    RandomDataReader cachedReader;
+    BOOST_CHECK_EQUAL(search(cachedReader), 128u);
+    sgd.SetMemoryCap(0);
+    BOOST_CHECK_EQUAL(search(cachedReader), 192u);
+    BOOST_CHECK(cachedReader.m_minibatchSizesRead.empty());
+
+    // If nothing fits, the smallest size is used.
+    sgd.SetMemoryCap(bytes64 - 1);
+    BOOST_CHECK_EQUAL(search(cachedReader), 64u);
+    BOOST_CHECK(cachedReader.m_minibatchSizesRead.empty());
+
+    _wunlink((c_modelPath + L".mbThroughput").c_str());
+    _wunlink(sgd.GetModelNameForEpoch(c_epochNumber - 1).c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,524 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the rewrites of ComputationNetworkOptimization.cpp and ComputationNetworkAnalysis.cpp: each compares the
+// outputs of a network before and after the rewrite, on identical copies built from the same random seed.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "LinearAlgebraNodes.h"
+#include "TrainingNodes.h"
+#include "TestHelpers.h"
+#include <chrono>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const float c_optimizationTolerance = 1e-4f;
+
+static vector<float> RandomValues(size_t count, mt19937& rng)
+{
+    uniform_real_distribution<float> distribution(-1, 1);
+    vector<float> values(count);
+    for (auto& value : values)
+        value = distribution(rng);
+    return values;
+}
+
+static MBLayoutPtr FrameModeLayout(size_t numSamples)
+{
+    auto layout = make_shared<MBLayout>();
+    layout->InitAsFrameMode(numSamples);
+    return layout;
+}
+
+// adds a BatchNormalization node with random statistics, the running variances being positive
+static shared_ptr<ComputationNode<float>> AddBatchNormalization(ComputationNetworkBuilder<float>& builder, const shared_ptr<ComputationNode<float>>& input,
+                                                               size_t numFactors, bool spatial, mt19937& rng, const wstring& name)
+{
+    auto scale = CreateRandomParameter(builder, name + L".scale", TensorShape(numFactors, 1), rng, 0.5f, 2.0f);
+    auto shift = CreateRandomParameter(builder, name + L".shift", TensorShape(numFactors, 1), rng);
+    auto runMean = CreateRandomParameter(builder, name + L".runMean", TensorShape(numFactors, 1), rng);
+    auto runVariance = CreateRandomParameter(builder, name + L".runVariance", TensorShape(numFactors, 1), rng, 0.25f, 4.0f);
+    auto runCount = CreateRandomParameter(builder, name + L".runCount", TensorShape(1), rng, 100.0f, 100.0f);
+    return builder.BatchNormalization(input, scale, shift, runMean, runVariance, runCount, spatial,
+                                      /*normalizationTimeConstant=*/0, /*blendTimeConstant=*/0, /*epsilon=*/1e-5, /*useCntkEngine=*/true,
+                                      /*disableRegularization=*/false, ImageLayoutKind::CHW, name);
+}
+
+// x [5 x 5 x 2] -> conv = Convolution(W, x) [5 x 5 x 4] -> plus = conv + b -> bn = spatial BatchNormalization(plus)
+static ComputationNetworkPtr CreateConvolutionBatchNormalizationNetwork(unsigned int seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(5, 5, 2));
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(3, 3, 2, 4), rng);
+    auto conv = builder.Convolution(w, x, TensorShape(3, 3, 2), TensorShape(4), TensorShape(1, 1, 2), { true }, { true, true, false },
+                                    TensorShape(0), TensorShape(0), /*transpose=*/false, TensorShape(0), ImageLayoutKind::CHW,
+                                    /*maxTempMemSizeInSamples=*/0, L"conv");
+    auto b = CreateRandomParameter(builder, L"b", TensorShape(1, 1, 4), rng);
+    auto plus = builder.Plus(conv, b, L"plus");
+    auto bn = AddBatchNormalization(builder, plus, 4, /*spatial=*/true, rng, L"bn");
+
+    net->AddToNodeGroup(L"output", bn);
+    net->CompileNetwork();
+    return net;
+}
+
+// x [6] -> times = Times(W, x) [5] -> plus = times + b -> bn = BatchNormalization(plus)
+// 'groupOutput' is the name of a node that is added to the output group in addition to bn, or empty.
+static ComputationNetworkPtr CreateTimesBatchNormalizationNetwork(unsigned int seed, const wstring& groupOutput)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(6));
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(5, 6), rng);
+    auto times = builder.Times(w, x, 1, L"times");
+    auto b = CreateRandomParameter(builder, L"b", TensorShape(5), rng);
+    auto plus = builder.Plus(times, b, L"plus");
+    auto bn = AddBatchNormalization(builder, plus, 5, /*spatial=*/false, rng, L"bn");
+
+    net->AddToNodeGroup(L"output", bn);
+    if (!groupOutput.empty())
+        net->AddToNodeGroup(L"output", net->GetNodeFromName(groupOutput));
+    net->CompileNetwork();
+    return net;
+}
+
+static void SetParameterValues(const ComputationNodeBasePtr& node, vector<float> values)
+{
+    auto& matrix = dynamic_pointer_cast<ComputationNode<float>>(node)->Value();
+    BOOST_REQUIRE_EQUAL(matrix.GetNumElements(), values.size());
+    matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), matrix.GetDeviceId(), values.data());
+}
+
+// x [6 x 6 x 3] -> conv1 [6 x 6 x 8] -> plus1 -> bn1 -> relu1 -> conv2 [6 x 6 x 4]
+// Filters 4..7 of conv1 are normalized to (almost) constant -1 by bn1, so relu1 zeroes them, and pruning them
+// does not change the output.
+static ComputationNetworkPtr CreateConvolutionChainNetwork(unsigned int seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(6, 6, 3));
+    auto w1 = CreateRandomParameter(builder, L"W1", TensorShape(3, 3, 3, 8), rng);
+    auto conv1 = builder.Convolution(w1, x, TensorShape(3, 3, 3), TensorShape(8), TensorShape(1, 1, 3), { true }, { true, true, false },
+                                     TensorShape(0), TensorShape(0), /*transpose=*/false, TensorShape(0), ImageLayoutKind::CHW,
+                                     /*maxTempMemSizeInSamples=*/0, L"conv1");
+    auto b1 = CreateRandomParameter(builder, L"b1", TensorShape(1, 1, 8), rng);
+    auto plus1 = builder.Plus(conv1, b1, L"plus1");
+    auto bn1 = AddBatchNormalization(builder, plus1, 8, /*spatial=*/true, rng, L"bn1");
+    vector<float> scaleValues(8), shiftValues(8);
+    uniform_real_distribution<float> distribution(-1, 1);
+    for (size_t c = 0; c < 8; c++)
+    {
+        scaleValues[c] = c < 4 ? 1 + distribution(rng) / 2 : 1e-4f;
+        shiftValues[c] = c < 4 ? distribution(rng) : -1;
+    }
+    SetParameterValues(net->GetNodeFromName(L"bn1.scale"), scaleValues);
+    SetParameterValues(net->GetNodeFromName(L"bn1.shift"), shiftValues);
+    auto relu1 = builder.RectifiedLinear(bn1, L"relu1");
+    auto w2 = CreateRandomParameter(builder, L"W2", TensorShape(3, 3, 8, 4), rng);
+    auto conv2 = builder.Convolution(w2, relu1, TensorShape(3, 3, 8), TensorShape(4), TensorShape(1, 1, 8), { true }, { true, true, false },
+                                     TensorShape(0), TensorShape(0), /*transpose=*/false, TensorShape(0), ImageLayoutKind::CHW,
+                                     /*maxTempMemSizeInSamples=*/0, L"conv2");
+
+    net->AddToNodeGroup(L"output", conv2);
+    net->CompileNetwork();
+    return net;
+}
+
+// x [24] -> h = ReLU(Times(W1, x) + b1) [32] -> y = Times(W2, h) [10]
+// W1 is of rank 4 up to a small noise, so that it can be factored with little error; W2 has full rank.
+static ComputationNetworkPtr CreateTimesChainNetwork(unsigned int seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(24));
+    auto w1 = CreateRandomParameter(builder, L"W1", TensorShape(32, 24), rng);
+    auto left = RandomValues(32 * 4, rng), right = RandomValues(4 * 24, rng), noise = RandomValues(32 * 24, rng);
+    vector<float> w1Values(32 * 24);
+    for (size_t j = 0; j < 24; j++)
+    {
+        for (size_t i = 0; i < 32; i++)
+        {
+            float value = 1e-5f * noise[i + j * 32];
+            for (size_t k = 0; k < 4; k++)
+                value += left[i + k * 32] * right[k + j * 4];
+            w1Values[i + j * 32] = value;
+        }
+    }
+    SetParameterValues(w1, w1Values);
+    auto times1 = builder.Times(w1, x, 1, L"times1");
+    auto b1 = CreateRandomParameter(builder, L"b1", TensorShape(32), rng);
+    auto h = builder.RectifiedLinear(builder.Plus(times1, b1, L"plus1"), L"h");
+    auto w2 = CreateRandomParameter(builder, L"W2", TensorShape(10, 32), rng);
+    auto y = builder.Times(w2, h, 1, L"y");
+
+    net->AddToNodeGroup(L"output", y);
+    net->CompileNetwork();
+    return net;
+}
+
+// x [4] -> h = Tanh(Times(W, RowStack(x, PastValue(h)))) [5] -> z = Times(V, h) [3] -> ce = CrossEntropyWithSoftmax(labels, z)
+static ComputationNetworkPtr CreateRecurrentProjectionNetwork(unsigned int seed)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(4));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(3));
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(5, 4 + 5), rng);
+    auto v = CreateRandomParameter(builder, L"V", TensorShape(3, 5), rng);
+
+    // the input of the delay is replaced by h once h exists
+    auto delay = builder.PastValue(x, 0.1f, 5, 1, L"delay");
+    auto rowStack = builder.RowStack({ x, delay }, L"rowStack");
+    auto times = builder.Times(w, rowStack, 1, L"times");
+    auto h = builder.Tanh(times, L"h");
+    static_pointer_cast<ComputationNodeBase>(delay)->SetInput(0, h);
+    auto z = builder.Times(v, h, 1, L"z");
+    auto ce = builder.CrossEntropyWithSoftmax(labels, z, L"ce");
+
+    net->AddToNodeGroup(L"output", h);
+    net->AddToNodeGroup(L"criterion", ce);
+    net->CompileNetwork();
+    return net;
+}
+
+static vector<float> ValuesOf(const Matrix<float>& matrix)
+{
+    vector<float> values(matrix.GetNumElements());
+    float* data = values.data();
+    size_t size = values.size();
+    matrix.CopyToArray(data, size);
+    return values;
+}
+
+// runs one forward and backward pass of ce on two sequences of 3 steps
+// Returns the values of h and ce, and the gradients of W and V.
+static vector<vector<float>> EvaluateRecurrentProjectionNetwork(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto h = net->GetNodeFromName(L"h");
+    auto ce = net->GetNodeFromName(L"ce");
+    net->AllocateAllMatrices({}, { h }, ce);
+    net->StartEvaluateMinibatchLoop(ce);
+    net->StartEvaluateMinibatchLoop(h);
+
+    auto layout = make_shared<MBLayout>();
+    layout->Init(2, 3);
+    layout->AddSequence(0, 0, 0, 3);
+    layout->AddSequence(1, 1, 0, 3);
+    net->GetMBLayoutPtrOfNetwork()->CopyFrom(layout, /*keepName=*/true);
+
+    mt19937 rng(11);
+    auto xValues = RandomValues(4 * 6, rng);
+    vector<float> labelValues(3 * 6, 0);
+    for (size_t t = 0; t < 6; t++)
+        labelValues[(t * 2) % 3 + t * 3] = 1;
+    auto x = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"x"));
+    auto labels = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"labels"));
+    x->Value().SetValue(4, 6, x->GetDeviceId(), xValues.data());
+    labels->Value().SetValue(3, 6, labels->GetDeviceId(), labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp({ x, labels });
+
+    net->ForwardProp(vector<ComputationNodeBasePtr>{ ce, h });
+    net->Backprop(ce);
+
+    auto valueOf = [&](const wstring& name) { return ValuesOf(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Value()); };
+    auto gradientOf = [&](const wstring& name) { return ValuesOf(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Gradient()); };
+    return { valueOf(L"h"), valueOf(L"ce"), gradientOf(L"W"), gradientOf(L"V") };
+}
+
+// x [inputDim] -> LSTM with gates Times(W, RowStack(x, PastValue(h))) + b -> h [hiddenDim] -> ce = CrossEntropyWithSoftmax(labels, Times(V, h))
+static ComputationNetworkPtr CreateLSTMNetwork(unsigned int seed, size_t inputDim, size_t hiddenDim, size_t numClasses)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(seed);
+
+    auto x = builder.CreateInputNode(L"x", TensorShape(inputDim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(numClasses));
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(4 * hiddenDim, inputDim + hiddenDim), rng, -0.1f, 0.1f);
+    auto b = CreateRandomParameter(builder, L"b", TensorShape(4 * hiddenDim), rng, -0.1f, 0.1f);
+    auto v = CreateRandomParameter(builder, L"V", TensorShape(numClasses, hiddenDim), rng, -0.1f, 0.1f);
+
+    // the inputs of the delays are replaced by h and c once they exist
+    auto hDelay = builder.PastValue(x, 0, hiddenDim, 1, L"hDelay");
+    auto cDelay = builder.PastValue(x, 0, hiddenDim, 1, L"cDelay");
+    auto z = builder.Plus(builder.Times(w, builder.RowStack({ x, hDelay }, L"rowStack"), 1, L"times"), b, L"z");
+    auto inputGate = builder.Sigmoid(builder.RowSlice(z, 0, hiddenDim), L"inputGate");
+    auto forgetGate = builder.Sigmoid(builder.RowSlice(z, hiddenDim, hiddenDim), L"forgetGate");
+    auto outputGate = builder.Sigmoid(builder.RowSlice(z, 2 * hiddenDim, hiddenDim), L"outputGate");
+    auto candidate = builder.Tanh(builder.RowSlice(z, 3 * hiddenDim, hiddenDim), L"candidate");
+    auto c = builder.Plus(builder.ElementTimes(forgetGate, cDelay), builder.ElementTimes(inputGate, candidate), L"c");
+    auto h = builder.ElementTimes(outputGate, builder.Tanh(c), L"h");
+    static_pointer_cast<ComputationNodeBase>(hDelay)->SetInput(0, h);
+    static_pointer_cast<ComputationNodeBase>(cDelay)->SetInput(0, c);
+    auto ce = builder.CrossEntropyWithSoftmax(labels, builder.Times(v, h, 1, L"logits"), L"ce");
+
+    net->AddToNodeGroup(L"criterion", ce);
+    net->CompileNetwork();
+    return net;
+}
+
+// Not a correctness test: the average time of a forward and backward pass of CreateLSTMNetwork() over a minibatch
+// of sequences of equal length, with or without HoistLoopInvariantProjections().
+static double TimeLSTMNetwork(bool hoist, size_t inputDim, size_t hiddenDim, size_t numSequences, size_t numSteps)
+{
+    const size_t numClasses = 10;
+    auto net = CreateLSTMNetwork(5, inputDim, hiddenDim, numClasses);
+    if (hoist)
+        net->HoistLoopInvariantProjections<float>();
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto ce = net->GetNodeFromName(L"ce");
+    net->AllocateAllMatrices({}, {}, ce);
+    net->StartEvaluateMinibatchLoop(ce);
+
+    auto layout = make_shared<MBLayout>();
+    layout->Init(numSequences, numSteps);
+    for (size_t s = 0; s < numSequences; s++)
+        layout->AddSequence(s, s, 0, numSteps);
+    net->GetMBLayoutPtrOfNetwork()->CopyFrom(layout, /*keepName=*/true);
+
+    size_t numColumns = numSequences * numSteps;
+    mt19937 rng(11);
+    auto xValues = RandomValues(inputDim * numColumns, rng);
+    vector<float> labelValues(numClasses * numColumns, 0);
+    for (size_t t = 0; t < numColumns; t++)
+        labelValues[t % numClasses + t * numClasses] = 1;
+    auto x = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"x"));
+    auto labels = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"labels"));
+    x->Value().SetValue(inputDim, numColumns, x->GetDeviceId(), xValues.data());
+    labels->Value().SetValue(numClasses, numColumns, labels->GetDeviceId(), labelValues.data());
+
+    const int repeats = 10;
+    chrono::steady_clock::time_point start;
+    for (int i = 0; i <= repeats; i++)
+    {
+        if (i == 1) // the first pass warms up
+            start = chrono::steady_clock::now();
+        ComputationNetwork::BumpEvalTimeStamp({ x, labels });
+        net->ForwardProp(ce);
+        net->Backprop(ce);
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+}
+
+static void CheckOutputsAreEqual(const vector<vector<float>>& expected, const vector<vector<float>>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        BOOST_REQUIRE_EQUAL(expected[i].size(), actual[i].size());
+        BOOST_CHECK(AreEqual(expected[i].data(), actual[i].data(), expected[i].size(), c_optimizationTolerance));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkOptimizationTests)
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationIntoConvolution)
+{
+    const size_t numSamples = 3;
+    mt19937 rng(17);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(5 * 5 * 2 * numSamples, rng) } };
+    const vector<wstring> outputNames = { L"bn" };
+
+    auto reference = CreateConvolutionBatchNormalizationNetwork(1);
+    auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+    auto net = CreateConvolutionBatchNormalizationNetwork(1);
+    auto stats = net->OptimizeForInference<float>(outputNames);
+    BOOST_CHECK_EQUAL(stats.m_numFoldedBatchNormalizations, 1);
+    BOOST_CHECK(net->GetNodeFromName(L"bn")->OperationName() != OperationNameOf(BatchNormalizationNode));
+    CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationSkipsRequestedOutputs)
+{
+    // the Convolution and the bias Plus would be rescaled by the folding
+    const size_t numSamples = 3;
+    mt19937 rng(18);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(5 * 5 * 2 * numSamples, rng) } };
+    for (const wstring& innerName : { L"conv", L"plus" })
+    {
+        const vector<wstring> outputNames = { L"bn", innerName };
+
+        auto reference = CreateConvolutionBatchNormalizationNetwork(2);
+        auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+        auto net = CreateConvolutionBatchNormalizationNetwork(2);
+        auto stats = net->OptimizeForInference<float>(outputNames);
+        BOOST_CHECK_EQUAL(stats.m_numFoldedBatchNormalizations, 0);
+        BOOST_CHECK(net->GetNodeFromName(L"bn")->OperationName() == OperationNameOf(BatchNormalizationNode));
+        CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationIntoTimes)
+{
+    const size_t numSamples = 4;
+    mt19937 rng(19);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(6 * numSamples, rng) } };
+    const vector<wstring> outputNames = { L"bn" };
+
+    auto reference = CreateTimesBatchNormalizationNetwork(3, L"");
+    auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+    auto net = CreateTimesBatchNormalizationNetwork(3, L"");
+    auto stats = net->OptimizeForInference<float>(outputNames);
+    BOOST_CHECK_EQUAL(stats.m_numFoldedBatchNormalizations, 1);
+    BOOST_CHECK(net->GetNodeFromName(L"bn")->OperationName() == OperationNameOf(PlusNode));
+    CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+}
+
+BOOST_AUTO_TEST_CASE(FoldBatchNormalizationSkipsGroupOutputs)
+{
+    // Times or the bias Plus is in the output group, but only bn is requested.
+    const size_t numSamples = 4;
+    mt19937 rng(20);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(6 * numSamples, rng) } };
+    for (const wstring& innerName : { L"times", L"plus" })
+    {
+        const vector<wstring> outputNames = { L"bn", innerName };
+
+        auto reference = CreateTimesBatchNormalizationNetwork(4, innerName);
+        auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+        auto net = CreateTimesBatchNormalizationNetwork(4, innerName);
+        auto stats = net->OptimizeForInference<float>({ L"bn" });
+        BOOST_CHECK_EQUAL(stats.m_numFoldedBatchNormalizations, 0);
+        BOOST_CHECK(net->GetNodeFromName(L"bn")->OperationName() == OperationNameOf(BatchNormalizationNode));
+        CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CompressForBudgetPrunesConvolutionFilters)
+{
+    const size_t numSamples = 2;
+    mt19937 rng(21);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(6 * 6 * 3 * numSamples, rng) } };
+    const vector<wstring> outputNames = { L"conv2" };
+
+    auto reference = CreateConvolutionChainNetwork(5);
+    auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+    // 36288 operations per sample before, 18144 with half of the filters of conv1 pruned
+    ComputationNetwork::CompressionBudget budget;
+    budget.m_flops = 30000;
+    budget.m_alignment = 4;
+    auto net = CreateConvolutionChainNetwork(5);
+    vector<ComputationNetwork::LayerCompressionStats> stats;
+    BOOST_REQUIRE_NO_THROW(stats = net->CompressForBudget<float>(outputNames, budget));
+    BOOST_REQUIRE_EQUAL(stats.size(), 1);
+    BOOST_CHECK(stats[0].m_nodeName == L"conv1");
+    BOOST_CHECK(stats[0].m_isChannelPruning);
+    BOOST_CHECK_EQUAL(stats[0].m_sizeBefore, 8);
+    BOOST_CHECK_EQUAL(stats[0].m_sizeAfter, 4);
+    BOOST_CHECK_NO_THROW(net->ValidateNetwork());
+
+    BOOST_CHECK_EQUAL(dynamic_pointer_cast<ConvolutionNode<float>>(net->GetNodeFromName(L"conv1"))->MapCount().GetNumElements(), 4);
+    BOOST_CHECK(net->GetNodeFromName(L"W1")->GetSampleLayout() == TensorShape(3, 3, 3, 4));
+    BOOST_CHECK(net->GetNodeFromName(L"conv1")->GetSampleLayout() == TensorShape(6, 6, 4));
+    BOOST_CHECK_EQUAL(net->GetNodeFromName(L"b1")->GetSampleLayout().GetNumElements(), 4);
+    for (size_t i = 1; i <= 4; i++)
+        BOOST_CHECK_EQUAL(net->GetNodeFromName(L"bn1")->Input(i)->GetSampleLayout().GetNumElements(), 4);
+    BOOST_CHECK(net->GetNodeFromName(L"relu1")->GetSampleLayout() == TensorShape(6, 6, 4));
+    BOOST_CHECK(dynamic_pointer_cast<ConvolutionNode<float>>(net->GetNodeFromName(L"conv2"))->KernelShape() == TensorShape(3, 3, 4));
+    BOOST_CHECK(net->GetNodeFromName(L"W2")->GetSampleLayout() == TensorShape(3, 3, 4, 4));
+    BOOST_CHECK(net->GetNodeFromName(L"conv2")->GetSampleLayout() == reference->GetNodeFromName(L"conv2")->GetSampleLayout());
+
+    CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+}
+
+BOOST_AUTO_TEST_CASE(CompressForBudgetFactorsTimesWeights)
+{
+    const size_t numSamples = 5;
+    mt19937 rng(22);
+    map<wstring, vector<float>> inputs = { { L"x", RandomValues(24 * numSamples, rng) } };
+    const vector<wstring> outputNames = { L"y" };
+
+    auto reference = CreateTimesChainNetwork(6);
+    auto expected = EvaluateNetwork(reference, outputNames, FrameModeLayout(numSamples), inputs);
+
+    // 2176 operations per sample before; only W1 can be factored within the allowed error
+    ComputationNetwork::CompressionBudget budget;
+    budget.m_flops = 2000;
+    budget.m_alignment = 4;
+    budget.m_maxLayerError = 0.01;
+    auto net = CreateTimesChainNetwork(6);
+    vector<ComputationNetwork::LayerCompressionStats> stats;
+    BOOST_REQUIRE_NO_THROW(stats = net->CompressForBudget<float>(outputNames, budget));
+    BOOST_REQUIRE_EQUAL(stats.size(), 2);
+    size_t rank = 0;
+    for (const auto& layer : stats)
+    {
+        BOOST_CHECK(!layer.m_isChannelPruning);
+        if (layer.m_nodeName == L"times1")
+            rank = layer.m_sizeAfter;
+        else
+            BOOST_CHECK_EQUAL(layer.m_sizeAfter, layer.m_sizeBefore);
+    }
+    BOOST_REQUIRE(rank >= 4 && rank < 24);
+    BOOST_CHECK_NO_THROW(net->ValidateNetwork());
+
+    BOOST_CHECK(!net->NodeNameExists(L"W1"));
+    BOOST_CHECK(net->GetNodeFromName(L"W1_U")->GetSampleLayout() == TensorShape(32, rank));
+    BOOST_CHECK(net->GetNodeFromName(L"W1_V")->GetSampleLayout() == TensorShape(rank, 24));
+    BOOST_CHECK(net->GetNodeFromName(L"h")->GetSampleLayout() == TensorShape(32));
+    BOOST_CHECK(net->GetNodeFromName(L"y")->GetSampleLayout() == TensorShape(10));
+
+    CheckOutputsAreEqual(expected, EvaluateNetwork(net, outputNames, FrameModeLayout(numSamples), inputs));
+}
+
+BOOST_AUTO_TEST_CASE(HoistLoopInvariantProjection)
+{
+    auto expected = EvaluateRecurrentProjectionNetwork(CreateRecurrentProjectionNetwork(7));
+
+    auto net = CreateRecurrentProjectionNetwork(7);
+    BOOST_REQUIRE_EQUAL(net->HoistLoopInvariantProjections<float>(), 1);
+    BOOST_CHECK(!net->NodeNameExists(L"rowStack"));
+    BOOST_CHECK(net->GetNodeFromName(L"times.invariantWeights")->GetSampleLayout() == TensorShape(5, 4));
+    BOOST_CHECK(net->GetNodeFromName(L"times.recurrentWeights")->GetSampleLayout() == TensorShape(5, 5));
+    BOOST_CHECK(net->GetNodeFromName(L"times")->OperationName() == PlusNode<float>::TypeName());
+
+    // only the recurrent product remains in the loop
+    for (const auto& node : net->GetEvalOrder(nullptr))
+    {
+        if (node->NodeName() == L"times.invariant")
+            BOOST_CHECK(!node->IsPartOfLoop());
+        else if (node->NodeName() == L"times.recurrent")
+            BOOST_CHECK(node->IsPartOfLoop());
+    }
+
+    CheckOutputsAreEqual(expected, EvaluateRecurrentProjectionNetwork(net));
+}
+
+BOOST_AUTO_TEST_CASE(HoistLoopInvariantProjectionTiming)
+{
+    const size_t inputDim = 256, hiddenDim = 128, numSequences = 8, numSteps = 50;
+    double elapsed = TimeLSTMNetwork(false, inputDim, hiddenDim, numSequences, numSteps);
+    double elapsedHoisted = TimeLSTMNetwork(true, inputDim, hiddenDim, numSequences, numSteps);
+    BOOST_TEST_MESSAGE("LSTM " << inputDim << " -> " << hiddenDim << ", " << numSequences << " sequences of " << numSteps
+                       << " steps, forward and backward: " << elapsed << " ms, with hoisted input projections " << elapsedHoisted << " ms");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -25,6 +25,69 @@ template bool Microsoft::MSR::CNTK::Test::AreEqual<float>(const float* a, const
 template bool Microsoft::MSR::CNTK::Test::AreEqual<double>(const double* a, const double* b, const size_t count,
                                                            const float threshold);
 
+template <class ElemType>
+shared_ptr<ComputationNode<ElemType>> Microsoft::MSR::CNTK::Test::CreateRandomParameter(ComputationNetworkBuilder<ElemType>& builder, const std::wstring& name,
+                                                                                         const TensorShape& shape, std::mt19937& rng, ElemType low, ElemType high)
+{
+    auto parameter = builder.CreateLearnableParameter(name, shape);
+    std::uniform_real_distribution<double> distribution(low, high);
+    std::vector<ElemType> values(shape.GetNumElements());
+    for (auto& value : values)
+        value = (ElemType)distribution(rng);
+    auto& matrix = parameter->Value();
+    matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), matrix.GetDeviceId(), values.data());
+    return parameter;
+}
+
+template shared_ptr<ComputationNode<float>> Microsoft::MSR::CNTK::Test::CreateRandomParameter<float>(ComputationNetworkBuilder<float>& builder, const std::wstring& name,
+                                                                                                     const TensorShape& shape, std::mt19937& rng, float low, float high);
+
+template shared_ptr<ComputationNode<double>> Microsoft::MSR::CNTK::Test::CreateRandomParameter<double>(ComputationNetworkBuilder<double>& builder, const std::wstring& name,
+                                                                                                       const TensorShape& shape, std::mt19937& rng, double low, double high);
+
+template <class ElemType>
+std::vector<std::vector<ElemType>> Microsoft::MSR::CNTK::Test::EvaluateNetwork(const ComputationNetworkPtr& net, const std::vector<std::wstring>& outputNames,
+                                                                               const MBLayoutPtr& layout, const std::map<std::wstring, std::vector<ElemType>>& inputs)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto outputNodes = net->OutputNodesByName(outputNames);
+    if (!net->AreMatricesAllocated())
+        net->AllocateAllMatrices({}, outputNodes, nullptr);
+    net->StartEvaluateMinibatchLoop(outputNodes);
+
+    net->GetMBLayoutPtrOfNetwork()->CopyFrom(layout, /*keepName=*/true);
+    std::vector<ComputationNodeBasePtr> inputNodes;
+    for (const auto& input : inputs)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(net->GetNodeFromName(input.first));
+        size_t numRows = node->GetSampleLayout().GetNumElements();
+        if (input.second.size() != numRows * layout->GetNumCols())
+            LogicError("Data size of input %ls is incompatible with the minibatch layout.", input.first.c_str());
+        node->Value().SetValue(numRows, layout->GetNumCols(), node->GetDeviceId(), const_cast<ElemType*>(input.second.data()));
+        inputNodes.push_back(node);
+    }
+    ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+    net->ForwardProp(outputNodes);
+
+    std::vector<std::vector<ElemType>> outputs;
+    for (const auto& node : outputNodes)
+    {
+        const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        std::vector<ElemType> values(value.GetNumElements());
+        ElemType* data = values.data();
+        size_t size = values.size();
+        value.CopyToArray(data, size);
+        outputs.push_back(values);
+    }
+    return outputs;
+}
+
+template std::vector<std::vector<float>> Microsoft::MSR::CNTK::Test::EvaluateNetwork<float>(const ComputationNetworkPtr& net, const std::vector<std::wstring>& outputNames,
+                                                                                            const MBLayoutPtr& layout, const std::map<std::wstring, std::vector<float>>& inputs);
+
+template std::vector<std::vector<double>> Microsoft::MSR::CNTK::Test::EvaluateNetwork<double>(const ComputationNetworkPtr& net, const std::vector<std::wstring>& outputNames,
+                                                                                              const MBLayoutPtr& layout, const std::map<std::wstring, std::vector<double>>& inputs);
+
 template <class ElemType>
 /*static*/ const std::wstring DummyNodeTest<ElemType>::TypeName()
 {
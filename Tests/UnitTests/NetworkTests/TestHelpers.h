@@ -6,6 +6,10 @@
 #pragma once
 
 #include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <map>
+#include <random>
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -13,6 +17,17 @@ namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 template <class ElemType>
 bool AreEqual(const ElemType* a, const ElemType* b, const size_t count, const float threshold);
 
+// Adds a LearnableParameter of the given shape to the network, with values drawn uniformly from [low, high).
+template <class ElemType>
+shared_ptr<ComputationNode<ElemType>> CreateRandomParameter(ComputationNetworkBuilder<ElemType>& builder, const std::wstring& name,
+                                                            const TensorShape& shape, std::mt19937& rng, ElemType low = -1, ElemType high = 1);
+
+// Evaluates the given outputs of a compiled network in inference mode, allocating its matrices if needed.
+// The minibatch has the given layout, and 'inputs' holds the values of the input nodes by name, one column per sample.
+template <class ElemType>
+std::vector<std::vector<ElemType>> EvaluateNetwork(const ComputationNetworkPtr& net, const std::vector<std::wstring>& outputNames,
+                                                   const MBLayoutPtr& layout, const std::map<std::wstring, std::vector<ElemType>>& inputs);
+
 // Minimalistic version of input node used to avoid dependency to other nodes.
 template <class ElemType>
 class DummyNodeTest : public ComputationNode<ElemType>
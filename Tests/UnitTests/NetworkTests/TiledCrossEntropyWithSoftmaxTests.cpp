@@ -0,0 +1,165 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of TiledCrossEntropyWithSoftmaxNode: its value and the gradients of the hidden activation and the weight must match
+// the ones of CrossEntropyWithSoftmax(labels, TransposeTimes(weight, hidden)), on networks built from the same random seed.
+//
+
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "TrainingNodes.h"
+#include "TestHelpers.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const float c_tiledCrossEntropyTolerance = 1e-4f;
+
+static const size_t c_vocabularySize = 7;
+static const size_t c_hiddenDim = 4;
+static const size_t c_tileSize = 3; // does not divide the vocabulary size
+
+// three sequences of 4, 2 and 3 steps, the last two followed by gaps
+static MBLayoutPtr SequenceLayoutWithGaps()
+{
+    auto layout = make_shared<MBLayout>();
+    layout->Init(3, 4);
+    layout->AddSequence(0, 0, 0, 4);
+    layout->AddSequence(1, 1, 0, 2);
+    layout->AddGap(1, 2, 4);
+    layout->AddSequence(2, 2, 0, 3);
+    layout->AddGap(2, 3, 4);
+    return layout;
+}
+
+static const size_t c_numSamples = 9; // non-gap columns of SequenceLayoutWithGaps()
+
+// labels [V], x [numSamples] -> h = U x [H] -> ce = criterion(labels, h, W [H x V])
+// x holds a different unit vector for each sample, such that the gradient of U holds the gradient of h of each sample.
+// Parameters whose gradient is not requested get a learning rate multiplier of 0.
+static ComputationNetworkPtr CreateCriterionNetwork(bool tiled, bool hiddenNeedsGradient, bool weightNeedsGradient)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    mt19937 rng(3);
+
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(c_vocabularySize));
+    auto x = builder.CreateInputNode(L"x", TensorShape(c_numSamples));
+    auto u = CreateRandomParameter(builder, L"U", TensorShape(c_hiddenDim, c_numSamples), rng);
+    auto w = CreateRandomParameter(builder, L"W", TensorShape(c_hiddenDim, c_vocabularySize), rng);
+    if (!hiddenNeedsGradient)
+        u->SetLearningRateMultiplier(0);
+    if (!weightNeedsGradient)
+        w->SetLearningRateMultiplier(0);
+
+    auto h = builder.Times(u, x, 1, L"h");
+    ComputationNodeBasePtr ce;
+    if (tiled)
+        ce = net->AddNodeToNetAndAttachInputs(New<TiledCrossEntropyWithSoftmaxNode<float>>(CPUDEVICE, L"ce", c_tileSize), { labels, h, w });
+    else
+        ce = builder.CrossEntropyWithSoftmax(labels, builder.TransposeTimes(w, h, L"z"), L"ce");
+
+    net->AddToNodeGroup(L"criterion", ce);
+    net->CompileNetwork();
+    return net;
+}
+
+static vector<float> ValuesOf(const Matrix<float>& matrix)
+{
+    vector<float> values(matrix.GetNumElements());
+    float* data = values.data();
+    size_t size = values.size();
+    matrix.CopyToArray(data, size);
+    return values;
+}
+
+// runs one forward and backward pass of ce
+// Returns the value of ce and the gradients of U and W, where requested.
+static vector<vector<float>> EvaluateCriterionNetwork(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto ce = net->GetNodeFromName(L"ce");
+    net->AllocateAllMatrices({}, {}, ce);
+    net->StartEvaluateMinibatchLoop(ce);
+
+    auto layout = SequenceLayoutWithGaps();
+    net->GetMBLayoutPtrOfNetwork()->CopyFrom(layout, /*keepName=*/true);
+
+    // Labels are arbitrary non-negative weights, including in the gaps, which the criterion must ignore.
+    // x is zero in the gaps, such that h is zero there as well, as the reference does not mask it.
+    const size_t numColumns = layout->GetNumCols();
+    mt19937 rng(13);
+    uniform_real_distribution<float> distribution(0, 1);
+    vector<float> labelValues(c_vocabularySize * numColumns);
+    for (auto& value : labelValues)
+        value = distribution(rng);
+    vector<float> xValues(c_numSamples * numColumns, 0);
+    size_t sample = 0;
+    for (size_t t = 0; t < layout->GetNumTimeSteps(); t++)
+    {
+        for (size_t s = 0; s < layout->GetNumParallelSequences(); s++)
+        {
+            if (!layout->IsGap(FrameRange(layout, t).Sequence(s)))
+                xValues[sample++ + (t * layout->GetNumParallelSequences() + s) * c_numSamples] = 1;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(sample, c_numSamples);
+
+    auto x = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"x"));
+    auto labels = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"labels"));
+    x->Value().SetValue(c_numSamples, numColumns, x->GetDeviceId(), xValues.data());
+    labels->Value().SetValue(c_vocabularySize, numColumns, labels->GetDeviceId(), labelValues.data());
+    ComputationNetwork::BumpEvalTimeStamp({ x, labels });
+
+    net->ForwardProp(ce);
+    net->Backprop(ce);
+
+    vector<vector<float>> results = { ValuesOf(dynamic_pointer_cast<ComputationNode<float>>(ce)->Value()) };
+    for (const auto& name : { L"U", L"W" })
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name));
+        if (parameter->NeedsGradient())
+            results.push_back(ValuesOf(parameter->Gradient()));
+    }
+    return results;
+}
+
+static void CheckTiledCrossEntropyMatchesReference(bool hiddenNeedsGradient, bool weightNeedsGradient)
+{
+    auto expected = EvaluateCriterionNetwork(CreateCriterionNetwork(false, hiddenNeedsGradient, weightNeedsGradient));
+    auto actual = EvaluateCriterionNetwork(CreateCriterionNetwork(true, hiddenNeedsGradient, weightNeedsGradient));
+
+    BOOST_REQUIRE_EQUAL(expected.size(), 1 + (hiddenNeedsGradient ? 1 : 0) + (weightNeedsGradient ? 1 : 0));
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        BOOST_REQUIRE_EQUAL(expected[i].size(), actual[i].size());
+        BOOST_CHECK(AreEqual(expected[i].data(), actual[i].data(), expected[i].size(), c_tiledCrossEntropyTolerance));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(TiledCrossEntropyWithSoftmaxTests)
+
+BOOST_AUTO_TEST_CASE(TiledCrossEntropyWithSoftmaxBothGradients)
+{
+    CheckTiledCrossEntropyMatchesReference(true, true);
+}
+
+BOOST_AUTO_TEST_CASE(TiledCrossEntropyWithSoftmaxHiddenGradientOnly)
+{
+    CheckTiledCrossEntropyMatchesReference(true, false);
+}
+
+BOOST_AUTO_TEST_CASE(TiledCrossEntropyWithSoftmaxWeightGradientOnly)
+{
+    CheckTiledCrossEntropyMatchesReference(false, true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
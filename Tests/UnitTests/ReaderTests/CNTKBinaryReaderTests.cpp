@@ -4,8 +4,11 @@
 //
 #include "stdafx.h"
 #include <algorithm>
+#include <random>
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
+#include "TextToBinaryConverter.h"
+#include "CBFCompression.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -19,6 +22,69 @@ struct CNTKBinaryReaderFixture : ReaderFixture
     }
 };
 
+::CNTK::StreamDescriptor CreateStreamDescriptor(const wstring& name, const string& alias, ::CNTK::StorageFormat format, size_t dimension)
+{
+    ::CNTK::StreamDescriptor stream;
+    stream.m_name = name;
+    stream.m_alias = alias;
+    stream.m_storageFormat = format;
+    stream.m_sampleDimension = dimension;
+    return stream;
+}
+
+// Converts a file from the CNTKTextFormatReader test data into the binary format. The chunk size
+// is kept small, so that the output consists of a number of chunks, which are parsed concurrently.
+// Any value encodings are applied to the streams in the given order.
+template <class ElemType>
+void ConvertTextToBinary(const string& textFile, const string& binaryFile, const vector<::CNTK::StreamDescriptor>& streams, size_t chunkSize,
+                         ::CNTK::ChunkCodecType codec = ::CNTK::ChunkCodecType::none, const vector<::CNTK::ValueEncodingType>& encodings = {})
+{
+    ::CNTK::TextToBinaryConverter<ElemType> converter(wstring(textFile.begin(), textFile.end()), streams);
+    converter.SetChunkSize(chunkSize);
+    converter.SetCompression(codec);
+    for (size_t i = 0; i < encodings.size(); ++i)
+        converter.SetValueEncoding(i, encodings[i]);
+    converter.SetNumThreads(4);
+    converter.Convert(wstring(binaryFile.begin(), binaryFile.end()));
+}
+
+// Compresses the data and checks that it decompresses to the original.
+void CheckCompressionRoundTrip(const vector<char>& data)
+{
+    vector<char> compressed;
+    ::CNTK::CBFCompression::Compress(data.data(), data.size(), compressed);
+    BOOST_CHECK_LE(compressed.size(), data.size() + data.size() / 255 + 16);
+
+    vector<char> decompressed(data.size());
+    ::CNTK::CBFCompression::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    BOOST_CHECK(decompressed == data);
+}
+
+// Random bytes, which do not compress.
+vector<char> RandomBytes(size_t size)
+{
+    std::mt19937 rng(0);
+    vector<char> data(size);
+    for (auto& value : data)
+        value = static_cast<char>(rng() & 0xff);
+    return data;
+}
+
+// Text-like data with many repetitions at various distances.
+vector<char> RepetitiveBytes(size_t size)
+{
+    std::mt19937 rng(0);
+    const string words[] = { "|features ", "0.5 ", "-1 ", "0 ", "0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 ", "|labels 1 0\n" };
+    vector<char> data;
+    while (data.size() < size)
+    {
+        const string& word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        data.insert(data.end(), word.begin(), word.end());
+    }
+    data.resize(size);
+    return data;
+}
+
 BOOST_FIXTURE_TEST_SUITE(ReaderTestSuite, CNTKBinaryReaderFixture)
 
 
@@ -131,6 +197,237 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse)
         true);
 };
 
+// The following tests convert the text format test data with the native converter and check that
+// the binary reader returns the same data as the text format reader does for the original input.
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_converted)
+{
+    ConvertTextToBinary<float>(
+        testDataPath() + "/Data/CNTKTextFormatReader/Simple_dense.txt",
+        "Simple_dense_converted.bin",
+        {
+            CreateStreamDescriptor(L"features", "F", ::CNTK::StorageFormat::Dense, 2),
+            CreateStreamDescriptor(L"labels", "L", ::CNTK::StorageFormat::Dense, 2)
+        },
+        16 * 1024);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_converted_Output.txt",
+        "Simple_converted",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs
+        1,
+        1,
+        0,
+        1);
+
+    boost::filesystem::remove("Simple_dense_converted.bin");
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_dense_converted)
+{
+    ConvertTextToBinary<double>(
+        testDataPath() + "/Data/CNTKTextFormatReader/50x20_jagged_sequences_dense.txt",
+        "50x20_jagged_sequences_dense_converted.bin",
+        { CreateStreamDescriptor(L"features", "F0", ::CNTK::StorageFormat::Dense, 3) },
+        1024);
+
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_dense_converted_Output.txt",
+        "50x20_jagged_sequences_dense_converted",
+        "reader",
+        508,  // epoch size
+        508,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1);
+
+    boost::filesystem::remove("50x20_jagged_sequences_dense_converted.bin");
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_converted)
+{
+    ConvertTextToBinary<float>(
+        testDataPath() + "/Data/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        "50x20_jagged_sequences_sparse_converted.bin",
+        { CreateStreamDescriptor(L"features", "F0", ::CNTK::StorageFormat::SparseCSC, 100) },
+        2048);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_converted_Output.txt",
+        "50x20_jagged_sequences_sparse_converted",
+        "reader",
+        564,  // epoch size
+        564,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+
+    boost::filesystem::remove("50x20_jagged_sequences_sparse_converted.bin");
+};
+
+// Version 2 files: compressed chunks and encoded values. The labels are one-hot vectors, so that the scaled byte
+// encoding is exact and the output is expected to match the one of the text format reader.
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_encoded)
+{
+    ConvertTextToBinary<float>(
+        testDataPath() + "/Data/CNTKTextFormatReader/Simple_dense.txt",
+        "Simple_dense_encoded.bin",
+        {
+            CreateStreamDescriptor(L"features", "F", ::CNTK::StorageFormat::Dense, 2),
+            CreateStreamDescriptor(L"labels", "L", ::CNTK::StorageFormat::Dense, 2)
+        },
+        16 * 1024,
+        ::CNTK::ChunkCodecType::lz4,
+        { ::CNTK::ValueEncodingType::none, ::CNTK::ValueEncodingType::scaled_uint8 });
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_encoded_Output.txt",
+        "Simple_encoded",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs
+        1,
+        1,
+        0,
+        1);
+
+    boost::filesystem::remove("Simple_dense_encoded.bin");
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_compressed)
+{
+    ConvertTextToBinary<float>(
+        testDataPath() + "/Data/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        "50x20_jagged_sequences_sparse_compressed.bin",
+        { CreateStreamDescriptor(L"features", "F0", ::CNTK::StorageFormat::SparseCSC, 100) },
+        2048,
+        ::CNTK::ChunkCodecType::lz4);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_compressed_Output.txt",
+        "50x20_jagged_sequences_sparse_compressed",
+        "reader",
+        564,  // epoch size
+        564,  // mb size
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+
+    boost::filesystem::remove("50x20_jagged_sequences_sparse_compressed.bin");
+};
+
+// Float16 values are rounded to half precision, the control file holds the rounded values of Simple_dense.
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_float16)
+{
+    ConvertTextToBinary<float>(
+        testDataPath() + "/Data/CNTKTextFormatReader/Simple_dense.txt",
+        "Simple_dense_float16.bin",
+        {
+            CreateStreamDescriptor(L"features", "F", ::CNTK::StorageFormat::Dense, 2),
+            CreateStreamDescriptor(L"labels", "L", ::CNTK::StorageFormat::Dense, 2)
+        },
+        16 * 1024,
+        ::CNTK::ChunkCodecType::none,
+        { ::CNTK::ValueEncodingType::float16, ::CNTK::ValueEncodingType::float16 });
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_float16.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_float16_Output.txt",
+        "Simple_float16",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs
+        1,
+        1,
+        0,
+        1);
+
+    boost::filesystem::remove("Simple_dense_float16.bin");
+};
+
+BOOST_AUTO_TEST_CASE(CBFCompression_RoundTrip)
+{
+    // empty and short blocks consist of literals only
+    CheckCompressionRoundTrip({});
+    CheckCompressionRoundTrip({ 'a' });
+    CheckCompressionRoundTrip(vector<char>(12, 'a'));
+    CheckCompressionRoundTrip(vector<char>(13, 'a'));
+
+    // long literal runs and long, overlapping matches, whose lengths take several bytes
+    CheckCompressionRoundTrip(RandomBytes(1000));
+    CheckCompressionRoundTrip(vector<char>(100000, 'a'));
+
+    // incompressible data is stored with a small overhead
+    CheckCompressionRoundTrip(RandomBytes(300000));
+
+    // matches at offsets up to the maximum of 65535
+    auto data = RepetitiveBytes(300000);
+    CheckCompressionRoundTrip(data);
+    vector<char> compressed;
+    ::CNTK::CBFCompression::Compress(data.data(), data.size(), compressed);
+    BOOST_CHECK_LT(compressed.size(), data.size() / 2);
+
+    auto random = RandomBytes(70000);
+    random.insert(random.end(), random.begin(), random.begin() + 1000);
+    CheckCompressionRoundTrip(random);
+}
+
+BOOST_AUTO_TEST_CASE(CBFCompression_TruncatedInput)
+{
+    auto data = RepetitiveBytes(5000);
+    vector<char> compressed;
+    ::CNTK::CBFCompression::Compress(data.data(), data.size(), compressed);
+
+    vector<char> decompressed(data.size());
+    for (size_t size = 0; size < compressed.size(); ++size)
+        BOOST_CHECK_THROW(::CNTK::CBFCompression::Decompress(compressed.data(), size, decompressed.data(), decompressed.size()), std::runtime_error);
+
+    // the decompressed size has to match the one given
+    BOOST_CHECK_THROW(::CNTK::CBFCompression::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size() - 1), std::runtime_error);
+    decompressed.resize(data.size() + 1);
+    BOOST_CHECK_THROW(::CNTK::CBFCompression::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(CBFCompression_InvalidOffset)
+{
+    // One literal 'a', followed by a match of 4 bytes at the given offset and an empty last sequence.
+    auto block = [](char offset) { return vector<char>{ 0x10, 'a', offset, 0x00, 0x00 }; };
+
+    vector<char> decompressed(5);
+    auto valid = block(1);
+    ::CNTK::CBFCompression::Decompress(valid.data(), valid.size(), decompressed.data(), decompressed.size());
+    BOOST_CHECK(decompressed == vector<char>(5, 'a'));
+
+    // a match must start within the decompressed data
+    auto zeroOffset = block(0);
+    BOOST_CHECK_THROW(::CNTK::CBFCompression::Decompress(zeroOffset.data(), zeroOffset.size(), decompressed.data(), decompressed.size()), std::runtime_error);
+    auto farOffset = block(2);
+    BOOST_CHECK_THROW(::CNTK::CBFCompression::Decompress(farOffset.data(), farOffset.size(), decompressed.data(), decompressed.size()), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -393,6 +393,99 @@ BOOST_AUTO_TEST_CASE(RandRollbackToSameEpochInBigRandomizationWindow)
     BOOST_CHECK_EQUAL_COLLECTIONS(thirdEpoch.begin(), thirdEpoch.end(), current.begin(), current.end());
 }
 
+// Returns the mean absolute length difference of consecutive sequences in the first sweep.
+static double MeanNeighborLengthDifference(SequenceEnumeratorPtr randomizer)
+{
+    EpochConfiguration config;
+    config.m_numberOfWorkers = 1;
+    config.m_workerRank = 0;
+    config.m_minibatchSizeInSamples = 1;
+    config.m_totalEpochSizeInSamples = ((size_t)-1) >> 2;
+    config.m_epochIndex = 0;
+    randomizer->StartEpoch(config);
+
+    std::vector<size_t> lengths;
+    for (;;)
+    {
+        auto sequences = randomizer->GetNextSequences(1, 1);
+        if (sequences.m_data.empty())
+            break;
+        for (auto& s : sequences.m_data[0])
+            lengths.push_back(s->m_numberOfSamples);
+        if (sequences.m_endOfEpoch)
+            break;
+    }
+
+    double difference = 0;
+    for (size_t i = 1; i < lengths.size(); ++i)
+        difference += std::abs((double)lengths[i] - (double)lengths[i - 1]);
+    return difference / (lengths.size() - 1);
+}
+
+BOOST_AUTO_TEST_CASE(RandLengthBucketing)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 3;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    // A non-zero seed offset also checks that seeking back to the beginning of the sweep reuses the right seed.
+    auto randomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, /*seedOffset*/ 3, /*numberOfLengthBuckets*/ 8);
+
+    // All samples of the sweep are still returned exactly once.
+    auto firstSweep = ReadFullSweep(randomizer, 0, sweepNumberOfSamples);
+
+    // Bucketing is deterministic across rollbacks.
+    size_t epochSize = firstSweep.size() / 4;
+    auto firstEpoch = ReadFullEpoch(randomizer, epochSize, 0);
+    auto secondEpoch = ReadFullEpoch(randomizer, epochSize, 1);
+    auto thirdEpoch = ReadFullEpoch(randomizer, epochSize, 2);
+    std::vector<float> threeEpochs = Concat(std::vector<vector<float>>{ firstEpoch, secondEpoch, thirdEpoch });
+    BOOST_CHECK_EQUAL_COLLECTIONS(firstSweep.begin(), firstSweep.begin() + threeEpochs.size(), threeEpochs.begin(), threeEpochs.end());
+
+    auto current = ReadFullEpoch(randomizer, epochSize, 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(firstEpoch.begin(), firstEpoch.end(), current.begin(), current.end());
+
+    current = ReadFullEpoch(randomizer, epochSize, 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS(thirdEpoch.begin(), thirdEpoch.end(), current.begin(), current.end());
+
+    // Neighboring sequences have much closer lengths than without bucketing.
+    auto plain = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 3);
+    double bucketedDifference = MeanNeighborLengthDifference(randomizer);
+    double plainDifference = MeanNeighborLengthDifference(plain);
+    BOOST_CHECK_LT(bucketedDifference * 4, plainDifference);
+}
+
+BOOST_AUTO_TEST_CASE(RandReadAhead)
+{
+    size_t chunkSizeInSamples = 10000;
+    size_t sweepNumberOfSamples = 500000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 3;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    auto baselineRandomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, false, false);
+    auto baseline = ReadFullSweep(baselineRandomizer, 0, sweepNumberOfSamples);
+    size_t epochSize = baseline.size() / 4;
+    auto baselineSecondEpoch = ReadFullEpoch(baselineRandomizer, epochSize, 1);
+
+    // Read-ahead depth and memory cap must not change the data: (chunks, max bytes) - a cap of two chunks
+    // of float samples, and a cap smaller than a single chunk.
+    std::vector<std::pair<size_t, size_t>> readAheadConfigs = { { 1, 0 }, { 8, 0 }, { 8, 2 * chunkSizeInSamples * sizeof(float) }, { 8, 1 } };
+    for (const auto& readAhead : readAheadConfigs)
+    {
+        auto randomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 0, 0, readAhead.first, readAhead.second);
+        auto sweep = ReadFullSweep(randomizer, 0, sweepNumberOfSamples);
+        BOOST_CHECK_EQUAL_COLLECTIONS(baseline.begin(), baseline.end(), sweep.begin(), sweep.end());
+
+        // Roll forward and back, so that chunks read ahead are dropped.
+        ReadFullEpoch(randomizer, epochSize, 3);
+        auto secondEpoch = ReadFullEpoch(randomizer, epochSize, 1);
+        BOOST_CHECK_EQUAL_COLLECTIONS(baselineSecondEpoch.begin(), baselineSecondEpoch.end(), secondEpoch.begin(), secondEpoch.end());
+    }
+}
+
 
 BOOST_AUTO_TEST_CASE(BlockRandomizerInstantiate)
 {
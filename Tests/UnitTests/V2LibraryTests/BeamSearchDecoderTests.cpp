@@ -0,0 +1,277 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Common.h"
+#include <chrono>
+#include <numeric>
+
+using namespace CNTK;
+
+namespace CNTK { namespace Test {
+
+// A toy sequence-to-sequence model: the encoder maps a source sequence to the initial hidden state and to a context
+// vector that stays the same during decoding; the decoder is a simple recurrent step over the previous token.
+struct Seq2SeqModel
+{
+    Variable source;
+    FunctionPtr encoder;
+
+    Variable token;
+    Variable hiddenState;
+    Variable context;
+    FunctionPtr decoder;
+    Variable scores;
+    Variable nextHiddenState;
+
+    size_t vocabularySize;
+    static const size_t StartToken = 0;
+    static const size_t EndToken = 1;
+};
+
+Seq2SeqModel CreateSeq2SeqModel(size_t sourceDim, size_t hiddenDim, size_t vocabularySize, const DeviceDescriptor& device)
+{
+    Seq2SeqModel model;
+    model.vocabularySize = vocabularySize;
+
+    model.source = InputVariable({ sourceDim }, DataType::Float, L"source");
+    auto encoded = Tanh(FullyConnectedLinearLayer(model.source, hiddenDim, device, L"", 1));
+    model.encoder = Combine({ Sequence::Last(encoded), Sequence::ReduceSum(FullyConnectedLinearLayer(model.source, hiddenDim, device, L"", 2)) });
+
+    auto batchAxis = std::vector<Axis>({ Axis::DefaultBatchAxis() });
+    model.token = InputVariable({ vocabularySize }, /*isSparse =*/ true, DataType::Float, L"token", batchAxis);
+    model.hiddenState = InputVariable({ hiddenDim }, DataType::Float, L"hiddenState", batchAxis);
+    model.context = InputVariable({ hiddenDim }, DataType::Float, L"context", batchAxis);
+
+    auto embedding = Parameter({ hiddenDim, vocabularySize }, DataType::Float, GlorotUniformInitializer(DefaultParamInitScale, SentinelValueForInferParamInitRank, SentinelValueForInferParamInitRank, 3), device);
+    auto recurrence = Parameter({ hiddenDim, hiddenDim }, DataType::Float, GlorotUniformInitializer(DefaultParamInitScale, SentinelValueForInferParamInitRank, SentinelValueForInferParamInitRank, 4), device);
+    auto next = Tanh(Plus(Plus(Times(embedding, model.token), Times(recurrence, model.hiddenState)), model.context));
+
+    // Make the end token likely enough for hypotheses to end at different lengths.
+    std::vector<float> bias(vocabularySize, 0.0f);
+    bias[Seq2SeqModel::EndToken] = 1.5f;
+    auto outputBias = Parameter(MakeSharedObject<NDArrayView>(NDShape({ vocabularySize }), bias, false)->DeepClone(device));
+    auto output = Parameter({ vocabularySize, hiddenDim }, DataType::Float, GlorotUniformInitializer(4 * DefaultParamInitScale, SentinelValueForInferParamInitRank, SentinelValueForInferParamInitRank, 5), device);
+    auto scores = Plus(Times(output, next), outputBias);
+
+    model.decoder = Combine({ scores, next });
+    model.scores = scores;
+    model.nextHiddenState = next;
+    return model;
+}
+
+BeamSearchDecoderPtr CreateDecoder(const Seq2SeqModel& model, const BeamSearchOptions& options)
+{
+    return CreateBeamSearchDecoder(model.encoder, model.decoder, model.token, model.scores,
+                                   { model.hiddenState, model.context }, { model.nextHiddenState, model.context },
+                                   Seq2SeqModel::StartToken, Seq2SeqModel::EndToken, options);
+}
+
+std::vector<std::vector<float>> GenerateSourceSequences(size_t numSequences, size_t sourceDim)
+{
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_int_distribution<size_t> length(2, 8);
+    std::vector<std::vector<float>> sequences(numSequences);
+    for (auto& sequence : sequences)
+    {
+        sequence.resize(length(rng) * sourceDim);
+        for (auto& v : sequence)
+            v = value(rng);
+    }
+    return sequences;
+}
+
+// Decodes one hypothesis at a time, one step per evaluation of the decoder, the way a step-wise loop in Python does.
+class StepwiseDecoder
+{
+public:
+    StepwiseDecoder(const Seq2SeqModel& model, const std::vector<float>& source, size_t sourceDim, const DeviceDescriptor& device)
+        : m_model(model), m_device(device)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { m_model.encoder->Outputs()[0], nullptr }, { m_model.encoder->Outputs()[1], nullptr } };
+        m_model.encoder->Forward({ { m_model.source, Value::Create(NDShape({ sourceDim }), std::vector<std::vector<float>>({ source }), device) } }, outputs, device);
+        m_initialHiddenState = outputs[m_model.encoder->Outputs()[0]];
+        m_context = outputs[m_model.encoder->Outputs()[1]];
+    }
+
+    // Log-probabilities of the next token after 'token' in state 'hiddenState'; updates 'hiddenState'.
+    std::vector<double> Step(size_t token, ValuePtr& hiddenState)
+    {
+        std::unordered_map<Variable, ValuePtr> arguments = {
+            { m_model.token, Value::CreateBatch<float>(m_model.vocabularySize, std::vector<size_t>({ token }), m_device) },
+            { m_model.hiddenState, hiddenState },
+            { m_model.context, m_context } };
+        std::unordered_map<Variable, ValuePtr> outputs = { { m_model.scores, nullptr }, { m_model.nextHiddenState, nullptr } };
+        m_model.decoder->Forward(arguments, outputs, m_device);
+        hiddenState = outputs[m_model.nextHiddenState]->DeepClone();
+
+        auto scores = outputs[m_model.scores]->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+        auto data = scores->DataBuffer<float>();
+        double maxScore = *std::max_element(data, data + m_model.vocabularySize);
+        double sum = 0;
+        for (size_t i = 0; i < m_model.vocabularySize; i++)
+            sum += std::exp(data[i] - maxScore);
+        std::vector<double> logProbabilities(m_model.vocabularySize);
+        for (size_t i = 0; i < m_model.vocabularySize; i++)
+            logProbabilities[i] = data[i] - maxScore - std::log(sum);
+        return logProbabilities;
+    }
+
+    // Log-probability of the hypothesis 'tokens', followed by the end token if 'finished'.
+    double Score(const std::vector<size_t>& tokens, bool finished)
+    {
+        auto hiddenState = m_initialHiddenState;
+        size_t previous = Seq2SeqModel::StartToken;
+        double logProbability = 0;
+        for (size_t i = 0; i < tokens.size() + (finished ? 1 : 0); i++)
+        {
+            auto next = (i < tokens.size()) ? tokens[i] : Seq2SeqModel::EndToken;
+            logProbability += Step(previous, hiddenState)[next];
+            previous = next;
+        }
+        return logProbability;
+    }
+
+    std::vector<size_t> Greedy(size_t maxLength)
+    {
+        auto hiddenState = m_initialHiddenState;
+        std::vector<size_t> tokens;
+        size_t previous = Seq2SeqModel::StartToken;
+        for (size_t length = 1; length <= maxLength; length++)
+        {
+            auto logProbabilities = Step(previous, hiddenState);
+            previous = std::max_element(logProbabilities.begin(), logProbabilities.end()) - logProbabilities.begin();
+            if (previous == Seq2SeqModel::EndToken)
+                break;
+            tokens.push_back(previous);
+        }
+        return tokens;
+    }
+
+private:
+    const Seq2SeqModel& m_model;
+    DeviceDescriptor m_device;
+    ValuePtr m_initialHiddenState;
+    ValuePtr m_context;
+};
+
+void TestBeamSearchDecoder(const DeviceDescriptor& device)
+{
+    const size_t sourceDim = 8;
+    const size_t numRequests = 6;
+    auto model = CreateSeq2SeqModel(sourceDim, 16, 20, device);
+    auto sources = GenerateSourceSequences(numRequests, sourceDim);
+    auto sourceValue = Value::Create(NDShape({ sourceDim }), sources, device);
+
+    // With a beam of 1, beam search is greedy decoding.
+    BeamSearchOptions greedyOptions;
+    greedyOptions.beamWidth = 1;
+    greedyOptions.maxLength = 10;
+    auto greedyResults = CreateDecoder(model, greedyOptions)->Decode({ { model.source, sourceValue } }, device);
+    BOOST_TEST(greedyResults.size() == numRequests);
+    for (size_t r = 0; r < numRequests; r++)
+    {
+        BOOST_TEST(greedyResults[r].size() == 1);
+        BOOST_TEST(greedyResults[r][0].tokens == StepwiseDecoder(model, sources[r], sourceDim, device).Greedy(greedyOptions.maxLength));
+    }
+
+    for (auto earlyStopping : { true, false })
+    {
+        BeamSearchOptions options;
+        options.beamWidth = 4;
+        options.maxLength = 10;
+        options.lengthPenalty = 0.6;
+        options.earlyStopping = earlyStopping;
+        auto decoder = CreateDecoder(model, options);
+        auto results = decoder->Decode({ { model.source, sourceValue } }, device);
+        BOOST_TEST(results.size() == numRequests);
+
+        for (size_t r = 0; r < numRequests; r++)
+        {
+            BOOST_TEST(!results[r].empty());
+            BOOST_TEST(results[r].size() <= options.beamWidth);
+
+            // The hypotheses are ranked by their length-normalized log-probability, which a step-wise evaluation reproduces.
+            StepwiseDecoder reference(model, sources[r], sourceDim, device);
+            for (size_t i = 0; i < results[r].size(); i++)
+            {
+                const auto& hypothesis = results[r][i];
+                if (i > 0)
+                    BOOST_TEST(hypothesis.score <= results[r][i - 1].score);
+                BOOST_TEST(hypothesis.finished == (hypothesis.tokens.size() < options.maxLength));
+                BOOST_TEST(std::abs(hypothesis.logProbability - reference.Score(hypothesis.tokens, hypothesis.finished)) < 1e-3 * (1 + std::abs(hypothesis.logProbability)));
+                auto length = hypothesis.tokens.size() + (hypothesis.finished ? 1 : 0);
+                BOOST_TEST(std::abs(hypothesis.score - hypothesis.logProbability / std::pow((5.0 + length) / 6.0, options.lengthPenalty)) < 1e-9);
+            }
+
+            // Requests are decoded independently of the others in the batch.
+            auto alone = decoder->Decode({ { model.source, Value::Create(NDShape({ sourceDim }), std::vector<std::vector<float>>({ sources[r] }), device) } }, device);
+            BOOST_TEST(alone[0].size() == results[r].size());
+            for (size_t i = 0; i < alone[0].size() && i < results[r].size(); i++)
+                BOOST_TEST(alone[0][i].tokens == results[r][i].tokens);
+        }
+    }
+}
+
+// Reports the throughput of beam search with the hypotheses of all requests in one batch, against decoding them
+// one hypothesis and one step at a time. The latter does not include the overhead of a Python loop, so the actual
+// gain over such a loop is larger.
+void TestBeamSearchDecoderThroughput(const DeviceDescriptor& device)
+{
+    const size_t sourceDim = 64;
+    const size_t numRequests = 32;
+    auto model = CreateSeq2SeqModel(sourceDim, 256, 2000, device);
+    auto sources = GenerateSourceSequences(numRequests, sourceDim);
+    auto sourceValue = Value::Create(NDShape({ sourceDim }), sources, device);
+
+    BeamSearchOptions options;
+    options.beamWidth = 4;
+    options.maxLength = 20;
+    auto decoder = CreateDecoder(model, options);
+    decoder->Decode({ { model.source, sourceValue } }, device); // warm up
+
+    auto start = std::chrono::high_resolution_clock::now();
+    decoder->Decode({ { model.source, sourceValue } }, device);
+    double batchedSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    double batchedTokensPerSecond = decoder->NumTokensScored() / batchedSeconds;
+
+    // As many single-hypothesis steps as the batched decoding took, spread over the requests.
+    StepwiseDecoder stepwise(model, sources[0], sourceDim, device);
+    std::vector<size_t> tokens(std::min<size_t>(decoder->NumTokensScored(), 2000));
+    for (size_t i = 0; i < tokens.size(); i++)
+        tokens[i] = 2 + i % (model.vocabularySize - 2);
+    start = std::chrono::high_resolution_clock::now();
+    stepwise.Score(tokens, false);
+    double stepwiseSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    double stepwiseTokensPerSecond = tokens.size() / stepwiseSeconds;
+
+    BOOST_TEST_MESSAGE("Beam search of " << numRequests << " requests, beam " << options.beamWidth << ": " << decoder->NumSteps() << " steps, "
+                       << batchedTokensPerSecond << " tokens/s batched, " << stepwiseTokensPerSecond << " tokens/s step-wise");
+    BOOST_TEST(batchedTokensPerSecond > stepwiseTokensPerSecond);
+}
+
+BOOST_AUTO_TEST_SUITE(BeamSearchDecoderSuite)
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBeamSearchDecoder(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestBeamSearchDecoder(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderThroughputInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBeamSearchDecoderThroughput(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}
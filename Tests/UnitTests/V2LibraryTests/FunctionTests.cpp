@@ -6,6 +6,14 @@
 #include "CNTKLibrary.h"
 #include "Common.h"
 #include <numeric>
+#include <map>
+#include <fstream>
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace CNTK;
 
@@ -1096,6 +1104,280 @@ void SetRandomSeed(const DeviceDescriptor& device)
     FloatingPointVectorCompare(result2, result4, "SetRandomSeed: output does match the expected after resetting the dropout seed.");
 }
 
+// the buffers of the parameters of 'function', by uid
+std::map<std::wstring, const float*> ParameterBuffers(const FunctionPtr& function)
+{
+    std::map<std::wstring, const float*> buffers;
+    for (const auto& parameter : function->Parameters())
+        buffers[parameter.Uid()] = parameter.Value()->DataBuffer<float>();
+    return buffers;
+}
+
+// the values of the parameters of 'function', by uid
+std::map<std::wstring, std::vector<float>> ParameterValues(const FunctionPtr& function)
+{
+    std::map<std::wstring, std::vector<float>> values;
+    for (const auto& parameter : function->Parameters())
+    {
+        auto data = parameter.Value()->DataBuffer<float>();
+        values[parameter.Uid()].assign(data, data + parameter.Shape().TotalSize());
+    }
+    return values;
+}
+
+// Multiplies the values of all parameters of 'function' by 'factor'.
+void ScaleParameters(const FunctionPtr& function, float factor)
+{
+    for (const auto& parameter : function->Parameters())
+    {
+        auto data = parameter.Value()->WritableDataBuffer<float>();
+        for (size_t i = 0; i < parameter.Shape().TotalSize(); i++)
+            data[i] *= factor;
+    }
+}
+
+// (the names passed through the environment are ASCII)
+std::string GetTestEnvironment(const char* name)
+{
+    auto value = getenv(name);
+    return value ? value : "";
+}
+
+void SetTestEnvironment(const char* name, const std::string& value)
+{
+#ifdef _WIN32
+    _putenv_s(name, value.c_str());
+#else
+    setenv(name, value.c_str(), 1);
+#endif
+}
+
+// Runs the test case SharedWeightsAttachInCPU in a new process of this executable, which attaches to the segment
+// 'segmentName' with the model in 'modelFile'. Returns true if it succeeded.
+bool RunSharedWeightsAttachProcess(const std::wstring& modelFile, const std::wstring& segmentName)
+{
+    SetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_MODEL", std::string(modelFile.begin(), modelFile.end()));
+    SetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_SEGMENT", std::string(segmentName.begin(), segmentName.end()));
+    std::string command = std::string("\"") + boost::unit_test::framework::master_test_suite().argv[0] + "\" --run_test=FunctionSuite/SharedWeightsAttachInCPU";
+#ifdef _WIN32
+    command = "\"" + command + "\""; // cmd.exe removes the outer quotes
+#endif
+    int status = system(command.c_str());
+    SetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_MODEL", "");
+    SetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_SEGMENT", "");
+    return status == 0;
+}
+
+std::wstring SharedWeightsSegmentName(const std::wstring& prefix)
+{
+#ifdef _WIN32
+    return prefix + std::to_wstring(GetCurrentProcessId());
+#else
+    return prefix + std::to_wstring(getpid());
+#endif
+}
+
+void TestSharedWeights(const DeviceDescriptor& device)
+{
+    const size_t dim = 256;
+    const size_t numClones = 4;
+
+    auto input = InputVariable({ dim }, DataType::Float, L"features");
+    auto model = FullyConnectedLinearLayer(FullyConnectedDNNLayer(input, dim, device, [](const FunctionPtr& f) { return ReLU(f); }), dim, device);
+    auto expected = CreateForwardFunctor(device, input)(model);
+
+    std::map<std::wstring, NDArrayViewPtr> values;
+    for (const auto& parameter : model->Parameters())
+        values[parameter.Uid()] = parameter.Value();
+    auto buffers = ParameterBuffers(model);
+
+    // Clones that share parameters hold the same values, also once their networks are compiled.
+    for (size_t i = 0; i < numClones; i++)
+    {
+        auto clone = model->Clone(ParameterCloningMethod::Share);
+        FloatingPointVectorCompare(CreateForwardFunctor(device, clone->Arguments()[0])(clone), expected,
+                                   "SharedWeights: output of a clone does not match the output of the original.");
+        for (const auto& parameter : clone->Parameters())
+            BOOST_TEST((parameter.Value() == values[parameter.Uid()]), "SharedWeights: a clone does not share the value of a parameter.");
+        BOOST_TEST((ParameterBuffers(clone) == buffers), "SharedWeights: a clone does not share the buffer of a parameter.");
+    }
+
+    // The segment is created with the values of the first load of the model, which differ from the ones in the file,
+    // and a second load that is bound to it takes them over.
+    const std::wstring modelFile = L"SharedWeights.model";
+    const std::wstring segmentName = SharedWeightsSegmentName(L"CNTKSharedWeightsTest");
+    model->Save(modelFile);
+
+    auto first = Function::Load(modelFile, device);
+    ScaleParameters(first, 2);
+    auto firstValues = ParameterValues(first);
+    BOOST_TEST(firstValues.size() == buffers.size());
+    BOOST_TEST(Internal::ShareWeightsAcrossProcesses(first, segmentName));
+    auto firstOutput = CreateForwardFunctor(device, first->Arguments()[0])(first);
+
+    auto second = Function::Load(modelFile, device);
+    BOOST_TEST(!Internal::ShareWeightsAcrossProcesses(second, segmentName));
+    BOOST_TEST((ParameterValues(second) == firstValues), "SharedWeights: a model that attached to the segment does not hold its values.");
+    FloatingPointVectorCompare(CreateForwardFunctor(device, second->Arguments()[0])(second), firstOutput,
+                               "SharedWeights: output of the model that attached to the segment does not match the one that created it.");
+
+    // So does another process.
+    BOOST_TEST(RunSharedWeightsAttachProcess(modelFile, segmentName), "SharedWeights: a process that attached to the segment failed.");
+
+    // The segment is mapped copy-on-write by each load: a write is seen by the clones of a load, but not by the other load.
+    auto firstClone = first->Clone(ParameterCloningMethod::Share);
+    ScaleParameters(first, 3);
+    BOOST_TEST((ParameterValues(firstClone) == ParameterValues(first)), "SharedWeights: a clone does not see a write to a shared parameter.");
+    BOOST_TEST((ParameterValues(second) == firstValues), "SharedWeights: a write to a parameter is seen by another model bound to the segment.");
+
+    // A model with different parameters is refused.
+    auto other = FullyConnectedLinearLayer(input, dim, device);
+    VerifyException([&]() { Internal::ShareWeightsAcrossProcesses(other, segmentName); }, "A model with different parameters was bound to a shared weight segment.");
+
+    Internal::RemoveSharedWeights(segmentName);
+    _wunlink(modelFile.c_str());
+}
+
+// The part of TestSharedWeights that runs in another process: the segment holds twice the values of the model file.
+void TestSharedWeightsAttach(const std::wstring& modelFile, const std::wstring& segmentName, const DeviceDescriptor& device)
+{
+    auto model = Function::Load(modelFile, device);
+    auto modelValues = ParameterValues(model);
+    BOOST_TEST(!Internal::ShareWeightsAcrossProcesses(model, segmentName), "SharedWeights: a process created the segment instead of attaching to it.");
+
+    auto values = ParameterValues(model);
+    BOOST_REQUIRE(values.size() == modelValues.size());
+    for (auto& value : modelValues)
+    {
+        for (auto& element : value.second)
+            element *= 2;
+        BOOST_TEST((values[value.first] == value.second), "SharedWeights: a process that attached to the segment does not see its values.");
+    }
+}
+
+// Private (anonymous) and shared memory resident in this process.
+struct ResidentMemory
+{
+    int64_t privateBytes;
+    int64_t sharedBytes;
+};
+
+ResidentMemory GetResidentMemory()
+{
+    ResidentMemory memory = { 0, 0 };
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS_EX counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters));
+    memory.privateBytes = counters.PrivateUsage;
+    memory.sharedBytes = counters.WorkingSetSize - counters.PrivateUsage;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 8, "RssAnon:") == 0)
+            memory.privateBytes = std::stoll(line.substr(8)) * 1024;
+        else if (line.compare(0, 9, "RssShmem:") == 0)
+            memory.sharedBytes = std::stoll(line.substr(9)) * 1024;
+    }
+#endif
+    return memory;
+}
+
+// Not a correctness test: reports how much resident memory clones of a model take, and loads of it with and without a
+// shared weight segment. Copy-on-write views are charged in full to the private memory on Windows.
+// Freed memory is not necessarily returned to the system, so that the numbers may be too low, but not too high.
+void ReportSharedWeightsMemory(const DeviceDescriptor& device)
+{
+    const size_t dim = 2048;
+    const size_t numCopies = 8;
+    const size_t parameterBytes = 2 * dim * (dim + 1) * sizeof(float);
+
+    auto input = InputVariable({ dim }, DataType::Float, L"features");
+    auto model = FullyConnectedLinearLayer(FullyConnectedDNNLayer(input, dim, device, [](const FunctionPtr& f) { return ReLU(f); }), dim, device);
+    CreateForwardFunctor(device, input)(model);
+
+    auto report = [&](const std::string& what, const ResidentMemory& before)
+    {
+        auto after = GetResidentMemory();
+        BOOST_TEST_MESSAGE("SharedWeights: " << numCopies << " " << what << " of a model with " << parameterBytes / 1024 << " KB of parameters took "
+                           << (after.privateBytes - before.privateBytes) / 1024 << " KB of private and "
+                           << (after.sharedBytes - before.sharedBytes) / 1024 << " KB of shared memory");
+    };
+
+    std::vector<FunctionPtr> copies;
+    auto before = GetResidentMemory();
+    for (size_t i = 0; i < numCopies; i++)
+    {
+        copies.push_back(model->Clone(ParameterCloningMethod::Share));
+        CreateForwardFunctor(device, copies.back()->Arguments()[0])(copies.back());
+    }
+    report("clones sharing parameters", before);
+    copies.clear();
+
+    const std::wstring modelFile = L"SharedWeightsMemory.model";
+    const std::wstring segmentName = SharedWeightsSegmentName(L"CNTKSharedWeightsMemory");
+    model->Save(modelFile);
+    for (bool share : { false, true })
+    {
+        before = GetResidentMemory();
+        for (size_t i = 0; i < numCopies; i++)
+        {
+            copies.push_back(Function::Load(modelFile, device));
+            if (share)
+                Internal::ShareWeightsAcrossProcesses(copies.back(), segmentName);
+            CreateForwardFunctor(device, copies.back()->Arguments()[0])(copies.back());
+        }
+        report(share ? "loads sharing a segment" : "loads", before);
+        copies.clear();
+    }
+
+    Internal::RemoveSharedWeights(segmentName);
+    _wunlink(modelFile.c_str());
+}
+
+void TestShapeSpecializationCache(const DeviceDescriptor& device)
+{
+    const size_t numChannels = 2;
+    const size_t numFilters = 3;
+    auto input = InputVariable({ NDShape::FreeDimension, NDShape::FreeDimension, numChannels }, DataType::Float, L"images");
+    auto kernel = Parameter({ 3, 3, numChannels, numFilters }, DataType::Float, GlorotUniformInitializer(), device);
+    auto model = Pooling(Convolution(kernel, input, { 1, 1, numChannels }), PoolingType::Max, { 2, 2 }, { 2, 2 });
+
+    auto evaluate = [&](size_t width, size_t height) {
+        NDShape shape = { width, height, numChannels };
+        std::vector<float> inputData(shape.TotalSize());
+        for (size_t i = 0; i < inputData.size(); i++)
+            inputData[i] = (float)(i % 7) / 7;
+        auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(shape.AppendShape({ 1, 1 }), inputData, false));
+        std::unordered_map<Variable, ValuePtr> outputs = { { model->Output(), nullptr } };
+        model->Forward({ { input, inputValue } }, outputs, device);
+        auto result = outputs[model->Output()]->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+        return std::vector<float>(result->DataBuffer<float>(), result->DataBuffer<float>() + result->Shape().TotalSize());
+    };
+
+    // Once both shapes have been seen, switching between them reuses what was built for each.
+    auto first = evaluate(8, 8);
+    auto second = evaluate(12, 10);
+    auto hits = Internal::GetShapeSpecializationCacheHits();
+    auto misses = Internal::GetShapeSpecializationCacheMisses();
+    for (size_t i = 0; i < 3; i++)
+    {
+        FloatingPointVectorCompare(evaluate(8, 8), first, "ShapeSpecializationCache: output for a shape seen before does not match.");
+        FloatingPointVectorCompare(evaluate(12, 10), second, "ShapeSpecializationCache: output for a shape seen before does not match.");
+    }
+    BOOST_TEST(Internal::GetShapeSpecializationCacheMisses() == misses);
+    BOOST_TEST(Internal::GetShapeSpecializationCacheHits() > hits);
+
+    // Without it, every switch rebuilds the state.
+    auto capacity = Internal::GetShapeSpecializationCacheCapacity();
+    Internal::SetShapeSpecializationCacheCapacity(0);
+    Internal::ResetShapeSpecializationCacheCounters();
+    FloatingPointVectorCompare(evaluate(8, 8), first, "ShapeSpecializationCache: output without the cache does not match.");
+    BOOST_TEST(Internal::GetShapeSpecializationCacheHits() == 0);
+    Internal::SetShapeSpecializationCacheCapacity(capacity);
+}
+
 BOOST_AUTO_TEST_SUITE(FunctionSuite)
 
 BOOST_AUTO_TEST_CASE(FindNameInCPU)
@@ -1222,6 +1504,39 @@ BOOST_AUTO_TEST_CASE(TestSettingRandomSeed)
         SetRandomSeed(DeviceDescriptor::GPUDevice(0));
 }
 
+BOOST_AUTO_TEST_CASE(SharedWeightsInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestSharedWeights(DeviceDescriptor::CPUDevice());
+}
+
+// Runs in the process started by TestSharedWeights, which names the model and the segment in the environment.
+BOOST_AUTO_TEST_CASE(SharedWeightsAttachInCPU)
+{
+    auto modelFile = GetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_MODEL");
+    auto segmentName = GetTestEnvironment("CNTK_SHARED_WEIGHTS_TEST_SEGMENT");
+    if (ShouldRunOnCpu() && !modelFile.empty() && !segmentName.empty())
+        TestSharedWeightsAttach(std::wstring(modelFile.begin(), modelFile.end()), std::wstring(segmentName.begin(), segmentName.end()), DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(SharedWeightsMemoryInCPU)
+{
+    if (ShouldRunOnCpu())
+        ReportSharedWeightsMemory(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(ShapeSpecializationCacheInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestShapeSpecializationCache(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(ShapeSpecializationCacheInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestShapeSpecializationCache(DeviceDescriptor::GPUDevice(0));
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
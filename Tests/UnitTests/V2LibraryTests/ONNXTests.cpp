@@ -0,0 +1,269 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <chrono>
+#include <fstream>
+#include "CNTKLibrary.h"
+#include "Common.h"
+
+using namespace CNTK;
+
+namespace CNTK { namespace Test {
+
+// The tests write their ONNX models with the few protobuf encoding rules they need (field numbers of onnx-ml.proto),
+// so that they do not depend on the protobuf library and the generated ONNX classes, which CNTKLibrary keeps internal.
+namespace ONNXProto
+{
+    void AppendVarint(std::string& message, uint64_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            message.push_back((char)((value & 0x7f) | 0x80));
+        message.push_back((char)value);
+    }
+
+    void AppendInt(std::string& message, int field, uint64_t value)
+    {
+        AppendVarint(message, (uint64_t)field << 3);
+        AppendVarint(message, value);
+    }
+
+    void AppendBytes(std::string& message, int field, const std::string& bytes)
+    {
+        AppendVarint(message, ((uint64_t)field << 3) | 2);
+        AppendVarint(message, bytes.size());
+        message += bytes;
+    }
+
+    std::string StringStringEntry(const std::string& key, const std::string& value)
+    {
+        std::string entry;
+        AppendBytes(entry, 1, key);
+        AppendBytes(entry, 2, value);
+        return entry;
+    }
+
+    // A float TensorProto whose data is 'data' if 'location' is empty, or the 'length' bytes at 'offset' of the file 'location'.
+    std::string FloatTensor(const std::string& name, const std::vector<size_t>& dims, const std::vector<float>& data,
+                            const std::string& location = "", size_t offset = 0, size_t length = 0)
+    {
+        std::string tensor;
+        for (auto dim : dims)
+            AppendInt(tensor, 1, dim);
+        AppendInt(tensor, 2, 1); // FLOAT
+        AppendBytes(tensor, 8, name);
+        if (location.empty())
+            AppendBytes(tensor, 9, std::string((const char*)data.data(), data.size() * sizeof(float)));
+        else
+        {
+            AppendBytes(tensor, 13, StringStringEntry("location", location));
+            AppendBytes(tensor, 13, StringStringEntry("offset", std::to_string(offset)));
+            AppendBytes(tensor, 13, StringStringEntry("length", std::to_string(length)));
+            AppendInt(tensor, 14, 1); // EXTERNAL
+        }
+        return tensor;
+    }
+
+    std::string FloatValueInfo(const std::string& name, const std::vector<size_t>& dims)
+    {
+        std::string shape;
+        for (auto dim : dims)
+        {
+            std::string dimension;
+            AppendInt(dimension, 1, dim);
+            AppendBytes(shape, 1, dimension);
+        }
+        std::string tensorType;
+        AppendInt(tensorType, 1, 1); // FLOAT
+        AppendBytes(tensorType, 2, shape);
+        std::string type;
+        AppendBytes(type, 1, tensorType);
+        std::string valueInfo;
+        AppendBytes(valueInfo, 1, name);
+        AppendBytes(valueInfo, 2, type);
+        return valueInfo;
+    }
+
+    std::string Node(const std::string& opType, const std::vector<std::string>& inputs, const std::string& output)
+    {
+        std::string node;
+        for (const auto& input : inputs)
+            AppendBytes(node, 1, input);
+        AppendBytes(node, 2, output);
+        AppendBytes(node, 3, output);
+        AppendBytes(node, 4, opType);
+        return node;
+    }
+
+    void WriteModel(const std::wstring& filePath, const std::vector<std::string>& nodes, const std::vector<std::string>& initializers,
+                    const std::string& output)
+    {
+        std::string graph;
+        for (const auto& node : nodes)
+            AppendBytes(graph, 1, node);
+        AppendBytes(graph, 2, "graph");
+        for (const auto& initializer : initializers)
+            AppendBytes(graph, 5, initializer);
+        AppendBytes(graph, 12, output);
+
+        std::string model;
+        AppendInt(model, 1, 3); // ir_version
+        AppendBytes(model, 2, "CNTK");
+        AppendBytes(model, 7, graph);
+
+        std::ofstream file(std::string(filePath.begin(), filePath.end()), std::ios::binary);
+        file.write(model.data(), model.size());
+    }
+}
+
+std::vector<float> RandomFloats(size_t count)
+{
+    std::uniform_real_distribution<float> distribution(-1, 1);
+    std::vector<float> values(count);
+    for (auto& value : values)
+        value = distribution(rng);
+    return values;
+}
+
+void WriteBytes(const std::wstring& filePath, const std::string& bytes)
+{
+    std::ofstream file(std::string(filePath.begin(), filePath.end()), std::ios::binary);
+    file.write(bytes.data(), bytes.size());
+}
+
+std::vector<float> ConstantValue(const FunctionPtr& function, const std::wstring& name)
+{
+    for (const auto& constant : function->Constants())
+    {
+        if (constant.Name() == name)
+        {
+            auto value = constant.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+            return std::vector<float>(value->DataBuffer<float>(), value->DataBuffer<float>() + value->Shape().TotalSize());
+        }
+    }
+    BOOST_ERROR("No constant found with the given name");
+    return std::vector<float>();
+}
+
+// Two initializers that are stored back to back in an external file, between other bytes, are added.
+void TestONNXExternalData(const DeviceDescriptor& device)
+{
+    using namespace ONNXProto;
+
+    const std::vector<size_t> dims = { 3, 5 };
+    const size_t byteSize = 3 * 5 * sizeof(float);
+    auto a = RandomFloats(3 * 5);
+    auto b = RandomFloats(3 * 5);
+
+    const std::wstring modelFile = L"ExternalData.onnx";
+    const std::wstring dataFile = L"ExternalData.bin";
+    const std::string header = "header";
+    std::string data = header + std::string((const char*)a.data(), byteSize) + std::string((const char*)b.data(), byteSize) + "trailer";
+    WriteBytes(dataFile, data);
+
+    auto writeModel = [&](const std::string& location)
+    {
+        WriteModel(modelFile, { Node("Add", { "a", "b" }, "sum") },
+                   { FloatTensor("a", dims, a, location, header.size(), byteSize), FloatTensor("b", dims, b, location, header.size() + byteSize, byteSize) },
+                   FloatValueInfo("sum", dims));
+    };
+
+    writeModel(std::string(dataFile.begin(), dataFile.end()));
+    auto function = Function::Load(modelFile, device, ModelFormat::ONNX);
+    FloatingPointVectorCompare(ConstantValue(function, L"a"), a, "ONNXExternalData: the first initializer does not match its external data.");
+    FloatingPointVectorCompare(ConstantValue(function, L"b"), b, "ONNXExternalData: the second initializer does not match its external data.");
+
+    std::unordered_map<Variable, ValuePtr> outputs = { { function->Output(), nullptr } };
+    function->Evaluate({}, outputs, device);
+    std::vector<float> expected(a.size());
+    for (size_t i = 0; i < a.size(); i++)
+        expected[i] = a[i] + b[i];
+    auto result = outputs[function->Output()]->Data()->DeepClone(DeviceDescriptor::CPUDevice());
+    FloatingPointVectorCompare(std::vector<float>(result->DataBuffer<float>(), result->DataBuffer<float>() + result->Shape().TotalSize()), expected,
+                               "ONNXExternalData: the output of the model does not match the sum of its initializers.");
+
+    // The second tensor ends past the end of a short file.
+    WriteBytes(dataFile, data.substr(0, header.size() + byteSize + byteSize / 2));
+    VerifyException([&]() { Function::Load(modelFile, device, ModelFormat::ONNX); }, "Was able to load a model whose external data file is too short.");
+
+    writeModel("Missing.bin");
+    VerifyException([&]() { Function::Load(modelFile, device, ModelFormat::ONNX); }, "Was able to load a model whose external data file is missing.");
+
+    _wunlink(modelFile.c_str());
+    _wunlink(dataFile.c_str());
+}
+
+// Not a correctness test: reports the time it takes to load a model with a few large initializers that are stored in
+// the model file, and one with the same initializers in an external file.
+void ReportONNXLoadTime(const DeviceDescriptor& device)
+{
+    using namespace ONNXProto;
+
+    const size_t numInitializers = 16;
+    const std::vector<size_t> dims = { 1024, 1024 };
+    const size_t byteSize = 1024 * 1024 * sizeof(float);
+    const std::wstring modelFile = L"LoadTime.onnx";
+    const std::wstring dataFile = L"LoadTime.bin";
+
+    std::vector<std::vector<float>> values;
+    std::string data;
+    for (size_t i = 0; i < numInitializers; i++)
+    {
+        values.push_back(RandomFloats(1024 * 1024));
+        data.append((const char*)values.back().data(), byteSize);
+    }
+    WriteBytes(dataFile, data);
+
+    for (bool external : { false, true })
+    {
+        std::vector<std::string> nodes, initializers;
+        std::string sum = "w0";
+        for (size_t i = 0; i < numInitializers; i++)
+        {
+            auto name = "w" + std::to_string(i);
+            initializers.push_back(external ? FloatTensor(name, dims, values[i], std::string(dataFile.begin(), dataFile.end()), i * byteSize, byteSize)
+                                            : FloatTensor(name, dims, values[i]));
+            if (i > 0)
+            {
+                nodes.push_back(Node("Add", { sum, name }, "sum" + std::to_string(i)));
+                sum = "sum" + std::to_string(i);
+            }
+        }
+        WriteModel(modelFile, nodes, initializers, FloatValueInfo(sum, dims));
+
+        auto start = std::chrono::steady_clock::now();
+        auto function = Function::Load(modelFile, device, ModelFormat::ONNX);
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        BOOST_TEST_MESSAGE("ONNXLoadTime: " << numInitializers << " initializers of " << byteSize / 1024 << " KB "
+                           << (external ? "in an external file" : "in the model file") << " loaded in " << elapsed << " ms");
+    }
+
+    _wunlink(modelFile.c_str());
+    _wunlink(dataFile.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE(ONNXSuite)
+
+BOOST_AUTO_TEST_CASE(ONNXExternalDataInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestONNXExternalData(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(ONNXExternalDataInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestONNXExternalData(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_CASE(ONNXLoadTimeInCPU)
+{
+    if (ShouldRunOnCpu())
+        ReportONNXLoadTime(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}
@@ -957,6 +957,46 @@ void TestLoadingModelFromMemoryBufferWithException()
     delete[] modelBuffer;
 }
 
+uint32_t ReadModelFilePrefix(const std::wstring& filePath)
+{
+    uint32_t prefix = 0;
+    auto stream = GetFstream(filePath, true);
+    stream->read(reinterpret_cast<char*>(&prefix), sizeof(prefix));
+    return prefix;
+}
+
+void TestMappableModelSaveAndLoad(const DeviceDescriptor& device)
+{
+    const std::wstring modelFile = L"TestMappableModelSaveAndLoad.model";
+    const uint32_t alignedMagicNumber = 0x636e746dU;
+    auto inputVar = InputVariable({ 20 }, false, DataType::Float, L"features");
+    auto function = BuildFFClassifierNet(inputVar, 10, device);
+
+    // models are saved in the aligned layout only on request
+    function->Save(modelFile);
+    BOOST_TEST(ReadModelFilePrefix(modelFile) != alignedMagicNumber);
+
+    Internal::EnableMappableModelSaving();
+    function->Save(modelFile);
+    Internal::DisableMappableModelSaving();
+    BOOST_TEST(ReadModelFilePrefix(modelFile) == alignedMagicNumber);
+
+    auto copiedFunction = Function::Load(modelFile, device);
+
+    Internal::EnableMemoryMappedModelLoading();
+    auto mappedFunction = Function::Load(modelFile, device);
+    Internal::DisableMemoryMappedModelLoading();
+
+    if (!AreEqual(function, copiedFunction))
+        BOOST_ERROR("TestMappableModelSaveAndLoad: original function and function loaded without mapping are not identical.");
+    if (!AreEqual(function, mappedFunction))
+        BOOST_ERROR("TestMappableModelSaveAndLoad: original function and memory mapped function are not identical.");
+
+    mappedFunction = nullptr; // releases the mapping
+    copiedFunction = nullptr;
+    _wunlink(modelFile.c_str());
+}
+
 BOOST_AUTO_TEST_SUITE(SerializationSuite)
 
 BOOST_AUTO_TEST_CASE(LoadingModelFromMemoryBuffer)
@@ -1029,6 +1069,11 @@ BOOST_AUTO_TEST_CASE(CheckpointingInCPU)
     TestCheckpointing(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(MappableModelSaveAndLoadInCPU)
+{
+    TestMappableModelSaveAndLoad(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(LegacyModelSavingInCPU)
 {
     TestLegacyModelSaving(DeviceDescriptor::CPUDevice());
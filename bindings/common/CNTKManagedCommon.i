@@ -244,11 +244,16 @@ IGNORE_CLASS CNTK::DistributedCommunicator;
 IGNORE_CLASS CNTK::QuantizedDistributedCommunicator;
 IGNORE_FUNCTION CNTK::MPICommunicator;
 IGNORE_FUNCTION CNTK::QuantizedMPICommunicator;
+IGNORE_FUNCTION CNTK::SparsifiedMPICommunicator;
 IGNORE_STRUCT CNTK::CrossValidationConfig;
 IGNORE_STRUCT CNTK::CheckpointConfig;
 IGNORE_STRUCT CNTK::TestConfig;
 IGNORE_CLASS CNTK::TrainingSession;
 IGNORE_FUNCTION CNTK::CreateBasicTrainingSession;
+IGNORE_STRUCT CNTK::BeamSearchOptions;
+IGNORE_STRUCT CNTK::BeamSearchHypothesis;
+IGNORE_CLASS CNTK::BeamSearchDecoder;
+IGNORE_FUNCTION CNTK::CreateBeamSearchDecoder;
 IGNORE_FUNCTION CNTK::CreateTrainingSession;
 IGNORE_FUNCTION CNTK::CreateDataParallelDistributedTrainer;
 IGNORE_FUNCTION CNTK::CreateQuantizedDataParallelDistributedTrainer;
@@ -302,6 +307,7 @@ IGNORE_FUNCTION CNTK::Internal::StartProfiler;
 IGNORE_FUNCTION CNTK::Internal::StopProfiler;
 IGNORE_FUNCTION CNTK::Internal::EnableProfiler;
 IGNORE_FUNCTION CNTK::Internal::DisableProfiler;
+IGNORE_FUNCTION CNTK::Internal::SetProfilerTraceMode;
 IGNORE_FUNCTION CNTK::Internal::EnableNodeTiming;
 IGNORE_FUNCTION CNTK::Internal::DisableNodeTiming;
 IGNORE_FUNCTION CNTK::Internal::AreEquivalent;
@@ -17,6 +17,8 @@
 
 %threadallow CNTK::Evaluator::TestMinibatch;
 
+%threadallow CNTK::BeamSearchDecoder::Decode;
+
 %threadallow CNTK::TrainingSession::Train;
 
 %include "stl.i"
@@ -157,6 +159,8 @@
 %template() std::vector<std::shared_ptr<CNTK::DistributedLearner>>;
 %template() std::vector<std::shared_ptr<CNTK::Trainer>>;
 %template() std::vector<std::shared_ptr<CNTK::Evaluator>>;
+%template() std::vector<CNTK::BeamSearchHypothesis>;
+%template() std::vector<std::vector<CNTK::BeamSearchHypothesis>>;
 %template() std::vector<std::shared_ptr<CNTK::ProgressWriter>>;
 %template() std::pair<double, double>;
 %template() std::pair<size_t, double>;
@@ -1482,6 +1486,7 @@ std::unordered_map<CNTK::StreamInformation, std::pair<CNTK::NDArrayViewPtr, CNTK
 
 %shared_ptr(CNTK::IDictionarySerializable)
 %shared_ptr(CNTK::Evaluator)
+%shared_ptr(CNTK::BeamSearchDecoder)
 %shared_ptr(CNTK::Trainer)
 %shared_ptr(CNTK::TrainingSession)
 %shared_ptr(CNTK::Function)
@@ -20,6 +20,22 @@ def start_profiler(dir='profiler', sync_gpu=True, reserve_mem=cntk_py.default_pr
     cntk_py.start_profiler(dir, sync_gpu, reserve_mem)
 
 
+def set_profiler_trace_mode(sampling_period=1):
+    '''
+    Switch the profiler to trace mode, for long runs: the detail log, a
+    Chrome/Perfetto trace, keeps the most recent events in the memory
+    reserved by :func:`start_profiler` instead of dropping new events once it
+    is full. Must be called after :func:`start_profiler`. Per-node forward
+    and backward spans also require
+    :func:`~cntk.debugging.debug.set_node_timing`.
+
+    Args:
+        sampling_period (int): record events during one in every
+         ``sampling_period`` minibatches only
+    '''
+    cntk_py.set_profiler_trace_mode(sampling_period)
+
+
 def stop_profiler():
     '''
     Stop profiler from gathering performance statistics and flush them to file
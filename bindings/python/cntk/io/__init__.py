@@ -110,7 +110,7 @@ class MinibatchData(cntk_py.MinibatchData, ArrayMixin):
 
 class MinibatchSource(cntk_py.MinibatchSource):
     '''
-    MinibatchSource(deserializers, max_samples=cntk.io.INFINITELY_REPEAT, max_sweeps=cntk.io.INFINITELY_REPEAT, randomization_window_in_chunks=cntk.io.DEFAULT_RANDOMIZATION_WINDOW, randomization_window_in_samples=0, randomization_seed=0, trace_level=cntk.logging.get_trace_level(), multithreaded_deserializer=None, frame_mode=False, truncation_length=0, randomize=True, max_errors=0)
+    MinibatchSource(deserializers, max_samples=cntk.io.INFINITELY_REPEAT, max_sweeps=cntk.io.INFINITELY_REPEAT, randomization_window_in_chunks=cntk.io.DEFAULT_RANDOMIZATION_WINDOW, randomization_window_in_samples=0, randomization_seed=0, trace_level=cntk.logging.get_trace_level(), multithreaded_deserializer=None, frame_mode=False, truncation_length=0, randomize=True, max_errors=0, number_of_length_buckets=0, number_of_read_ahead_chunks=1, read_ahead_max_bytes=0)
 
     Args:
         deserializers (a single deserializer or a `list`): deserializers to be used in the composite reader
@@ -151,6 +151,13 @@ class MinibatchSource(cntk_py.MinibatchSource):
         randomize (`bool`, defaults to `True`): Enables or disables randomization; use randomization_window_in_chunks or
           randomization_window_in_samples to specify the randomization range
         max_errors (`int`, defaults to `0`): maximum number of errors in the dataset to ignore
+        number_of_length_buckets (`int`, defaults to `0`): if greater than 1 (and randomization is enabled),
+          the sequences of each randomized chunk are sorted into this many buckets by length and the buckets are
+          returned in a random order, so that minibatches contain sequences of similar length and need less padding.
+        number_of_read_ahead_chunks (`int`, defaults to `1`): number of chunks to read ahead of the randomization
+          window in the background (only applicable with randomization). Helps to hide the latency of slow storage.
+        read_ahead_max_bytes (`int`, defaults to `0`): upper bound on the estimated memory size of the chunks read ahead,
+          in bytes (0 means no limit)
     '''
     _runtime_deserializer_table = {}
     _deserializer_factory = None
@@ -193,7 +200,10 @@ class MinibatchSource(cntk_py.MinibatchSource):
         frame_mode=False,
         truncation_length=0,
         randomize=True,
-        max_errors=0):
+        max_errors=0,
+        number_of_length_buckets=0,
+        number_of_read_ahead_chunks=1,
+        read_ahead_max_bytes=0):
 
         if not isinstance(deserializers, (list,tuple)):
             deserializers = [ deserializers ]
@@ -221,6 +231,9 @@ class MinibatchSource(cntk_py.MinibatchSource):
 
         config.trace_level = trace_level
         config.max_errors = max_errors
+        config.number_of_length_buckets = number_of_length_buckets
+        config.number_of_read_ahead_chunks = number_of_read_ahead_chunks
+        config.read_ahead_max_bytes = read_ahead_max_bytes
 
         if not randomize:
             config.randomization_window_in_chunks = 0
@@ -32,6 +32,7 @@ def mpiexec_execute(script, mpiexec_params, params, timeout_seconds=TIMEOUT_SECO
 
 BlockMomentumConfig = collections.namedtuple('BlockMomentumConfig', 'block_momentum_as_time_constant block_learning_rate block_size distributed_after')
 DataParallelConfig = collections.namedtuple('DataParallelConfig', 'num_quantization_bits distributed_after')
+SparsifiedDataParallelConfig = collections.namedtuple('SparsifiedDataParallelConfig', 'density target_bytes_per_step distributed_after')
     
 class SimpleTrainer:
     def __init__(self, mode, config):
@@ -57,6 +58,8 @@ class SimpleTrainer:
                 if config is None:
                     config = DataParallelConfig(num_quantization_bits=32, distributed_after=0)
                 learner = C.data_parallel_distributed_learner(local_learner, num_quantization_bits=config.num_quantization_bits, distributed_after=config.distributed_after)
+            elif mode == 'sparsified_data_parallel':
+                learner = C.train.distributed.sparsified_data_parallel_distributed_learner(local_learner, density=config.density, target_bytes_per_step=config.target_bytes_per_step, distributed_after=config.distributed_after)
             elif mode == 'block_momentum':
                 if config is None:
                     # the default config to match data parallel SGD
@@ -103,6 +106,8 @@ TRAINING_SETTINGS = [
     ('block_momentum', None),
     ('block_momentum', BlockMomentumConfig(block_momentum_as_time_constant=4000, block_learning_rate=2, block_size=NUM_WORKERS*BATCH_SIZE_PER_WORKER*3, distributed_after=NUM_WORKERS*BATCH_SIZE_PER_WORKER*2)),
     ('data_parallel', DataParallelConfig(num_quantization_bits=1, distributed_after=NUM_WORKERS*BATCH_SIZE_PER_WORKER*2)),
+    ('sparsified_data_parallel', SparsifiedDataParallelConfig(density=0.05, target_bytes_per_step=0, distributed_after=0)),
+    ('sparsified_data_parallel', SparsifiedDataParallelConfig(density=0.05, target_bytes_per_step=4096, distributed_after=NUM_WORKERS*BATCH_SIZE_PER_WORKER*2)),
 ]
 
 @pytest.mark.parametrize("mode, config", TRAINING_SETTINGS)
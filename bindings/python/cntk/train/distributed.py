@@ -145,6 +145,30 @@ def data_parallel_distributed_learner(learner, distributed_after=0, num_quantiza
             distributed_after,
             use_async_buffered_parameter_update)
 
+@typemap
+def sparsified_data_parallel_distributed_learner(learner, density=0.01, target_bytes_per_step=0, use_sampled_threshold=False, distributed_after=0):
+    '''
+    Creates a data parallel distributed learner that aggregates only the largest-magnitude
+    gradient entries (top-k sparsification). Entries that are not sent are kept
+    as residuals and added to the gradients of the next minibatch.
+
+    Args:
+        learner: a local learner (i.e. sgd)
+        density (float): fraction of the gradient entries that are sent, in (0, 1]
+        target_bytes_per_step (int): if non-zero, the density is adapted so that
+         every worker sends about this many bytes per minibatch
+        use_sampled_threshold (bool): estimate the selection threshold from a sample
+         of the gradient instead of an exact top-k selection
+        distributed_after (int): number of samples after which distributed training starts
+    Returns:
+        a distributed learner instance
+    '''
+    return cntk_py.create_quantized_data_parallel_distributed_learner(
+        cntk_py.sparsified_mpicommunicator(density, target_bytes_per_step, use_sampled_threshold),
+        learner,
+        distributed_after,
+        False)
+
 @typemap
 def block_momentum_distributed_learner(learner, block_size, block_momentum_as_time_constant=None, use_nestrov_momentum=True, reset_sgd_momentum_after_aggregation=True, block_learning_rate=1.0, distributed_after=0):
     '''